@@ -0,0 +1,84 @@
+/*!
+ *    ________  ________  ________  ________  ________   ___  ___  _________
+ *   |\   ____\|\   __  \|\   ____\|\   __  \|\   ___  \|\  \|\  \|\___   ___\
+ *   \ \  \___|\ \  \|\  \ \  \___|\ \  \|\  \ \  \\ \  \ \  \\\  \|___ \  \_|
+ *    \ \  \    \ \  \\\  \ \  \    \ \  \\\  \ \  \\ \  \ \  \\\  \   \ \  \
+ *     \ \  \____\ \  \\\  \ \  \____\ \  \\\  \ \  \\ \  \ \  \\\  \   \ \  \
+ *      \ \_______\ \_______\ \_______\ \_______\ \__\\ \__\ \_______\   \ \__\
+ *       \|_______|\|_______|\|_______|\|_______|\|__| \|__|\|_______|    \|__|
+ *
+ * \file benchmarks/bench.h
+ * \brief A tiny microbenchmark harness.
+ * \author SiriusNEO
+ */
+
+#ifndef BENCHMARKS_BENCH_H_
+#define BENCHMARKS_BENCH_H_
+
+#include <chrono>
+#include <cstdio>
+#include <iostream>
+
+namespace coconut {
+
+namespace bench {
+
+/*! \brief A benchmark function. It prints its own results. */
+typedef void (*BenchmarkFn)();
+
+/*!
+ * \brief Register a benchmark. Used by the BENCHMARK macro.
+ * \param name The name of the benchmark.
+ * \param fn The benchmark function.
+ * \return Always 0.
+ */
+int registerBenchmark(const char* name, BenchmarkFn fn);
+
+/*!
+ * \brief Time a function.
+ * \param fn The function. It is called once per iteration.
+ * \param iterations Number of iterations.
+ * \return Nanoseconds per iteration.
+ */
+template <typename Fn>
+double nsPerIteration(Fn fn, long iterations) {
+  auto start = std::chrono::steady_clock::now();
+  for (long i = 0; i < iterations; ++i) {
+    fn();
+  }
+  auto end = std::chrono::steady_clock::now();
+  return std::chrono::duration<double, std::nano>(end - start).count() /
+         iterations;
+}
+
+/*!
+ * \brief Mute the logs of the VM (written to std::cout) in a scope, e.g. when
+ * building instructions. Results are printed with printf, so not affected.
+ */
+class QuietLogs {
+ public:
+  QuietLogs() { std::cout.setstate(std::ios::failbit); }
+  ~QuietLogs() { std::cout.clear(); }
+};
+
+/*!
+ * \brief Print a result line.
+ * \param name The name of the case.
+ * \param ns Nanoseconds per operation.
+ */
+inline void report(const char* name, double ns) {
+  printf("  %-44s %10.2f ns/op\n", name, ns);
+}
+
+}  // namespace bench
+
+}  // namespace coconut
+
+// Define and register a benchmark.
+#define BENCHMARK(name)                               \
+  static void name();                                 \
+  static int name##_registered =                      \
+      coconut::bench::registerBenchmark(#name, name); \
+  static void name()
+
+#endif  // BENCHMARKS_BENCH_H_
@@ -0,0 +1,214 @@
+/*!
+ *    ________  ________  ________  ________  ________   ___  ___  _________
+ *   |\   ____\|\   __  \|\   ____\|\   __  \|\   ___  \|\  \|\  \|\___   ___\
+ *   \ \  \___|\ \  \|\  \ \  \___|\ \  \|\  \ \  \\ \  \ \  \\\  \|___ \  \_|
+ *    \ \  \    \ \  \\\  \ \  \    \ \  \\\  \ \  \\ \  \ \  \\\  \   \ \  \
+ *     \ \  \____\ \  \\\  \ \  \____\ \  \\\  \ \  \\ \  \ \  \\\  \   \ \  \
+ *      \ \_______\ \_______\ \_______\ \_______\ \__\\ \__\ \_______\   \ \__\
+ *       \|_______|\|_______|\|_______|\|_______|\|__| \|__|\|_______|    \|__|
+ *
+ * \file benchmarks/bench_bytecode_arith.cc
+ * \brief Per-op cost of arithmetic and comparison instructions: switching on
+ * the operator at runtime (before) vs. template-specialized (after).
+ * \author SiriusNEO
+ */
+
+#include <random>
+#include <vector>
+
+#include "../src/bytecode/bytecode_decoder.h"
+#include "bench.h"
+
+using namespace coconut;
+using namespace coconut::bytecode;
+
+namespace {
+
+// The iarith instruction before specialization: it switches on op_ at every
+// execution. Kept here as the baseline.
+class SwitchedIarith : public InstWithoutOperand {
+ private:
+  ArithmOp op_;
+
+ public:
+  explicit SwitchedIarith(ArithmOp op) : op_(op) {}
+
+  void accept(FrameExecutor* executor) {
+    int value2 = executor->frame->operandStack->popInt();
+    int value1 = executor->frame->operandStack->popInt();
+    int result = 0;
+    switch (op_) {
+      case ADD:
+        result = value1 + value2;
+        break;
+      case SUB:
+        result = value1 - value2;
+        break;
+      case MUL:
+        result = value1 * value2;
+        break;
+      case SHL:
+        result = value1 << (value2 & 0x1f);
+        break;
+      case SHR:
+        result = value1 >> (value2 & 0x1f);
+        break;
+      case AND:
+        result = value1 & value2;
+        break;
+      case OR:
+        result = value1 | value2;
+        break;
+      case XOR:
+        result = value1 ^ value2;
+        break;
+      default:
+        break;
+    }
+    executor->frame->operandStack->pushInt(result);
+  }
+};
+
+// The if_icmp instruction before specialization.
+class SwitchedIfIcmp : public InstWithOffset {
+ private:
+  CmpOp op_;
+
+ public:
+  explicit SwitchedIfIcmp(CmpOp op) : op_(op) { offset_ = 3; }
+
+  void accept(FrameExecutor* executor) {
+    int value2 = executor->frame->operandStack->popInt(),
+        value1 = executor->frame->operandStack->popInt();
+    bool succeed = false;
+    switch (op_) {
+      case EQ:
+        succeed = (value1 == value2);
+        break;
+      case NE:
+        succeed = (value1 != value2);
+        break;
+      case LT:
+        succeed = (value1 < value2);
+        break;
+      case GE:
+        succeed = (value1 >= value2);
+        break;
+      case GT:
+        succeed = (value1 > value2);
+        break;
+      case LE:
+        succeed = (value1 <= value2);
+        break;
+    }
+    if (succeed) {
+      executor->branch(offset_);
+    }
+  }
+};
+
+const long kIterations = 20000000;
+const int kSequenceLen = 4096;  // power of 2
+
+// Opcodes and operators of the int arithmetic in the sequence.
+const uint8_t kArithOpcodes[] = {0x60, 0x64, 0x68, 0x78,
+                                 0x7a, 0x7e, 0x80, 0x82};
+const ArithmOp kArithOps[] = {ADD, SUB, MUL, SHL, SHR, AND, OR, XOR};
+
+// Opcodes and operators of if_icmp<cond>.
+const uint8_t kCmpOpcodes[] = {0x9f, 0xa0, 0xa1, 0xa2, 0xa3, 0xa4};
+const CmpOp kCmpOps[] = {EQ, NE, LT, GE, GT, LE};
+
+// A random sequence of choices in [0, n). With n = 1 all are the same.
+std::vector<int> makeChoices(int n) {
+  std::mt19937 rng(42);
+  std::vector<int> choices(kSequenceLen);
+  for (int& choice : choices) choice = rng() % n;
+  return choices;
+}
+
+// Run the sequence in a frame. Every step pushes two ints, executes the
+// instruction and pops its result (if any).
+double runSequence(const std::vector<Instruction*>& sequence, bool hasResult) {
+  rtda::Thread thread;
+  thread.stack.push(0, 4);
+  FrameExecutor executor(&thread, thread.stack.topFrame);
+  rtda::OperandStack* stack = thread.stack.topFrame->operandStack;
+  int i = 0;
+
+  double ns = bench::nsPerIteration(
+      [&]() {
+        stack->pushInt(i);
+        stack->pushInt(3);
+        executor.execute(sequence[i]);
+        if (hasResult) stack->popInt();
+        i = (i + 1) & (kSequenceLen - 1);
+      },
+      kIterations);
+
+  for (Instruction* inst : sequence) delete inst;
+  return ns;
+}
+
+// Specialized instructions, made by the factory as the interpreter does.
+std::vector<Instruction*> specialized(const uint8_t* opcodes,
+                                      const std::vector<int>& choices) {
+  bench::QuietLogs quiet;
+  BYTE offset[] = {0x00, 0x03};
+  BytecodeDecoder decoder(2, offset);
+  std::vector<Instruction*> sequence;
+  for (int choice : choices) {
+    Instruction* inst = decoder.instructionFactory(opcodes[choice]);
+    decoder.reader.cursor = 0;
+    decoder.getOperands(inst);
+    sequence.push_back(inst);
+  }
+  return sequence;
+}
+
+}  // namespace
+
+BENCHMARK(BytecodeArith) {
+  // cost of the harness itself
+  rtda::Thread thread;
+  thread.stack.push(0, 4);
+  rtda::OperandStack* stack = thread.stack.topFrame->operandStack;
+  bench::report("operand stack only (push 2, pop 2)",
+                bench::nsPerIteration(
+                    [&]() {
+                      stack->pushInt(1);
+                      stack->pushInt(3);
+                      stack->popInt();
+                      stack->popInt();
+                    },
+                    kIterations));
+
+  for (int n : {1, 8}) {
+    std::vector<int> choices = makeChoices(n);
+    std::vector<Instruction*> before, after;
+    for (int choice : choices) {
+      before.push_back(new SwitchedIarith(kArithOps[choice]));
+    }
+    after = specialized(kArithOpcodes, choices);
+
+    bench::report(n == 1 ? "iadd only, switch on op (before)"
+                         : "8 mixed iarith, switch on op (before)",
+                  runSequence(before, true));
+    bench::report(n == 1 ? "iadd only, specialized (after)"
+                         : "8 mixed iarith, specialized (after)",
+                  runSequence(after, true));
+  }
+}
+
+BENCHMARK(BytecodeIfIcmp) {
+  std::vector<int> choices = makeChoices(6);
+  std::vector<Instruction*> before;
+  for (int choice : choices) {
+    before.push_back(new SwitchedIfIcmp(kCmpOps[choice]));
+  }
+
+  bench::report("6 mixed if_icmp, switch on op (before)",
+                runSequence(before, false));
+  bench::report("6 mixed if_icmp, specialized (after)",
+                runSequence(specialized(kCmpOpcodes, choices), false));
+}
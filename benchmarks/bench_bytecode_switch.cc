@@ -0,0 +1,127 @@
+/*!
+ *    ________  ________  ________  ________  ________   ___  ___  _________
+ *   |\   ____\|\   __  \|\   ____\|\   __  \|\   ___  \|\  \|\  \|\___   ___\
+ *   \ \  \___|\ \  \|\  \ \  \___|\ \  \|\  \ \  \\ \  \ \  \\\  \|___ \  \_|
+ *    \ \  \    \ \  \\\  \ \  \    \ \  \\\  \ \  \\ \  \ \  \\\  \   \ \  \
+ *     \ \  \____\ \  \\\  \ \  \____\ \  \\\  \ \  \\ \  \ \  \\\  \   \ \  \
+ *      \ \_______\ \_______\ \_______\ \_______\ \__\\ \__\ \_______\   \ \__\
+ *       \|_______|\|_______|\|_______|\|_______|\|__| \|__|\|_______|    \|__|
+ *
+ * \file benchmarks/bench_bytecode_switch.cc
+ * \brief Cost of lookupswitch by case count: linear scan (before) vs. search
+ * (sparse keys: scan or binary search) and jump table (dense keys) (after).
+ * \author SiriusNEO
+ */
+
+#include <random>
+#include <vector>
+
+#include "../src/bytecode/bytecode_decoder.h"
+#include "bench.h"
+
+using namespace coconut;
+using namespace coconut::bytecode;
+
+namespace {
+
+// The lookupswitch before: scan all pairs. Kept here as the baseline.
+class LinearLookupswitch : public Instruction {
+ private:
+  int defaultOffset_, npairs_;
+  std::vector<int> matchOffsetPairs_;
+
+ public:
+  void accept(utils::ByteReader* reader) {
+    reader->padding4Bytes();
+    defaultOffset_ = reader->fetchInt32();
+    npairs_ = reader->fetchInt32();
+    reader->fetchInt32List(npairs_ << 1, matchOffsetPairs_);
+  }
+
+  void accept(FrameExecutor* executor) {
+    int key = executor->frame->operandStack->popInt();
+    for (int i = 0; i < npairs_; i++) {
+      if (key == matchOffsetPairs_[i << 1]) {
+        executor->branch(matchOffsetPairs_[(i << 1) | 1]);
+        return;
+      }
+    }
+    executor->branch(defaultOffset_);
+  }
+};
+
+const long kIterations = 2000000;
+const int kKeysLen = 4096;  // power of 2
+
+// The bytes of a lookupswitch at pc 0 with these keys.
+std::vector<BYTE> switchBytes(const std::vector<int>& keys) {
+  std::vector<BYTE> bytes = {0xab, 0x00, 0x00, 0x00};
+  auto append = [&bytes](int val) {
+    bytes.insert(bytes.end(), {BYTE(val >> 24), BYTE(val >> 16),
+                               BYTE(val >> 8), BYTE(val)});
+  };
+  append(-1);
+  append(keys.size());
+  for (size_t i = 0; i < keys.size(); ++i) {
+    append(keys[i]);
+    append(i);
+  }
+  return bytes;
+}
+
+// Run the switch on random keys of the switch.
+double runSwitch(Instruction* inst, const std::vector<int>& keys) {
+  std::mt19937 rng(42);
+  std::vector<int> lookups(kKeysLen);
+  for (int& key : lookups) key = keys[rng() % keys.size()];
+
+  rtda::Thread thread;
+  thread.stack.push(0, 1);
+  FrameExecutor executor(&thread, thread.stack.topFrame);
+  rtda::OperandStack* stack = thread.stack.topFrame->operandStack;
+  int i = 0;
+
+  double ns = bench::nsPerIteration(
+      [&]() {
+        stack->pushInt(lookups[i]);
+        executor.execute(inst);
+        i = (i + 1) & (kKeysLen - 1);
+      },
+      kIterations);
+
+  delete inst;
+  return ns;
+}
+
+}  // namespace
+
+BENCHMARK(BytecodeLookupswitch) {
+  for (int n = 4; n <= 4096; n <<= 2) {
+    for (bool dense : {false, true}) {
+      // dense: 0, 2, 4, ... sparse: 0, 1000, 2000, ...
+      std::vector<int> keys;
+      for (int i = 0; i < n; ++i) keys.push_back(i * (dense ? 2 : 1000));
+      std::vector<BYTE> bytes = switchBytes(keys);
+
+      Instruction* before = new LinearLookupswitch();
+      Instruction* after;
+      {
+        bench::QuietLogs quiet;
+        BytecodeDecoder decoder(bytes.size(), bytes.data());
+        after = decoder.getInst();
+        decoder.getOperands(after);
+        decoder.reader.cursor = 1;
+        before->accept(&decoder.reader);
+      }
+
+      char name[64];
+      snprintf(name, sizeof(name), "%4d cases, %s, linear (before)", n,
+               dense ? "dense " : "sparse");
+      bench::report(name, runSwitch(before, keys));
+      snprintf(name, sizeof(name), "%4d cases, %s, %s (after)", n,
+               dense ? "dense " : "sparse",
+               dense ? "jump table" : "search");
+      bench::report(name, runSwitch(after, keys));
+    }
+  }
+}
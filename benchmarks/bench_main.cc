@@ -0,0 +1,53 @@
+/*!
+ *    ________  ________  ________  ________  ________   ___  ___  _________
+ *   |\   ____\|\   __  \|\   ____\|\   __  \|\   ___  \|\  \|\  \|\___   ___\
+ *   \ \  \___|\ \  \|\  \ \  \___|\ \  \|\  \ \  \\ \  \ \  \\\  \|___ \  \_|
+ *    \ \  \    \ \  \\\  \ \  \    \ \  \\\  \ \  \\ \  \ \  \\\  \   \ \  \
+ *     \ \  \____\ \  \\\  \ \  \____\ \  \\\  \ \  \\ \  \ \  \\\  \   \ \  \
+ *      \ \_______\ \_______\ \_______\ \_______\ \__\\ \__\ \_______\   \ \__\
+ *       \|_______|\|_______|\|_______|\|_______|\|__| \|__|\|_______|    \|__|
+ *
+ * \file benchmarks/bench_main.cc
+ * \brief Entry of the microbenchmarks.
+ *
+ * Usage: cocobench [filter]
+ * Run the benchmarks whose names contain the filter (all by default).
+ * \author SiriusNEO
+ */
+
+#include <cstring>
+#include <utility>
+#include <vector>
+
+#include "bench.h"
+
+namespace coconut {
+
+namespace bench {
+
+static std::vector<std::pair<const char*, BenchmarkFn>>& registry() {
+  static std::vector<std::pair<const char*, BenchmarkFn>> benchmarks;
+  return benchmarks;
+}
+
+int registerBenchmark(const char* name, BenchmarkFn fn) {
+  registry().push_back(std::make_pair(name, fn));
+  return 0;
+}
+
+}  // namespace bench
+
+}  // namespace coconut
+
+int main(int argc, char* argv[]) {
+  const char* filter = argc > 1 ? argv[1] : "";
+
+  for (auto& benchmark : coconut::bench::registry()) {
+    if (std::strstr(benchmark.first, filter) != nullptr) {
+      printf("%s\n", benchmark.first);
+      benchmark.second();
+    }
+  }
+
+  return 0;
+}
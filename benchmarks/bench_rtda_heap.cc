@@ -0,0 +1,88 @@
+/*!
+ *    ________  ________  ________  ________  ________   ___  ___  _________
+ *   |\   ____\|\   __  \|\   ____\|\   __  \|\   ___  \|\  \|\  \|\___   ___\
+ *   \ \  \___|\ \  \|\  \ \  \___|\ \  \|\  \ \  \\ \  \ \  \\\  \|___ \  \_|
+ *    \ \  \    \ \  \\\  \ \  \    \ \  \\\  \ \  \\ \  \ \  \\\  \   \ \  \
+ *     \ \  \____\ \  \\\  \ \  \____\ \  \\\  \ \  \\ \  \ \  \\\  \   \ \  \
+ *      \ \_______\ \_______\ \_______\ \_______\ \__\\ \__\ \_______\   \ \__\
+ *       \|_______|\|_______|\|_______|\|_______|\|__| \|__|\|_______|    \|__|
+ *
+ * \file benchmarks/bench_rtda_heap.cc
+ * \brief Cost of a subtype check (checkcast, instanceof, catch types), by where
+ * the supertype is found, and of walking the superclass chain instead.
+ * \author SiriusNEO
+ */
+
+#include <string>
+#include <vector>
+
+#include "../src/rtda/heap/class.h"
+#include "bench.h"
+
+using namespace coconut;
+
+namespace {
+
+const long kIterations = 10000000;
+const int kDepth = 12;
+
+// The check of the old class table: walk the superclass chain.
+bool walkSuperclasses(const rtda::Class* cls, const rtda::Class* other) {
+  for (; cls != nullptr; cls = cls->superClass) {
+    if (cls == other) return true;
+  }
+  return false;
+}
+
+}  // namespace
+
+BENCHMARK(RtdaSubtypeCheck) {
+  rtda::ClassTable& table = rtda::ClassTable::instance();
+  // interfaces I0, I1, and classes C0 ... C11: C0 extends java/lang/Object
+  // implements I0, I1
+  std::vector<rtda::Class*> interfaces;
+  for (int i = 0; i < 2; ++i) {
+    interfaces.push_back(new rtda::Class("BenchI" + std::to_string(i),
+                                         table.resolve("java/lang/Object")));
+    interfaces.back()->isInterface = true;
+  }
+  std::vector<rtda::Class*> classes;
+  for (int i = 0; i < kDepth; ++i) {
+    classes.push_back(new rtda::Class(
+        "BenchC" + std::to_string(i),
+        i == 0 ? table.resolve("java/lang/Object") : classes.back()));
+  }
+  classes[0]->interfaces = interfaces;
+  const rtda::Class* leaf = classes.back();
+  table.link(classes.back());
+
+  // the supertype is loaded each time, so the check is not hoisted
+  auto run = [&](const char* name, const rtda::Class* other0,
+                 const rtda::Class* other1, bool walk) {
+    const rtda::Class* volatile others[2] = {other0, other1};
+    long i = 0, found = 0;
+    double ns = bench::nsPerIteration(
+        [&]() {
+          const rtda::Class* other = others[++i & 1];
+          found += walk ? walkSuperclasses(leaf, other)
+                        : leaf->isSubtypeOf(other);
+        },
+        kIterations);
+    if (found != kIterations) printf("  %s: not found\n", name);
+    bench::report(name, ns);
+  };
+
+  // warm up
+  bench::nsPerIteration([&]() { leaf->isSubtypeOf(classes[4]); }, kIterations);
+  run("primary super (depth 4)", classes[4], classes[4], false);
+  run("secondary super (interface), cached", interfaces[0], interfaces[0],
+      false);
+  run("secondary super (2 interfaces), scanned", interfaces[0],
+      interfaces[1], false);
+  run("secondary super (depth 10), cached", classes[10], classes[10], false);
+  run("superclass chain walk (depth 4)", classes[4], classes[4], true);
+  run("superclass chain walk (depth 0)", classes[0], classes[0], true);
+
+  for (rtda::Class* cls : classes) delete cls;
+  for (rtda::Class* cls : interfaces) delete cls;
+}
@@ -0,0 +1,72 @@
+/*!
+ *    ________  ________  ________  ________  ________   ___  ___  _________
+ *   |\   ____\|\   __  \|\   ____\|\   __  \|\   ___  \|\  \|\  \|\___   ___\
+ *   \ \  \___|\ \  \|\  \ \  \___|\ \  \|\  \ \  \\ \  \ \  \\\  \|___ \  \_|
+ *    \ \  \    \ \  \\\  \ \  \    \ \  \\\  \ \  \\ \  \ \  \\\  \   \ \  \
+ *     \ \  \____\ \  \\\  \ \  \____\ \  \\\  \ \  \\ \  \ \  \\\  \   \ \  \
+ *      \ \_______\ \_______\ \_______\ \_______\ \__\\ \__\ \_______\   \ \__\
+ *       \|_______|\|_______|\|_______|\|_______|\|__| \|__|\|_______|    \|__|
+ *
+ * \file benchmarks/bench_rtda_vmstack.cc
+ * \brief Cost of pushing and popping frames of the JVM stack, as in a deep
+ * recursion, and of moving longs and doubles between the locals and the operand
+ * stack.
+ * \author SiriusNEO
+ */
+
+#include "../src/rtda/thread.h"
+#include "bench.h"
+
+using namespace coconut;
+
+namespace {
+
+const long kIterations = 20000;
+const int kDepth = 256;
+
+}  // namespace
+
+BENCHMARK(RtdaFramePushPop) {
+  rtda::Thread thread;
+  double ns = bench::nsPerIteration(
+      [&]() {
+        for (int i = 0; i < kDepth; ++i) {
+          thread.stack.push(4, 8);
+          thread.stack.topFrame->localVariableTable->setInt(0, i);
+        }
+        for (int i = 0; i < kDepth; ++i) {
+          thread.stack.pop();
+        }
+      },
+      kIterations);
+  bench::report("push + pop one frame", ns / kDepth);
+}
+
+BENCHMARK(RtdaWideSlots) {
+  rtda::Thread thread;
+  thread.stack.push(4, 4);
+  rtda::OperandStack* stack = thread.stack.topFrame->operandStack;
+  rtda::LocalVariableTable* locals = thread.stack.topFrame->localVariableTable;
+  locals->setLong(0, 1);
+  locals->setDouble(2, 1.0);
+  const long iterations = kIterations * kDepth;
+  // lload_0; lload_0; ladd; lstore_0, as in the classic engine
+  double ns = bench::nsPerIteration(
+      [&]() {
+        stack->pushLong(locals->getLong(0));
+        stack->pushLong(locals->getLong(0));
+        long long value2 = stack->popLong();
+        locals->setLong(0, stack->popLong() + value2);
+      },
+      iterations);
+  bench::report("lload, lload, ladd, lstore", ns);
+  ns = bench::nsPerIteration(
+      [&]() {
+        stack->pushDouble(locals->getDouble(2));
+        stack->pushDouble(locals->getDouble(2));
+        double value2 = stack->popDouble();
+        locals->setDouble(2, stack->popDouble() * value2);
+      },
+      iterations);
+  bench::report("dload, dload, dmul, dstore", ns);
+}
@@ -0,0 +1,418 @@
+/*!
+ *    ________  ________  ________  ________  ________   ___  ___  _________
+ *   |\   ____\|\   __  \|\   ____\|\   __  \|\   ___  \|\  \|\  \|\___   ___\
+ *   \ \  \___|\ \  \|\  \ \  \___|\ \  \|\  \ \  \\ \  \ \  \\\  \|___ \  \_|
+ *    \ \  \    \ \  \\\  \ \  \    \ \  \\\  \ \  \\ \  \ \  \\\  \   \ \  \
+ *     \ \  \____\ \  \\\  \ \  \____\ \  \\\  \ \  \\ \  \ \  \\\  \   \ \  \
+ *      \ \_______\ \_______\ \_______\ \_______\ \__\\ \__\ \_______\   \ \__\
+ *       \|_______|\|_______|\|_______|\|_______|\|__| \|__|\|_______|    \|__|
+ *
+ * \file benchmarks/bench_vm_engines.cc
+ * \brief Cost of one iteration of an int loop on the threaded engine, by its
+ * options, on the register engine, and compiled by the template JIT (also
+ * for a loop entered once, by OSR). (The classic engine logs every
+ * instruction, so it is left out.)
+ * \author SiriusNEO
+ */
+
+#include "../src/vm/register_interpreter.h"
+#include "../src/vm/verifier.h"
+#include "../testing/code_builder.h"
+#include "bench.h"
+
+using namespace coconut;
+using namespace coconut::vm;
+
+namespace {
+
+const int kLoopIterations = 10000;
+const int kRuns = 2000;
+
+// int sum = 0; for (int i = 0; i < 100 * 100; ++i) sum += i; return sum;
+classfile::CodeAttr* makeIntLoop() {
+  return makeCodeAttr(
+      2, 3,
+      {0x03, 0x3b, 0x03, 0x3c, 0x11, 0x00, 0x64, 0x11, 0x00, 0x64,
+       0x68, 0x3d, 0x1b, 0x1c, 0xa2, 0x00, 0x0d, 0x1a, 0x1b, 0x60,
+       0x3b, 0x84, 0x01, 0x01, 0xa7, 0xff, 0xf4, 0x1a, 0xac});
+}
+
+// long sum = 0; for (int i = 0; i < 100 * 100; ++i) sum += i; return sum;
+// With double instead of long if isDouble.
+classfile::CodeAttr* makeWideLoop(bool isDouble) {
+  // (lconst_0, lstore_0, lload_0, i2l, ladd, lreturn) or the double ones
+  std::vector<BYTE> op = {0x09, 0x3f, 0x1e, 0x85, 0x61, 0xad};
+  if (isDouble) op = {0x0e, 0x47, 0x26, 0x87, 0x63, 0xaf};
+  return makeCodeAttr(
+      4, 3,
+      {op[0], op[1], 0x03, 0x3d, 0x1c, 0x11, 0x27, 0x10, 0xa2, 0x00, 0x0e,
+       op[2], 0x1c, op[3], op[4], op[1], 0x84, 0x02, 0x01, 0xa7, 0xff, 0xf1,
+       op[2], op[5]});
+}
+
+// Run the loop on an engine. Returns nanoseconds per loop iteration.
+double runLoop(Interpreter* engine, classfile::CodeAttr* codeAttr,
+               rtda::Object* arg = nullptr, long runs = kRuns) {
+  double ns = bench::nsPerIteration(
+      [&]() {
+        rtda::Thread thread;
+        // room for the returned value, a long or a double too
+        thread.stack.push(0, 2);
+        thread.stack.push(codeAttr->maxLocals, codeAttr->maxStack);
+        thread.stack.topFrame->localVariableTable->setRef(0, arg);
+        engine->execute(&thread, codeAttr);
+      },
+      runs);
+  return ns / kLoopIterations;
+}
+
+// static int loop(Throwable t) {
+//   int i = 0;
+//   for (; i < 100 * 100; ++i) try { throw t; } catch (RuntimeException e) {}
+//   return i;
+// }
+// static int rethrow(Throwable t) { throw t; }
+// static int loopInvoke(Throwable t): the same as loop, but throw t by rethrow.
+// static int loopDivide(Throwable t): the same as loop, but throw by i / 0,
+// catching ArithmeticException.
+classfile::ClassFile* makeThrowLoops() {
+  return makeClassFile(
+      {{"loop",
+        "(Ljava/lang/Throwable;)I",
+        2,
+        2,
+        {0x03, 0x3c, 0x1b, 0x11, 0x27, 0x10, 0xa2, 0x00, 0x0c, 0x2a,
+         0xbf, 0x57, 0x84, 0x01, 0x01, 0xa7, 0xff, 0xf3, 0x1b, 0xac},
+        {},
+        {{9, 11, 11, 22}}},
+       {"rethrow", "(Ljava/lang/Throwable;)I", 1, 1, {0x2a, 0xbf}},
+       {"loopInvoke",
+        "(Ljava/lang/Throwable;)I",
+        2,
+        2,
+        {0x03, 0x3c, 0x1b, 0x11, 0x27, 0x10, 0xa2, 0x00, 0x12,
+         0x2a, 0xb8, 0x00, 0x0b, 0x57, 0xa7, 0x00, 0x04, 0x57,
+         0x84, 0x01, 0x01, 0xa7, 0xff, 0xed, 0x1b, 0xac},
+        {},
+        {{9, 13, 17, 22}}},
+       {"loopDivide",
+        "(Ljava/lang/Throwable;)I",
+        2,
+        2,
+        {0x03, 0x3c, 0x1b, 0x11, 0x27, 0x10, 0xa2, 0x00, 0x11,
+         0x1b, 0x03, 0x6c, 0x57, 0xa7, 0x00, 0x04, 0x57, 0x84,
+         0x01, 0x01, 0xa7, 0xff, 0xee, 0x1b, 0xac},
+        {},
+        {{9, 13, 16, 24}}}},
+      {"java/lang/RuntimeException", "java/lang/ArithmeticException"});
+}
+
+}  // namespace
+
+BENCHMARK(VMIntLoop) {
+  classfile::CodeAttr* codeAttr = makeIntLoop();
+  verifyCode(codeAttr, "()I");
+  ThreadedInterpreter threaded(false, false), super(true, false),
+      tos(true, true), jit(true, false);
+  RegisterInterpreter reg;
+  // compiled after its first run, by the backedges of that run
+  jit.jit = true;
+
+  bench::QuietLogs quiet;
+  bench::report("threaded", runLoop(&threaded, codeAttr));
+  bench::report("threaded, superinstructions", runLoop(&super, codeAttr));
+  bench::report("threaded, superinstructions, TOS caching",
+                runLoop(&tos, codeAttr));
+  bench::report("register", runLoop(&reg, codeAttr));
+  bench::report("template JIT", runLoop(&jit, codeAttr));
+
+  delete codeAttr;
+}
+
+namespace {
+
+// int sum = 0;
+// for (int i = 0; i < 1000; ++i) for (int j = 0; j < 1000; ++j) sum += j;
+// return sum;
+classfile::CodeAttr* makeNestedLoop() {
+  return makeCodeAttr(
+      2, 3,
+      {0x03, 0x3b, 0x03, 0x3c, 0x1b, 0x11, 0x03, 0xe8, 0xa2, 0x00,
+       0x1c, 0x03, 0x3d, 0x1c, 0x11, 0x03, 0xe8, 0xa2, 0x00, 0x0d,
+       0x1a, 0x1c, 0x60, 0x3b, 0x84, 0x02, 0x01, 0xa7, 0xff, 0xf2,
+       0x84, 0x01, 0x01, 0xa7, 0xff, 0xe3, 0x1a, 0xac});
+}
+
+// Run a method once on a new engine, as if it never ran before (the counters
+// of the code are reset), like a main which loops. Returns nanoseconds per
+// inner iteration, including the compiling.
+double runOnce(bool jit, classfile::CodeAttr* codeAttr) {
+  const long runs = 20;
+  double ns = bench::nsPerIteration(
+      [&]() {
+        ThreadedInterpreter engine;
+        engine.jit = jit;
+        engine.policy.compilerThreads = 0;
+        codeAttr->invocationCount = codeAttr->backedgeCount = 0;
+        rtda::Thread thread;
+        thread.stack.push(0, 1);
+        thread.stack.push(codeAttr->maxLocals, codeAttr->maxStack);
+        engine.execute(&thread, codeAttr);
+      },
+      runs);
+  return ns / (1000 * 1000);
+}
+
+}  // namespace
+
+BENCHMARK(VMOsrLoop) {
+  classfile::CodeAttr* codeAttr = makeNestedLoop();
+  verifyCode(codeAttr, "()I");
+
+  bench::QuietLogs quiet;
+  bench::report("threaded, entered once", runOnce(false, codeAttr));
+  bench::report("template JIT with OSR, entered once", runOnce(true, codeAttr));
+
+  delete codeAttr;
+}
+
+BENCHMARK(VMWideLoop) {
+  classfile::CodeAttr* longLoop = makeWideLoop(false);
+  classfile::CodeAttr* doubleLoop = makeWideLoop(true);
+  verifyCode(longLoop, "()J");
+  verifyCode(doubleLoop, "()D");
+  ThreadedInterpreter threaded(false, false);
+
+  bench::QuietLogs quiet;
+  bench::report("long: lload, i2l, ladd, lstore", runLoop(&threaded, longLoop));
+  bench::report("double: dload, i2d, dadd, dstore",
+                runLoop(&threaded, doubleLoop));
+
+  delete doubleLoop;
+  delete longLoop;
+}
+
+BENCHMARK(VMExceptions) {
+  bench::QuietLogs quiet;
+  classfile::ClassFile* classFile = makeThrowLoops();
+  const char* descriptor = "(Ljava/lang/Throwable;)I";
+  classfile::CodeAttr* loop =
+      classFile->findMethod("loop", descriptor)->attributes->filtCodeAttr();
+  classfile::CodeAttr* loopInvoke =
+      classFile->findMethod("loopInvoke", descriptor)
+          ->attributes->filtCodeAttr();
+  classfile::CodeAttr* loopDivide =
+      classFile->findMethod("loopDivide", descriptor)
+          ->attributes->filtCodeAttr();
+  rtda::Object exception(
+      rtda::ClassTable::instance().resolve("java/lang/ArithmeticException"));
+  ThreadedInterpreter threaded;
+  threaded.classFile = classFile;
+  const long runs = kRuns / 10;
+  verifyClass(classFile);
+
+  bench::report("athrow, caught in the frame",
+                runLoop(&threaded, loop, &exception, runs));
+  bench::report("athrow, caught in the invoker",
+                runLoop(&threaded, loopInvoke, &exception, runs));
+  bench::report("idiv by zero, preallocated exception",
+                runLoop(&threaded, loopDivide, nullptr, runs));
+  // the cost of unwinding with a C++ exception instead, for comparison
+  auto panic = []() {
+    try {
+      throw utils::JVMPanic(__FILE__, __LINE__, "exception");
+    } catch (const utils::JVMPanic&) {
+    }
+  };
+  bench::report("C++ throw of utils::JVMPanic",
+                bench::nsPerIteration(panic, runs * kLoopIterations));
+
+  delete classFile;
+}
+
+namespace {
+
+// int speak() { return 1; }
+// static int loopVirtual(Animal a, Animal b) {
+//   int sum = 0;
+//   for (int i = 0; i < 100 * 100; ++i) sum += ((i & 1) != 0 ? b : a).speak();
+//   return sum;
+// }
+// static int loopStatic(Animal a, Animal b): the same, but calls
+// static int one() { return 1; }
+classfile::ClassFile* makeCallLoops() {
+  std::vector<BYTE> loop = {
+      0x03, 0x3d, 0x03, 0x3e, 0x1c, 0x11, 0x27, 0x10, 0xa2, 0x00,
+      0x1a, 0x1c, 0x04, 0x7e, 0x99, 0x00, 0x07, 0x2b, 0xa7, 0x00,
+      0x04, 0x2a, 0xb6, 0x00, 0x07, 0x1d, 0x60, 0x3e, 0x84, 0x02,
+      0x01, 0xa7, 0xff, 0xe5, 0x1d, 0xac};
+  // the same, but pop the receiver and invokestatic one
+  std::vector<BYTE> loopStatic = {
+      0x03, 0x3d, 0x03, 0x3e, 0x1c, 0x11, 0x27, 0x10, 0xa2, 0x00,
+      0x1b, 0x1c, 0x04, 0x7e, 0x99, 0x00, 0x07, 0x2b, 0xa7, 0x00,
+      0x04, 0x2a, 0x57, 0xb8, 0x00, 0x13, 0x1d, 0x60, 0x3e, 0x84,
+      0x02, 0x01, 0xa7, 0xff, 0xe4, 0x1d, 0xac};
+  // #22 Class java/lang/Object
+  return makeClassFile(
+      {{"speak", "()I", 1, 1, {0x04, 0xac}, {}, {}, 0x01},
+       {"loopVirtual", "(LAnimal;LAnimal;)I", 2, 4, loop},
+       {"loopStatic", "(LAnimal;LAnimal;)I", 2, 4, loopStatic},
+       {"one", "()I", 1, 0, {0x04, 0xac}}},
+      {"java/lang/Object"}, "Animal", 22);
+}
+
+}  // namespace
+
+BENCHMARK(VMInvokeVirtual) {
+  bench::QuietLogs quiet;
+  classfile::ClassFile* animal = makeCallLoops();
+  // class Dog extends Animal { int speak() { return 2; } }
+  classfile::ClassFile* dog =
+      makeClassFile({{"speak", "()I", 1, 1, {0x05, 0xac}, {}, {}, 0x01}},
+                    {"Animal"}, "Dog", 10);
+  rtda::ClassTable& table = rtda::ClassTable::instance();
+  rtda::Object animalObject(table.define(animal)), dogObject(table.define(dog));
+  verifyClass(animal);
+  verifyClass(dog);
+  const char* descriptor = "(LAnimal;LAnimal;)I";
+  classfile::CodeAttr* loopVirtual =
+      animal->findMethod("loopVirtual", descriptor)->attributes->filtCodeAttr();
+  classfile::CodeAttr* loopStatic =
+      animal->findMethod("loopStatic", descriptor)->attributes->filtCodeAttr();
+
+  // Returns nanoseconds per call.
+  auto runCalls = [&](ThreadedInterpreter* engine, classfile::CodeAttr* code,
+                      rtda::Object* a, rtda::Object* b) {
+    double ns = bench::nsPerIteration(
+        [&]() {
+          rtda::Thread thread;
+          thread.stack.push(0, 1);
+          thread.stack.push(code->maxLocals, code->maxStack);
+          thread.stack.topFrame->localVariableTable->setRef(0, a);
+          thread.stack.topFrame->localVariableTable->setRef(1, b);
+          engine->execute(&thread, code);
+        },
+        kRuns / 10);
+    return ns / kLoopIterations;
+  };
+
+  ThreadedInterpreter threaded;
+  threaded.classFile = animal;
+  bench::report("invokestatic",
+                runCalls(&threaded, loopStatic, &animalObject, &dogObject));
+  bench::report("invokevirtual, monomorphic (cache hits)",
+                runCalls(&threaded, loopVirtual, &dogObject, &dogObject));
+  bench::report("invokevirtual, 2 classes (polymorphic)",
+                runCalls(&threaded, loopVirtual, &animalObject, &dogObject));
+
+  // more receiver classes than the inline cache holds: the site becomes
+  // megamorphic and dispatches through the vtables
+  std::vector<classfile::ClassFile*> more;
+  std::vector<rtda::Object> objects;
+  objects.reserve(kInlineCacheSize);
+  for (int i = 0; i < kInlineCacheSize; ++i) {
+    more.push_back(makeClassFile(
+        {{"speak", "()I", 1, 1, {0x10, BYTE(i), 0xac}, {}, {}, 0x01}},
+        {"Animal"}, "Animal" + std::to_string(i), 10));
+    objects.emplace_back(table.define(more.back()));
+    verifyClass(more.back());
+    runCalls(&threaded, loopVirtual, &objects.back(), &objects.back());
+  }
+  bench::report("invokevirtual, 2 classes (megamorphic)",
+                runCalls(&threaded, loopVirtual, &animalObject, &dogObject));
+
+  for (auto* classFile : more) delete classFile;
+  delete dog;
+  delete animal;
+}
+
+namespace {
+
+// interface List {
+//   int get();
+//   static int loopInterface(List a, List b): the loop of loopVirtual, but
+//   calls a.get() or b.get() by invokeinterface
+// }
+classfile::ClassFile* makeInterfaceLoop() {
+  std::vector<BYTE> loop = {
+      0x03, 0x3d, 0x03, 0x3e, 0x1c, 0x11, 0x27, 0x10, 0xa2, 0x00,
+      0x1c, 0x1c, 0x04, 0x7e, 0x99, 0x00, 0x07, 0x2b, 0xa7, 0x00,
+      0x04, 0x2a, 0xb9, 0x00, 0x07, 0x01, 0x00, 0x1d, 0x60, 0x3e,
+      0x84, 0x02, 0x01, 0xa7, 0xff, 0xe3, 0x1d, 0xac};
+  // #14 Class java/lang/Object
+  return makeClassFile({{"get", "()I", 0, 1, {}, {}, {}, 0x0401},
+                        {"loopInterface", "(LList;LList;)I", 2, 4, loop}},
+                       {"java/lang/Object"}, "List", 14, {}, 0x0601);
+}
+
+}  // namespace
+
+BENCHMARK(VMInvokeInterface) {
+  bench::QuietLogs quiet;
+  classfile::ClassFile* list = makeInterfaceLoop();
+  classfile::ClassFile* deque = makeClassFile(
+      {}, {"java/lang/Object"}, "Deque", 6, {}, 0x0601);
+  // class ArrayList implements List { int get() { return 1; } }
+  classfile::ClassFile* arrayList =
+      makeClassFile({{"get", "()I", 1, 1, {0x04, 0xac}, {}, {}, 0x01}},
+                    {"java/lang/Object", "List"}, "ArrayList", 10, {12});
+  // class LinkedList implements Deque, List { int get() { return 2; } }: List
+  // has another itable index
+  classfile::ClassFile* linkedList = makeClassFile(
+      {{"get", "()I", 1, 1, {0x05, 0xac}, {}, {}, 0x01}},
+      {"java/lang/Object", "Deque", "List"}, "LinkedList", 10, {12, 14});
+  rtda::ClassTable& table = rtda::ClassTable::instance();
+  table.define(list);
+  table.define(deque);
+  rtda::Object arrayObject(table.define(arrayList));
+  rtda::Object linkedObject(table.define(linkedList));
+  for (auto* classFile : {list, arrayList, linkedList}) verifyClass(classFile);
+  classfile::CodeAttr* loop =
+      list->findMethod("loopInterface", "(LList;LList;)I")
+          ->attributes->filtCodeAttr();
+
+  // Returns nanoseconds per call.
+  auto runCalls = [&](ThreadedInterpreter* engine, rtda::Object* a,
+                      rtda::Object* b) {
+    double ns = bench::nsPerIteration(
+        [&]() {
+          rtda::Thread thread;
+          thread.stack.push(0, 1);
+          thread.stack.push(loop->maxLocals, loop->maxStack);
+          thread.stack.topFrame->localVariableTable->setRef(0, a);
+          thread.stack.topFrame->localVariableTable->setRef(1, b);
+          engine->execute(&thread, loop);
+        },
+        kRuns / 10);
+    return ns / kLoopIterations;
+  };
+
+  ThreadedInterpreter threaded;
+  bench::report("invokeinterface, monomorphic (cache hits)",
+                runCalls(&threaded, &arrayObject, &arrayObject));
+  bench::report("invokeinterface, 2 classes (polymorphic)",
+                runCalls(&threaded, &arrayObject, &linkedObject));
+
+  // past the inline cache, the calls find the itable by the hint of the site
+  std::vector<classfile::ClassFile*> more;
+  std::vector<rtda::Object> objects;
+  objects.reserve(kInlineCacheSize);
+  for (int i = 0; i < kInlineCacheSize; ++i) {
+    more.push_back(makeClassFile(
+        {{"get", "()I", 1, 1, {0x10, BYTE(i), 0xac}, {}, {}, 0x01}},
+        {"java/lang/Object", "List"}, "List" + std::to_string(i), 10, {12}));
+    objects.emplace_back(table.define(more.back()));
+    verifyClass(more.back());
+    runCalls(&threaded, &objects.back(), &objects.back());
+  }
+  bench::report("invokeinterface, megamorphic (hint hits)",
+                runCalls(&threaded, &arrayObject, &arrayObject));
+  bench::report("invokeinterface, megamorphic (hint misses)",
+                runCalls(&threaded, &arrayObject, &linkedObject));
+
+  for (auto* classFile : more) delete classFile;
+  delete linkedList;
+  delete arrayList;
+  delete deque;
+  delete list;
+}
@@ -0,0 +1,108 @@
+#!/usr/bin/env python3
+"""Regenerate src/vm/superinstructions.def from an opcode-pair histogram.
+
+Usage:
+    python3 scripts/gen_superinstructions.py [histogram] [--min-count N]
+
+The histogram is the file written by `coconut --pair-histogram <file>`: one
+"<opcode1> <opcode2> <count>" line per pair, opcodes in canonical form (see
+src/vm/superinstructions.h). Each candidate below is scored by the smallest
+count among its adjacent pairs; candidates scoring at least --min-count are
+enabled. Without a histogram, every candidate is enabled.
+
+Enabled patterns are listed first, longer ones before shorter ones (the
+translator takes the first pattern that matches), then by score.
+"""
+
+import os
+import sys
+
+ILOAD, ISTORE, ICONST = 0x15, 0x36, 0x10
+IADD, ISUB, IINC, GOTO = 0x60, 0x64, 0x84, 0xA7
+IF_ICMP = {"eq": 0x9F, "ne": 0xA0, "lt": 0xA1, "ge": 0xA2, "gt": 0xA3, "le": 0xA4}
+
+# Every candidate must have a handler in src/vm/threaded_interpreter.cc.
+CANDIDATES = [
+    ("iload_iload_iadd_istore", [ILOAD, ILOAD, IADD, ISTORE]),
+    ("iload_iload_isub_istore", [ILOAD, ILOAD, ISUB, ISTORE]),
+    ("iload_iconst_iadd_istore", [ILOAD, ICONST, IADD, ISTORE]),
+    ("iload_iload_iadd", [ILOAD, ILOAD, IADD]),
+    ("iload_iload", [ILOAD, ILOAD]),
+    ("iinc_goto", [IINC, GOTO]),
+]
+for cond, op in IF_ICMP.items():
+    CANDIDATES.append(("iload_iconst_if_icmp" + cond, [ILOAD, ICONST, op]))
+for cond, op in IF_ICMP.items():
+    CANDIDATES.append(("iload_iload_if_icmp" + cond, [ILOAD, ILOAD, op]))
+
+MAX_LENGTH = 4
+
+HEADER = """\
+/*!
+ * \\file src/vm/superinstructions.def
+ * \\brief Superinstruction patterns fused by ThreadedCode.
+ *
+ * GENERATED by scripts/gen_superinstructions.py{source}. Do not edit by hand.
+ *
+ * SUPERINST(name, enabled, length, opcode1, opcode2, opcode3, opcode4)
+ *
+ * Opcodes are canonical (see canonicalOpcode()). Unused opcode slots are 0.
+ * The score is the smallest count of the adjacent pairs in the histogram.
+ */
+
+"""
+
+
+def read_histogram(path):
+    pairs = {}
+    with open(path) as f:
+        for line in f:
+            fields = line.split()
+            if len(fields) != 3 or line.startswith("#"):
+                continue
+            pairs[(int(fields[0], 0), int(fields[1], 0))] = int(fields[2])
+    return pairs
+
+
+def main(argv):
+    histogram, min_count = None, 1
+    args = list(argv[1:])
+    while args:
+        arg = args.pop(0)
+        if arg == "--min-count":
+            min_count = int(args.pop(0))
+        else:
+            histogram = arg
+
+    pairs = read_histogram(histogram) if histogram else None
+    rows = []
+    for name, ops in CANDIDATES:
+        if pairs is None:
+            score = None
+            enabled = True
+        else:
+            score = min(pairs.get(p, 0) for p in zip(ops, ops[1:]))
+            enabled = score >= min_count
+        rows.append((name, ops, score, enabled))
+    rows.sort(key=lambda r: (not r[3], -len(r[1]), -(r[2] or 0)))
+
+    source = " from " + os.path.basename(histogram) if histogram else ""
+    out = [HEADER.format(source=source)]
+    for name, ops, score, enabled in rows:
+        slots = ops + [0] * (MAX_LENGTH - len(ops))
+        line = "SUPERINST({}, {}, {}, {})".format(
+            name, int(enabled), len(ops), ", ".join("0x%02x" % op for op in slots)
+        )
+        if score is not None:
+            line += "  // score: {}".format(score)
+        out.append(line + "\n")
+
+    target = os.path.join(
+        os.path.dirname(os.path.abspath(__file__)), "..", "src", "vm",
+        "superinstructions.def")
+    with open(target, "w") as f:
+        f.writelines(out)
+
+
+if __name__ == "__main__":
+    main(sys.argv)
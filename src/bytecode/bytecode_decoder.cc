@@ -64,6 +64,7 @@ Instruction* BytecodeDecoder::instructionFactory(uint8_t opcode) {
     case 0x12:  // return new ldc
     case 0x13:  // return new ldc_w
     case 0x14:  // return new ldc2_w
+      LOG(FATAL) << "Unimplemented instruction";
     // Loads
     case 0x15:
       return new Inst_iload(0, false);
@@ -124,6 +125,7 @@ Instruction* BytecodeDecoder::instructionFactory(uint8_t opcode) {
     case 0x33:  // return new Inst_baload();
     case 0x34:  // return new Inst_caload();
     case 0x35:  // return new Inst_saload();
+      LOG(FATAL) << "Unimplemented instruction";
     // Stores
     case 0x36:
       return new Inst_istore(0, false);
@@ -184,6 +186,7 @@ Instruction* BytecodeDecoder::instructionFactory(uint8_t opcode) {
     case 0x54:  // return new Inst_bastore();
     case 0x55:  // return new Inst_castore();
     case 0x56:  // return new Inst_sastore();
+      LOG(FATAL) << "Unimplemented instruction";
     // Stack
     case 0x57:
       return new Inst_pop(false);
@@ -205,77 +208,77 @@ Instruction* BytecodeDecoder::instructionFactory(uint8_t opcode) {
       return new Inst_swap();
     // Math
     case 0x60:
-      return new Inst_iarith(ADD);
+      return new Inst_iarith<ADD>();
     case 0x61:
-      return new Inst_larith(ADD);
+      return new Inst_larith<ADD>();
     case 0x62:
-      return new Inst_farith(ADD);
+      return new Inst_farith<ADD>();
     case 0x63:
-      return new Inst_darith(ADD);
+      return new Inst_darith<ADD>();
     case 0x64:
-      return new Inst_iarith(SUB);
+      return new Inst_iarith<SUB>();
     case 0x65:
-      return new Inst_larith(SUB);
+      return new Inst_larith<SUB>();
     case 0x66:
-      return new Inst_farith(SUB);
+      return new Inst_farith<SUB>();
     case 0x67:
-      return new Inst_darith(SUB);
+      return new Inst_darith<SUB>();
     case 0x68:
-      return new Inst_iarith(MUL);
+      return new Inst_iarith<MUL>();
     case 0x69:
-      return new Inst_larith(MUL);
+      return new Inst_larith<MUL>();
     case 0x6a:
-      return new Inst_farith(MUL);
+      return new Inst_farith<MUL>();
     case 0x6b:
-      return new Inst_darith(MUL);
+      return new Inst_darith<MUL>();
     case 0x6c:
-      return new Inst_iarith(DIV);
+      return new Inst_iarith<DIV>();
     case 0x6d:
-      return new Inst_larith(DIV);
+      return new Inst_larith<DIV>();
     case 0x6e:
-      return new Inst_farith(DIV);
+      return new Inst_farith<DIV>();
     case 0x6f:
-      return new Inst_darith(DIV);
+      return new Inst_darith<DIV>();
     case 0x70:
-      return new Inst_iarith(REM);
+      return new Inst_iarith<REM>();
     case 0x71:
-      return new Inst_larith(REM);
+      return new Inst_larith<REM>();
     case 0x72:
-      return new Inst_farith(REM);
+      return new Inst_farith<REM>();
     case 0x73:
-      return new Inst_darith(REM);
+      return new Inst_darith<REM>();
     case 0x74:
-      return new Inst_iarith(NEG);
+      return new Inst_neg<int>();
     case 0x75:
-      return new Inst_larith(NEG);
+      return new Inst_neg<long long>();
     case 0x76:
-      return new Inst_farith(NEG);
+      return new Inst_neg<float>();
     case 0x77:
-      return new Inst_darith(NEG);
+      return new Inst_neg<double>();
     case 0x78:
-      return new Inst_iarith(SHL);
+      return new Inst_iarith<SHL>();
     case 0x79:
-      return new Inst_larith(SHL);
+      return new Inst_larith<SHL>();
     case 0x7a:
-      return new Inst_iarith(SHR);
+      return new Inst_iarith<SHR>();
     case 0x7b:
-      return new Inst_larith(SHR);
+      return new Inst_larith<SHR>();
     case 0x7c:
-      return new Inst_iarith(USHR);
+      return new Inst_iarith<USHR>();
     case 0x7d:
-      return new Inst_larith(USHR);
+      return new Inst_larith<USHR>();
     case 0x7e:
-      return new Inst_iarith(AND);
+      return new Inst_iarith<AND>();
     case 0x7f:
-      return new Inst_larith(AND);
+      return new Inst_larith<AND>();
     case 0x80:
-      return new Inst_iarith(OR);
+      return new Inst_iarith<OR>();
     case 0x81:
-      return new Inst_larith(OR);
+      return new Inst_larith<OR>();
     case 0x82:
-      return new Inst_iarith(XOR);
+      return new Inst_iarith<XOR>();
     case 0x83:
-      return new Inst_larith(XOR);
+      return new Inst_larith<XOR>();
     case 0x84:
       return new Inst_iinc();
     // Conversions
@@ -313,62 +316,69 @@ Instruction* BytecodeDecoder::instructionFactory(uint8_t opcode) {
     case 0x94:
       return new Inst_lcmp();
     case 0x95:
-      return new Inst_fcmp(false);
+      return new Inst_fcmp<false>();
     case 0x96:
-      return new Inst_fcmp(true);
+      return new Inst_fcmp<true>();
     case 0x97:
-      return new Inst_dcmp(false);
+      return new Inst_dcmp<false>();
     case 0x98:
-      return new Inst_dcmp(true);
+      return new Inst_dcmp<true>();
     case 0x99:
-      return new Inst_if(EQ);
+      return new Inst_if<EQ>();
     case 0x9a:
-      return new Inst_if(NE);
+      return new Inst_if<NE>();
     case 0x9b:
-      return new Inst_if(LT);
+      return new Inst_if<LT>();
     case 0x9c:
-      return new Inst_if(GE);
+      return new Inst_if<GE>();
     case 0x9d:
-      return new Inst_if(GT);
+      return new Inst_if<GT>();
     case 0x9e:
-      return new Inst_if(LE);
+      return new Inst_if<LE>();
     case 0x9f:
-      return new Inst_if_icmp(EQ);
+      return new Inst_if_icmp<EQ>();
     case 0xa0:
-      return new Inst_if_icmp(NE);
+      return new Inst_if_icmp<NE>();
     case 0xa1:
-      return new Inst_if_icmp(LT);
+      return new Inst_if_icmp<LT>();
     case 0xa2:
-      return new Inst_if_icmp(GE);
+      return new Inst_if_icmp<GE>();
     case 0xa3:
-      return new Inst_if_icmp(GT);
+      return new Inst_if_icmp<GT>();
     case 0xa4:
-      return new Inst_if_icmp(LE);
+      return new Inst_if_icmp<LE>();
     case 0xa5:
-      return new Inst_if_acmp(EQ);
+      return new Inst_if_acmp<EQ>();
     case 0xa6:
-      return new Inst_if_acmp(NE);
+      return new Inst_if_acmp<NE>();
     // Control
     case 0xa7:
       return new Inst_goto();
     case 0xa8:  // return new Inst_jsr();
     case 0xa9:  // return new ret();
+      LOG(FATAL) << "Unimplemented instruction";
     case 0xaa:
       return new Inst_tableswitch();
     case 0xab:
       return new Inst_lookupswitch();
-    case 0xac:  // return new ireturn();
-    case 0xad:  // return new lreturn();
-    case 0xae:  // return new freturn();
-    case 0xaf:  // return new dreturn();
-    case 0xb0:  // return new areturn();
-    case 0xb1:  // return new return();
-      LOG(FATAL) << "Unimplemented instruction";
+    case 0xac:
+      return new Inst_ireturn();
+    case 0xad:
+      return new Inst_lreturn();
+    case 0xae:
+      return new Inst_freturn();
+    case 0xaf:
+      return new Inst_dreturn();
+    case 0xb0:
+      return new Inst_areturn();
+    case 0xb1:
+      return new Inst_return();
     // References
     /* 0xb2 ~ 0xc3 */
     case 0xc4:
       return new Inst_wide(getInst());
     case 0xc5:  // return new Inst_multianewarray();
+      LOG(FATAL) << "Unimplemented instruction";
     case 0xc6:
       return new Inst_ifnull();
     case 0xc7:
@@ -0,0 +1,62 @@
+/*!
+ *    ________  ________  ________  ________  ________   ___  ___  _________
+ *   |\   ____\|\   __  \|\   ____\|\   __  \|\   ___  \|\  \|\  \|\___   ___\
+ *   \ \  \___|\ \  \|\  \ \  \___|\ \  \|\  \ \  \\ \  \ \  \\\  \|___ \  \_|
+ *    \ \  \    \ \  \\\  \ \  \    \ \  \\\  \ \  \\ \  \ \  \\\  \   \ \  \
+ *     \ \  \____\ \  \\\  \ \  \____\ \  \\\  \ \  \\ \  \ \  \\\  \   \ \  \
+ *      \ \_______\ \_______\ \_______\ \_______\ \__\\ \__\ \_______\   \ \__\
+ *       \|_______|\|_______|\|_______|\|_______|\|__| \|__|\|_______|    \|__|
+ *
+ * \file src/bytecode/decoded_method.cc
+ * \brief Implementation of decoded_method.h
+ * \author SiriusNEO
+ */
+
+#include "decoded_method.h"
+
+namespace coconut {
+
+namespace bytecode {
+
+DecodedMethod::DecodedMethod(classfile::CodeAttr* codeAttr)
+    : decoder_(codeAttr->codeLen, codeAttr->code),
+      codeLen_(codeAttr->codeLen) {
+  insts_ = new DecodedInst[codeLen_];
+  for (uint32_t i = 0; i < codeLen_; ++i) {
+    insts_[i].inst = nullptr;
+    insts_[i].opcode = 0;
+    insts_[i].nextPc = 0;
+  }
+}
+
+DecodedMethod::~DecodedMethod() {
+  for (uint32_t i = 0; i < codeLen_; ++i) {
+    if (insts_[i].inst != nullptr) {
+      delete insts_[i].inst;
+    }
+  }
+  delete[] insts_;
+}
+
+void DecodedMethod::decode_(int pc) {
+  CHECK(pc >= 0 && uint32_t(pc) < codeLen_) << "pc out of code range: " << pc;
+
+  decoder_.reader.cursor = pc;
+  Instruction* inst = decoder_.getInst();
+  decoder_.getOperands(inst);
+
+  insts_[pc].inst = inst;
+  insts_[pc].opcode = decoder_.reader.bytePool[pc];
+  insts_[pc].nextPc = decoder_.reader.cursor;
+}
+
+DecodedMethod* DecodedMethod::of(classfile::CodeAttr* codeAttr) {
+  if (codeAttr->decodedMethod == nullptr) {
+    codeAttr->decodedMethod = new DecodedMethod(codeAttr);
+  }
+  return codeAttr->decodedMethod;
+}
+
+}  // namespace bytecode
+
+}  // namespace coconut
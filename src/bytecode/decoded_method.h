@@ -0,0 +1,104 @@
+/*!
+ *    ________  ________  ________  ________  ________   ___  ___  _________
+ *   |\   ____\|\   __  \|\   ____\|\   __  \|\   ___  \|\  \|\  \|\___   ___\
+ *   \ \  \___|\ \  \|\  \ \  \___|\ \  \|\  \ \  \\ \  \ \  \\\  \|___ \  \_|
+ *    \ \  \    \ \  \\\  \ \  \    \ \  \\\  \ \  \\ \  \ \  \\\  \   \ \  \
+ *     \ \  \____\ \  \\\  \ \  \____\ \  \\\  \ \  \\ \  \ \  \\\  \   \ \  \
+ *      \ \_______\ \_______\ \_______\ \_______\ \__\\ \__\ \_______\   \ \__\
+ *       \|_______|\|_______|\|_______|\|_______|\|__| \|__|\|_______|    \|__|
+ *
+ * \file src/bytecode/decoded_method.h
+ * \brief Decoded-method cache: pc-indexed, ready-to-run instructions.
+ * \author SiriusNEO
+ */
+
+#ifndef SRC_BYTECODE_DECODED_METHOD_H_
+#define SRC_BYTECODE_DECODED_METHOD_H_
+
+#include "../classfile/attributes.h"
+#include "bytecode_decoder.h"
+
+namespace coconut {
+
+namespace bytecode {
+
+/*! \brief A decoded instruction in the cache. */
+struct DecodedInst {
+  /*! \brief The instruction, with its operands already fetched. */
+  Instruction* inst;
+
+  /*! \brief The opcode of the instruction. */
+  uint8_t opcode;
+
+  /*! \brief The pc of the instruction following this one. */
+  int nextPc;
+};
+
+/*!
+ * \brief The decoded form of a CodeAttr.
+ *
+ * It is a contiguous array indexed by pc. Every instruction is decoded (built
+ * by the factory and filled with its operands) only once, when it is fetched
+ * for the first time. After that, the interpreter dispatches straight from the
+ * array, without allocating or reading any byte.
+ *
+ * Slots whose pc falls in the operands of an instruction stay empty.
+ *
+ * \note The cache is owned by the CodeAttr (see DecodedMethod::of), so it
+ * lives as long as the class.
+ */
+class DecodedMethod {
+ private:
+  /*! \brief Internal decoder, reading the code of the method. */
+  BytecodeDecoder decoder_;
+
+  /*! \brief The length of the code. */
+  uint32_t codeLen_;
+
+  /*! \brief The decoded instructions, indexed by pc. */
+  DecodedInst* insts_;
+
+  /*!
+   * \brief Decode the instruction at some pc and put it into the cache.
+   * \param pc The pc of the instruction.
+   */
+  void decode_(int pc);
+
+ public:
+  /*!
+   * \brief Default constructor. Nothing is decoded here.
+   * \param codeAttr The code to decode.
+   */
+  explicit DecodedMethod(classfile::CodeAttr* codeAttr);
+
+  /*! \brief Default destructor. Delete all decoded instructions. */
+  ~DecodedMethod();
+
+  /*!
+   * \brief Fetch the decoded instruction at some pc. Decode it if it is not in
+   * the cache yet.
+   * \param pc The pc of the instruction.
+   * \return The decoded instruction.
+   */
+  const DecodedInst& fetch(int pc) {
+    DecodedInst& decoded = insts_[pc];
+    if (decoded.inst == nullptr) {
+      decode_(pc);
+    }
+    return decoded;
+  }
+
+  /*!
+   * \brief Get the decoded method of a CodeAttr. It is created when first
+   * requested and then attached to (and owned by) the CodeAttr.
+   * \param codeAttr The code attribute.
+   * \return The decoded method.
+   */
+  static DecodedMethod* of(classfile::CodeAttr* codeAttr);
+};
+
+}  // namespace bytecode
+
+}  // namespace coconut
+
+#endif  // SRC_BYTECODE_DECODED_METHOD_H_
@@ -81,6 +81,53 @@ class FrameExecutor {
    * offset. \param offset the offset.
    */
   void branch(int offset) { frame->nextPc = thread->pc + offset; }
+
+  /*!
+   * \brief Return from current frame. That is, pop it from the JVM stack and
+   * move to the invoker frame (nullptr if there is no invoker).
+   */
+  void popFrame() {
+    thread->stack.pop();
+    frame = thread->stack.topFrame;
+  }
+};
+
+/*!
+ * \brief Typed access to the operand stack, so that templated instructions can
+ * push and pop a value of type T. Specialized for int, long long, float,
+ * double.
+ */
+template <typename T>
+struct TypedOperand;
+
+template <>
+struct TypedOperand<int> {
+  static int pop(rtda::OperandStack* stack) { return stack->popInt(); }
+  static void push(rtda::OperandStack* stack, int val) { stack->pushInt(val); }
+};
+
+template <>
+struct TypedOperand<long long> {
+  static long long pop(rtda::OperandStack* stack) { return stack->popLong(); }
+  static void push(rtda::OperandStack* stack, long long val) {
+    stack->pushLong(val);
+  }
+};
+
+template <>
+struct TypedOperand<float> {
+  static float pop(rtda::OperandStack* stack) { return stack->popFloat(); }
+  static void push(rtda::OperandStack* stack, float val) {
+    stack->pushFloat(val);
+  }
+};
+
+template <>
+struct TypedOperand<double> {
+  static double pop(rtda::OperandStack* stack) { return stack->popDouble(); }
+  static void push(rtda::OperandStack* stack, double val) {
+    stack->pushDouble(val);
+  }
 };
 
 /*! \brief Base class for instructions without operands. */
@@ -19,8 +19,8 @@ namespace coconut {
 namespace bytecode {
 
 void Inst_lcmp::accept(FrameExecutor* executor) {
-  long long value1 = executor->frame->operandStack->popLong(),
-            value2 = executor->frame->operandStack->popLong();
+  long long value2 = executor->frame->operandStack->popLong(),
+            value1 = executor->frame->operandStack->popLong();
   if (value1 == value2)
     executor->frame->operandStack->pushInt(0);
   else if (value1 < value2)
@@ -29,38 +29,15 @@ void Inst_lcmp::accept(FrameExecutor* executor) {
     executor->frame->operandStack->pushInt(1);
 }
 
-void Inst_fcmp::accept(FrameExecutor* executor) {
-  float value1 = executor->frame->operandStack->popFloat(),
-        value2 = executor->frame->operandStack->popFloat();
+template <typename T, bool isG>
+void Inst_fpcmp<T, isG>::accept(FrameExecutor* executor) {
+  T value2 = TypedOperand<T>::pop(executor->frame->operandStack),
+    value1 = TypedOperand<T>::pop(executor->frame->operandStack);
 
   // IEEE 754
   // C++ operators may not follow, so check by hand
   if (std::isnan(value1) || std::isnan(value2)) {
-    if (is_g_)
-      executor->frame->operandStack->pushInt(1);
-    else
-      executor->frame->operandStack->pushInt(-1);
-  } else {
-    if (value1 == value2)
-      executor->frame->operandStack->pushInt(0);
-    else if (value1 < value2)
-      executor->frame->operandStack->pushInt(-1);
-    else
-      executor->frame->operandStack->pushInt(1);
-  }
-}
-
-void Inst_dcmp::accept(FrameExecutor* executor) {
-  double value1 = executor->frame->operandStack->popDouble(),
-         value2 = executor->frame->operandStack->popDouble();
-
-  // IEEE 754
-  // C++ operators may not follow, so check by hand
-  if (std::isnan(value1) || std::isnan(value2)) {
-    if (is_g_)
-      executor->frame->operandStack->pushInt(1);
-    else
-      executor->frame->operandStack->pushInt(-1);
+    executor->frame->operandStack->pushInt(isG ? 1 : -1);
   } else {
     if (value1 == value2)
       executor->frame->operandStack->pushInt(0);
@@ -71,89 +48,59 @@ void Inst_dcmp::accept(FrameExecutor* executor) {
   }
 }
 
-void Inst_if::accept(FrameExecutor* executor) {
+template <CmpOp op>
+void Inst_if<op>::accept(FrameExecutor* executor) {
   int value = executor->frame->operandStack->popInt();
-  bool succeed = false;
-
-  switch (op_) {
-    case EQ:
-      succeed = (value == 0);
-      break;
-    case NE:
-      succeed = (value != 0);
-      break;
-    case LT:
-      succeed = (value < 0);
-      break;
-    case GE:
-      succeed = (value >= 0);
-      break;
-    case GT:
-      succeed = (value > 0);
-      break;
-    case LE:
-      succeed = (value <= 0);
-      break;
-  }
 
-  if (succeed) {
+  if (Compare<op>::apply(value, 0)) {
     executor->branch(offset_);
   }
 }
 
-void Inst_if_icmp::accept(FrameExecutor* executor) {
+template <CmpOp op>
+void Inst_if_icmp<op>::accept(FrameExecutor* executor) {
   int value2 = executor->frame->operandStack->popInt(),
       value1 = executor->frame->operandStack->popInt();
-  bool succeed = false;
-
-  switch (op_) {
-    case EQ:
-      succeed = (value1 == value2);
-      break;
-    case NE:
-      succeed = (value1 != value2);
-      break;
-    case LT:
-      succeed = (value1 < value2);
-      break;
-    case GE:
-      succeed = (value1 >= value2);
-      break;
-    case GT:
-      succeed = (value1 > value2);
-      break;
-    case LE:
-      succeed = (value1 <= value2);
-      break;
-  }
 
-  if (succeed) {
+  if (Compare<op>::apply(value1, value2)) {
     executor->branch(offset_);
   }
 }
 
-void Inst_if_acmp::accept(FrameExecutor* executor) {
+template <CmpOp op>
+void Inst_if_acmp<op>::accept(FrameExecutor* executor) {
   rtda::Object *value2 = executor->frame->operandStack->popRef(),
                *value1 = executor->frame->operandStack->popRef();
-  bool succeed = false;
-
-  switch (op_) {
-    case EQ:
-      succeed = (value1 == value2);
-      break;
-    case NE:
-      succeed = (value1 != value2);
-      break;
-    default: /* not possible */
-      LOG(FATAL) << "if_acmp can not have operator type: " << op_;
-      break;
-  }
 
-  if (succeed) {
+  if (Compare<op>::apply(value1, value2)) {
     executor->branch(offset_);
   }
 }
 
+// instantiate all comparison instructions
+
+template class Inst_fpcmp<float, false>;
+template class Inst_fpcmp<float, true>;
+template class Inst_fpcmp<double, false>;
+template class Inst_fpcmp<double, true>;
+
+template class Inst_if<EQ>;
+template class Inst_if<NE>;
+template class Inst_if<LT>;
+template class Inst_if<GE>;
+template class Inst_if<GT>;
+template class Inst_if<LE>;
+
+template class Inst_if_icmp<EQ>;
+template class Inst_if_icmp<NE>;
+template class Inst_if_icmp<LT>;
+template class Inst_if_icmp<GE>;
+template class Inst_if_icmp<GT>;
+template class Inst_if_icmp<LE>;
+
+template class Inst_if_acmp<EQ>;
+template class Inst_if_acmp<NE>;
+
 }  // namespace bytecode
 
 }  // namespace coconut
@@ -30,76 +30,109 @@ class Inst_lcmp : public InstWithoutOperand {
 };
 
 /*!
- * \brief fcmp instruction (fcmpl, fcmpg).
- * Use a is_g flag to determine whether it is fcmpl or fcmpg.
+ * \brief Floating-point comparison on type T (fcmpl, fcmpg, dcmpl, dcmpg).
+ * isG is true for the "g" versions, which push 1 (instead of -1) on NaN.
  */
-class Inst_fcmp : public InstWithoutOperand {
- private:
-  bool is_g_;
-
+template <typename T, bool isG>
+class Inst_fpcmp : public InstWithoutOperand {
  public:
-  Inst_fcmp(bool is_g) : is_g_(is_g) {}
-
   void accept(FrameExecutor* executor);
 };
 
+/*! \brief fcmp instruction (fcmpl, fcmpg). */
+template <bool isG>
+using Inst_fcmp = Inst_fpcmp<float, isG>;
+
+/*! \brief dcmp instruction (dcmpl, dcmpg). */
+template <bool isG>
+using Inst_dcmp = Inst_fpcmp<double, isG>;
+
+/*! \brief Enum type of comparison operators. */
+enum CmpOp { EQ, NE, LT, GE, GT, LE };
+
 /*!
- * \brief dcmp instruction (dcmpl, dcmpg).
- * Use a is_g flag to determine whether it is dcmpl or dcmpg.
+ * \brief Comparison "value1 op value2", selected at compile time. Specialized
+ * for every CmpOp.
  */
-class Inst_dcmp : public InstWithoutOperand {
- private:
-  bool is_g_;
+template <CmpOp op>
+struct Compare;
+
+template <>
+struct Compare<EQ> {
+  template <typename T>
+  static bool apply(T value1, T value2) {
+    return value1 == value2;
+  }
+};
 
- public:
-  Inst_dcmp(bool is_g) : is_g_(is_g) {}
+template <>
+struct Compare<NE> {
+  template <typename T>
+  static bool apply(T value1, T value2) {
+    return value1 != value2;
+  }
+};
 
-  void accept(FrameExecutor* executor);
+template <>
+struct Compare<LT> {
+  template <typename T>
+  static bool apply(T value1, T value2) {
+    return value1 < value2;
+  }
 };
 
-/*! \brief Enum type of comparison operators. */
-enum CmpOp { EQ, NE, LT, GE, GT, LE };
+template <>
+struct Compare<GE> {
+  template <typename T>
+  static bool apply(T value1, T value2) {
+    return value1 >= value2;
+  }
+};
+
+template <>
+struct Compare<GT> {
+  template <typename T>
+  static bool apply(T value1, T value2) {
+    return value1 > value2;
+  }
+};
+
+template <>
+struct Compare<LE> {
+  template <typename T>
+  static bool apply(T value1, T value2) {
+    return value1 <= value2;
+  }
+};
 
 /*!
  * \brief if instruction (ifeq, ifne, iflt, ifge, ifgt, ifle).
- * Use op to identify different comparsions.
+ * Each comparison is a separate class, e.g. Inst_if<EQ> is ifeq.
  */
+template <CmpOp op>
 class Inst_if : public InstWithOffset {
- private:
-  CmpOp op_;
-
  public:
-  Inst_if(CmpOp op) : op_(op) {}
-
   void accept(FrameExecutor* executor);
 };
 
 /*!
  * \brief if_icmp instruction (if_icmpeq, if_icmpne, if_icmplt, if_icmpge,
  * if_icmpgt, if_icmple).
- * Use op to identify different comparisons.
+ * Each comparison is a separate class, e.g. Inst_if_icmp<LT> is if_icmplt.
  */
+template <CmpOp op>
 class Inst_if_icmp : public InstWithOffset {
- private:
-  CmpOp op_;
-
  public:
-  Inst_if_icmp(CmpOp op) : op_(op) {}
-
   void accept(FrameExecutor* executor);
 };
 
 /*!
- * \brief if_acmp instruction (if_icmpeq, if_icmpne).
- * Use op to identify different comparisons.
+ * \brief if_acmp instruction (if_acmpeq, if_acmpne).
+ * Each comparison is a separate class, only EQ and NE are valid.
  */
+template <CmpOp op>
 class Inst_if_acmp : public InstWithOffset {
- private:
-  CmpOp op_;
-
  public:
-  Inst_if_acmp(CmpOp op) : op_(op) {}
-
   void accept(FrameExecutor* executor);
 };
 
@@ -14,6 +14,8 @@
 
 #include "control.h"
 
+#include <algorithm>
+
 namespace coconut {
 
 namespace bytecode {
@@ -40,20 +42,85 @@ void Inst_lookupswitch::accept(utils::ByteReader* reader) {
   reader->padding4Bytes();
   defaultOffset_ = reader->fetchInt32();
   npairs_ = reader->fetchInt32();
-  reader->fetchInt32List(npairs_ << 1, matchOffsetPairs_);
+  for (int i = 0; i < npairs_; i++) {
+    matches_.push_back(reader->fetchInt32());
+    offsets_.push_back(reader->fetchInt32());
+  }
+  CHECK(std::is_sorted(matches_.begin(), matches_.end()))
+      << "lookupswitch keys are not sorted";
+
+  if (isDenseSwitch(npairs_, matches_.front(), matches_.back())) {
+    low_ = matches_.front();
+    jumpOffsets_.assign(matches_.back() - low_ + 1, defaultOffset_);
+    for (int i = 0; i < npairs_; i++) {
+      jumpOffsets_[matches_[i] - low_] = offsets_[i];
+    }
+  }
 }
 
 void Inst_lookupswitch::accept(FrameExecutor* executor) {
   int key = executor->frame->operandStack->popInt();
-  for (int i = 0; i < npairs_; i++) {
-    if (key == matchOffsetPairs_[i << 1]) {
-      executor->branch(matchOffsetPairs_[(i << 1) | 1]);
-      return;
-    }
+
+  if (!jumpOffsets_.empty()) {
+    unsigned int index = (unsigned int)(key) - (unsigned int)(low_);
+    if (index < jumpOffsets_.size())
+      executor->branch(jumpOffsets_[index]);
+    else
+      executor->branch(defaultOffset_);
+    return;
+  }
+
+  auto it = npairs_ <= kLinearSwitchMaxCases
+                 ? std::find(matches_.begin(), matches_.end(), key)
+                 : std::lower_bound(matches_.begin(), matches_.end(), key);
+  if (it != matches_.end() && *it == key)
+    executor->branch(offsets_[it - matches_.begin()]);
+  else
+    executor->branch(defaultOffset_);
+}
+
+void Inst_ireturn::accept(FrameExecutor* executor) {
+  int val = executor->frame->operandStack->popInt();
+  executor->popFrame();
+  if (executor->frame != nullptr) {
+    executor->frame->operandStack->pushInt(val);
+  }
+}
+
+void Inst_lreturn::accept(FrameExecutor* executor) {
+  long long val = executor->frame->operandStack->popLong();
+  executor->popFrame();
+  if (executor->frame != nullptr) {
+    executor->frame->operandStack->pushLong(val);
+  }
+}
+
+void Inst_freturn::accept(FrameExecutor* executor) {
+  float val = executor->frame->operandStack->popFloat();
+  executor->popFrame();
+  if (executor->frame != nullptr) {
+    executor->frame->operandStack->pushFloat(val);
   }
-  executor->branch(defaultOffset_);
 }
 
+void Inst_dreturn::accept(FrameExecutor* executor) {
+  double val = executor->frame->operandStack->popDouble();
+  executor->popFrame();
+  if (executor->frame != nullptr) {
+    executor->frame->operandStack->pushDouble(val);
+  }
+}
+
+void Inst_areturn::accept(FrameExecutor* executor) {
+  rtda::Object* ref = executor->frame->operandStack->popRef();
+  executor->popFrame();
+  if (executor->frame != nullptr) {
+    executor->frame->operandStack->pushRef(ref);
+  }
+}
+
+void Inst_return::accept(FrameExecutor* executor) { executor->popFrame(); }
+
 }  // namespace bytecode
 
 }  // namespace coconut
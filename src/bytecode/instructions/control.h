@@ -44,16 +44,48 @@ class Inst_tableswitch : public Instruction {
   void accept(FrameExecutor* executor);
 };
 
+/*!
+ * \brief A lookupswitch is dense if its key range is at most this many times
+ * its number of cases. A dense one is compiled into a jump table.
+ */
+const int kDenseSwitchFactor = 4;
+
+/*!
+ * \brief A sparse lookupswitch with at most this many cases is scanned
+ * linearly, which predicts better than binary search for few cases.
+ */
+const int kLinearSwitchMaxCases = 64;
+
+/*!
+ * \brief Whether a lookupswitch should be compiled into a jump table.
+ * \param npairs Number of cases.
+ * \param low The smallest key.
+ * \param high The largest key.
+ */
+inline bool isDenseSwitch(int npairs, int low, int high) {
+  long long range = (long long)(high) - low + 1;
+  return npairs > 0 && range <= kDenseSwitchFactor * (long long)(npairs);
+}
+
 /*!
  * \brief lookupswitch instruction.
  *
  * Access jump table by key match and jump. It has many jump targets (stored in
  * key-value paris).
+ *
+ * The keys are sorted (guaranteed by the JVM specification), so they are
+ * searched by binary search, or scanned if there are only a few of them. If
+ * the keys are dense (see isDenseSwitch), a jump table indexed by (key - low)
+ * is built when decoding instead.
  */
 class Inst_lookupswitch : public Instruction {
  private:
   int defaultOffset_, npairs_;
-  std::vector<int> matchOffsetPairs_;
+  std::vector<int> matches_, offsets_;
+
+  /*! \brief Jump table of a dense switch. Empty if not dense. */
+  int low_;
+  std::vector<int> jumpOffsets_;
 
  public:
   void accept(utils::ByteReader* reader);
@@ -61,7 +93,55 @@ class Inst_lookupswitch : public Instruction {
   void accept(FrameExecutor* executor);
 };
 
-// TODO: jsr, ret, xreturn implementation
+/*!
+ * \brief ireturn instruction. Return an int to the invoker frame.
+ */
+class Inst_ireturn : public InstWithoutOperand {
+ public:
+  void accept(FrameExecutor* executor);
+};
+
+/*!
+ * \brief lreturn instruction. Return a long to the invoker frame.
+ */
+class Inst_lreturn : public InstWithoutOperand {
+ public:
+  void accept(FrameExecutor* executor);
+};
+
+/*!
+ * \brief freturn instruction. Return a float to the invoker frame.
+ */
+class Inst_freturn : public InstWithoutOperand {
+ public:
+  void accept(FrameExecutor* executor);
+};
+
+/*!
+ * \brief dreturn instruction. Return a double to the invoker frame.
+ */
+class Inst_dreturn : public InstWithoutOperand {
+ public:
+  void accept(FrameExecutor* executor);
+};
+
+/*!
+ * \brief areturn instruction. Return a reference to the invoker frame.
+ */
+class Inst_areturn : public InstWithoutOperand {
+ public:
+  void accept(FrameExecutor* executor);
+};
+
+/*!
+ * \brief return instruction. Return void from the method.
+ */
+class Inst_return : public InstWithoutOperand {
+ public:
+  void accept(FrameExecutor* executor);
+};
+
+// TODO: jsr, ret implementation
 
 }  // namespace bytecode
 
@@ -65,12 +65,12 @@ void Inst_l2d::accept(FrameExecutor* executor) {
 
 void Inst_f2i::accept(FrameExecutor* executor) {
   executor->frame->operandStack->pushInt(
-      executor->frame->operandStack->popFloat());
+      saturatingCast<int>(executor->frame->operandStack->popFloat()));
 }
 
 void Inst_f2l::accept(FrameExecutor* executor) {
   executor->frame->operandStack->pushLong(
-      executor->frame->operandStack->popFloat());
+      saturatingCast<long long>(executor->frame->operandStack->popFloat()));
 }
 
 void Inst_f2d::accept(FrameExecutor* executor) {
@@ -80,12 +80,12 @@ void Inst_f2d::accept(FrameExecutor* executor) {
 
 void Inst_d2i::accept(FrameExecutor* executor) {
   executor->frame->operandStack->pushInt(
-      executor->frame->operandStack->popDouble());
+      saturatingCast<int>(executor->frame->operandStack->popDouble()));
 }
 
 void Inst_d2l::accept(FrameExecutor* executor) {
   executor->frame->operandStack->pushLong(
-      executor->frame->operandStack->popDouble());
+      saturatingCast<long long>(executor->frame->operandStack->popDouble()));
 }
 
 void Inst_d2f::accept(FrameExecutor* executor) {
@@ -18,6 +18,9 @@
 #ifndef SRC_BYTECODE_INSTRUCTIONS_CONVERSIONS_H_
 #define SRC_BYTECODE_INSTRUCTIONS_CONVERSIONS_H_
 
+#include <cmath>
+#include <limits>
+
 #include "../inst_base.h"
 
 namespace coconut {
@@ -78,6 +81,24 @@ class Inst_l2d : public InstWithoutOperand {
   void accept(FrameExecutor* executor);
 };
 
+/*!
+ * \brief Floating-point to integral conversion as in Java (f2i, f2l, d2i, d2l):
+ * NaN converts to 0, and values out of the range of To saturate to its MIN or
+ * MAX. A plain cast of them is undefined in C++.
+ */
+template <typename To, typename From>
+inline To saturatingCast(From value) {
+  if (std::isnan(value)) return 0;
+  if (value <= From(std::numeric_limits<To>::min())) {
+    return std::numeric_limits<To>::min();
+  }
+  // MAX may round up to 2^31 or 2^63 in From, which is out of range as well
+  if (value >= From(std::numeric_limits<To>::max())) {
+    return std::numeric_limits<To>::max();
+  }
+  return To(value);
+}
+
 /*! \brief f2i instruction (float to int). */
 class Inst_f2i : public InstWithoutOperand {
  public:
@@ -18,194 +18,65 @@ namespace coconut {
 
 namespace bytecode {
 
-void Inst_iarith::accept(FrameExecutor* executor) {
-  int value2 = executor->frame->operandStack->popInt();
-  int result;
-
-  if (op_ == NEG) {
-    result = -value2;
-  } else {
-    int value1 = executor->frame->operandStack->popInt();
-    switch (op_) {
-      case ADD:
-        result = value1 + value2;
-        break;
-      case SUB:
-        result = value1 - value2;
-        break;
-      case MUL:
-        result = value1 * value2;
-        break;
-      case DIV:
-      case REM: {
-        // TODO: throw Java Exception instead.
-        CHECK(value2 != 0) << "java.lang.ArithmeticException: / by zero";
-        if (op_ == DIV)
-          result = value1 / value2;
-        else
-          result = value1 % value2;
-        break;
-      }
-      case SHL:
-        result = value1 << (value2 & 0x1f);
-        break;
-      case SHR:
-        result = value1 >> ((unsigned int)(value2 & 0x1f));
-        break;
-      case USHR:
-        result = (unsigned int)(value1) >> ((unsigned int)(value2 & 0x1f));
-        break;
-      case AND:
-        result = value1 & value2;
-        break;
-      case OR:
-        result = value1 | value2;
-        break;
-      case XOR:
-        result = value1 ^ value2;
-        break;
-      case NEG: /* impossible */
-        break;
-    }
-  }
-
-  executor->frame->operandStack->pushInt(result);
+template <typename T, ArithmOp op>
+void Inst_arith<T, op>::accept(FrameExecutor* executor) {
+  // the shift distance of shl, shr, ushr is an int
+  typedef typename std::conditional<isShift(op), int, T>::type Operand2;
+
+  Operand2 value2 = TypedOperand<Operand2>::pop(executor->frame->operandStack);
+  T value1 = TypedOperand<T>::pop(executor->frame->operandStack);
+  TypedOperand<T>::push(executor->frame->operandStack,
+                        Arithm<op, T>::apply(value1, value2));
 }
 
-void Inst_larith::accept(FrameExecutor* executor) {
-  long long value2 = executor->frame->operandStack->popLong();
-  long long result;
-
-  if (op_ == NEG) {
-    result = -value2;
-  } else {
-    long long value1 = executor->frame->operandStack->popLong();
-    switch (op_) {
-      case ADD:
-        result = value1 + value2;
-        break;
-      case SUB:
-        result = value1 - value2;
-        break;
-      case MUL:
-        result = value1 * value2;
-        break;
-      case DIV:
-      case REM: {
-        // TODO: throw Java Exception instead.
-        CHECK(value2 != 0) << "java.lang.ArithmeticException: / by zero";
-        if (op_ == DIV)
-          result = value1 / value2;
-        else
-          result = value1 % value2;
-        break;
-      }
-      case SHL:
-        result = value1 << (value2 & 0x3f);
-        break;
-      case SHR:
-        result = value1 >> ((unsigned long long)(value2 & 0x3f));
-        break;
-      case USHR:
-        result = (unsigned long long)(value1) >>
-                 ((unsigned long long)(value2 & 0x3f));
-        break;
-      case AND:
-        result = value1 & value2;
-        break;
-      case OR:
-        result = value1 | value2;
-        break;
-      case XOR:
-        result = value1 ^ value2;
-        break;
-      case NEG: /* impossible */
-        break;
-    }
-  }
-
-  executor->frame->operandStack->pushLong(result);
+template <typename T>
+void Inst_neg<T>::accept(FrameExecutor* executor) {
+  T value = TypedOperand<T>::pop(executor->frame->operandStack);
+  TypedOperand<T>::push(executor->frame->operandStack, -value);
 }
 
-void Inst_farith::accept(FrameExecutor* executor) {
-  float value2 = executor->frame->operandStack->popFloat();
-  float result;
-
-  if (op_ == NEG) {
-    result = -value2;
-  } else {
-    float value1 = executor->frame->operandStack->popFloat();
-    switch (op_) {
-      case ADD:
-        result = value1 + value2;
-        break;
-      case SUB:
-        result = value1 - value2;
-        break;
-      case MUL:
-        result = value1 * value2;
-        break;
-      case DIV:
-      case REM: {
-        if (op_ == DIV)
-          result = value1 / value2;
-        else
-          result = std::fmod(value1, value2);  // check
-        break;
-      }
-      case SHL:
-      case SHR:
-      case USHR:
-      case AND:
-      case OR:
-      case XOR:
-      case NEG: /* impossible */
-        break;
-    }
-  }
-
-  executor->frame->operandStack->pushFloat(result);
-}
-
-void Inst_darith::accept(FrameExecutor* executor) {
-  double value2 = executor->frame->operandStack->popDouble();
-  double result;
-
-  if (op_ == NEG) {
-    result = -value2;
-  } else {
-    double value1 = executor->frame->operandStack->popDouble();
-    switch (op_) {
-      case ADD:
-        result = value1 + value2;
-        break;
-      case SUB:
-        result = value1 - value2;
-        break;
-      case MUL:
-        result = value1 * value2;
-        break;
-      case DIV:
-      case REM: {
-        if (op_ == DIV)
-          result = value1 / value2;
-        else
-          result = std::fmod(value1, value2);  // check
-        break;
-      }
-      case SHL:
-      case SHR:
-      case USHR:
-      case AND:
-      case OR:
-      case XOR:
-      case NEG: /* impossible */
-        break;
-    }
-  }
-
-  executor->frame->operandStack->pushDouble(result);
-}
+// instantiate all arithmetic instructions
+
+template class Inst_arith<int, ADD>;
+template class Inst_arith<int, SUB>;
+template class Inst_arith<int, MUL>;
+template class Inst_arith<int, DIV>;
+template class Inst_arith<int, REM>;
+template class Inst_arith<int, SHL>;
+template class Inst_arith<int, SHR>;
+template class Inst_arith<int, USHR>;
+template class Inst_arith<int, AND>;
+template class Inst_arith<int, OR>;
+template class Inst_arith<int, XOR>;
+
+template class Inst_arith<long long, ADD>;
+template class Inst_arith<long long, SUB>;
+template class Inst_arith<long long, MUL>;
+template class Inst_arith<long long, DIV>;
+template class Inst_arith<long long, REM>;
+template class Inst_arith<long long, SHL>;
+template class Inst_arith<long long, SHR>;
+template class Inst_arith<long long, USHR>;
+template class Inst_arith<long long, AND>;
+template class Inst_arith<long long, OR>;
+template class Inst_arith<long long, XOR>;
+
+template class Inst_arith<float, ADD>;
+template class Inst_arith<float, SUB>;
+template class Inst_arith<float, MUL>;
+template class Inst_arith<float, DIV>;
+template class Inst_arith<float, REM>;
+
+template class Inst_arith<double, ADD>;
+template class Inst_arith<double, SUB>;
+template class Inst_arith<double, MUL>;
+template class Inst_arith<double, DIV>;
+template class Inst_arith<double, REM>;
+
+template class Inst_neg<int>;
+template class Inst_neg<long long>;
+template class Inst_neg<float>;
+template class Inst_neg<double>;
 
 void Inst_iinc::accept(utils::ByteReader* reader) {
   index_ = (unsigned int)(reader->fetchU1());
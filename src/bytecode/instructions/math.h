@@ -25,6 +25,8 @@
 #define SRC_BYTECODE_INSTRUCTIONS_MATH_H_
 
 #include <cmath>
+#include <limits>
+#include <type_traits>
 
 #include "../inst_base.h"
 
@@ -35,61 +37,142 @@ namespace bytecode {
 /*! \brief Enum type for arithmetic operators. */
 enum ArithmOp { ADD, SUB, MUL, DIV, REM, NEG, SHL, SHR, USHR, AND, OR, XOR };
 
+/*! \brief Whether the operator is a shift, whose distance is an int. */
+constexpr bool isShift(ArithmOp op) {
+  return op == SHL || op == SHR || op == USHR;
+}
+
 /*!
- * \brief iarith instruction (iadd, isub, imul, idiv, irem, ineg, ishl, ishr,
- * iushr, iand, ior, ixor).
- * Use op to identify different arithmetic operations.
+ * \brief Arithmetic operation "value1 op value2" on type T, selected at compile
+ * time. Specialized for every binary ArithmOp (NEG is Inst_neg).
  */
-class Inst_iarith : public InstWithoutOperand {
- private:
-  ArithmOp op_;
+template <ArithmOp op, typename T>
+struct Arithm;
 
- public:
-  Inst_iarith(ArithmOp op) : op_(op) {}
+template <typename T>
+struct Arithm<ADD, T> {
+  static T apply(T value1, T value2) { return value1 + value2; }
+};
 
-  void accept(FrameExecutor* executor);
+template <typename T>
+struct Arithm<SUB, T> {
+  static T apply(T value1, T value2) { return value1 - value2; }
 };
 
-/*!
- * \brief larith instruction (ladd, lsub, lmul, ldiv, lrem, lneg, lshl, lshr,
- * lushr, land, lor, lxor).
- * Use op to identify different arithmetic operations.
- */
-class Inst_larith : public InstWithoutOperand {
- private:
-  ArithmOp op_;
+template <typename T>
+struct Arithm<MUL, T> {
+  static T apply(T value1, T value2) { return value1 * value2; }
+};
 
- public:
-  Inst_larith(ArithmOp op) : op_(op) {}
+template <typename T>
+struct Arithm<DIV, T> {
+  static T apply(T value1, T value2) {
+    if (std::is_integral<T>::value) {
+      // TODO: throw Java Exception instead.
+      CHECK(value2 != 0) << "java.lang.ArithmeticException: / by zero";
+      // MIN / -1 overflows, which traps on x86: Java wraps it around to MIN
+      if (value2 == T(-1) && value1 == std::numeric_limits<T>::min()) {
+        return value1;
+      }
+    }
+    return value1 / value2;
+  }
+};
 
-  void accept(FrameExecutor* executor);
+template <typename T>
+struct Arithm<REM, T> {
+  static T apply(T value1, T value2) {
+    // TODO: throw Java Exception instead.
+    CHECK(value2 != 0) << "java.lang.ArithmeticException: / by zero";
+    if (value2 == -1) return 0;  // MIN % -1 overflows as well
+    return value1 % value2;
+  }
 };
 
-/*!
- * \brief farith instruction (fadd, fsub, fmul, fdiv, frem, fneg).
- * Use op to identify different arithmetic operations.
- */
-class Inst_farith : public InstWithoutOperand {
- private:
-  ArithmOp op_;
+template <>
+struct Arithm<REM, float> {
+  static float apply(float value1, float value2) {
+    return std::fmod(value1, value2);
+  }
+};
 
- public:
-  Inst_farith(ArithmOp op) : op_(op) {}
+template <>
+struct Arithm<REM, double> {
+  static double apply(double value1, double value2) {
+    return std::fmod(value1, value2);
+  }
+};
 
-  void accept(FrameExecutor* executor);
+template <typename T>
+struct Arithm<SHL, T> {
+  static T apply(T value1, int value2) {
+    return value1 << (value2 & (sizeof(T) * 8 - 1));
+  }
+};
+
+template <typename T>
+struct Arithm<SHR, T> {
+  static T apply(T value1, int value2) {
+    return value1 >> (value2 & (sizeof(T) * 8 - 1));
+  }
+};
+
+template <typename T>
+struct Arithm<USHR, T> {
+  static T apply(T value1, int value2) {
+    typedef typename std::make_unsigned<T>::type UnsignedT;
+    return T(UnsignedT(value1) >> (value2 & (sizeof(T) * 8 - 1)));
+  }
+};
+
+template <typename T>
+struct Arithm<AND, T> {
+  static T apply(T value1, T value2) { return value1 & value2; }
+};
+
+template <typename T>
+struct Arithm<OR, T> {
+  static T apply(T value1, T value2) { return value1 | value2; }
+};
+
+template <typename T>
+struct Arithm<XOR, T> {
+  static T apply(T value1, T value2) { return value1 ^ value2; }
 };
 
 /*!
- * \brief darith instruction (dadd, dsub, dmul, ddiv, drem, dneg).
- * Use op to identify different arithmetic operations.
+ * \brief Binary arithmetic instruction on type T.
+ * Each (T, op) is a separate class, e.g. Inst_arith<int, ADD> is iadd, so
+ * executing it does not switch on the operator again after dispatch.
  */
-class Inst_darith : public InstWithoutOperand {
- private:
-  ArithmOp op_;
-
+template <typename T, ArithmOp op>
+class Inst_arith : public InstWithoutOperand {
  public:
-  Inst_darith(ArithmOp op) : op_(op) {}
+  void accept(FrameExecutor* executor);
+};
+
+/*! \brief iarith instruction (iadd, isub, imul, idiv, irem, ishl, ishr, iushr,
+ * iand, ior, ixor). */
+template <ArithmOp op>
+using Inst_iarith = Inst_arith<int, op>;
 
+/*! \brief larith instruction (ladd, lsub, lmul, ldiv, lrem, lshl, lshr, lushr,
+ * land, lor, lxor). */
+template <ArithmOp op>
+using Inst_larith = Inst_arith<long long, op>;
+
+/*! \brief farith instruction (fadd, fsub, fmul, fdiv, frem). */
+template <ArithmOp op>
+using Inst_farith = Inst_arith<float, op>;
+
+/*! \brief darith instruction (dadd, dsub, dmul, ddiv, drem). */
+template <ArithmOp op>
+using Inst_darith = Inst_arith<double, op>;
+
+/*! \brief neg instruction on type T (ineg, lneg, fneg, dneg). */
+template <typename T>
+class Inst_neg : public InstWithoutOperand {
+ public:
   void accept(FrameExecutor* executor);
 };
 
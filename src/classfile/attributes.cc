@@ -14,6 +14,9 @@
 
 #include "attributes.h"
 
+#include "../bytecode/decoded_method.h"
+#include "../vm/method_data.h"
+
 namespace coconut {
 
 namespace classfile {
@@ -24,8 +27,8 @@ AttributeInfo* attributeInfoFactory(utils::ByteReader& reader,
   uint32_t attrLen = reader.fetchU4();
   std::string attrName = cp->getLiteral(attrNameIdx);
 
-  int namePos = 9;
-  for (int i = 0; i < 9; ++i) {
+  int namePos = POS_Unimplemented;
+  for (int i = 0; i < POS_Unimplemented; ++i) {
     if (attrName == ATTRIBUTES_NAMES[i]) {
       namePos = i;
       break;
@@ -65,12 +68,87 @@ AttributeInfo* attributeInfoFactory(utils::ByteReader& reader,
       // LOG(INFO) << "syn attr";
       return new SyntheticAttr();
     }
+    case POS_StackMapTable: {
+      return new StackMapTableAttr(reader);
+    }
     default: {
       return new UnimplementedAttr(reader, attrLen);
     }
   }
 }
 
+StackMapTableAttr* Attributes::filtStackMapTableAttr() {
+  for (int i = 0; i < attributesNum; ++i) {
+    if (list[i]->namePos == POS_StackMapTable) {
+      return static_cast<StackMapTableAttr*>(list[i]);
+    }
+  }
+  return nullptr;
+}
+
+static VerificationTypeInfo fetchVerificationTypeInfo(
+    utils::ByteReader& reader) {
+  VerificationTypeInfo info = {reader.fetchU1(), 0};
+  if (info.tag == ITEM_Object || info.tag == ITEM_Uninitialized) {
+    info.data = reader.fetchU2();
+  }
+  return info;
+}
+
+StackMapTableAttr::StackMapTableAttr(utils::ByteReader& reader)
+    : AttributeInfo(POS_StackMapTable) {
+  uint16_t entriesNum = reader.fetchU2();
+  for (uint16_t i = 0; i < entriesNum; ++i) {
+    StackMapFrame frame;
+    frame.frameType = reader.fetchU1();
+    if (frame.frameType < 64) {
+      // same_frame
+      frame.offsetDelta = frame.frameType;
+    } else if (frame.frameType < 128) {
+      // same_locals_1_stack_item_frame
+      frame.offsetDelta = frame.frameType - 64;
+      frame.stack.push_back(fetchVerificationTypeInfo(reader));
+    } else if (frame.frameType == 247) {
+      // same_locals_1_stack_item_frame_extended
+      frame.offsetDelta = reader.fetchU2();
+      frame.stack.push_back(fetchVerificationTypeInfo(reader));
+    } else if (frame.frameType >= 248 && frame.frameType <= 251) {
+      // chop_frame, same_frame_extended
+      frame.offsetDelta = reader.fetchU2();
+    } else if (frame.frameType >= 252 && frame.frameType <= 254) {
+      // append_frame
+      frame.offsetDelta = reader.fetchU2();
+      for (int k = 0; k < frame.frameType - 251; ++k) {
+        frame.locals.push_back(fetchVerificationTypeInfo(reader));
+      }
+    } else if (frame.frameType == 255) {
+      // full_frame
+      frame.offsetDelta = reader.fetchU2();
+      uint16_t localsNum = reader.fetchU2();
+      for (uint16_t k = 0; k < localsNum; ++k) {
+        frame.locals.push_back(fetchVerificationTypeInfo(reader));
+      }
+      uint16_t stackNum = reader.fetchU2();
+      for (uint16_t k = 0; k < stackNum; ++k) {
+        frame.stack.push_back(fetchVerificationTypeInfo(reader));
+      }
+    } else {
+      LOG(FATAL) << "Bad stack map frame type: "
+                 << static_cast<unsigned int>(frame.frameType);
+    }
+    entries.push_back(frame);
+  }
+}
+
+CodeAttr::~CodeAttr() {
+  delete[] code;
+  delete attributes;
+  if (decodedMethod != nullptr) {
+    delete decodedMethod;
+  }
+  delete methodData;
+}
+
 }  // namespace classfile
 
 }  // namespace coconut
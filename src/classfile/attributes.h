@@ -20,6 +20,20 @@
 
 namespace coconut {
 
+namespace bytecode {
+
+// pre-declare DecodedMethod to avoid cycle reference.
+class DecodedMethod;
+
+}  // namespace bytecode
+
+namespace vm {
+
+// pre-declare MethodData to avoid cycle reference.
+class MethodData;
+
+}  // namespace vm
+
 namespace classfile {
 
 /*! \brief Positions of attributes in the list. */
@@ -32,13 +46,14 @@ const int POS_LineNumberTable = 5;
 const int POS_LocalVariableTable = 6;
 const int POS_SourceFile = 7;
 const int POS_Synthetic = 8;
-const int POS_Unimplemented = 9;
+const int POS_StackMapTable = 9;
+const int POS_Unimplemented = 10;
 
 /*! \brief Names of the attributes. */
 const std::string ATTRIBUTES_NAMES[] = {
     "Code",         "ConstantValue",   "Deprecated",         "Exceptions",
     "InnerClasses", "LineNumberTable", "LocalVariableTable", "SourceFile",
-    "Synthetic",    "Unimplemented"};
+    "Synthetic",    "StackMapTable",   "Unimplemented"};
 
 /*! \brief The attribute info. Record the position of name instead of name
  * string. */
@@ -64,8 +79,9 @@ struct AttributeInfo {
 AttributeInfo* attributeInfoFactory(utils::ByteReader& reader,
                                     ConstantPool* cp);
 
-// pre-declare CodeAttr to avoid cycle reference.
+// pre-declare CodeAttr, StackMapTableAttr to avoid cycle reference.
 struct CodeAttr;
+struct StackMapTableAttr;
 
 /*! \brief Abstraction of a list of attribute infos. */
 struct Attributes {
@@ -95,6 +111,9 @@ struct Attributes {
     }
     return nullptr;
   }
+
+  /*! \brief Get the StackMapTable attribute. nullptr if there is none. */
+  StackMapTableAttr* filtStackMapTableAttr();
 };
 
 /*! \brief The entry of exception table. Used in CodeAttr. */
@@ -105,9 +124,20 @@ struct ExceptionTableEntry {
   uint16_t catchType;
 };
 
+/*! \brief Result of the verification of a code (see vm/verifier.h). */
+enum VerifyStatus : uint8_t {
+  /*! \brief Not verified yet. */
+  kVerifyPending,
+  /*! \brief Proven type-safe: engines may run it without runtime checks. */
+  kVerifyPassed,
+  /*! \brief Rejected: it only runs on the checked (classic) engine. */
+  kVerifyFailed
+};
+
 /*!
  * \brief The Code attribute.
- * \note It has some memory fields (code, attributes) to delete.
+ * \note It has some memory fields (code, attributes, decodedMethod, methodData)
+ * to delete.
  */
 struct CodeAttr : public AttributeInfo {
   ConstantPool* cp;
@@ -118,8 +148,44 @@ struct CodeAttr : public AttributeInfo {
   std::vector<ExceptionTableEntry> exceptionTable;
   Attributes* attributes;
 
+  /*! \brief The decoded instructions. Built when it is first interpreted. */
+  bytecode::DecodedMethod* decodedMethod;
+
+  /*! \brief Result of the verifier. Set when the class is verified. */
+  VerifyStatus verifyStatus;
+
+  /*!
+   * \brief The name and the descriptor of the method, as indices of cp. Set by
+   * the MethodInfo owning the code. 0 if unknown.
+   */
+  uint16_t methodNameIdx;
+  uint16_t methodDescriptorIdx;
+
+  /*!
+   * \brief Number of times the method is invoked, and number of backward
+   * branches taken in it. Counted by the threaded engine (a frame adds its
+   * backedges in batches), without atomic read-modify-writes, so a race may
+   * lose counts.
+   */
+  uint64_t invocationCount;
+  uint64_t backedgeCount;
+
+  /*!
+   * \brief The profile of the method (see vm/method_data.h). Allocated once
+   * the method is warm. nullptr before.
+   */
+  vm::MethodData* methodData;
+
   CodeAttr(utils::ByteReader& reader, ConstantPool* _cp)
-      : cp(_cp), AttributeInfo(POS_Code) {
+      : cp(_cp),
+        AttributeInfo(POS_Code),
+        decodedMethod(nullptr),
+        verifyStatus(kVerifyPending),
+        methodNameIdx(0),
+        methodDescriptorIdx(0),
+        invocationCount(0),
+        backedgeCount(0),
+        methodData(nullptr) {
     maxStack = reader.fetchU2();
     maxLocals = reader.fetchU2();
 
@@ -137,10 +203,7 @@ struct CodeAttr : public AttributeInfo {
     attributes = new Attributes(reader, cp);
   }
 
-  ~CodeAttr() {
-    delete[] code;
-    delete attributes;
-  }
+  ~CodeAttr();
 };
 
 /*! \brief The ConstantValue attribute. */
@@ -236,6 +299,44 @@ struct SyntheticAttr : public AttributeInfo {
   SyntheticAttr() : AttributeInfo(POS_Synthetic) {}
 };
 
+/*! \brief Tags of verification_type_info. Used in StackMapTableAttr. */
+const uint8_t ITEM_Top = 0;
+const uint8_t ITEM_Integer = 1;
+const uint8_t ITEM_Float = 2;
+const uint8_t ITEM_Double = 3;
+const uint8_t ITEM_Long = 4;
+const uint8_t ITEM_Null = 5;
+const uint8_t ITEM_UninitializedThis = 6;
+const uint8_t ITEM_Object = 7;
+const uint8_t ITEM_Uninitialized = 8;
+
+/*!
+ * \brief The verification_type_info. data is the class index of ITEM_Object,
+ * or the offset of the new instruction of ITEM_Uninitialized.
+ */
+struct VerificationTypeInfo {
+  uint8_t tag;
+  uint16_t data;
+};
+
+/*!
+ * \brief An entry of stack map table, as it is in the class file: locals are
+ * the appended ones of an append frame, or all of a full frame.
+ */
+struct StackMapFrame {
+  uint8_t frameType;
+  uint16_t offsetDelta;
+  std::vector<VerificationTypeInfo> locals;
+  std::vector<VerificationTypeInfo> stack;
+};
+
+/*! \brief The StackMapTable attribute. */
+struct StackMapTableAttr : public AttributeInfo {
+  std::vector<StackMapFrame> entries;
+
+  StackMapTableAttr(utils::ByteReader& reader);
+};
+
 /*! \brief Attributes which are unimplemented. Temporarily stored in this
  * structural. */
 struct UnimplementedAttr : public AttributeInfo {
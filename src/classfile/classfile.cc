@@ -82,6 +82,16 @@ ClassFile::ClassFile(utils::ByteReader& reader)
   attributes = new Attributes(reader, cp);
 }
 
+MethodInfo* ClassFile::findMethod(const std::string& name,
+                                  const std::string& descriptor) {
+  for (auto& method : methods) {
+    if (method.fieldName() == name && method.descriptor() == descriptor) {
+      return &method;
+    }
+  }
+  return nullptr;
+}
+
 void ClassFile::display() const {
   std::ostringstream s;
   s << "--- [classfile] ---\n"
@@ -24,6 +24,13 @@ namespace classfile {
 /*! \brief Java class file magic number: cafe babe. */
 const int JAVA_CLASS_MAGIC = 0xCAFEBABE;
 
+/*! \brief Access flags of classes and methods. */
+const uint16_t ACC_PRIVATE = 0x0002;
+const uint16_t ACC_STATIC = 0x0008;
+const uint16_t ACC_NATIVE = 0x0100;
+const uint16_t ACC_INTERFACE = 0x0200;
+const uint16_t ACC_ABSTRACT = 0x0400;
+
 /*! \brief Info of fields in Java. "Fields" here means members in the class. */
 struct FieldInfo {
   ConstantPool* cp;
@@ -39,6 +46,11 @@ struct FieldInfo {
     descriptorIdx = reader.fetchU2();
 
     attributes = new Attributes(reader, cp);
+    CodeAttr* codeAttr = attributes->filtCodeAttr();
+    if (codeAttr != nullptr) {
+      codeAttr->methodNameIdx = nameIdx;
+      codeAttr->methodDescriptorIdx = descriptorIdx;
+    }
   }
 
   FieldInfo(FieldInfo&& other)
@@ -52,6 +64,8 @@ struct FieldInfo {
 
   std::string fieldName() const { return cp->getLiteral(nameIdx); }
 
+  std::string descriptor() const { return cp->getLiteral(descriptorIdx); }
+
   ~FieldInfo() {
     if (attributes != nullptr) delete attributes;
   }
@@ -135,6 +149,15 @@ class ClassFile {
     return cp->getClassNameStr(superClass);
   }
 
+  /*!
+   * \brief Find a method declared in this class.
+   * \param name The name of the method.
+   * \param descriptor The descriptor of the method.
+   * \return The method. nullptr if not found.
+   */
+  MethodInfo* findMethod(const std::string& name,
+                         const std::string& descriptor);
+
   /*!
    * \brief Display the class file.
    */
@@ -88,6 +88,9 @@ class ConstantPool {
     }
   }
 
+  /*! \brief Max number of info, i.e. the bound of the indices. */
+  uint16_t count() const { return cpCount_; }
+
   /*!
    * \brief Get a literal string from the pool.
    * \param utf8Idx The index of the utf8.
@@ -129,7 +132,8 @@ struct ConstantFloatInfo : public ConstantInfo {
 
   explicit ConstantFloatInfo(utils::ByteReader& reader)
       : ConstantInfo(CONSTANT_TAG_Float) {
-    val = float(reader.fetchU4());
+    uint32_t bits = reader.fetchU4();
+    val = *(float*)(&bits);
   }
 };
 
@@ -151,7 +155,8 @@ struct ConstantDoubleInfo : public ConstantInfo {
 
   explicit ConstantDoubleInfo(utils::ByteReader& reader)
       : ConstantInfo(CONSTANT_TAG_Double) {
-    val = double(reader.fetchU8());
+    uint64_t bits = reader.fetchU8();
+    val = *(double*)(&bits);
   }
 };
 
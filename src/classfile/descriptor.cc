@@ -0,0 +1,75 @@
+/*!
+ *    ________  ________  ________  ________  ________   ___  ___  _________
+ *   |\   ____\|\   __  \|\   ____\|\   __  \|\   ___  \|\  \|\  \|\___   ___\
+ *   \ \  \___|\ \  \|\  \ \  \___|\ \  \|\  \ \  \\ \  \ \  \\\  \|___ \  \_|
+ *    \ \  \    \ \  \\\  \ \  \    \ \  \\\  \ \  \\ \  \ \  \\\  \   \ \  \
+ *     \ \  \____\ \  \\\  \ \  \____\ \  \\\  \ \  \\ \  \ \  \\\  \   \ \  \
+ *      \ \_______\ \_______\ \_______\ \_______\ \__\\ \__\ \_______\   \ \__\
+ *       \|_______|\|_______|\|_______|\|_______|\|__| \|__|\|_______|    \|__|
+ *
+ * \file src/classfile/descriptor.cc
+ * \brief Implementation of descriptor.h
+ * \author SiriusNEO
+ */
+
+#include "descriptor.h"
+
+#include "../utils/logging.h"
+
+namespace coconut {
+
+namespace classfile {
+
+// Parse a field type at pos, and move pos to the next type.
+static char parseFieldType(const std::string& descriptor, size_t& pos) {
+  // an array is a reference, whatever its element type is
+  bool array = false;
+  while (pos < descriptor.size() && descriptor[pos] == '[') {
+    array = true;
+    ++pos;
+  }
+  CHECK(pos < descriptor.size()) << "Bad descriptor: " << descriptor;
+  char type = descriptor[pos];
+  if (type == 'L') {
+    pos = descriptor.find(';', pos);
+    CHECK(pos != std::string::npos) << "Bad descriptor: " << descriptor;
+  } else {
+    CHECK(std::string("BCDFIJSZ").find(type) != std::string::npos)
+        << "Bad descriptor: " << descriptor;
+  }
+  ++pos;
+  return array ? 'L' : type;
+}
+
+std::string argumentTypes(const std::string& descriptor) {
+  CHECK(!descriptor.empty() && descriptor[0] == '(')
+      << "Bad method descriptor: " << descriptor;
+
+  std::string types;
+  size_t pos = 1;
+  while (pos < descriptor.size() && descriptor[pos] != ')') {
+    types.push_back(parseFieldType(descriptor, pos));
+  }
+  CHECK(pos < descriptor.size()) << "Bad method descriptor: " << descriptor;
+  return types;
+}
+
+char returnType(const std::string& descriptor) {
+  size_t pos = descriptor.find(')');
+  CHECK(pos != std::string::npos) << "Bad method descriptor: " << descriptor;
+  ++pos;
+  if (pos < descriptor.size() && descriptor[pos] == 'V') return 'V';
+  return parseFieldType(descriptor, pos);
+}
+
+int argumentSlots(const std::string& descriptor) {
+  int slots = 0;
+  for (char type : argumentTypes(descriptor)) {
+    slots += (type == 'J' || type == 'D') ? 2 : 1;
+  }
+  return slots;
+}
+
+}  // namespace classfile
+
+}  // namespace coconut
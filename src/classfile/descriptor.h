@@ -0,0 +1,56 @@
+/*!
+ *    ________  ________  ________  ________  ________   ___  ___  _________
+ *   |\   ____\|\   __  \|\   ____\|\   __  \|\   ___  \|\  \|\  \|\___   ___\
+ *   \ \  \___|\ \  \|\  \ \  \___|\ \  \|\  \ \  \\ \  \ \  \\\  \|___ \  \_|
+ *    \ \  \    \ \  \\\  \ \  \    \ \  \\\  \ \  \\ \  \ \  \\\  \   \ \  \
+ *     \ \  \____\ \  \\\  \ \  \____\ \  \\\  \ \  \\ \  \ \  \\\  \   \ \  \
+ *      \ \_______\ \_______\ \_______\ \_______\ \__\\ \__\ \_______\   \ \__\
+ *       \|_______|\|_______|\|_______|\|_______|\|__| \|__|\|_______|    \|__|
+ *
+ * \file src/classfile/descriptor.h
+ * \brief Parsing of field and method descriptors.
+ * \author SiriusNEO
+ */
+
+#ifndef SRC_CLASSFILE_DESCRIPTOR_H_
+#define SRC_CLASSFILE_DESCRIPTOR_H_
+
+#include <string>
+
+namespace coconut {
+
+namespace classfile {
+
+/*!
+ * \brief The types of the arguments of a method, one char per argument: the
+ * base type (e.g. I, J), or L for a reference (an object or an array).
+ * E.g. "IJL" for "(IJ[Ljava/lang/String;)V".
+ * \param descriptor The method descriptor.
+ * \return The types.
+ * \throw Panic if the descriptor is malformed.
+ */
+std::string argumentTypes(const std::string& descriptor);
+
+/*!
+ * \brief The return type of a method: the base type, L for a reference, or V
+ * for void.
+ * \param descriptor The method descriptor.
+ * \return The type.
+ * \throw Panic if the descriptor is malformed.
+ */
+char returnType(const std::string& descriptor);
+
+/*!
+ * \brief Number of slots the arguments of a method take, e.g. 3 for "(IJ)V".
+ * long and double take two slots. The receiver (this) is not counted.
+ * \param descriptor The method descriptor.
+ * \return Number of slots.
+ * \throw Panic if the descriptor is malformed.
+ */
+int argumentSlots(const std::string& descriptor);
+
+}  // namespace classfile
+
+}  // namespace coconut
+
+#endif  // SRC_CLASSFILE_DESCRIPTOR_H_
@@ -34,10 +34,15 @@
  *     https://github.com/Davipb/utf8-utf16-converter
  */
 
+#include <iostream>
+
 #include "classfile/file_loader.h"
 #include "utils/cmdline.h"
 #include "utils/logging.h"
 #include "vm/interpreter.h"
+#include "vm/register_interpreter.h"
+#include "vm/threaded_interpreter.h"
+#include "vm/verifier.h"
 
 #define MAX_CLASSFILE_SIZE 1048576  // 1MB
 
@@ -52,6 +57,8 @@ int main(int argc, char *argv[]) {
   LOG(INFO) << "Main Class: " << cmd.mainClassName.c_str();
   LOG(INFO) << "Class Path: " << cmd.classPath.c_str();
   LOG(INFO) << "JRE Path: " << cmd.jrePath.c_str();
+  LOG(INFO) << "Engine: " << cmd.engine.c_str();
+  LOG(INFO) << "Stack Size: " << cmd.stackSize;
 
   // Load Classes
   classfile::FileLoader fileLoader(cmd.jrePath, cmd.classPath);
@@ -63,9 +70,50 @@ int main(int argc, char *argv[]) {
   classFile.display();
   LOG(INFO) << "Class file loaded successfully.";
 
+  // verify the class, so the engines can run its code without checks
+  vm::verifyClass(&classFile);
+
   // interpret the program
-  vm::Interpreter interpreter;
-  interpreter.interpret(classFile.methods[1]);
+  vm::Interpreter *interpreter;
+  vm::ThreadedInterpreter *threaded = nullptr;
+  if (cmd.engine == "threaded") {
+    threaded =
+        new vm::ThreadedInterpreter(cmd.superInstructions, cmd.tosCaching);
+    threaded->jit = cmd.jit;
+    threaded->policy.invocationThreshold = cmd.invocationThreshold;
+    threaded->policy.backedgeThreshold = cmd.backedgeThreshold;
+    threaded->policy.compileThreshold = cmd.compileThreshold;
+    threaded->policy.compilerThreads = cmd.compilerThreads;
+    interpreter = threaded;
+  } else if (cmd.engine == "register") {
+    interpreter = new vm::RegisterInterpreter(cmd.superInstructions);
+  } else {
+    interpreter = new vm::Interpreter();
+  }
+  vm::OpcodePairHistogram *histogram = nullptr;
+  if (!cmd.pairHistogram.empty()) {
+    histogram = new vm::OpcodePairHistogram();
+    interpreter->histogram = histogram;
+  }
+  interpreter->classFile = &classFile;
+  interpreter->stackSize = cmd.stackSize;
+  interpreter->interpret(classFile.methods[1]);
+  if (threaded != nullptr && cmd.dumpProfiles) {
+    threaded->dumpProfiles(std::cout);
+  }
+  if (threaded != nullptr && cmd.printCompilation) {
+    threaded->policy.dumpTransitions(std::cout);
+  }
+  delete interpreter;
+
+  // dump the histogram, see scripts/gen_superinstructions.py
+  if (histogram != nullptr) {
+    FILE *file = fopen(cmd.pairHistogram.c_str(), "w");
+    CHECK(file != nullptr) << "Cannot open " << cmd.pairHistogram.c_str();
+    histogram->dump(file);
+    fclose(file);
+    delete histogram;
+  }
 
   return 0;
 }
@@ -0,0 +1,291 @@
+/*!
+ *    ________  ________  ________  ________  ________   ___  ___  _________
+ *   |\   ____\|\   __  \|\   ____\|\   __  \|\   ___  \|\  \|\  \|\___   ___\
+ *   \ \  \___|\ \  \|\  \ \  \___|\ \  \|\  \ \  \\ \  \ \  \\\  \|___ \  \_|
+ *    \ \  \    \ \  \\\  \ \  \    \ \  \\\  \ \  \\ \  \ \  \\\  \   \ \  \
+ *     \ \  \____\ \  \\\  \ \  \____\ \  \\\  \ \  \\ \  \ \  \\\  \   \ \  \
+ *      \ \_______\ \_______\ \_______\ \_______\ \__\\ \__\ \_______\   \ \__\
+ *       \|_______|\|_______|\|_______|\|_______|\|__| \|__|\|_______|    \|__|
+ *
+ * \file src/rtda/heap/class.cc
+ * \brief Implementation of class.h
+ * \author SiriusNEO
+ */
+
+#include "class.h"
+
+#include <algorithm>
+#include <unordered_set>
+
+#include "../../classfile/classfile.h"
+#include "../../utils/logging.h"
+
+namespace coconut {
+
+namespace rtda {
+
+// Bootstrap classes: (name, superclass), every superclass before its subclass.
+static const char* const kBootstrapClasses[][2] = {
+    {"java/lang/Object", nullptr},
+    {"java/lang/Throwable", "java/lang/Object"},
+    {"java/lang/Exception", "java/lang/Throwable"},
+    {"java/lang/RuntimeException", "java/lang/Exception"},
+    {"java/lang/ArithmeticException", "java/lang/RuntimeException"},
+    {"java/lang/NullPointerException", "java/lang/RuntimeException"},
+    {"java/lang/ClassCastException", "java/lang/RuntimeException"},
+    {"java/lang/NegativeArraySizeException", "java/lang/RuntimeException"},
+    {"java/lang/IndexOutOfBoundsException", "java/lang/RuntimeException"},
+    {"java/lang/ArrayIndexOutOfBoundsException",
+     "java/lang/IndexOutOfBoundsException"},
+    {"java/lang/Error", "java/lang/Throwable"},
+    {"java/lang/VirtualMachineError", "java/lang/Error"},
+    {"java/lang/StackOverflowError", "java/lang/VirtualMachineError"},
+    {"java/lang/OutOfMemoryError", "java/lang/VirtualMachineError"},
+};
+
+classfile::MethodInfo* Class::findMethod(const std::string& name,
+                                         const std::string& descriptor) const {
+  for (const Class* cls = this; cls != nullptr; cls = cls->superClass) {
+    if (cls->classFile == nullptr) continue;
+    classfile::MethodInfo* method =
+        cls->classFile->findMethod(name, descriptor);
+    if (method != nullptr) return method;
+  }
+  return nullptr;
+}
+
+int Class::vtableSlot(const std::string& name,
+                      const std::string& descriptor) const {
+  auto it = vtableSlots.find(name + descriptor);
+  return it == vtableSlots.end() ? -1 : it->second;
+}
+
+bool Class::linkAndCheck_(const Class* other) const {
+  ClassTable::instance().link(const_cast<Class*>(this));
+  ClassTable::instance().link(const_cast<Class*>(other));
+  return isSubtypeOf(other);
+}
+
+bool Class::isSecondarySubtypeOf_(const Class* other) const {
+  for (const Class* super : secondarySupers) {
+    if (super == other) {
+      __atomic_store_n(&secondarySuperCache_, other, __ATOMIC_RELAXED);
+      return true;
+    }
+  }
+  return false;
+}
+
+// Collect the superinterfaces of a class or an interface, directly or not,
+// which are not collected yet.
+static void collectInterfaces(const Class* cls, std::vector<Class*>* out) {
+  for (Class* interfaceClass : cls->interfaces) {
+    if (std::find(out->begin(), out->end(), interfaceClass) == out->end()) {
+      out->push_back(interfaceClass);
+      collectInterfaces(interfaceClass, out);
+    }
+  }
+}
+
+ClassTable::ClassTable() {
+  for (const auto& entry : kBootstrapClasses) {
+    define_(entry[0], entry[1]);
+  }
+}
+
+ClassTable::~ClassTable() {
+  for (auto& entry : classes_) {
+    delete entry.second;
+  }
+}
+
+Class* ClassTable::define_(const std::string& name, const char* superName) {
+  Class* superClass = superName == nullptr ? nullptr : classes_.at(superName);
+  Class* cls = new Class(name, superClass);
+  classes_[name] = cls;
+  return cls;
+}
+
+Class* ClassTable::define(classfile::ClassFile* classFile) {
+  Class* superClass = nullptr;
+  if (classFile->superClass != 0) {
+    superClass = resolve(classFile->cp->getClassNameStr(classFile->superClass));
+  }
+  std::vector<Class*> interfaces;
+  for (uint16_t index : classFile->interfaces) {
+    interfaces.push_back(resolve(classFile->cp->getClassNameStr(index)));
+  }
+  std::string name = classFile->className();
+  std::lock_guard<std::mutex> lock(mutex_);
+  Class*& cls = classes_[name];
+  if (cls == nullptr) {
+    cls = new Class(name, superClass, classFile);
+  } else {
+    // resolved before (e.g. as a catch type), or a bootstrap class
+    CHECK(cls->classFile == nullptr)
+        << "java.lang.LinkageError: duplicate class definition: " << name;
+    if (cls->superClass == nullptr) cls->superClass = superClass;
+    cls->classFile = classFile;
+    // linked as a class without superclass (e.g. by a type check): it is
+    // linked again, and so are the classes which copied its tables
+    if (cls->linked_) unlink_(cls);
+  }
+  cls->isInterface = (classFile->accessFlags & classfile::ACC_INTERFACE) != 0;
+  cls->interfaces = std::move(interfaces);
+  return cls;
+}
+
+void ClassTable::unlink_(Class* cls) {
+  std::unordered_set<Class*> unlinked;
+  std::vector<Class*> worklist = {cls};
+  while (!worklist.empty()) {
+    Class* stale = worklist.back();
+    worklist.pop_back();
+    if (!unlinked.insert(stale).second) continue;
+    stale->linked_ = false;
+    stale->vtable.clear();
+    stale->vtableSlots.clear();
+    stale->itables.clear();
+    stale->depth = 0;
+    std::fill(stale->primarySupers, stale->primarySupers + kPrimarySuperDepth,
+              nullptr);
+    stale->secondarySupers.clear();
+    stale->secondarySuperCache_ = nullptr;
+    // the linked subclasses and subinterfaces, and the implementations
+    for (auto& entry : classes_) {
+      Class* other = entry.second;
+      if (other == nullptr || !other->linked_) continue;
+      if (other->superClass == stale ||
+          std::find(other->interfaces.begin(), other->interfaces.end(),
+                    stale) != other->interfaces.end()) {
+        worklist.push_back(other);
+      }
+    }
+  }
+}
+
+void ClassTable::link(Class* cls) {
+  if (cls->isLinked()) return;
+  std::lock_guard<std::mutex> lock(mutex_);
+  link_(cls);
+}
+
+void ClassTable::link_(Class* cls) {
+  if (cls->linked_) return;
+  if (cls->superClass != nullptr) {
+    link_(cls->superClass);
+    cls->vtable = cls->superClass->vtable;
+    cls->vtableSlots = cls->superClass->vtableSlots;
+  }
+  if (cls->classFile != nullptr) {
+    for (classfile::MethodInfo& method : cls->classFile->methods) {
+      std::string name = method.fieldName();
+      // static, private methods and <init> are not dispatched on the receiver
+      if ((method.accessFlags &
+           (classfile::ACC_STATIC | classfile::ACC_PRIVATE)) != 0 ||
+          name[0] == '<') {
+        continue;
+      }
+      VTableEntry entry = {&method, method.attributes->filtCodeAttr()};
+      auto inserted =
+          cls->vtableSlots.emplace(name + method.descriptor(), 0);
+      if (inserted.second) {
+        // a new virtual method
+        inserted.first->second = cls->vtable.size();
+        cls->vtable.push_back(entry);
+      } else {
+        // overrides the method of a superclass
+        cls->vtable[inserted.first->second] = entry;
+      }
+    }
+  }
+  std::vector<Class*> interfaces;
+  collectInterfaces(cls, &interfaces);
+
+  // the supers for subtype checks
+  if (cls->superClass != nullptr) {
+    cls->depth = cls->superClass->depth + 1;
+    std::copy(cls->superClass->primarySupers,
+              cls->superClass->primarySupers + kPrimarySuperDepth,
+              cls->primarySupers);
+    cls->secondarySupers = cls->superClass->secondarySupers;
+  }
+  if (!cls->isInterface) {
+    if (cls->depth < kPrimarySuperDepth) {
+      cls->primarySupers[cls->depth] = cls;
+    } else {
+      cls->secondarySupers.push_back(cls);
+    }
+  }
+  for (Class* interfaceClass : interfaces) {
+    if (std::find(cls->secondarySupers.begin(), cls->secondarySupers.end(),
+                  interfaceClass) == cls->secondarySupers.end()) {
+      cls->secondarySupers.push_back(interfaceClass);
+    }
+  }
+
+  if (cls->isInterface) {
+    // the methods of the superinterfaces follow the ones of the interface
+    for (Class* interfaceClass : interfaces) {
+      link_(interfaceClass);
+      for (const VTableEntry& entry : interfaceClass->vtable) {
+        auto inserted = cls->vtableSlots.emplace(
+            entry.method->fieldName() + entry.method->descriptor(),
+            cls->vtable.size());
+        if (inserted.second) cls->vtable.push_back(entry);
+      }
+    }
+  } else {
+    // the interfaces of the superclass keep their indices
+    if (cls->superClass != nullptr) {
+      std::vector<Class*> inherited;
+      for (const ITable& itable : cls->superClass->itables) {
+        inherited.push_back(itable.interfaceClass);
+      }
+      for (Class* interfaceClass : interfaces) {
+        if (std::find(inherited.begin(), inherited.end(), interfaceClass) ==
+            inherited.end()) {
+          inherited.push_back(interfaceClass);
+        }
+      }
+      interfaces = std::move(inherited);
+    }
+    for (Class* interfaceClass : interfaces) {
+      link_(interfaceClass);
+      ITable itable = {interfaceClass, interfaceClass->vtable};
+      for (VTableEntry& entry : itable.methods) {
+        // the implementation in the class, or else the one of the interface
+        // (a default method, or abstract)
+        int slot = cls->vtableSlot(entry.method->fieldName(),
+                                   entry.method->descriptor());
+        if (slot >= 0 && cls->vtable[slot].code != nullptr) {
+          entry = cls->vtable[slot];
+        }
+      }
+      cls->itables.push_back(std::move(itable));
+    }
+  }
+  __atomic_store_n(&cls->linked_, true, __ATOMIC_RELEASE);
+}
+
+Class* ClassTable::resolve(const std::string& name) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto it = classes_.find(name);
+  if (it != classes_.end()) {
+    return it->second;
+  }
+  // unknown superclass: only the class itself and catch-all handlers match it
+  return define_(name, nullptr);
+}
+
+ClassTable* ClassTable::scoped_ = nullptr;
+
+ClassTable& ClassTable::instance() {
+  if (scoped_ != nullptr) return *scoped_;
+  static ClassTable table;
+  return table;
+}
+
+}  // namespace rtda
+
+}  // namespace coconut
@@ -0,0 +1,344 @@
+/*!
+ *    ________  ________  ________  ________  ________   ___  ___  _________
+ *   |\   ____\|\   __  \|\   ____\|\   __  \|\   ___  \|\  \|\  \|\___   ___\
+ *   \ \  \___|\ \  \|\  \ \  \___|\ \  \|\  \ \  \\ \  \ \  \\\  \|___ \  \_|
+ *    \ \  \    \ \  \\\  \ \  \    \ \  \\\  \ \  \\ \  \ \  \\\  \   \ \  \
+ *     \ \  \____\ \  \\\  \ \  \____\ \  \\\  \ \  \\ \  \ \  \\\  \   \ \  \
+ *      \ \_______\ \_______\ \_______\ \_______\ \__\\ \__\ \_______\   \ \__\
+ *       \|_______|\|_______|\|_______|\|_______|\|__| \|__|\|_______|    \|__|
+ *
+ * \file src/rtda/heap/class.h
+ * \brief Runtime classes.
+ * \author SiriusNEO
+ */
+
+#ifndef SRC_RTDA_HEAP_CLASS_H_
+#define SRC_RTDA_HEAP_CLASS_H_
+
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace coconut {
+
+namespace classfile {
+
+class ClassFile;
+struct CodeAttr;
+struct FieldInfo;
+typedef FieldInfo MethodInfo;
+
+}  // namespace classfile
+
+namespace rtda {
+
+/*! \brief A virtual method in a vtable. */
+struct VTableEntry {
+  /*! \brief The method. */
+  classfile::MethodInfo* method;
+
+  /*! \brief The code of the method. nullptr if it is abstract or native. */
+  classfile::CodeAttr* code;
+};
+
+class Class;
+
+/*! \brief Number of superclasses in the primary supers display of a class. */
+const int kPrimarySuperDepth = 8;
+
+/*!
+ * \brief The itable of an interface in a class: the methods of the interface,
+ * by their slots in the vtable of the interface, and what they dispatch to in
+ * the class.
+ */
+struct ITable {
+  /*! \brief The interface. */
+  Class* interfaceClass;
+
+  /*! \brief The methods, by slot. */
+  std::vector<VTableEntry> methods;
+};
+
+/*!
+ * \brief A class at runtime.
+ *
+ * It keeps the name, the superclass and the class file (if the class is
+ * loaded from one), which is enough to match a thrown object against catch
+ * types and to find the method a virtual call dispatches to.
+ *
+ * When a class is linked (see ClassTable::link), its vtable is laid out: the
+ * vtable of the superclass, with the overridden methods replaced, followed by
+ * the new virtual methods. So a method has the same slot in all subclasses,
+ * and a virtual call is an index into the vtable of the receiver class.
+ *
+ * The vtable of an interface lays out its methods, including the ones of its
+ * superinterfaces. A linked class has an itable for each interface it
+ * implements, directly or not, with the same layout. So an interface call
+ * finds the itable of the interface in the receiver class, and then indexes
+ * it like a vtable. The itables of the superclass come first, in the same
+ * order, so an interface mostly has the same itable index in all subclasses,
+ * and a call site remembers the last index as a hint (see findITable).
+ *
+ * Subtype checks (checkcast, instanceof, catch types, receivers) do not walk
+ * the superclass chain. A linked class has a display of its superclasses by
+ * depth (java/lang/Object at 0), itself included, so a class at depth d is a
+ * supertype iff it is at d in the display: one load and one compare. The
+ * superclasses deeper than kPrimarySuperDepth and all the superinterfaces are
+ * the secondary supers, which are scanned, with the last one found cached.
+ */
+class Class {
+ public:
+  /*! \brief The binary name in internal form, e.g. java/lang/Object. */
+  std::string name;
+
+  /*! \brief The superclass. nullptr for java/lang/Object. */
+  Class* superClass;
+
+  /*! \brief The class file, with the methods. nullptr if not loaded. */
+  classfile::ClassFile* classFile;
+
+  /*! \brief Whether it is an interface. */
+  bool isInterface;
+
+  /*! \brief The direct superinterfaces. */
+  std::vector<Class*> interfaces;
+
+  /*! \brief The virtual methods, by slot. Built when linked. */
+  std::vector<VTableEntry> vtable;
+
+  /*! \brief The slot of each virtual method, by name + descriptor. */
+  std::unordered_map<std::string, int> vtableSlots;
+
+  /*! \brief The itables of the implemented interfaces. Built when linked. */
+  std::vector<ITable> itables;
+
+  /*! \brief Number of superclasses. Set when linked. */
+  int depth;
+
+  /*!
+   * \brief The primary supers display: the superclass (or this class) at each
+   * depth, nullptr past the depth of the class. Set when linked.
+   */
+  const Class* primarySupers[kPrimarySuperDepth];
+
+  /*!
+   * \brief The secondary supers: all superinterfaces, and the superclasses
+   * (or this class) too deep for the display. Set when linked.
+   */
+  std::vector<const Class*> secondarySupers;
+
+  /*!
+   * \brief Default constructor.
+   * \param name The name of the class.
+   * \param superClass The superclass.
+   * \param classFile The class file.
+   */
+  Class(std::string name, Class* superClass,
+        classfile::ClassFile* classFile = nullptr)
+      : name(std::move(name)),
+        superClass(superClass),
+        classFile(classFile),
+        isInterface(false),
+        depth(0),
+        primarySupers(),
+        linked_(false),
+        secondarySuperCache_(nullptr) {}
+
+  /*!
+   * \brief Whether this class is the class, a subclass, or an implementation
+   * of another class or interface. In constant time, except for a secondary
+   * super not found in the cache. The classes are linked if they are not.
+   * \param other The other class.
+   */
+  bool isSubtypeOf(const Class* other) const {
+    if (!isLinked() || !other->isLinked()) return linkAndCheck_(other);
+    if (!other->isInterface && other->depth < kPrimarySuperDepth) {
+      return primarySupers[other->depth] == other;
+    }
+    if (this == other ||
+        __atomic_load_n(&secondarySuperCache_, __ATOMIC_RELAXED) == other) {
+      return true;
+    }
+    return isSecondarySubtypeOf_(other);
+  }
+
+  /*!
+   * \brief Find a method in the class or its superclasses, e.g. the target of
+   * a virtual call on an object of the class.
+   * \param name The name of the method.
+   * \param descriptor The descriptor of the method.
+   * \return The method. nullptr if not found.
+   */
+  classfile::MethodInfo* findMethod(const std::string& name,
+                                    const std::string& descriptor) const;
+
+  /*! \brief Whether the vtable is built. */
+  bool isLinked() const { return __atomic_load_n(&linked_, __ATOMIC_ACQUIRE); }
+
+  /*!
+   * \brief The vtable slot of a virtual method, in this class and all its
+   * subclasses. The class must be linked.
+   * \param name The name of the method.
+   * \param descriptor The descriptor of the method.
+   * \return The slot. -1 if it is not a virtual method of the class.
+   */
+  int vtableSlot(const std::string& name, const std::string& descriptor) const;
+
+  /*!
+   * \brief Find the itable of an interface. The class must be linked.
+   * \param interfaceClass The interface.
+   * \param hint The index to try first. Updated to the index found.
+   * \return The itable. nullptr if the class does not implement it.
+   */
+  const ITable* findITable(const Class* interfaceClass, int* hint) const {
+    int size = itables.size();
+    int index = __atomic_load_n(hint, __ATOMIC_RELAXED);
+    if (index < size && itables[index].interfaceClass == interfaceClass) {
+      return &itables[index];
+    }
+    for (int i = 0; i < size; ++i) {
+      if (itables[i].interfaceClass == interfaceClass) {
+        __atomic_store_n(hint, i, __ATOMIC_RELAXED);
+        return &itables[i];
+      }
+    }
+    return nullptr;
+  }
+
+  friend class ClassTable;
+
+ private:
+  /*! \brief Whether the vtable is built. Published last when linking. */
+  bool linked_;
+
+  /*! \brief The last secondary super found by isSubtypeOf. */
+  mutable const Class* secondarySuperCache_;
+
+  /*!
+   * \brief isSubtypeOf with the classes not linked yet: link them and check.
+   * \param other The other class.
+   */
+  bool linkAndCheck_(const Class* other) const;
+
+  /*!
+   * \brief Scan the secondary supers for another class, and cache it if found.
+   * \param other The other class.
+   */
+  bool isSecondarySubtypeOf_(const Class* other) const;
+};
+
+/*!
+ * \brief The table of all runtime classes, by name.
+ *
+ * It is pre-populated with the bootstrap classes the VM itself throws (see
+ * class.cc). A name not in the table is defined on its first resolution.
+ * TODO: load them from class files, with the real superclass.
+ */
+class ClassTable {
+ private:
+  /*! \brief Map from name to class. */
+  std::unordered_map<std::string, Class*> classes_;
+
+  /*! \brief Guard of classes_. Threads may resolve at the same time. */
+  std::mutex mutex_;
+
+  /*!
+   * \brief Define a class. The caller must hold mutex_.
+   * \param name The name of the class.
+   * \param superName The name of the superclass. nullptr if there is none.
+   * \return The class.
+   */
+  Class* define_(const std::string& name, const char* superName);
+
+  /*!
+   * \brief Link a class and its superclasses and superinterfaces. The caller
+   * must hold mutex_.
+   * \param cls The class.
+   */
+  void link_(Class* cls);
+
+  /*!
+   * \brief Undo the linking of a class, and of the linked classes which copied
+   * its tables: its subclasses, subinterfaces and implementations, directly
+   * or not. They are linked again when used. The caller must hold mutex_.
+   * \param cls The class.
+   */
+  void unlink_(Class* cls);
+
+  /*! \brief The table of the innermost live Scope. nullptr if none. */
+  static ClassTable* scoped_;
+
+ public:
+  class Scope;
+
+  /*! \brief Default constructor, with the bootstrap classes defined. */
+  ClassTable();
+
+  /*! \brief Destructor. */
+  ~ClassTable();
+
+  ClassTable(const ClassTable&) = delete;
+  ClassTable& operator=(const ClassTable&) = delete;
+
+  /*!
+   * \brief Define a class loaded from a class file, with its superclass and
+   * superinterfaces. If the name is already resolved, the class is completed
+   * in place. If it was linked, it is linked again, and so are the classes
+   * linked against it. Classes must be defined before running code which
+   * uses them.
+   * \param classFile The class file.
+   * \return The class.
+   */
+  Class* define(classfile::ClassFile* classFile);
+
+  /*!
+   * \brief Link a class: build the vtables and itables of it and its
+   * superclasses and superinterfaces, if not built yet. A class is linked
+   * after its class file and the ones of its superclasses and superinterfaces
+   * are defined, e.g. at the first virtual call on it.
+   * \param cls The class.
+   */
+  void link(Class* cls);
+
+  /*!
+   * \brief Resolve a class by name. Define it if it is not in the table.
+   * \param name The name in internal form.
+   * \return The class. Never nullptr.
+   */
+  Class* resolve(const std::string& name);
+
+  /*! \brief The table shared by the whole VM, or the one of a Scope. */
+  static ClassTable& instance();
+};
+
+/*!
+ * \brief A fresh class table, which ClassTable::instance() returns while the
+ * scope lives, e.g. in a test, so the classes it defines go away before their
+ * class files. Scopes nest. No other thread may use the table meanwhile.
+ */
+class ClassTable::Scope {
+ private:
+  /*! \brief The table of the scope. */
+  ClassTable table_;
+
+  /*! \brief The table of the enclosing scope. nullptr if none. */
+  ClassTable* previous_;
+
+ public:
+  /*! \brief Default constructor. Make the table the instance. */
+  Scope() : previous_(scoped_) { scoped_ = &table_; }
+
+  /*! \brief Destructor. Restore the enclosing instance. */
+  ~Scope() { scoped_ = previous_; }
+
+  Scope(const Scope&) = delete;
+  Scope& operator=(const Scope&) = delete;
+};
+
+}  // namespace rtda
+
+}  // namespace coconut
+
+#endif  // SRC_RTDA_HEAP_CLASS_H_
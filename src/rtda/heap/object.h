@@ -15,6 +15,8 @@
 #ifndef SRC_RTDA_HEAP_OBJECT_H_
 #define SRC_RTDA_HEAP_OBJECT_H_
 
+#include "class.h"
+
 namespace coconut {
 
 namespace rtda {
@@ -22,10 +24,21 @@ namespace rtda {
 /*!
  * \brief java.lang.Object.
  *
- * Nothing here now. TODO: Support functionalities in JVM heap.
+ * Only the class is kept now. TODO: Support functionalities in JVM heap.
  */
 class Object {
-  // nothing now
+ public:
+  /*! \brief The class of the object. nullptr if unknown. */
+  Class* klass;
+
+  /*!
+   * \brief Default constructor.
+   * \param klass The class of the object.
+   */
+  explicit Object(Class* klass = nullptr) : klass(klass) {}
+
+  /*! \brief Destructor. Subclasses (e.g. Throwable) may own memory. */
+  virtual ~Object() = default;
 };
 
 }  // namespace rtda
@@ -0,0 +1,64 @@
+/*!
+ *    ________  ________  ________  ________  ________   ___  ___  _________
+ *   |\   ____\|\   __  \|\   ____\|\   __  \|\   ___  \|\  \|\  \|\___   ___\
+ *   \ \  \___|\ \  \|\  \ \  \___|\ \  \|\  \ \  \\ \  \ \  \\\  \|___ \  \_|
+ *    \ \  \    \ \  \\\  \ \  \    \ \  \\\  \ \  \\ \  \ \  \\\  \   \ \  \
+ *     \ \  \____\ \  \\\  \ \  \____\ \  \\\  \ \  \\ \  \ \  \\\  \   \ \  \
+ *      \ \_______\ \_______\ \_______\ \_______\ \__\\ \__\ \_______\   \ \__\
+ *       \|_______|\|_______|\|_______|\|_______|\|__| \|__|\|_______|    \|__|
+ *
+ * \file src/rtda/heap/throwable.cc
+ * \brief Implementation of throwable.h
+ * \author SiriusNEO
+ */
+
+#include "throwable.h"
+
+#include <algorithm>
+
+#include "../../classfile/attributes.h"
+
+namespace coconut {
+
+namespace rtda {
+
+void Throwable::fillInStackTrace(const JVMStack& stack) {
+  backtrace.clear();
+  for (StackFrame* frame = stack.topFrame; frame != nullptr;
+       frame = frame->lower()) {
+    if (frame->code != nullptr) {
+      backtrace.push_back({frame->code, frame->nextPc});
+    }
+  }
+}
+
+std::vector<std::string> Throwable::getStackTrace() const {
+  std::vector<std::string> trace;
+  for (const StackTraceEntry& entry : backtrace) {
+    const classfile::CodeAttr* code = entry.code;
+    std::string method = "<unknown>";
+    if (code->cp != nullptr && code->methodNameIdx != 0) {
+      method = code->cp->getLiteral(code->methodNameIdx) +
+               code->cp->getLiteral(code->methodDescriptorIdx);
+    }
+    trace.push_back(method + " (pc " + std::to_string(entry.pc) + ")");
+  }
+  return trace;
+}
+
+void Throwable::printStackTrace(std::ostream& os) const {
+  std::string name = klass != nullptr ? klass->name : "<unknown class>";
+  std::replace(name.begin(), name.end(), '/', '.');
+  os << name;
+  if (message != nullptr) {
+    os << ": " << message;
+  }
+  os << "\n";
+  for (const std::string& frame : getStackTrace()) {
+    os << "\tat " << frame << "\n";
+  }
+}
+
+}  // namespace rtda
+
+}  // namespace coconut
@@ -0,0 +1,84 @@
+/*!
+ *    ________  ________  ________  ________  ________   ___  ___  _________
+ *   |\   ____\|\   __  \|\   ____\|\   __  \|\   ___  \|\  \|\  \|\___   ___\
+ *   \ \  \___|\ \  \|\  \ \  \___|\ \  \|\  \ \  \\ \  \ \  \\\  \|___ \  \_|
+ *    \ \  \    \ \  \\\  \ \  \    \ \  \\\  \ \  \\ \  \ \  \\\  \   \ \  \
+ *     \ \  \____\ \  \\\  \ \  \____\ \  \\\  \ \  \\ \  \ \  \\\  \   \ \  \
+ *      \ \_______\ \_______\ \_______\ \_______\ \__\\ \__\ \_______\   \ \__\
+ *       \|_______|\|_______|\|_______|\|_______|\|__| \|__|\|_______|    \|__|
+ *
+ * \file src/rtda/heap/throwable.h
+ * \brief java.lang.Throwable.
+ * \author SiriusNEO
+ */
+
+#ifndef SRC_RTDA_HEAP_THROWABLE_H_
+#define SRC_RTDA_HEAP_THROWABLE_H_
+
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include "../vmstack/jvm_stack.h"
+#include "object.h"
+
+namespace coconut {
+
+namespace rtda {
+
+/*! \brief A frame of a captured stack trace: the code and the pc in it. */
+struct StackTraceEntry {
+  const classfile::CodeAttr* code;
+  int pc;
+};
+
+/*!
+ * \brief java.lang.Throwable.
+ *
+ * The stack trace is captured as a compact array of (code, pc) pairs, which
+ * is cheap enough to do at every throw. It is turned into strings only when
+ * it is asked for (getStackTrace, printStackTrace).
+ */
+class Throwable : public Object {
+ public:
+  /*! \brief The detail message. nullptr if there is none. */
+  const char* message;
+
+  /*! \brief The captured stack trace, the top frame first. */
+  std::vector<StackTraceEntry> backtrace;
+
+  /*!
+   * \brief Default constructor.
+   * \param klass The class, a subclass of java/lang/Throwable.
+   * \param message The detail message.
+   */
+  explicit Throwable(Class* klass, const char* message = nullptr)
+      : Object(klass), message(message) {}
+
+  /*!
+   * \brief Capture the stack trace of a stack. The frames without a code are
+   * skipped. The storage of the last trace is reused.
+   * \param stack The stack. The pc of each frame is its nextPc, so the engine
+   * must save the pc of the top frame first.
+   */
+  void fillInStackTrace(const JVMStack& stack);
+
+  /*!
+   * \brief Materialize the stack trace, e.g. "main()I (pc 3)".
+   * \return The frames, the top frame first.
+   */
+  std::vector<std::string> getStackTrace() const;
+
+  /*!
+   * \brief Print the class, the message and the stack trace, in the format of
+   * java.lang.Throwable.printStackTrace.
+   * \param os The stream.
+   */
+  void printStackTrace(std::ostream& os) const;
+};
+
+}  // namespace rtda
+
+}  // namespace coconut
+
+#endif  // SRC_RTDA_HEAP_THROWABLE_H_
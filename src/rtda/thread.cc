@@ -0,0 +1,51 @@
+/*!
+ *    ________  ________  ________  ________  ________   ___  ___  _________
+ *   |\   ____\|\   __  \|\   ____\|\   __  \|\   ___  \|\  \|\  \|\___   ___\
+ *   \ \  \___|\ \  \|\  \ \  \___|\ \  \|\  \ \  \\ \  \ \  \\\  \|___ \  \_|
+ *    \ \  \    \ \  \\\  \ \  \    \ \  \\\  \ \  \\ \  \ \  \\\  \   \ \  \
+ *     \ \  \____\ \  \\\  \ \  \____\ \  \\\  \ \  \\ \  \ \  \\\  \   \ \  \
+ *      \ \_______\ \_______\ \_______\ \_______\ \__\\ \__\ \_______\   \ \__\
+ *       \|_______|\|_______|\|_______|\|_______|\|__| \|__|\|_______|    \|__|
+ *
+ * \file src/rtda/thread.cc
+ * \brief Implementation of thread.h
+ * \author SiriusNEO
+ */
+
+#include "thread.h"
+
+namespace coconut {
+
+namespace rtda {
+
+// Class and detail message of the exceptions raised by the VM.
+static const char* const kVMExceptionInfo[kVMExceptionEnd][2] = {
+    {"java/lang/ArithmeticException", "/ by zero"},
+    {"java/lang/NullPointerException", nullptr},
+    {"java/lang/StackOverflowError", nullptr},
+    {"java/lang/ClassCastException", nullptr},
+};
+
+Thread::Thread(size_t stackSize)
+    : vmExceptions_(), pc(0), stack(stackSize), exception(nullptr) {}
+
+Thread::~Thread() {
+  for (Throwable* throwable : vmExceptions_) {
+    delete throwable;
+  }
+}
+
+Throwable* Thread::raise(VMException kind) {
+  Throwable*& throwable = vmExceptions_[kind];
+  if (throwable == nullptr) {
+    throwable = new Throwable(
+        ClassTable::instance().resolve(kVMExceptionInfo[kind][0]),
+        kVMExceptionInfo[kind][1]);
+  }
+  throwable->fillInStackTrace(stack);
+  return throwable;
+}
+
+}  // namespace rtda
+
+}  // namespace coconut
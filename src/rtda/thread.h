@@ -15,12 +15,22 @@
 #ifndef SRC_RTDA_THREAD_H_
 #define SRC_RTDA_THREAD_H_
 
+#include "heap/throwable.h"
 #include "vmstack/jvm_stack.h"
 
 namespace coconut {
 
 namespace rtda {
 
+/*! \brief Exceptions raised by the VM itself. */
+enum VMException {
+  kArithmeticException,
+  kNullPointerException,
+  kStackOverflowError,
+  kClassCastException,
+  kVMExceptionEnd
+};
+
 /*!
  * \brief Thread abstraction in JVM.
  *
@@ -28,6 +38,13 @@ namespace rtda {
  * a vm stack.
  */
 class Thread {
+ private:
+  /*!
+   * \brief The preallocated instances of the exceptions raised by the VM,
+   * created at their first raise. nullptr if not created.
+   */
+  Throwable* vmExceptions_[kVMExceptionEnd];
+
  public:
   /*! \brief The programming counter. */
   int pc;
@@ -35,8 +52,33 @@ class Thread {
   /*! \brief The virtual machine stack. */
   JVMStack stack;
 
-  // TODO: change 1024 into an argument in commandline
-  Thread() : pc(0), stack(1024) {}
+  /*!
+   * \brief The exception thrown out of the last returned frame, to be thrown
+   * again in its invoker. nullptr if the frame returned normally.
+   */
+  Object* exception;
+
+  /*!
+   * \brief Default constructor.
+   * \param stackSize The size of the vm stack in bytes.
+   */
+  explicit Thread(size_t stackSize = DEFAULT_STACK_SIZE);
+
+  /*! \brief Destructor. */
+  ~Thread();
+
+  Thread(const Thread&) = delete;
+  Thread& operator=(const Thread&) = delete;
+
+  /*!
+   * \brief Raise an exception of the VM, e.g. java.lang.ArithmeticException of
+   * idiv. The instance of the thread is reused, with the stack trace captured
+   * again, so a raise in a hot loop allocates nothing. A handler which keeps it
+   * sees the trace of the latest raise.
+   * \param kind The exception.
+   * \return The exception to throw.
+   */
+  Throwable* raise(VMException kind);
 };
 
 }  // namespace rtda
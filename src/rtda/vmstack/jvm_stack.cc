@@ -14,18 +14,123 @@
 
 #include "jvm_stack.h"
 
+#include <signal.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <new>
+
 namespace coconut {
 
 namespace rtda {
 
-void JVMStack::push(unsigned int maxLocals, unsigned int maxStack) {
-  // TODO: Made it a Java exception (StackOverflowError).
-  CHECK(size < capacity_) << "java.lang.StackOverflowError";
-  if (isEmpty()) {
-    topFrame = new StackFrame(maxLocals, maxStack, nullptr);
-  } else {
-    topFrame = new StackFrame(maxLocals, maxStack, topFrame);
+static_assert(alignof(StackFrame) <= alignof(Slot),
+              "StackFrame can not be placed in the slot arena");
+
+// The largest frame a class file can describe (max_locals and max_stack are
+// u2), so a frame overflowing the arena always ends in the guard zone.
+static const size_t kMaxFrameBytes = (2 * 0xffff + kFrameSlots) * sizeof(Slot);
+
+// The guard zone [start, end) of the stack pushing a frame on this thread, to
+// tell a stack overflow from other faults. Empty out of JVMStack::push. It is
+// per thread, not a table of all the stacks, as the signal handler can not
+// take a lock.
+static thread_local uintptr_t guardStart = 0;
+static thread_local uintptr_t guardEnd = 0;
+
+// The SIGSEGV action before ours, restored for the faults which are not ours.
+static struct sigaction previousAction;
+
+static size_t roundToPages(size_t size) {
+  static const size_t pageSize = sysconf(_SC_PAGESIZE);
+  return (size + pageSize - 1) / pageSize * pageSize;
+}
+
+static bool isGuardFault(void* addr) {
+  uintptr_t address = reinterpret_cast<uintptr_t>(addr);
+  return guardStart <= address && address < guardEnd;
+}
+
+// The fault is raised by a load in JVMStack::push (compiled with
+// -fnon-call-exceptions), so the panic unwinds from there to the interpreter.
+// SA_NODEFER keeps SIGSEGV unblocked after the handler is left by a throw.
+static void onSegmentationFault(int, siginfo_t* info, void*) {
+  if (isGuardFault(info->si_addr)) {
+    guardStart = guardEnd = 0;
+    throw StackOverflowPanic(__FILE__, __LINE__,
+                             "java.lang.StackOverflowError");
+  }
+  // not a stack overflow: fault again with the previous action
+  sigaction(SIGSEGV, &previousAction, nullptr);
+}
+
+static void installGuardHandler() {
+  struct sigaction action;
+  std::memset(&action, 0, sizeof(action));
+  action.sa_sigaction = onSegmentationFault;
+  action.sa_flags = SA_SIGINFO | SA_NODEFER;
+  sigemptyset(&action.sa_mask);
+  CHECK(sigaction(SIGSEGV, &action, &previousAction) == 0)
+      << "Cannot install the SIGSEGV handler";
+}
+
+JVMStack::JVMStack(size_t stackSize) : size(0), topFrame(nullptr) {
+  static bool handlerInstalled = (installGuardHandler(), true);
+  (void)handlerInstalled;
+
+  size_t arenaSize = roundToPages(std::max(stackSize, (size_t)1));
+  size_t guardSize = roundToPages(kMaxFrameBytes);
+  reserved_ = arenaSize + guardSize;
+
+  // the pages are committed lazily, when they are touched
+  void* memory = mmap(nullptr, reserved_, PROT_READ | PROT_WRITE,
+                      MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+  CHECK(memory != MAP_FAILED) << "Cannot reserve a stack of " << stackSize
+                              << " bytes";
+  memory_ = static_cast<char*>(memory);
+  CHECK(mprotect(memory_ + arenaSize, guardSize, PROT_NONE) == 0)
+      << "Cannot protect the guard zone of the stack";
+  guard_ = memory_ + arenaSize;
+  free_ = reinterpret_cast<Slot*>(memory_);
+}
+
+JVMStack::~JVMStack() {
+  clear();
+  munmap(memory_, reserved_);
+}
+
+void JVMStack::push(unsigned int maxLocals, unsigned int maxStack,
+                    unsigned int argSlots) {
+  CHECK(argSlots <= maxLocals) << "Arguments do not fit in the locals";
+
+  Slot* locals = free_;
+  OperandStack* invokerStack = nullptr;
+  if (argSlots > 0) {
+    CHECK(!isEmpty()) << "No invoker frame to pass the arguments";
+    invokerStack = topFrame->operandStack;
+    locals = invokerStack->top() - argSlots;
   }
+  // the rest locals may cover the unused part of the invoker's operand stack
+  Slot* frame = locals + maxLocals;
+  Slot* stack = frame + kFrameSlots;
+
+  // touch the end of the frame: it faults in the guard zone if the frame does
+  // not fit (see onSegmentationFault), before the stack is modified.
+  guardStart = reinterpret_cast<uintptr_t>(guard_);
+  guardEnd = reinterpret_cast<uintptr_t>(memory_ + reserved_);
+  std::atomic_signal_fence(std::memory_order_seq_cst);
+  (void)reinterpret_cast<volatile char*>(stack + maxStack)[-1];
+  std::atomic_signal_fence(std::memory_order_seq_cst);
+  guardStart = guardEnd = 0;
+
+  if (invokerStack != nullptr) invokerStack->setTop(locals);
+  topFrame = new (frame)
+      StackFrame(locals, maxLocals, stack, maxStack, topFrame, free_);
+  free_ = std::max(free_, stack + maxStack);
   ++size;
 }
 
@@ -33,7 +138,9 @@ void JVMStack::pop() {
   CHECK(!isEmpty()) << "JVMStack is empty! can not pop.";
   StackFrame* popped = topFrame;
   topFrame = topFrame->lowerFrame;
-  delete popped;
+  free_ = popped->base;
+  popped->~StackFrame();
+  --size;
 }
 
 }  // namespace rtda
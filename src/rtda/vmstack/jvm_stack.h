@@ -15,21 +15,46 @@
 #ifndef SRC_RTDA_VMSTACK_JVM_STACK_H_
 #define SRC_RTDA_VMSTACK_JVM_STACK_H_
 
+#include <cstddef>
+
 #include "local_variable_table.h"
 #include "operand_stack.h"
 
+/*! \brief Default size of a JVMStack in bytes (512KB). */
+#define DEFAULT_STACK_SIZE (512 << 10)
+
 namespace coconut {
 
+namespace classfile {
+
+struct CodeAttr;
+
+}  // namespace classfile
+
 namespace rtda {
 
 // pre-declare JVMStack to avoid cycle reference.
 class JVMStack;
 
+/*!
+ * \brief The panic thrown by JVMStack::push when the stack overflows. Engines
+ * supporting Java exceptions turn it into java.lang.StackOverflowError.
+ */
+class StackOverflowPanic : public utils::JVMPanic {
+ public:
+  using utils::JVMPanic::JVMPanic;
+};
+
 /*!
  * \brief Frame of JVM stack.
  *
  * A frame contains a table of local variables (LVT) and the operand stack (OS)
  * in this context.
+ *
+ * A frame is a record in the slot arena of its JVMStack: the slots of the local
+ * variables, then the frame itself, then the slots of the operand stack. The
+ * first locals of an invoked method may be the top slots of the operand stack
+ * of the invoker (see JVMStack::push), so the arguments are never copied.
  */
 class StackFrame {
  public:
@@ -45,28 +70,34 @@ class StackFrame {
    */
   int nextPc;
 
+  /*!
+   * \brief The code running in the frame, set by the engine. Used to capture
+   * stack traces. nullptr if unknown.
+   */
+  const classfile::CodeAttr* code;
+
   /*!
    * \brief Default constructor.
+   * \param locals The slots of the local variables.
    * \param maxLocals Max number of local variables.
+   * \param stack The slots of the operand stack.
    * \param maxStack Max space for the operand stack.
    * \param _lowerFrame The lower (next) frame.
+   * \param _base The first free slot of the arena before the frame is pushed.
    */
-  StackFrame(unsigned int maxLocals, unsigned int maxStack,
-             StackFrame* _lowerFrame)
-      : nextPc(0), lowerFrame(_lowerFrame) {
-    localVariableTable = new LocalVariableTable(maxLocals);
-    operandStack = new OperandStack(maxStack);
-  }
-
-  /*! \brief Default destructor. */
-  ~StackFrame() {
-    if (localVariableTable != nullptr) {
-      delete localVariableTable;
-    }
-    if (operandStack != nullptr) {
-      delete operandStack;
-    }
-  }
+  StackFrame(Slot* locals, unsigned int maxLocals, Slot* stack,
+             unsigned int maxStack, StackFrame* _lowerFrame, Slot* _base)
+      : localVariableTable(&locals_),
+        operandStack(&stack_),
+        nextPc(0),
+        code(nullptr),
+        lowerFrame(_lowerFrame),
+        base(_base),
+        locals_(locals, maxLocals),
+        stack_(stack, maxStack) {}
+
+  /*! \brief The lower (invoker) frame. nullptr if it is the lowest. */
+  StackFrame* lower() const { return lowerFrame; }
 
   // Declare JVMStack as its friend class to let it access lowerFrame.
   friend JVMStack;
@@ -76,24 +107,56 @@ class StackFrame {
    * \brief The lower (next) frame in the stack.
    *
    * The lowest frame is the one pushed to the stack firstly.
-   * Use this pointer because JVMStack is organized as a linked list. This is
-   * to prevent the VM from allocating all memory at first (allocate when
-   * using).
    */
   StackFrame* lowerFrame;
+
+  /*! \brief The first free slot of the arena, restored when popped. */
+  Slot* base;
+
+  /*! \brief The local variable table, pointed by localVariableTable. */
+  LocalVariableTable locals_;
+
+  /*! \brief The operand stack, pointed by operandStack. */
+  OperandStack stack_;
 };
 
+/*!
+ * \brief Number of slots taken by the frame record. The operand stack of a
+ * frame starts at this distance from the end of its locals.
+ */
+const unsigned int kFrameSlots =
+    (sizeof(StackFrame) + sizeof(Slot) - 1) / sizeof(Slot);
+
 /*!
  * \brief JVM stack.
  *
- * It is a linked list. The memory of its frame is allocated when pushed (so it
- * uses the arguments "maxLocals" and "maxStack" to perfrom the "push" action).
- * And delete the memory when pop.
+ * Frames are allocated in a contiguous arena of slots, reserved when the stack
+ * is created. A push bumps the free pointer by the size of the frame (see
+ * StackFrame) and a pop resets it to where it was before the push, so a call
+ * costs no heap allocation, and the frame, its locals and its operand stack
+ * are adjacent in memory.
+ *
+ * The arena is an mmap reservation: the pages are committed by the kernel when
+ * they are touched first, so a thread only costs the memory its deepest call
+ * chain used. It is followed by a PROT_NONE guard zone larger than any frame,
+ * and a push touches the last byte of the new frame before anything else. A
+ * frame which does not fit in the arena thus faults in the guard zone, and the
+ * fault is turned into a StackOverflowPanic thrown from push, without
+ * comparing the frame against the end of the arena on every push.
  */
 class JVMStack {
  private:
-  /*! \brief The total capacity of the stack (the number of frames). */
-  unsigned int capacity_;
+  /*! \brief The reserved memory: the arena, then the guard zone. */
+  char* memory_;
+
+  /*! \brief The size of the reservation in bytes. */
+  size_t reserved_;
+
+  /*! \brief The guard zone, from the end of the arena to the reservation's. */
+  char* guard_;
+
+  /*! \brief The first free slot of the arena. */
+  Slot* free_;
 
  public:
   /*! \brief The current size of the stack (also the number of frames). */
@@ -103,14 +166,17 @@ class JVMStack {
   StackFrame* topFrame;
 
   /*!
-   * \brief Default constructor.
-   * \param capacity The capacity.
+   * \brief Default constructor. Reserve the arena and its guard zone.
+   * \param stackSize The size of the arena in bytes, rounded up to pages.
+   * \throw Panic if the memory can not be reserved.
    */
-  JVMStack(unsigned int capacity)
-      : capacity_(capacity), size(0), topFrame(nullptr) {}
+  explicit JVMStack(size_t stackSize = DEFAULT_STACK_SIZE);
+
+  /*! \brief Default destructor. Release the reservation. */
+  ~JVMStack();
 
-  /*! \brief Default destructor. */
-  ~JVMStack() { clear(); }
+  JVMStack(const JVMStack&) = delete;
+  JVMStack& operator=(const JVMStack&) = delete;
 
   /*!
    * \brief Check whether the stack is empty.
@@ -131,8 +197,14 @@ class JVMStack {
    * constructed frame because we want to manage the memory in this class.
    * \param maxLocals Max number of local variables.
    * \param maxStack Max space for the operand stack.
+   * \param argSlots Number of argument slots. They are popped from the operand
+   * stack of the top frame and become the first locals of the new frame in
+   * place (the frames overlap), so the arguments are not copied.
+   * \throw StackOverflowPanic if the frame does not fit in the arena. The
+   * stack is left unchanged.
    */
-  void push(unsigned int maxLocals, unsigned int maxStack);
+  void push(unsigned int maxLocals, unsigned int maxStack,
+            unsigned int argSlots = 0);
 
   /*!
    * \brief Pop the top frame.
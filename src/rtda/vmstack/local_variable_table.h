@@ -27,7 +27,7 @@ namespace rtda {
  *
  * It is in a frame of the JVM Stack. It stores values of local variables in
  * current scope. A slot is 32bit in JVM convention so long/double take two
- * slots.
+ * slots (see Slot for how the value is laid out in them).
  */
 class LocalVariableTable {
  private:
@@ -47,83 +47,119 @@ class LocalVariableTable {
 
  public:
   /*!
-   * \brief Default constructor.
+   * \brief Default constructor. The slots are owned by the frame (see
+   * JVMStack), not by the table.
+   * \param slots The first slot of the table.
    * \param maxLocals Max number of slots.
    */
-  LocalVariableTable(unsigned int maxLocals) : maxLocals_(maxLocals) {
-    slots_ = new Slot[maxLocals_];
-  }
-
-  /*! \brief Default destructor. */
-  ~LocalVariableTable() { delete[] slots_; }
+  LocalVariableTable(Slot* slots, unsigned int maxLocals)
+      : slots_(slots), maxLocals_(maxLocals) {}
 
   /*! \brief Show the brief info of the table. */
   std::string brief();
 
+  /*!
+   * \brief The first slot of the table. Used by the engines which keep the
+   * locals pointer in a register.
+   */
+  Slot* slots() { return slots_; }
+
   /*!
    * \brief Set an integer(int32) to a postion.
    * \param index The position we set the data.
    * \param val The data we want to set.
    */
-  void setInt(unsigned int index, int32_t val);
+  void setInt(unsigned int index, int32_t val) {
+    checkOverflow_(index);
+    slots_[index].bytes = val;
+  }
 
   /*!
    * \brief Get an integer(int32) from a postion.
    * \param index The position we fetch the data.
    */
-  int32_t getInt(unsigned int index);
+  int32_t getInt(unsigned int index) {
+    checkOverflow_(index);
+    return int32_t(slots_[index].bytes);
+  }
 
   /*!
    * \brief Set a float32 number to a postion.
    * \param index The position we set the data.
    * \param val The data we want to set.
    */
-  void setFloat(unsigned int index, float val);
+  void setFloat(unsigned int index, float val) {
+    checkOverflow_(index);
+    // turn float into Slot32 (bitwise)
+    // if you use (Slot)(val), round up will happen
+    slots_[index].bytes = *(Slot32*)(&val);
+  }
 
   /*!
    * \brief Get a float32 number from a postion.
    * \param index The position we fetch the data.
    */
-  float getFloat(unsigned int index);
+  float getFloat(unsigned int index) {
+    checkOverflow_(index);
+    return *(float*)(&slots_[index].bytes);
+  }
 
   /*!
    * \brief Set a long(int64) integer to a postion.
    * \param index The position we set the data.
    * \param val The data we want to set.
    */
-  void setLong(unsigned int index, long long val);
+  void setLong(unsigned int index, long long val) {
+    checkOverflow_(index + 1);
+    setLongSlots(slots_ + index, val);
+  }
 
   /*!
    * \brief Get a long(int64) integer from a postion.
    * \param index The position we fetch the data.
    */
-  long long getLong(unsigned int index);
+  long long getLong(unsigned int index) {
+    checkOverflow_(index + 1);
+    return getLongSlots(slots_ + index);
+  }
 
   /*!
    * \brief Set a double(float64) number to a postion.
    * \param index The position we set the data.
    * \param val The data we want to set.
    */
-  void setDouble(unsigned int index, double val);
+  void setDouble(unsigned int index, double val) {
+    checkOverflow_(index + 1);
+    setDoubleSlots(slots_ + index, val);
+  }
 
   /*!
    * \brief Get a double(float64) number from a postion.
    * \param index The position we fetch the data.
    */
-  double getDouble(unsigned int index);
+  double getDouble(unsigned int index) {
+    checkOverflow_(index + 1);
+    return getDoubleSlots(slots_ + index);
+  }
 
   /*!
    * \brief Set an Object reference to a postion.
    * \param index The position we set the ref.
    * \param ref The ref we want to set.
    */
-  void setRef(unsigned int index, Object* ref);
+  void setRef(unsigned int index, Object* ref) {
+    checkOverflow_(index);
+    slots_[index].ref = ref;
+  }
 
   /*!
    * \brief Get an Object reference from a postion.
    * \param index The position we fetch the data.
    */
-  Object* getRef(unsigned int index);
+  Object* getRef(unsigned int index) {
+    checkOverflow_(index);
+    return slots_[index].ref;
+  }
 };
 
 }  // namespace rtda
@@ -52,22 +52,19 @@ class OperandStack {
 
   /*! \brief Stack down. */
   void down() {
+    CHECK(top_ > 0) << "OperandStack underflow!";
     --top_;
-    CHECK(top_ >= 0) << "OperandStack underflow!";
   }
 
  public:
   /*!
-   * \brief Default constructor. Pre-allocate all spaces for an operand stack.
-   * (Since it won't be too large in a single frame)
+   * \brief Default constructor. The slots are owned by the frame (see
+   * JVMStack), not by the stack.
+   * \param slots The first slot of the stack.
    * \param maxStack Max space for the operand stack.
    */
-  OperandStack(unsigned int maxStack) : maxStack_(maxStack), top_(0) {
-    slots_ = new Slot[maxStack];
-  }
-
-  /*! \brief Default destructor. */
-  ~OperandStack() { delete[] slots_; }
+  OperandStack(Slot* slots, unsigned int maxStack)
+      : slots_(slots), top_(0), maxStack_(maxStack) {}
 
   /*! \brief Show the brief info of the stack. */
   std::string brief();
@@ -76,79 +73,143 @@ class OperandStack {
    * \brief Get a slot from a postion.
    * \param index The position we fetch the slot.
    */
-  Slot getSlot(int index);
+  Slot getSlot(int index) { return slots_[index]; }
+
+  /*!
+   * \brief The bottom slot of the stack. Used by compiled code, which keeps
+   * the values at fixed positions from it.
+   */
+  Slot* slots() { return slots_; }
+
+  /*! \brief Pop all values, e.g. when an exception handler is entered. */
+  void clear() { top_ = 0; }
+
+  /*!
+   * \brief The slot above the top of the stack, i.e. the next free one. Used by
+   * the engines which keep the stack pointer in a register.
+   */
+  Slot* top() { return slots_ + top_; }
+
+  /*!
+   * \brief Write back a stack pointer got from top().
+   * \param sp The slot above the new top of the stack.
+   */
+  void setTop(Slot* sp) {
+    top_ = (unsigned int)(sp - slots_);
+    CHECK(top_ <= maxStack_) << "OperandStack overflow!";
+  }
 
   /*!
    * \brief Push a slot into the stack.
    * \param slot The slot we want to push.
    */
-  void pushSlot(Slot slot);
+  void pushSlot(Slot slot) {
+    slots_[top_] = slot;
+    up();
+  }
 
   /*!
    * \brief Pop a slot from the stack.
    * \return The slot popped.
    */
-  Slot popSlot();
+  Slot popSlot() {
+    down();
+    return slots_[top_];
+  }
 
   /*!
    * \brief Push an integer(int32) into the stack.
    * \param val The value we want to push.
    */
-  void pushInt(int val);
+  void pushInt(int val) {
+    slots_[top_].bytes = val;
+    up();
+  }
 
   /*!
    * \brief Pop an integer(int32) from the stack.
    * \return The value popped.
    */
-  int popInt();
+  int popInt() {
+    down();
+    return int(slots_[top_].bytes);
+  }
 
   /*!
    * \brief Push a float32 number into the stack.
    * \param val The value we want to push.
    */
-  void pushFloat(float val);
+  void pushFloat(float val) {
+    slots_[top_].bytes = *(Slot32*)(&val);
+    up();
+  }
 
   /*!
    * \brief Pop a float32 number from the stack.
    * \return The value popped.
    */
-  float popFloat();
+  float popFloat() {
+    down();
+    return *(float*)(&slots_[top_].bytes);
+  }
 
   /*!
    * \brief Push a long(int64) integer into the stack.
    * \param val The value we want to push.
    */
-  void pushLong(long long val);
+  void pushLong(long long val) {
+    CHECK(top_ + 2 <= maxStack_) << "OperandStack overflow!";
+    setLongSlots(slots_ + top_, val);
+    top_ += 2;
+  }
 
   /*!
    * \brief Pop a long(int64) integer from the stack.
    * \return The value popped.
    */
-  long long popLong();
+  long long popLong() {
+    CHECK(top_ >= 2) << "OperandStack underflow!";
+    top_ -= 2;
+    return getLongSlots(slots_ + top_);
+  }
 
   /*!
    * \brief Push a double(float64) number into the stack.
    * \param val The value we want to push.
    */
-  void pushDouble(double val);
+  void pushDouble(double val) {
+    CHECK(top_ + 2 <= maxStack_) << "OperandStack overflow!";
+    setDoubleSlots(slots_ + top_, val);
+    top_ += 2;
+  }
 
   /*!
    * \brief Pop a double(float64) number from the stack.
    * \return The value popped.
    */
-  double popDouble();
+  double popDouble() {
+    CHECK(top_ >= 2) << "OperandStack underflow!";
+    top_ -= 2;
+    return getDoubleSlots(slots_ + top_);
+  }
 
   /*!
    * \brief Push an Object reference into the stack.
    * \param ref The ref we want to push.
    */
-  void pushRef(Object* ref);
+  void pushRef(Object* ref) {
+    slots_[top_].ref = ref;
+    up();
+  }
 
   /*!
    * \brief Pop an Object reference from the stack.
    * \return The ref popped.
    */
-  Object* popRef();
+  Object* popRef() {
+    down();
+    return slots_[top_].ref;
+  }
 };
 
 }  // namespace rtda
@@ -15,6 +15,8 @@
 #ifndef SRC_RTDA_VMSTACK_SLOT_H_
 #define SRC_RTDA_VMSTACK_SLOT_H_
 
+#include <cstring>
+
 #include "../../utils/typedef.h"
 #include "../heap/object.h"
 
@@ -33,12 +35,82 @@ typedef uint32_t Slot32;
  * union is 64bit. So why long and double still cost 2 slots (in this case, are
  * 128 bits)? It looks like a waste of space. The answer is: obey the standard
  * of JVM.
+ *
+ * The two slots of a long or a double are only an addressing convention: the
+ * value is stored whole in the first one (int64 or float64), so it is accessed
+ * by one aligned load or store, and the second one is left as it is. With
+ * COCONUT_SPLIT_WIDE_SLOTS defined (the SPLIT_WIDE_SLOTS option of cmake), the
+ * value is split into its low and high 32 bits in the two slots instead, as in
+ * a JVM of 32-bit slots.
  */
 typedef union {
   Slot32 bytes;
   Object* ref;
+  /*! \brief A long, in the first of its two slots. */
+  int64_t i64;
+  /*! \brief A double, in the first of its two slots. */
+  double f64;
 } Slot;
 
+static_assert(sizeof(Slot) == 8, "A slot holds a long or a double");
+
+/*!
+ * \brief Store a long into its two slots.
+ * \param slots The first slot.
+ * \param val The value.
+ */
+inline void setLongSlots(Slot* slots, long long val) {
+#ifdef COCONUT_SPLIT_WIDE_SLOTS
+  // low, then high
+  slots[0].bytes = Slot32(val);
+  slots[1].bytes = Slot32(val >> 32);
+#else
+  slots[0].i64 = val;
+#endif
+}
+
+/*!
+ * \brief Load a long from its two slots.
+ * \param slots The first slot.
+ */
+inline long long getLongSlots(const Slot* slots) {
+#ifdef COCONUT_SPLIT_WIDE_SLOTS
+  return ((long long)(slots[1].bytes) << 32) | (long long)(slots[0].bytes);
+#else
+  return slots[0].i64;
+#endif
+}
+
+/*!
+ * \brief Store a double into its two slots.
+ * \param slots The first slot.
+ * \param val The value.
+ */
+inline void setDoubleSlots(Slot* slots, double val) {
+#ifdef COCONUT_SPLIT_WIDE_SLOTS
+  long long bits;
+  std::memcpy(&bits, &val, sizeof(bits));
+  setLongSlots(slots, bits);
+#else
+  slots[0].f64 = val;
+#endif
+}
+
+/*!
+ * \brief Load a double from its two slots.
+ * \param slots The first slot.
+ */
+inline double getDoubleSlots(const Slot* slots) {
+#ifdef COCONUT_SPLIT_WIDE_SLOTS
+  long long bits = getLongSlots(slots);
+  double val;
+  std::memcpy(&val, &bits, sizeof(val));
+  return val;
+#else
+  return slots[0].f64;
+#endif
+}
+
 };  // namespace rtda
 
 };  // namespace coconut
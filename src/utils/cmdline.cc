@@ -14,6 +14,8 @@
 
 #include "cmdline.h"
 
+#include <cstdlib>
+
 namespace coconut {
 
 namespace utils {
@@ -23,8 +25,60 @@ void commandLinePanic(const char* what) {
   exit(1);
 }
 
+size_t parseSize(const char* str) {
+  char* end;
+  unsigned long long size = std::strtoull(str, &end, 10);
+  if (end == str) return 0;
+  switch (*end) {
+    case 'g':
+    case 'G':
+      size <<= 10;
+      // fall through
+    case 'm':
+    case 'M':
+      size <<= 10;
+      // fall through
+    case 'k':
+    case 'K':
+      size <<= 10;
+      ++end;
+      break;
+    default:
+      break;
+  }
+  return *end == '\0' ? size : 0;
+}
+
+// Parse the count after an option, e.g. of --compile-threshold.
+static unsigned long long parseCount(int argc, char* argv[], int i,
+                                     const char* what) {
+  if (i == argc) {
+    commandLinePanic(what);
+  }
+  char* end;
+  unsigned long long count = std::strtoull(argv[i], &end, 10);
+  if (end == argv[i] || *end != '\0' || argv[i][0] == '-') {
+    commandLinePanic(what);
+  }
+  return count;
+}
+
 CommandOptions::CommandOptions(int argc, char* argv[])
-    : classPath(DEFAULT_CP), mainClassName(DEFAULT_MAINCN), args() {
+    : classPath(DEFAULT_CP),
+      mainClassName(DEFAULT_MAINCN),
+      args(),
+      engine(DEFAULT_ENGINE),
+      superInstructions(true),
+      tosCaching(false),
+      jit(false),
+      invocationThreshold(DEFAULT_INVOCATION_THRESHOLD),
+      backedgeThreshold(DEFAULT_BACKEDGE_THRESHOLD),
+      compileThreshold(DEFAULT_COMPILE_THRESHOLD),
+      compilerThreads(DEFAULT_COMPILER_THREADS),
+      printCompilation(false),
+      stackSize(parseSize(DEFAULT_STACK_SIZE_STR)),
+      pairHistogram(),
+      dumpProfiles(false) {
   if (argc <= 1) {
     commandLinePanic("error: no argument.");
   }
@@ -42,6 +96,35 @@ CommandOptions::CommandOptions(int argc, char* argv[])
       printf("\t--version\tshow the version information\n");
       printf("\t--class-path\tclass search path\n");
       printf("\t--jre-path\tjava runtime environment path\n");
+      printf(
+          "\t--engine\texecution engine: classic (default), threaded, "
+          "register\n");
+      printf("\t--no-superinst\tdisable superinstructions (threaded)\n");
+      printf(
+          "\t--tos-cache\tcache the top of stack in a register (threaded)\n");
+      printf("\t--jit\tcompile hot methods into machine code (threaded)\n");
+      printf(
+          "\t--invocation-threshold\tcompile a method after this many "
+          "invocations (jit)\n");
+      printf(
+          "\t--backedge-threshold\tcompile a method after this many "
+          "backedges (jit)\n");
+      printf(
+          "\t--compile-threshold\tcompile a method after this many "
+          "invocations plus backedges (jit)\n");
+      printf(
+          "\t--compiler-threads\tnumber of background compiler threads, 0 to "
+          "compile in place (jit)\n");
+      printf(
+          "\t--print-compilation\tprint the tier transitions of methods "
+          "(jit)\n");
+      printf("\t--stack-size\tvm stack size of a thread, e.g. 512k, 8m\n");
+      printf(
+          "\t--pair-histogram\tdump executed opcode pairs to a file "
+          "(classic)\n");
+      printf(
+          "\t--dump-profiles\tprint the hottest methods and branches "
+          "(threaded)\n");
       exit(0);
     } else if (std::strcmp(argv[i], "--version") == 0) {
       printf("%s\n", VERSION);
@@ -59,6 +142,54 @@ CommandOptions::CommandOptions(int argc, char* argv[])
         commandLinePanic("error: --jre-path requires jre path specification");
       }
       jrePath = std::string(argv[i]);
+    } else if (std::strcmp(argv[i], "--engine") == 0) {
+      ++i;
+      if (i == argc) {
+        commandLinePanic("error: --engine requires engine specification");
+      }
+      engine = std::string(argv[i]);
+      if (engine != "classic" && engine != "threaded" &&
+          engine != "register") {
+        commandLinePanic(
+            "error: unknown engine, use classic, threaded or register");
+      }
+    } else if (std::strcmp(argv[i], "--no-superinst") == 0) {
+      superInstructions = false;
+    } else if (std::strcmp(argv[i], "--tos-cache") == 0) {
+      tosCaching = true;
+    } else if (std::strcmp(argv[i], "--jit") == 0) {
+      jit = true;
+    } else if (std::strcmp(argv[i], "--invocation-threshold") == 0) {
+      invocationThreshold = parseCount(
+          argc, argv, ++i, "error: --invocation-threshold requires a count");
+    } else if (std::strcmp(argv[i], "--backedge-threshold") == 0) {
+      backedgeThreshold = parseCount(
+          argc, argv, ++i, "error: --backedge-threshold requires a count");
+    } else if (std::strcmp(argv[i], "--compile-threshold") == 0) {
+      compileThreshold = parseCount(
+          argc, argv, ++i, "error: --compile-threshold requires a count");
+    } else if (std::strcmp(argv[i], "--compiler-threads") == 0) {
+      compilerThreads = int(parseCount(
+          argc, argv, ++i, "error: --compiler-threads requires a count"));
+    } else if (std::strcmp(argv[i], "--print-compilation") == 0) {
+      printCompilation = true;
+    } else if (std::strcmp(argv[i], "--stack-size") == 0) {
+      ++i;
+      if (i == argc) {
+        commandLinePanic("error: --stack-size requires size specification");
+      }
+      stackSize = parseSize(argv[i]);
+      if (stackSize == 0) {
+        commandLinePanic("error: invalid stack size, use e.g. 512k or 8m");
+      }
+    } else if (std::strcmp(argv[i], "--pair-histogram") == 0) {
+      ++i;
+      if (i == argc) {
+        commandLinePanic("error: --pair-histogram requires file specification");
+      }
+      pairHistogram = std::string(argv[i]);
+    } else if (std::strcmp(argv[i], "--dump-profiles") == 0) {
+      dumpProfiles = true;
     } else if (mainClassName == DEFAULT_MAINCN) {
       // this must be the main class
       mainClassName = std::string(argv[i]);
@@ -67,6 +198,10 @@ CommandOptions::CommandOptions(int argc, char* argv[])
       args.push_back(std::string(argv[i]));
     }
   }
+
+  if (!pairHistogram.empty() && engine != "classic") {
+    commandLinePanic("error: --pair-histogram requires the classic engine");
+  }
 }
 
 }  // namespace utils
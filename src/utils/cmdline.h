@@ -15,6 +15,7 @@
 #ifndef SRC_UTILS_CMDLINE_H_
 #define SRC_UTILS_CMDLINE_H_
 
+#include <cstddef>
 #include <cstdio>
 #include <cstring>
 #include <string>
@@ -29,10 +30,25 @@ namespace utils {
 #define DEFAULT_CP "./"
 #define DEFAULT_MAINCN "Main.class"
 #define DEFAULT_JREPATH "./"
+#define DEFAULT_ENGINE "classic"
+#define DEFAULT_STACK_SIZE_STR "512k"
+
+// the defaults of vm::TieredPolicy
+#define DEFAULT_INVOCATION_THRESHOLD 5000
+#define DEFAULT_BACKEDGE_THRESHOLD 40000
+#define DEFAULT_COMPILE_THRESHOLD 10000
+#define DEFAULT_COMPILER_THREADS 1
 
 /*! \brief Error in command line. */
 void commandLinePanic(const char* what);
 
+/*!
+ * \brief Parse a size in bytes, with an optional k, m or g suffix.
+ * \param str The size string.
+ * \return The size in bytes, or 0 if the string is not a valid size.
+ */
+size_t parseSize(const char* str);
+
 /*!
  * \brief Wrapper for commandline options.
  *
@@ -56,6 +72,61 @@ class CommandOptions {
   /*! \brief Args passed to the main class. */
   std::vector<std::string> args;
 
+  /*!
+   * \brief The execution engine: "classic" (virtual accept() dispatch),
+   * "threaded" (computed-goto dispatch) or "register" (register code, see
+   * vm::RegisterInterpreter).
+   */
+  std::string engine;
+
+  /*! \brief Whether the threaded engine fuses superinstructions. */
+  bool superInstructions;
+
+  /*! \brief Whether the threaded engine caches the top of stack. */
+  bool tosCaching;
+
+  /*! \brief Whether the threaded engine compiles hot methods. */
+  bool jit;
+
+  /*!
+   * \brief The thresholds of the tiered policy: a method gets compiled after
+   * this many invocations, backedges, or invocations plus backedges (see
+   * vm::TieredPolicy).
+   */
+  uint64_t invocationThreshold;
+  uint64_t backedgeThreshold;
+  uint64_t compileThreshold;
+
+  /*!
+   * \brief Number of threads which compile hot methods in the background. 0
+   * to compile them in the thread which runs them.
+   */
+  int compilerThreads;
+
+  /*!
+   * \brief Whether to print every tier transition of the methods (compiled or
+   * rejected) at exit.
+   */
+  bool printCompilation;
+
+  /*!
+   * \brief The size of the vm stack of each thread in bytes. Parsed from a
+   * number with an optional k, m or g suffix, like -Xss.
+   */
+  size_t stackSize;
+
+  /*!
+   * \brief If not empty, the classic engine records a histogram of executed
+   * opcode pairs and dumps it to this file at exit.
+   */
+  std::string pairHistogram;
+
+  /*!
+   * \brief Whether the threaded engine prints the hottest methods and branches
+   * of its profiles at exit.
+   */
+  bool dumpProfiles;
+
   /*!
    * \brief Default constructor. Parse and wrap the command line.
    * \param argc The argument counter.
@@ -14,6 +14,8 @@
 
 #include "misc.h"
 
+#include <pthread.h>
+
 namespace coconut {
 
 namespace utils {
@@ -28,6 +30,24 @@ void split(const std::string& originStr, char delim,
   }
 }
 
+const char* nativeStackLimit(size_t reserve) {
+  static thread_local const char* stackEnd = nullptr;
+#if defined(__linux__)
+  if (stackEnd == nullptr) {
+    pthread_attr_t attr;
+    void* addr;
+    size_t size;
+    if (pthread_getattr_np(pthread_self(), &attr) == 0) {
+      if (pthread_attr_getstack(&attr, &addr, &size) == 0) {
+        stackEnd = static_cast<const char*>(addr);
+      }
+      pthread_attr_destroy(&attr);
+    }
+  }
+#endif
+  return stackEnd == nullptr ? nullptr : stackEnd + reserve;
+}
+
 }  // namespace utils
 
 }  // namespace coconut
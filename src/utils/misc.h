@@ -15,6 +15,7 @@
 #ifndef SRC_UTILS_MISC_H_
 #define SRC_UTILS_MISC_H_
 
+#include <cstddef>
 #include <string>
 #include <vector>
 
@@ -44,6 +45,15 @@ inline bool instanceof (const BaseClass* ptr) {
 void split(const std::string& originStr, char delim,
            std::vector<std::string>& ret);
 
+/*!
+ * \brief The lowest address the native stack of the calling thread may grow
+ * down to, leaving some reserve above its end, e.g. for a call out of an
+ * engine. The end is looked up once per thread.
+ * \param reserve The size of the reserve in bytes.
+ * \return The address, or nullptr if the end of the stack is unknown.
+ */
+const char* nativeStackLimit(size_t reserve);
+
 }  // namespace utils
 
 }  // namespace coconut
@@ -0,0 +1,51 @@
+/*!
+ *    ________  ________  ________  ________  ________   ___  ___  _________
+ *   |\   ____\|\   __  \|\   ____\|\   __  \|\   ___  \|\  \|\  \|\___   ___\
+ *   \ \  \___|\ \  \|\  \ \  \___|\ \  \|\  \ \  \\ \  \ \  \\\  \|___ \  \_|
+ *    \ \  \    \ \  \\\  \ \  \    \ \  \\\  \ \  \\ \  \ \  \\\  \   \ \  \
+ *     \ \  \____\ \  \\\  \ \  \____\ \  \\\  \ \  \\ \  \ \  \\\  \   \ \  \
+ *      \ \_______\ \_______\ \_______\ \_______\ \__\\ \__\ \_______\   \ \__\
+ *       \|_______|\|_______|\|_______|\|_______|\|__| \|__|\|_______|    \|__|
+ *
+ * \file src/vm/code_cache.cc
+ * \brief Implementation of code_cache.h
+ * \author SiriusNEO
+ */
+
+#include "code_cache.h"
+
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include <cstring>
+
+#include "../utils/logging.h"
+
+namespace coconut {
+
+namespace vm {
+
+CodeCache::~CodeCache() {
+  for (const Region& region : regions_) {
+    munmap(region.start, region.length);
+  }
+}
+
+const void* CodeCache::install(const std::vector<uint8_t>& code) {
+  size_t pageSize = sysconf(_SC_PAGESIZE);
+  size_t length = (code.size() + pageSize - 1) / pageSize * pageSize;
+  void* start = mmap(nullptr, length, PROT_READ | PROT_WRITE,
+                     MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  CHECK(start != MAP_FAILED) << "Cannot map " << length << " bytes for code";
+  std::memcpy(start, code.data(), code.size());
+  CHECK(mprotect(start, length, PROT_READ | PROT_EXEC) == 0)
+      << "Cannot make the code executable";
+  std::lock_guard<std::mutex> lock(mutex_);
+  regions_.push_back(Region{start, length});
+  codeBytes += code.size();
+  return start;
+}
+
+}  // namespace vm
+
+}  // namespace coconut
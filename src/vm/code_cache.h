@@ -0,0 +1,71 @@
+/*!
+ *    ________  ________  ________  ________  ________   ___  ___  _________
+ *   |\   ____\|\   __  \|\   ____\|\   __  \|\   ___  \|\  \|\  \|\___   ___\
+ *   \ \  \___|\ \  \|\  \ \  \___|\ \  \|\  \ \  \\ \  \ \  \\\  \|___ \  \_|
+ *    \ \  \    \ \  \\\  \ \  \    \ \  \\\  \ \  \\ \  \ \  \\\  \   \ \  \
+ *     \ \  \____\ \  \\\  \ \  \____\ \  \\\  \ \  \\ \  \ \  \\\  \   \ \  \
+ *      \ \_______\ \_______\ \_______\ \_______\ \__\\ \__\ \_______\   \ \__\
+ *       \|_______|\|_______|\|_______|\|_______|\|__| \|__|\|_______|    \|__|
+ *
+ * \file src/vm/code_cache.h
+ * \brief Executable memory for compiled code.
+ * \author SiriusNEO
+ */
+
+#ifndef SRC_VM_CODE_CACHE_H_
+#define SRC_VM_CODE_CACHE_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+namespace coconut {
+
+namespace vm {
+
+/*!
+ * \brief Executable memory for compiled code.
+ *
+ * Each piece of code gets its own pages, mapped writable, filled, and then
+ * turned read-only and executable, so no page is ever writable and executable
+ * at the same time. The code lives until the cache is destroyed. Compiler
+ * threads may install code concurrently.
+ */
+class CodeCache {
+ private:
+  /*! \brief A mapping: its start and its length. */
+  struct Region {
+    void* start;
+    size_t length;
+  };
+
+  /*! \brief The mappings of the installed code. */
+  std::vector<Region> regions_;
+
+  /*! \brief Guards regions_ and codeBytes. */
+  std::mutex mutex_;
+
+ public:
+  /*! \brief Number of bytes of code installed. */
+  size_t codeBytes;
+
+  /*! \brief Default constructor. An empty cache. */
+  CodeCache() : codeBytes(0) {}
+
+  /*! \brief Default destructor. Unmap all code. */
+  ~CodeCache();
+
+  /*!
+   * \brief Copy code into executable memory.
+   * \param code The machine code.
+   * \return The start of the installed code.
+   */
+  const void* install(const std::vector<uint8_t>& code);
+};
+
+}  // namespace vm
+
+}  // namespace coconut
+
+#endif  // SRC_VM_CODE_CACHE_H_
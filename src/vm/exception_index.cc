@@ -0,0 +1,79 @@
+/*!
+ *    ________  ________  ________  ________  ________   ___  ___  _________
+ *   |\   ____\|\   __  \|\   ____\|\   __  \|\   ___  \|\  \|\  \|\___   ___\
+ *   \ \  \___|\ \  \|\  \ \  \___|\ \  \|\  \ \  \\ \  \ \  \\\  \|___ \  \_|
+ *    \ \  \    \ \  \\\  \ \  \    \ \  \\\  \ \  \\ \  \ \  \\\  \   \ \  \
+ *     \ \  \____\ \  \\\  \ \  \____\ \  \\\  \ \  \\ \  \ \  \\\  \   \ \  \
+ *      \ \_______\ \_______\ \_______\ \_______\ \__\\ \__\ \_______\   \ \__\
+ *       \|_______|\|_______|\|_______|\|_______|\|__| \|__|\|_______|    \|__|
+ *
+ * \file src/vm/exception_index.cc
+ * \brief Implementation of exception_index.h
+ * \author SiriusNEO
+ */
+
+#include "exception_index.h"
+
+#include <algorithm>
+
+#include "../utils/logging.h"
+
+namespace coconut {
+
+namespace vm {
+
+ExceptionIndex::ExceptionIndex(classfile::CodeAttr* codeAttr) {
+  const auto& table = codeAttr->exceptionTable;
+  if (table.empty()) return;
+
+  // resolve the catch types once
+  std::vector<const rtda::Class*> catchClasses;
+  for (const auto& entry : table) {
+    if (entry.catchType == 0) {
+      catchClasses.push_back(nullptr);
+    } else {
+      CHECK(codeAttr->cp != nullptr) << "Catch type without constant pool";
+      catchClasses.push_back(rtda::ClassTable::instance().resolve(
+          codeAttr->cp->getClassNameStr(entry.catchType)));
+    }
+    segmentStarts_.push_back(entry.startPc);
+    segmentStarts_.push_back(entry.endPc);
+  }
+  std::sort(segmentStarts_.begin(), segmentStarts_.end());
+  segmentStarts_.erase(
+      std::unique(segmentStarts_.begin(), segmentStarts_.end()),
+      segmentStarts_.end());
+
+  // the handlers of a segment: the entries covering it, in the table order
+  for (size_t i = 0; i + 1 < segmentStarts_.size(); ++i) {
+    first_.push_back(handlers_.size());
+    for (size_t j = 0; j < table.size(); ++j) {
+      if (table[j].startPc <= segmentStarts_[i] &&
+          segmentStarts_[i] < table[j].endPc) {
+        handlers_.push_back({table[j].handlerPc, catchClasses[j]});
+      }
+    }
+  }
+  first_.push_back(handlers_.size());
+}
+
+int ExceptionIndex::find(int pc, const rtda::Class* thrown) const {
+  // the segment containing pc: the last start <= pc
+  auto it = std::upper_bound(segmentStarts_.begin(), segmentStarts_.end(), pc);
+  if (it == segmentStarts_.begin() || it == segmentStarts_.end()) {
+    return -1;
+  }
+  size_t segment = it - segmentStarts_.begin() - 1;
+  for (int i = first_[segment]; i < first_[segment + 1]; ++i) {
+    const rtda::Class* catchClass = handlers_[i].catchClass;
+    if (catchClass == nullptr ||
+        (thrown != nullptr && thrown->isSubtypeOf(catchClass))) {
+      return handlers_[i].handlerPc;
+    }
+  }
+  return -1;
+}
+
+}  // namespace vm
+
+}  // namespace coconut
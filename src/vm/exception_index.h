@@ -0,0 +1,90 @@
+/*!
+ *    ________  ________  ________  ________  ________   ___  ___  _________
+ *   |\   ____\|\   __  \|\   ____\|\   __  \|\   ___  \|\  \|\  \|\___   ___\
+ *   \ \  \___|\ \  \|\  \ \  \___|\ \  \|\  \ \  \\ \  \ \  \\\  \|___ \  \_|
+ *    \ \  \    \ \  \\\  \ \  \    \ \  \\\  \ \  \\ \  \ \  \\\  \   \ \  \
+ *     \ \  \____\ \  \\\  \ \  \____\ \  \\\  \ \  \\ \  \ \  \\\  \   \ \  \
+ *      \ \_______\ \_______\ \_______\ \_______\ \__\\ \__\ \_______\   \ \__\
+ *       \|_______|\|_______|\|_______|\|_______|\|__| \|__|\|_______|    \|__|
+ *
+ * \file src/vm/exception_index.h
+ * \brief Precomputed index of exception handlers.
+ * \author SiriusNEO
+ */
+
+#ifndef SRC_VM_EXCEPTION_INDEX_H_
+#define SRC_VM_EXCEPTION_INDEX_H_
+
+#include <vector>
+
+#include "../classfile/attributes.h"
+#include "../rtda/heap/class.h"
+
+namespace coconut {
+
+namespace vm {
+
+/*! \brief An exception handler, with its catch type resolved. */
+struct ExceptionHandler {
+  /*! \brief The pc of the handler. */
+  int handlerPc;
+
+  /*! \brief The class caught. nullptr catches everything (e.g. finally). */
+  const rtda::Class* catchClass;
+};
+
+/*!
+ * \brief Index of the exception table of a code, built once when translating.
+ *
+ * The pcs are split into disjoint segments at every startPc and endPc in the
+ * table. All pcs in a segment are covered by the same handlers, which are kept
+ * in the order of the table. So finding the handler of a throw is a binary
+ * search of the segment plus a scan of the (few) handlers covering it, and the
+ * catch types are never looked up in the constant pool again.
+ *
+ * The table is assumed well-formed: only verified code is translated, and the
+ * Verifier checks the ranges and handlers are in the code, at instruction
+ * starts, and the ranges are not empty.
+ */
+class ExceptionIndex {
+ private:
+  /*!
+   * \brief The first pc of each segment, in ascending order. The last one is
+   * the end of the last segment.
+   */
+  std::vector<int> segmentStarts_;
+
+  /*!
+   * \brief The handlers of segment i are handlers_[first_[i], first_[i + 1]).
+   * It has one more element than the segments.
+   */
+  std::vector<int> first_;
+
+  /*! \brief The handlers of all segments. */
+  std::vector<ExceptionHandler> handlers_;
+
+ public:
+  /*!
+   * \brief Default constructor. Build the index of a code.
+   * \param codeAttr The code.
+   */
+  explicit ExceptionIndex(classfile::CodeAttr* codeAttr);
+
+  /*! \brief Whether the code has no handlers. */
+  bool empty() const { return handlers_.empty(); }
+
+  /*!
+   * \brief Find the handler of an exception.
+   * \param pc The pc where the exception is thrown.
+   * \param thrown The class of the exception. nullptr if unknown, which only
+   * matches the handlers catching everything.
+   * \return The pc of the handler. -1 if there is no handler.
+   */
+  int find(int pc, const rtda::Class* thrown) const;
+};
+
+}  // namespace vm
+
+}  // namespace coconut
+
+#endif  // SRC_VM_EXCEPTION_INDEX_H_
@@ -0,0 +1,158 @@
+/*!
+ *    ________  ________  ________  ________  ________   ___  ___  _________
+ *   |\   ____\|\   __  \|\   ____\|\   __  \|\   ___  \|\  \|\  \|\___   ___\
+ *   \ \  \___|\ \  \|\  \ \  \___|\ \  \|\  \ \  \\ \  \ \  \\\  \|___ \  \_|
+ *    \ \  \    \ \  \\\  \ \  \    \ \  \\\  \ \  \\ \  \ \  \\\  \   \ \  \
+ *     \ \  \____\ \  \\\  \ \  \____\ \  \\\  \ \  \\ \  \ \  \\\  \   \ \  \
+ *      \ \_______\ \_______\ \_______\ \_______\ \__\\ \__\ \_______\   \ \__\
+ *       \|_______|\|_______|\|_______|\|_______|\|__| \|__|\|_______|    \|__|
+ *
+ * \file src/vm/exec_context.h
+ * \brief Flattened execution context of the threaded dispatch loop.
+ * \author SiriusNEO
+ */
+
+#ifndef SRC_VM_EXEC_CONTEXT_H_
+#define SRC_VM_EXEC_CONTEXT_H_
+
+#include <cstring>
+
+#include "../rtda/vmstack/jvm_stack.h"
+#include "threaded_code.h"
+
+namespace coconut {
+
+namespace vm {
+
+/*!
+ * \brief The hot state of a running frame, flattened out of rtda::StackFrame.
+ *
+ * Going through the frame costs three or four dependent loads per access
+ * (frame -> operandStack -> slots_ -> top_), so the dispatch loop copies the
+ * raw pointers into this struct when it enters a frame and works on them
+ * directly. It lives on the C++ stack of the loop and its address is never
+ * taken, so the compiler keeps the fields in registers.
+ *
+ * The accessors do no bound checks: the operand stack and the locals are sized
+ * by maxStack and maxLocals of the code. The frame only sees the changes after
+ * save() is called, so call it before leaving the loop in a way that may
+ * inspect the frame (e.g. a panic).
+ */
+struct ExecContext {
+  /*! \brief The slot above the top of the operand stack. */
+  rtda::Slot* sp;
+
+  /*! \brief The first local variable. */
+  rtda::Slot* locals;
+
+  /*! \brief The current instruction. */
+  ThreadedInst* pc;
+
+  /*! \brief The runtime constant pool of the code. */
+  classfile::ConstantPool* cp;
+
+  /*!
+   * \brief Load the context of a frame.
+   * \param frame The frame, whose nextPc is the pc to start with.
+   * \param code The translated code running in the frame.
+   */
+  ExecContext(rtda::StackFrame* frame, ThreadedCode* code)
+      : sp(frame->operandStack->top()),
+        locals(frame->localVariableTable->slots()),
+        pc(code->at(frame->nextPc)),
+        cp(code->cp) {}
+
+  /*!
+   * \brief Write the stack pointer and the pc back to the frame.
+   * \param frame The frame the context is loaded from.
+   */
+  void save(rtda::StackFrame* frame) {
+    frame->operandStack->setTop(sp);
+    frame->nextPc = pc->pc;
+  }
+
+  /* Operand stack */
+
+  void pushSlot(rtda::Slot slot) { *sp++ = slot; }
+
+  rtda::Slot popSlot() { return *--sp; }
+
+  void pushInt(int val) { (sp++)->bytes = val; }
+
+  int popInt() { return int((--sp)->bytes); }
+
+  // floats are copied bitwise (a cast would round, a casted pointer aliases)
+  void pushFloat(float val) { std::memcpy(&(sp++)->bytes, &val, sizeof(val)); }
+
+  float popFloat() {
+    float val;
+    std::memcpy(&val, &(--sp)->bytes, sizeof(val));
+    return val;
+  }
+
+  void pushLong(long long val) {
+    rtda::setLongSlots(sp, val);
+    sp += 2;
+  }
+
+  long long popLong() {
+    sp -= 2;
+    return rtda::getLongSlots(sp);
+  }
+
+  void pushDouble(double val) {
+    rtda::setDoubleSlots(sp, val);
+    sp += 2;
+  }
+
+  double popDouble() {
+    sp -= 2;
+    return rtda::getDoubleSlots(sp);
+  }
+
+  void pushRef(rtda::Object* ref) { (sp++)->ref = ref; }
+
+  rtda::Object* popRef() { return (--sp)->ref; }
+
+  /* Local variables */
+
+  int getInt(int index) const { return int(locals[index].bytes); }
+
+  void setInt(int index, int val) { locals[index].bytes = val; }
+
+  float getFloat(int index) const {
+    float val;
+    std::memcpy(&val, &locals[index].bytes, sizeof(val));
+    return val;
+  }
+
+  void setFloat(int index, float val) {
+    std::memcpy(&locals[index].bytes, &val, sizeof(val));
+  }
+
+  long long getLong(int index) const {
+    return rtda::getLongSlots(locals + index);
+  }
+
+  void setLong(int index, long long val) {
+    rtda::setLongSlots(locals + index, val);
+  }
+
+  double getDouble(int index) const {
+    return rtda::getDoubleSlots(locals + index);
+  }
+
+  void setDouble(int index, double val) {
+    rtda::setDoubleSlots(locals + index, val);
+  }
+
+  rtda::Object* getRef(int index) const { return locals[index].ref; }
+
+  void setRef(int index, rtda::Object* ref) { locals[index].ref = ref; }
+};
+
+}  // namespace vm
+
+}  // namespace coconut
+
+#endif  // SRC_VM_EXEC_CONTEXT_H_
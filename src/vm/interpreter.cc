@@ -14,24 +14,35 @@
 
 #include "interpreter.h"
 
+#include <sstream>
+
 namespace coconut {
 
 namespace vm {
 
-void Interpreter::loop(rtda::Thread* thread) {
+void Interpreter::loop(rtda::Thread* thread, bytecode::DecodedMethod* method) {
   bytecode::FrameExecutor executor(thread, thread->stack.topFrame);
+  unsigned int depth = thread->stack.size;
+
+  if (histogram != nullptr) {
+    histogram->breakSequence();
+  }
 
   while (true) {
     thread->pc = executor.frame->nextPc;
-    decoder_->reader.cursor = thread->pc;
 
-    // new
-    bytecode::Instruction* newInst = decoder_->getInst();
-    decoder_->getOperands(newInst);
-    executor.frame->nextPc = decoder_->reader.cursor;
+    const bytecode::DecodedInst& decoded = method->fetch(thread->pc);
+    executor.frame->nextPc = decoded.nextPc;
+    if (histogram != nullptr) {
+      histogram->record(decoded.opcode);
+    }
     LOG(INFO) << "Execute inst: " << thread->pc;
-    executor.execute(newInst);
-    delete newInst;
+    executor.execute(decoded.inst);
+
+    // the frame returns
+    if (thread->stack.size < depth) {
+      break;
+    }
 
     // operand stack
     LOG(INFO) << executor.frame->operandStack->brief();
@@ -48,16 +59,33 @@ void Interpreter::interpret(classfile::MethodInfo& methodInfo) {
 
   CHECK(codeAttr != nullptr) << "No CodeAttr found";
 
-  // load code
-  decoder_ = new bytecode::BytecodeDecoder(codeAttr->codeLen, codeAttr->code);
-
-  rtda::Thread thread;
+  rtda::Thread thread(stackSize);
   thread.stack.push(codeAttr->maxLocals, codeAttr->maxStack);
   LOG(INFO) << "thread info: maxLocals=" << codeAttr->maxLocals
             << " maxStack=%d" << codeAttr->maxStack;
 
+  execute(&thread, codeAttr);
+  if (thread.exception != nullptr) {
+    std::ostringstream trace;
+    rtda::Throwable* throwable =
+        dynamic_cast<rtda::Throwable*>(thread.exception);
+    if (throwable != nullptr) {
+      throwable->printStackTrace(trace);
+    } else {
+      rtda::Class* klass = thread.exception->klass;
+      trace << (klass != nullptr ? klass->name : "<unknown class>");
+    }
+    LOG(FATAL) << "Uncaught exception: " << trace.str();
+  }
+}
+
+void Interpreter::execute(rtda::Thread* thread, classfile::CodeAttr* codeAttr) {
+  thread->stack.topFrame->code = codeAttr;
+  // load code
+  bytecode::DecodedMethod* method = bytecode::DecodedMethod::of(codeAttr);
+
   // start loop
-  loop(&thread);
+  loop(thread, method);
 }
 
 }  // namespace vm
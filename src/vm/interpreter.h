@@ -15,8 +15,9 @@
 #ifndef SRC_VM_INTERPRETER_H_
 #define SRC_VM_INTERPRETER_H_
 
-#include "../bytecode/bytecode_decoder.h"
+#include "../bytecode/decoded_method.h"
 #include "../classfile/classfile.h"
+#include "opcode_histogram.h"
 
 namespace coconut {
 
@@ -29,35 +30,63 @@ namespace vm {
  * detailed, it will create a new thread and push a single new stack frame to
  * the VM stack. Then all operations will be taken in this frame.
  *
+ * Instructions are dispatched from the decoded-method cache of the code (see
+ * bytecode::DecodedMethod), so each instruction is decoded only once.
+ *
+ * This is the classic engine: every instruction is applied through its virtual
+ * accept(). Other engines (see threaded_interpreter.h) inherit from it and
+ * override execute(), so they can be selected at startup and A/B compared.
+ *
  * TODO: iterate it.
  */
 class Interpreter {
  private:
-  /*! \brief Internal decoder. */
-  bytecode::BytecodeDecoder* decoder_;
-
   /*!
-   * \brief Loop in a thread. It is an infinite-loop for now.
+   * \brief Loop in a thread, until the frame it starts with returns.
    * \param thread The thread the interpreter runs.
+   * \param method The decoded method running in the thread.
    */
-  void loop(rtda::Thread* thread);
+  void loop(rtda::Thread* thread, bytecode::DecodedMethod* method);
 
  public:
+  /*!
+   * \brief If not null, the classic engine records every executed opcode into
+   * it. Not owned by the interpreter.
+   */
+  OpcodePairHistogram* histogram;
+
+  /*!
+   * \brief The class whose methods invokestatic calls. Not owned by the
+   * interpreter.
+   *
+   * TODO: there is no class loading yet, so only the methods of this class
+   * can be invoked.
+   */
+  classfile::ClassFile* classFile;
+
+  /*! \brief The size of the vm stack of the thread, in bytes. */
+  size_t stackSize;
+
   /*! \brief Default constructor. */
-  Interpreter() : decoder_(nullptr) {}
+  Interpreter()
+      : histogram(nullptr), classFile(nullptr), stackSize(DEFAULT_STACK_SIZE) {}
 
-  /*! \brief Internal destructor. */
-  ~Interpreter() {
-    if (decoder_ != nullptr) {
-      delete decoder_;
-    }
-  }
+  /*! \brief Default destructor. */
+  virtual ~Interpreter() {}
 
   /*!
    * \brief Interpret a method.
    * \param  methodInfo The info of the method we want to interpret.
    */
   void interpret(classfile::MethodInfo& methodInfo);
+
+  /*!
+   * \brief Execute a code on the top frame of a thread, until this frame
+   * returns. The returned value (if any) is pushed to the invoker frame.
+   * \param thread The thread. Its top frame must be allocated for the code.
+   * \param codeAttr The code to execute.
+   */
+  virtual void execute(rtda::Thread* thread, classfile::CodeAttr* codeAttr);
 };
 
 }  // namespace vm
@@ -0,0 +1,234 @@
+/*!
+ *    ________  ________  ________  ________  ________   ___  ___  _________
+ *   |\   ____\|\   __  \|\   ____\|\   __  \|\   ___  \|\  \|\  \|\___   ___\
+ *   \ \  \___|\ \  \|\  \ \  \___|\ \  \|\  \ \  \\ \  \ \  \\\  \|___ \  \_|
+ *    \ \  \    \ \  \\\  \ \  \    \ \  \\\  \ \  \\ \  \ \  \\\  \   \ \  \
+ *     \ \  \____\ \  \\\  \ \  \____\ \  \\\  \ \  \\ \  \ \  \\\  \   \ \  \
+ *      \ \_______\ \_______\ \_______\ \_______\ \__\\ \__\ \_______\   \ \__\
+ *       \|_______|\|_______|\|_______|\|_______|\|__| \|__|\|_______|    \|__|
+ *
+ * \file src/vm/method_data.cc
+ * \brief Implementation of method_data.h
+ * \author SiriusNEO
+ */
+
+#include "method_data.h"
+
+#include <algorithm>
+#include <string>
+#include <utility>
+
+#include "verifier.h"
+
+namespace coconut {
+
+namespace vm {
+
+static int readS4(const BYTE* code, int pc) {
+  return int32_t((uint32_t(code[pc]) << 24) | (uint32_t(code[pc + 1]) << 16) |
+                 (uint32_t(code[pc + 2]) << 8) | uint32_t(code[pc + 3]));
+}
+
+MethodData::MethodData(const classfile::CodeAttr* codeAttr)
+    : cells_(codeAttr->codeLen, -1), codeAttr(codeAttr) {
+  const BYTE* code = codeAttr->code;
+  int codeLen = codeAttr->codeLen;
+  for (int pc = 0; pc < codeLen;) {
+    int length = instructionLength(code, codeLen, pc);
+    CHECK(length > 0) << "Profiling an unverified code";
+    uint8_t opcode = code[pc];
+    if ((opcode >= 0x99 && opcode <= 0xa6) || opcode == 0xc6 ||
+        opcode == 0xc7) {
+      // if<cond>, if_icmp<cond>, if_acmp<cond>, ifnull, ifnonnull
+      cells_[pc] = branches.size();
+      branches.push_back(BranchProfile{pc, 0, 0});
+    } else if (opcode == 0xaa || opcode == 0xab) {
+      // padding to 4 bytes, default, then the table
+      int base = pc + 1 + (4 - (pc + 1) % 4) % 4;
+      SwitchProfile profile;
+      profile.pc = pc;
+      profile.isTable = opcode == 0xaa;
+      int cases;
+      if (profile.isTable) {
+        int low = readS4(code, base + 4);
+        profile.keys.push_back(low);
+        cases = readS4(code, base + 8) - low + 1;
+      } else {
+        cases = readS4(code, base + 4);
+        for (int i = 0; i < cases; ++i) {
+          profile.keys.push_back(readS4(code, base + 8 + 8 * i));
+        }
+      }
+      profile.counts.resize(1 + cases, 0);
+      cells_[pc] = switches.size();
+      switches.push_back(std::move(profile));
+    } else if (opcode == 0xb6 || opcode == 0xb9) {
+      // invokevirtual, invokeinterface
+      cells_[pc] = receivers.size();
+      receivers.push_back(ReceiverProfile{pc, {}, {}, 0});
+    }
+    pc += length;
+  }
+}
+
+MethodData* MethodData::allocate(classfile::CodeAttr* codeAttr,
+                                 uint64_t threshold) {
+  MethodData* data = __atomic_load_n(&codeAttr->methodData, __ATOMIC_ACQUIRE);
+  if (data != nullptr) return data;
+  if (__atomic_load_n(&codeAttr->invocationCount, __ATOMIC_RELAXED) +
+          __atomic_load_n(&codeAttr->backedgeCount, __ATOMIC_RELAXED) <
+      threshold) {
+    return nullptr;
+  }
+  // threads may warm it up at the same time: the first one publishes its data
+  MethodData* created = new MethodData(codeAttr);
+  if (!__atomic_compare_exchange_n(&codeAttr->methodData, &data, created,
+                                   false, __ATOMIC_ACQ_REL,
+                                   __ATOMIC_ACQUIRE)) {
+    delete created;
+    return data;
+  }
+  return created;
+}
+
+void MethodData::countSwitch(int pc, int key) {
+  SwitchProfile& profile = switches[cells_[pc]];
+  int index = 0;  // default
+  if (profile.isTable) {
+    long long offset = (long long)key - profile.keys[0];
+    if (offset >= 0 && offset + 1 < (long long)profile.counts.size()) {
+      index = 1 + offset;
+    }
+  } else {
+    // the keys of a lookupswitch are sorted
+    auto found =
+        std::lower_bound(profile.keys.begin(), profile.keys.end(), key);
+    if (found != profile.keys.end() && *found == key) {
+      index = 1 + (found - profile.keys.begin());
+    }
+  }
+  increment_(&profile.counts[index]);
+}
+
+void MethodData::countReceiver(int pc, const rtda::Class* receiverClass) {
+  ReceiverProfile& profile = receivers[cells_[pc]];
+  for (int i = 0; i < kReceiverRows; ++i) {
+    const rtda::Class* rowClass =
+        __atomic_load_n(&profile.classes[i], __ATOMIC_RELAXED);
+    if (rowClass == nullptr) {
+      // claim the free row. If another thread wins it, check its class
+      if (__atomic_compare_exchange_n(&profile.classes[i], &rowClass,
+                                      receiverClass, false, __ATOMIC_RELAXED,
+                                      __ATOMIC_RELAXED)) {
+        rowClass = receiverClass;
+      }
+    }
+    if (rowClass == receiverClass) {
+      increment_(&profile.counts[i]);
+      return;
+    }
+  }
+  increment_(&profile.others);
+}
+
+const BranchProfile* MethodData::branchAt(int pc) const {
+  if (pc < 0 || pc >= int(cells_.size()) || cells_[pc] < 0) return nullptr;
+  // the cell is an index of the kind of the instruction at pc
+  size_t index = cells_[pc];
+  if (index >= branches.size() || branches[index].pc != pc) return nullptr;
+  return &branches[index];
+}
+
+const SwitchProfile* MethodData::switchAt(int pc) const {
+  if (pc < 0 || pc >= int(cells_.size()) || cells_[pc] < 0) return nullptr;
+  size_t index = cells_[pc];
+  if (index >= switches.size() || switches[index].pc != pc) return nullptr;
+  return &switches[index];
+}
+
+const ReceiverProfile* MethodData::receiverAt(int pc) const {
+  if (pc < 0 || pc >= int(cells_.size()) || cells_[pc] < 0) return nullptr;
+  size_t index = cells_[pc];
+  if (index >= receivers.size() || receivers[index].pc != pc) return nullptr;
+  return &receivers[index];
+}
+
+std::string methodName(const classfile::CodeAttr* codeAttr) {
+  if (codeAttr->cp == nullptr || codeAttr->methodNameIdx == 0) {
+    return "<unknown>";
+  }
+  return codeAttr->cp->getLiteral(codeAttr->methodNameIdx) +
+         codeAttr->cp->getLiteral(codeAttr->methodDescriptorIdx);
+}
+
+// Print the lines with the largest counts first.
+static void printHottest(std::vector<std::pair<uint64_t, std::string>>& lines,
+                         const char* title, std::ostream& os, int limit) {
+  std::stable_sort(lines.begin(), lines.end(),
+                   [](const std::pair<uint64_t, std::string>& a,
+                      const std::pair<uint64_t, std::string>& b) {
+                     return a.first > b.first;
+                   });
+  os << title << ":\n";
+  for (int i = 0; i < limit && i < int(lines.size()); ++i) {
+    os << "  " << lines[i].second << "\n";
+  }
+}
+
+void dumpProfiles(const std::vector<const classfile::CodeAttr*>& codes,
+                  std::ostream& os, int limit) {
+  std::vector<std::pair<uint64_t, std::string>> methods, branches, switches,
+      receivers;
+  for (const classfile::CodeAttr* codeAttr : codes) {
+    std::string name = methodName(codeAttr);
+    uint64_t invocations = codeAttr->invocationCount;
+    uint64_t backedges = codeAttr->backedgeCount;
+    const MethodData* data = codeAttr->methodData;
+    methods.emplace_back(invocations + backedges,
+                         name + ": " + std::to_string(invocations) +
+                             " invocations, " + std::to_string(backedges) +
+                             " backedges" + (data ? "" : " (not profiled)"));
+    if (data == nullptr) continue;
+
+    for (const BranchProfile& profile : data->branches) {
+      branches.emplace_back(
+          profile.taken + profile.notTaken,
+          name + " pc " + std::to_string(profile.pc) + ": " +
+              std::to_string(profile.taken) + " taken, " +
+              std::to_string(profile.notTaken) + " not taken");
+    }
+    for (const SwitchProfile& profile : data->switches) {
+      uint64_t total = 0;
+      std::string line = name + " pc " + std::to_string(profile.pc) +
+                         ": default " + std::to_string(profile.counts[0]);
+      for (size_t i = 1; i < profile.counts.size(); ++i) {
+        int key = profile.isTable ? profile.keys[0] + int(i - 1)
+                                  : profile.keys[i - 1];
+        line += ", case " + std::to_string(key) + " " +
+                std::to_string(profile.counts[i]);
+        total += profile.counts[i];
+      }
+      switches.emplace_back(total + profile.counts[0], line);
+    }
+    for (const ReceiverProfile& profile : data->receivers) {
+      uint64_t total = profile.others;
+      std::string line = name + " pc " + std::to_string(profile.pc) + ":";
+      for (int i = 0; i < kReceiverRows && profile.classes[i] != nullptr;
+           ++i) {
+        line += " " + profile.classes[i]->name + " " +
+                std::to_string(profile.counts[i]) + ",";
+        total += profile.counts[i];
+      }
+      receivers.emplace_back(
+          total, line + " others " + std::to_string(profile.others));
+    }
+  }
+  printHottest(methods, "Hottest methods", os, limit);
+  printHottest(branches, "Hottest branches", os, limit);
+  printHottest(switches, "Hottest switches", os, limit);
+  printHottest(receivers, "Hottest call sites", os, limit);
+}
+
+}  // namespace vm
+
+}  // namespace coconut
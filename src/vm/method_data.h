@@ -0,0 +1,202 @@
+/*!
+ *    ________  ________  ________  ________  ________   ___  ___  _________
+ *   |\   ____\|\   __  \|\   ____\|\   __  \|\   ___  \|\  \|\  \|\___   ___\
+ *   \ \  \___|\ \  \|\  \ \  \___|\ \  \|\  \ \  \\ \  \ \  \\\  \|___ \  \_|
+ *    \ \  \    \ \  \\\  \ \  \    \ \  \\\  \ \  \\ \  \ \  \\\  \   \ \  \
+ *     \ \  \____\ \  \\\  \ \  \____\ \  \\\  \ \  \\ \  \ \  \\\  \   \ \  \
+ *      \ \_______\ \_______\ \_______\ \_______\ \__\\ \__\ \_______\   \ \__\
+ *       \|_______|\|_______|\|_______|\|_______|\|__| \|__|\|_______|    \|__|
+ *
+ * \file src/vm/method_data.h
+ * \brief Profiles of methods, collected by the interpreter.
+ * \author SiriusNEO
+ */
+
+#ifndef SRC_VM_METHOD_DATA_H_
+#define SRC_VM_METHOD_DATA_H_
+
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include "../classfile/attributes.h"
+#include "../rtda/heap/class.h"
+
+namespace coconut {
+
+namespace vm {
+
+/*!
+ * \brief Default number of invocations and backedges after which a method is
+ * warm, and gets a MethodData.
+ */
+const uint64_t kProfileThreshold = 1000;
+
+/*! \brief Max number of receiver classes recorded at a call site. */
+const int kReceiverRows = 2;
+
+/*! \brief Taken and not-taken counts of a conditional branch. */
+struct BranchProfile {
+  /*! \brief The pc of the branch. */
+  int pc;
+
+  uint64_t taken;
+  uint64_t notTaken;
+};
+
+/*! \brief Counts of the cases of a tableswitch or a lookupswitch. */
+struct SwitchProfile {
+  /*! \brief The pc of the switch. */
+  int pc;
+
+  /*!
+   * \brief The keys of the cases. A tableswitch stores only low, and the key
+   * of case i is low + i.
+   */
+  std::vector<int> keys;
+
+  /*! \brief Whether it is a tableswitch. */
+  bool isTable;
+
+  /*! \brief Counts of the default, then of each case in the code order. */
+  std::vector<uint64_t> counts;
+};
+
+/*!
+ * \brief Receiver classes of a virtual or interface call site. The first
+ * kReceiverRows classes seen get a row each, and later ones are counted in
+ * others.
+ */
+struct ReceiverProfile {
+  /*! \brief The pc of the call site. */
+  int pc;
+
+  /*! \brief The classes of the rows. nullptr if the row is free. */
+  const rtda::Class* classes[kReceiverRows];
+
+  uint64_t counts[kReceiverRows];
+  uint64_t others;
+};
+
+/*!
+ * \brief The profile of a method: branch, switch and receiver-type profiles,
+ * indexed by pc, for the optimization tiers.
+ *
+ * It is only allocated once the method is warm (see allocate), so cold code
+ * pays nothing but the counters of its CodeAttr. The cells are laid out when
+ * it is allocated, by a scan of the code, and never move.
+ *
+ * Threads may count at the same time. Like the counters of an inline cache,
+ * counts are not incremented atomically, so a race may lose some. A receiver
+ * row is claimed with a compare-and-swap, so a class has at most one row.
+ */
+class MethodData {
+ private:
+  /*!
+   * \brief Map from pc to the index of its profile in the vector of its kind.
+   * -1 if the instruction is not profiled.
+   */
+  std::vector<int> cells_;
+
+  /*! \brief Increment a counter, without an atomic read-modify-write. */
+  static void increment_(uint64_t* counter) {
+    __atomic_store_n(counter, __atomic_load_n(counter, __ATOMIC_RELAXED) + 1,
+                     __ATOMIC_RELAXED);
+  }
+
+ public:
+  /*! \brief The code profiled. */
+  const classfile::CodeAttr* codeAttr;
+
+  /*! \brief Profiles of the conditional branches, in the order of the code. */
+  std::vector<BranchProfile> branches;
+
+  /*! \brief Profiles of the switches, in the order of the code. */
+  std::vector<SwitchProfile> switches;
+
+  /*! \brief Profiles of the virtual and interface call sites. */
+  std::vector<ReceiverProfile> receivers;
+
+  /*!
+   * \brief Default constructor. Lay out the cells of a code.
+   * \param codeAttr The code. It must be verified.
+   */
+  explicit MethodData(const classfile::CodeAttr* codeAttr);
+
+  /*!
+   * \brief Get the MethodData of a code, and allocate it if the code is warm.
+   * \param codeAttr The code. It must be verified.
+   * \param threshold The number of invocations and backedges of a warm code.
+   * \return The MethodData, owned by the code. nullptr if it is not warm yet.
+   */
+  static MethodData* allocate(classfile::CodeAttr* codeAttr,
+                              uint64_t threshold);
+
+  /*!
+   * \brief Count a conditional branch. The engine binds the profile of a
+   * branch to its instruction, so it is passed directly.
+   * \param profile The profile of the branch.
+   * \param taken Whether it is taken.
+   */
+  static void countBranch(BranchProfile* profile, bool taken) {
+    increment_(taken ? &profile->taken : &profile->notTaken);
+  }
+
+  /*!
+   * \brief Count the case of a switch a key goes to.
+   * \param pc The pc of the switch.
+   * \param key The key.
+   */
+  void countSwitch(int pc, int key);
+
+  /*!
+   * \brief Count the class of a receiver at a call site.
+   * \param pc The pc of the call site.
+   * \param receiverClass The class of the receiver.
+   */
+  void countReceiver(int pc, const rtda::Class* receiverClass);
+
+  /*!
+   * \brief Get the profile of a branch.
+   * \param pc The pc of the branch.
+   * \return The profile. nullptr if it is not a profiled branch.
+   */
+  const BranchProfile* branchAt(int pc) const;
+
+  /*!
+   * \brief Get the profile of a switch.
+   * \param pc The pc of the switch.
+   * \return The profile. nullptr if it is not a switch.
+   */
+  const SwitchProfile* switchAt(int pc) const;
+
+  /*!
+   * \brief Get the profile of a call site.
+   * \param pc The pc of the call site.
+   * \return The profile. nullptr if it is not a virtual call site.
+   */
+  const ReceiverProfile* receiverAt(int pc) const;
+};
+
+/*!
+ * \brief The name and the descriptor of the method of a code, e.g. "main()I".
+ * "<unknown>" if the code is not of a method of a class file.
+ */
+std::string methodName(const classfile::CodeAttr* codeAttr);
+
+/*!
+ * \brief Print the hottest methods, by invocations and backedges, and the
+ * hottest branches, switches and call sites of their profiles, e.g.
+ * "main()I pc 12: 99 taken, 1 not taken".
+ * \param codes The codes.
+ * \param os The stream.
+ * \param limit Max number of lines of each part.
+ */
+void dumpProfiles(const std::vector<const classfile::CodeAttr*>& codes,
+                  std::ostream& os, int limit = 10);
+
+}  // namespace vm
+
+}  // namespace coconut
+
+#endif  // SRC_VM_METHOD_DATA_H_
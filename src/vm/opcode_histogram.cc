@@ -0,0 +1,59 @@
+/*!
+ *    ________  ________  ________  ________  ________   ___  ___  _________
+ *   |\   ____\|\   __  \|\   ____\|\   __  \|\   ___  \|\  \|\  \|\___   ___\
+ *   \ \  \___|\ \  \|\  \ \  \___|\ \  \|\  \ \  \\ \  \ \  \\\  \|___ \  \_|
+ *    \ \  \    \ \  \\\  \ \  \    \ \  \\\  \ \  \\ \  \ \  \\\  \   \ \  \
+ *     \ \  \____\ \  \\\  \ \  \____\ \  \\\  \ \  \\ \  \ \  \\\  \   \ \  \
+ *      \ \_______\ \_______\ \_______\ \_______\ \__\\ \__\ \_______\   \ \__\
+ *       \|_______|\|_______|\|_______|\|_______|\|__| \|__|\|_______|    \|__|
+ *
+ * \file src/vm/opcode_histogram.cc
+ * \brief Implementation of opcode_histogram.h
+ * \author SiriusNEO
+ */
+
+#include "opcode_histogram.h"
+
+#include <algorithm>
+#include <cstring>
+#include <vector>
+
+#include "superinstructions.h"
+
+namespace coconut {
+
+namespace vm {
+
+OpcodePairHistogram::OpcodePairHistogram() : last_(-1) {
+  std::memset(counts_, 0, sizeof(counts_));
+}
+
+void OpcodePairHistogram::record(uint8_t opcode) {
+  uint8_t canonical = canonicalOpcode(opcode);
+  if (last_ >= 0) {
+    ++counts_[last_][canonical];
+  }
+  last_ = canonical;
+}
+
+void OpcodePairHistogram::dump(FILE* file) const {
+  std::vector<int> pairs;
+  for (int i = 0; i < 256 * 256; ++i) {
+    if (counts_[i >> 8][i & 0xff] > 0) {
+      pairs.push_back(i);
+    }
+  }
+  std::sort(pairs.begin(), pairs.end(), [this](int a, int b) {
+    return counts_[a >> 8][a & 0xff] > counts_[b >> 8][b & 0xff];
+  });
+
+  fprintf(file, "# first second count\n");
+  for (int pair : pairs) {
+    fprintf(file, "0x%02x 0x%02x %llu\n", pair >> 8, pair & 0xff,
+            static_cast<unsigned long long>(counts_[pair >> 8][pair & 0xff]));
+  }
+}
+
+}  // namespace vm
+
+}  // namespace coconut
@@ -0,0 +1,75 @@
+/*!
+ *    ________  ________  ________  ________  ________   ___  ___  _________
+ *   |\   ____\|\   __  \|\   ____\|\   __  \|\   ___  \|\  \|\  \|\___   ___\
+ *   \ \  \___|\ \  \|\  \ \  \___|\ \  \|\  \ \  \\ \  \ \  \\\  \|___ \  \_|
+ *    \ \  \    \ \  \\\  \ \  \    \ \  \\\  \ \  \\ \  \ \  \\\  \   \ \  \
+ *     \ \  \____\ \  \\\  \ \  \____\ \  \\\  \ \  \\ \  \ \  \\\  \   \ \  \
+ *      \ \_______\ \_______\ \_______\ \_______\ \__\\ \__\ \_______\   \ \__\
+ *       \|_______|\|_______|\|_______|\|_______|\|__| \|__|\|_______|    \|__|
+ *
+ * \file src/vm/opcode_histogram.h
+ * \brief Histogram of executed opcode pairs.
+ * \author SiriusNEO
+ */
+
+#ifndef SRC_VM_OPCODE_HISTOGRAM_H_
+#define SRC_VM_OPCODE_HISTOGRAM_H_
+
+#include <cstdint>
+#include <cstdio>
+
+namespace coconut {
+
+namespace vm {
+
+/*!
+ * \brief Counts of adjacent executed opcode pairs.
+ *
+ * Opcodes are recorded in canonical form (see canonicalOpcode()). The dump is
+ * the input of scripts/gen_superinstructions.py, which regenerates the
+ * superinstruction table from it.
+ */
+class OpcodePairHistogram {
+ private:
+  /*! \brief counts_[first][second]. */
+  uint64_t counts_[256][256];
+
+  /*! \brief The last recorded opcode. -1 if none. */
+  int last_;
+
+ public:
+  /*! \brief Default constructor. All counts are zero. */
+  OpcodePairHistogram();
+
+  /*!
+   * \brief Record an executed opcode, counting the pair (last, opcode).
+   * \param opcode The opcode.
+   */
+  void record(uint8_t opcode);
+
+  /*! \brief Start a new sequence, e.g. when entering another method. */
+  void breakSequence() { last_ = -1; }
+
+  /*!
+   * \brief Get the count of a pair.
+   * \param first The first opcode (canonical).
+   * \param second The second opcode (canonical).
+   * \return The count.
+   */
+  uint64_t count(uint8_t first, uint8_t second) const {
+    return counts_[first][second];
+  }
+
+  /*!
+   * \brief Dump the non-zero pairs, one "first second count" line per pair,
+   * in descending order of counts.
+   * \param file The output file.
+   */
+  void dump(FILE* file) const;
+};
+
+}  // namespace vm
+
+}  // namespace coconut
+
+#endif  // SRC_VM_OPCODE_HISTOGRAM_H_
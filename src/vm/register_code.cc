@@ -0,0 +1,367 @@
+/*!
+ *    ________  ________  ________  ________  ________   ___  ___  _________
+ *   |\   ____\|\   __  \|\   ____\|\   __  \|\   ___  \|\  \|\  \|\___   ___\
+ *   \ \  \___|\ \  \|\  \ \  \___|\ \  \|\  \ \  \\ \  \ \  \\\  \|___ \  \_|
+ *    \ \  \    \ \  \\\  \ \  \    \ \  \\\  \ \  \\ \  \ \  \\\  \   \ \  \
+ *     \ \  \____\ \  \\\  \ \  \____\ \  \\\  \ \  \\ \  \ \  \\\  \   \ \  \
+ *      \ \_______\ \_______\ \_______\ \_______\ \__\\ \__\ \_______\   \ \__\
+ *       \|_______|\|_______|\|_______|\|_______|\|__| \|__|\|_______|    \|__|
+ *
+ * \file src/vm/register_code.cc
+ * \brief Implementation of register_code.h
+ * \author SiriusNEO
+ */
+
+#include "register_code.h"
+
+namespace coconut {
+
+namespace vm {
+
+// JVM opcodes of the binary int operations, in the order of REG_BINARY_OPS.
+static const uint8_t kBinaryOpcodes[] = {0x60, 0x64, 0x68, 0x6c, 0x70, 0x78,
+                                         0x7a, 0x7c, 0x7e, 0x80, 0x82};
+
+// Index of an opcode in kBinaryOpcodes. -1 if it is not a binary int op.
+static int binaryIndex(uint8_t opcode) {
+  for (int i = 0; i < int(sizeof(kBinaryOpcodes)); ++i) {
+    if (kBinaryOpcodes[i] == opcode) return i;
+  }
+  return -1;
+}
+
+// Whether the binary op (index in kBinaryOpcodes) is commutative.
+static bool isCommutative(int index) {
+  uint8_t opcode = kBinaryOpcodes[index];
+  return opcode == 0x60 || opcode == 0x68 || opcode == 0x7e ||
+         opcode == 0x80 || opcode == 0x82;
+}
+
+// The condition (index in REG_CONDS) of b op a, given the one of a op b.
+static const int kSwappedConds[] = {0, 1, 4, 5, 2, 3};
+
+// Stack effect of a supported (canonical) opcode. Return false if the opcode
+// is not supported.
+static bool stackEffect(uint8_t opcode, int& pops, int& pushes) {
+  pops = pushes = 0;
+  if (binaryIndex(opcode) >= 0) {
+    pops = 2, pushes = 1;
+    return true;
+  }
+  switch (opcode) {
+    case 0x00:  // nop
+    case 0x84:  // iinc
+    case 0xa7:  // goto
+    case 0xb1:  // return
+      return true;
+    case 0x10:  // iconst, bipush, sipush
+    case 0x15:  // iload
+      pushes = 1;
+      return true;
+    case 0x36:  // istore
+    case 0x57:  // pop
+    case 0xac:  // ireturn
+      pops = 1;
+      return true;
+    case 0x59:  // dup
+      pops = 1, pushes = 2;
+      return true;
+    case 0x74:  // ineg
+      pops = 1, pushes = 1;
+      return true;
+    default:
+      break;
+  }
+  if (opcode >= 0x99 && opcode <= 0x9e) {  // if<cond>
+    pops = 1;
+    return true;
+  }
+  if (opcode >= 0x9f && opcode <= 0xa4) {  // if_icmp<cond>
+    pops = 2;
+    return true;
+  }
+  return false;
+}
+
+// Whether the control never falls through to the next instruction.
+static bool isTerminal(uint8_t opcode) {
+  return opcode == 0xa7 || opcode == 0xac || opcode == 0xb1;
+}
+
+RegisterCode::RegisterCode(classfile::CodeAttr* codeAttr, ThreadedCode* code)
+    : pcToIndex_(codeAttr->codeLen, -1),
+      maxLocals(code->maxLocals),
+      numRegs(code->maxLocals + rtda::kFrameSlots + code->maxStack),
+      supported(false),
+      numBytecodes(0),
+      linked(false) {
+  // TODO: exception handlers enter with a fresh stack, not supported yet.
+  if (!codeAttr->exceptionTable.empty()) return;
+
+  std::vector<int> depths;
+  if (!computeDepths_(code, depths)) return;
+
+  translate_(code, depths);
+  supported = true;
+}
+
+bool RegisterCode::computeDepths_(ThreadedCode* code,
+                                  std::vector<int>& depths) {
+  const std::vector<ThreadedInst>& src = code->insts;
+  depths.assign(src.size(), -1);
+  std::vector<int> worklist = {0};
+  depths[0] = 0;
+
+  while (!worklist.empty()) {
+    int i = worklist.back();
+    worklist.pop_back();
+
+    uint8_t opcode = canonicalOpcode(src[i].opcode);
+    int pops, pushes;
+    if (!stackEffect(opcode, pops, pushes) || depths[i] < pops) return false;
+    int depth = depths[i] - pops + pushes;
+    if (depth > code->maxStack) return false;
+
+    std::vector<int> successors;
+    if (!isTerminal(opcode)) {
+      if (size_t(i + 1) >= src.size()) return false;  // falls off the code
+      successors.push_back(i + 1);
+    }
+    if (src[i].target != nullptr) {
+      successors.push_back(src[i].target - src.data());
+    }
+    for (int next : successors) {
+      if (depths[next] < 0) {
+        depths[next] = depth;
+        worklist.push_back(next);
+      } else if (depths[next] != depth) {
+        return false;  // inconsistent stack, leave it to the verifier
+      }
+    }
+  }
+  return true;
+}
+
+void RegisterCode::translate_(ThreadedCode* code,
+                              const std::vector<int>& depths) {
+  const std::vector<ThreadedInst>& src = code->insts;
+
+  // blocks start at pc 0 and at branch targets
+  std::vector<bool> leaders(src.size(), false);
+  leaders[0] = true;
+  for (const auto& inst : src) {
+    if (inst.target != nullptr) leaders[inst.target - src.data()] = true;
+  }
+
+  // symbolic operand stack: a register or an immediate
+  struct Entry {
+    bool isImm;
+    int value;
+  };
+  std::vector<Entry> stack;
+  std::vector<int> blockStarts(src.size(), -1);
+  std::vector<std::pair<int, int>> branches;  // (register inst, bytecode inst)
+  // the last inst writing a stack slot as its result, for store forwarding
+  int lastResult = -1;
+  const ThreadedInst* cur = nullptr;
+
+  auto stackReg = [this](int depth) {
+    return int(maxLocals + rtda::kFrameSlots) + depth;
+  };
+
+  auto emit = [&](uint8_t opcode, int dst, int src1, int src2) {
+    RegInst inst;
+    inst.handler = nullptr;
+    inst.opcode = opcode;
+    inst.pc = cur->pc;
+    inst.dst = dst;
+    inst.src1 = src1;
+    inst.src2 = src2;
+    inst.target = nullptr;
+    insts.push_back(inst);
+  };
+
+  // write the entry at some depth to its stack slot
+  auto materialize = [&](int depth) {
+    Entry& entry = stack[depth];
+    if (entry.isImm) {
+      emit(kReg_movi, stackReg(depth), entry.value, 0);
+    } else if (entry.value != stackReg(depth)) {
+      emit(kReg_mov, stackReg(depth), entry.value, 0);
+    } else {
+      return;
+    }
+    entry.isImm = false;
+    entry.value = stackReg(depth);
+  };
+
+  auto flush = [&]() {
+    for (size_t depth = 0; depth < stack.size(); ++depth) materialize(depth);
+  };
+
+  // write out the entries reading a local before it changes
+  auto invalidate = [&](int local) {
+    for (size_t depth = 0; depth < stack.size(); ++depth) {
+      if (!stack[depth].isImm && stack[depth].value == local) {
+        materialize(depth);
+      }
+    }
+  };
+
+  // get an operand in a register, using the stack slot at depth if needed
+  auto inRegister = [&](Entry entry, int depth) {
+    if (!entry.isImm) return entry.value;
+    emit(kReg_movi, stackReg(depth), entry.value, 0);
+    return stackReg(depth);
+  };
+
+  auto pop = [&]() {
+    Entry entry = stack.back();
+    stack.pop_back();
+    return entry;
+  };
+
+  bool fallsThrough = false;
+  for (size_t i = 0; i < src.size(); ++i) {
+    if (depths[i] < 0) continue;  // unreachable
+    cur = &src[i];
+    uint8_t opcode = canonicalOpcode(cur->opcode);
+    ++numBytecodes;
+
+    if (leaders[i]) {
+      if (fallsThrough) flush();
+      stack.assign(depths[i], Entry{false, 0});
+      for (int depth = 0; depth < depths[i]; ++depth) {
+        stack[depth].value = stackReg(depth);
+      }
+      blockStarts[i] = insts.size();
+      pcToIndex_[cur->pc] = insts.size();
+      lastResult = -1;
+    }
+    fallsThrough = !isTerminal(opcode);
+
+    int binary = binaryIndex(opcode);
+    if (binary >= 0) {
+      Entry value2 = pop(), value1 = pop();
+      int depth = stack.size();
+      if (value1.isImm && !value2.isImm && isCommutative(binary)) {
+        std::swap(value1, value2);
+      }
+      int src1 = inRegister(value1, depth);
+      if (value2.isImm) {
+        emit(kReg_iadd_ri + 2 * binary, stackReg(depth), src1, value2.value);
+      } else {
+        emit(kReg_iadd_rr + 2 * binary, stackReg(depth), src1, value2.value);
+      }
+      stack.push_back(Entry{false, stackReg(depth)});
+      lastResult = insts.size() - 1;
+      continue;
+    }
+
+    if (opcode >= 0x99 && opcode <= 0xa4) {
+      Entry value2 = opcode >= 0x9f ? pop() : Entry{true, 0};
+      Entry value1 = pop();
+      int depth = stack.size();
+      int cond = opcode >= 0x9f ? opcode - 0x9f : opcode - 0x99;
+      flush();
+      if (value1.isImm && !value2.isImm) {
+        std::swap(value1, value2);
+        cond = kSwappedConds[cond];
+      }
+      int src1 = inRegister(value1, depth);
+      if (value2.isImm) {
+        emit(kReg_if_eq_ri + 2 * cond, 0, src1, value2.value);
+      } else {
+        emit(kReg_if_eq_rr + 2 * cond, 0, src1, value2.value);
+      }
+      branches.emplace_back(insts.size() - 1, cur->target - src.data());
+      lastResult = -1;
+      continue;
+    }
+
+    switch (opcode) {
+      case 0x00:  // nop
+        break;
+      case 0x10:  // iconst, bipush, sipush
+        stack.push_back(Entry{true, cur->operand1});
+        break;
+      case 0x15:  // iload
+        stack.push_back(Entry{false, cur->operand1});
+        break;
+      case 0x36: {  // istore
+        Entry value = pop();
+        int local = cur->operand1;
+        bool forward = !value.isImm && lastResult >= 0 &&
+                       size_t(lastResult) == insts.size() - 1 &&
+                       insts.back().dst == value.value;
+        // neither the local nor the result (after a dup) may stay on the stack
+        for (const Entry& entry : stack) {
+          if (!entry.isImm &&
+              (entry.value == local || entry.value == value.value)) {
+            forward = false;
+          }
+        }
+        invalidate(local);
+        if (forward) {
+          insts.back().dst = local;
+        } else {
+          emit(value.isImm ? kReg_movi : kReg_mov, local, value.value, 0);
+        }
+        lastResult = -1;
+        break;
+      }
+      case 0x57:  // pop
+        pop();
+        break;
+      case 0x59:  // dup
+        stack.push_back(stack.back());
+        break;
+      case 0x74: {  // ineg
+        Entry value = pop();
+        int depth = stack.size();
+        if (value.isImm) {
+          stack.push_back(Entry{true, int(0u - (unsigned int)(value.value))});
+          break;
+        }
+        emit(kReg_ineg, stackReg(depth), value.value, 0);
+        stack.push_back(Entry{false, stackReg(depth)});
+        lastResult = insts.size() - 1;
+        break;
+      }
+      case 0x84:  // iinc
+        invalidate(cur->operand1);
+        emit(kReg_iadd_ri, cur->operand1, cur->operand1, cur->operand2);
+        lastResult = -1;
+        break;
+      case 0xa7:  // goto
+        flush();
+        emit(kReg_goto, 0, 0, 0);
+        branches.emplace_back(insts.size() - 1, cur->target - src.data());
+        break;
+      case 0xac: {  // ireturn
+        Entry value = pop();
+        emit(value.isImm ? kReg_ireturn_i : kReg_ireturn_r, 0, value.value,
+             0);
+        break;
+      }
+      case 0xb1:  // return
+        emit(kReg_return, 0, 0, 0);
+        break;
+      default:
+        LOG(FATAL) << "Unexpected opcode in register translation: 0x"
+                   << std::hex << int(opcode);
+    }
+  }
+
+  // insts does not grow any more, so the pointers are stable
+  for (const auto& branch : branches) {
+    int start = blockStarts[branch.second];
+    CHECK(start >= 0 && size_t(start) < insts.size())
+        << "Bad branch target in register code";
+    insts[branch.first].target = &insts[start];
+  }
+}
+
+}  // namespace vm
+
+}  // namespace coconut
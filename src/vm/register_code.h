@@ -0,0 +1,194 @@
+/*!
+ *    ________  ________  ________  ________  ________   ___  ___  _________
+ *   |\   ____\|\   __  \|\   ____\|\   __  \|\   ___  \|\  \|\  \|\___   ___\
+ *   \ \  \___|\ \  \|\  \ \  \___|\ \  \|\  \ \  \\ \  \ \  \\\  \|___ \  \_|
+ *    \ \  \    \ \  \\\  \ \  \    \ \  \\\  \ \  \\ \  \ \  \\\  \   \ \  \
+ *     \ \  \____\ \  \\\  \ \  \____\ \  \\\  \ \  \\ \  \ \  \\\  \   \ \  \
+ *      \ \_______\ \_______\ \_______\ \_______\ \__\\ \__\ \_______\   \ \__\
+ *       \|_______|\|_______|\|_______|\|_______|\|__| \|__|\|_______|    \|__|
+ *
+ * \file src/vm/register_code.h
+ * \brief Register-based form of the code, translated from the stack form.
+ * \author SiriusNEO
+ */
+
+#ifndef SRC_VM_REGISTER_CODE_H_
+#define SRC_VM_REGISTER_CODE_H_
+
+#include "../rtda/vmstack/jvm_stack.h"
+#include "threaded_code.h"
+
+namespace coconut {
+
+namespace vm {
+
+// Binary int operations, in the order of their JVM opcodes.
+#define REG_BINARY_OPS(X) \
+  X(iadd)                 \
+  X(isub)                 \
+  X(imul)                 \
+  X(idiv)                 \
+  X(irem)                 \
+  X(ishl)                 \
+  X(ishr)                 \
+  X(iushr)                \
+  X(iand)                 \
+  X(ior)                  \
+  X(ixor)
+
+// Conditions of int comparisons, in the order of their JVM opcodes.
+#define REG_CONDS(X) \
+  X(eq)              \
+  X(ne)              \
+  X(lt)              \
+  X(ge)              \
+  X(gt)              \
+  X(le)
+
+/*!
+ * \brief Opcodes of the register instructions.
+ *
+ * Operands are register numbers or immediates. The suffix tells the kinds of
+ * the sources: _rr is reg op reg, _ri is reg op immediate.
+ */
+enum RegOpcode : uint8_t {
+  /*! \brief dst = src1 (register). */
+  kReg_mov,
+  /*! \brief dst = src1 (immediate). */
+  kReg_movi,
+  /*! \brief dst = -src1. */
+  kReg_ineg,
+#define X(name) kReg_##name##_rr, kReg_##name##_ri,
+  REG_BINARY_OPS(X)
+#undef X
+#define X(cond) kReg_if_##cond##_rr, kReg_if_##cond##_ri,
+  REG_CONDS(X)
+#undef X
+  /*! \brief Jump to target. */
+  kReg_goto,
+  /*! \brief Return src1 (register). */
+  kReg_ireturn_r,
+  /*! \brief Return src1 (immediate). */
+  kReg_ireturn_i,
+  /*! \brief Return void. */
+  kReg_return,
+  kRegOpcodeEnd
+};
+
+/*!
+ * \brief A three-address instruction over the registers of a frame.
+ *
+ * Registers are slots counted from the first local of the frame: registers
+ * [0, maxLocals) are the local variables and register maxLocals +
+ * rtda::kFrameSlots + d is the operand stack slot at depth d (see
+ * rtda::StackFrame for the layout).
+ */
+struct RegInst {
+  /*! \brief The address of the handler, bound by the engine. */
+  const void* handler;
+
+  /*! \brief The opcode, see RegOpcode. */
+  uint8_t opcode;
+
+  /*! \brief The pc of the bytecode instruction it comes from. */
+  int pc;
+
+  /*! \brief The destination register. */
+  int dst;
+
+  /*! \brief The first source: a register, or an immediate of movi/ireturn_i. */
+  int src1;
+
+  /*! \brief The second source: a register (_rr) or an immediate (_ri). */
+  int src2;
+
+  /*! \brief The branch target. nullptr if it is not a branch. */
+  RegInst* target;
+};
+
+/*!
+ * \brief Register-based form of a CodeAttr.
+ *
+ * The stack code is translated by simulating the operand stack with symbolic
+ * entries: a load or a constant pushes the local or the immediate itself
+ * instead of copying it, and an operation reads its sources from there and
+ * writes the stack slot of its result. A store right after an operation
+ * retargets the result to the local. So "iload_1; iload_2; iadd; istore_3"
+ * becomes a single "r3 = r1 + r2", and most loads, constants and stores do not
+ * need a dispatch at all.
+ *
+ * Entries are written to their stack slots before a branch and at a branch
+ * target, so the stack is in the same (real) state at every block boundary,
+ * whichever way the block is reached. An entry reading a local is also written
+ * out before the local is changed.
+ *
+ * Only int code is translated for now: constants, loads/stores, arithmetic,
+ * iinc, pop/dup, comparisons and branches, ireturn and return. Code with other
+ * instructions or with an exception table is not supported (see supported),
+ * and is left to the stack engines.
+ */
+class RegisterCode {
+ private:
+  /*! \brief Map from pc to the first instruction of a block. -1 if none. */
+  std::vector<int> pcToIndex_;
+
+  /*!
+   * \brief Compute the operand stack depth before each instruction.
+   * \param code The threaded code, for the decoded instructions.
+   * \param depths The depths. -1 if the instruction is unreachable.
+   * \return Whether all reachable instructions are supported.
+   */
+  bool computeDepths_(ThreadedCode* code, std::vector<int>& depths);
+
+  /*!
+   * \brief Translate the reachable instructions.
+   * \param code The threaded code.
+   * \param depths The depths from computeDepths_().
+   */
+  void translate_(ThreadedCode* code, const std::vector<int>& depths);
+
+ public:
+  /*! \brief Max number of local variables. */
+  uint16_t maxLocals;
+
+  /*!
+   * \brief Number of registers: locals, the frame record, then operand stack
+   * slots.
+   */
+  int numRegs;
+
+  /*! \brief Whether the code is translated. If not, insts is empty. */
+  bool supported;
+
+  /*! \brief Number of reachable bytecode instructions translated. */
+  int numBytecodes;
+
+  /*! \brief The instructions. */
+  std::vector<RegInst> insts;
+
+  /*! \brief Whether the handlers have been bound by the engine. */
+  bool linked;
+
+  /*!
+   * \brief Default constructor. Translate the code into register code.
+   * \param codeAttr The code, for its exception table.
+   * \param code The threaded code of it, without superinstructions.
+   */
+  RegisterCode(classfile::CodeAttr* codeAttr, ThreadedCode* code);
+
+  /*!
+   * \brief Get the first instruction at some pc.
+   * \param pc The pc. It must be the start of a block (e.g. 0).
+   * \return The pointer of the instruction.
+   */
+  RegInst* at(int pc) {
+    CHECK(pcToIndex_[pc] >= 0) << "Not a block start of register code: " << pc;
+    return &insts[pcToIndex_[pc]];
+  }
+};
+
+}  // namespace vm
+
+}  // namespace coconut
+
+#endif  // SRC_VM_REGISTER_CODE_H_
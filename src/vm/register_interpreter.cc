@@ -0,0 +1,223 @@
+/*!
+ *    ________  ________  ________  ________  ________   ___  ___  _________
+ *   |\   ____\|\   __  \|\   ____\|\   __  \|\   ___  \|\  \|\  \|\___   ___\
+ *   \ \  \___|\ \  \|\  \ \  \___|\ \  \|\  \ \  \\ \  \ \  \\\  \|___ \  \_|
+ *    \ \  \    \ \  \\\  \ \  \    \ \  \\\  \ \  \\ \  \ \  \\\  \   \ \  \
+ *     \ \  \____\ \  \\\  \ \  \____\ \  \\\  \ \  \\ \  \ \  \\\  \   \ \  \
+ *      \ \_______\ \_______\ \_______\ \_______\ \__\\ \__\ \_______\   \ \__\
+ *       \|_______|\|_______|\|_______|\|_______|\|__| \|__|\|_______|    \|__|
+ *
+ * \file src/vm/register_interpreter.cc
+ * \brief Implementation of register_interpreter.h
+ * \author SiriusNEO
+ */
+
+#include "register_interpreter.h"
+
+#if !defined(__GNUC__)
+#error "RegisterInterpreter requires computed goto (GCC or Clang)."
+#endif
+
+namespace coconut {
+
+namespace vm {
+
+RegisterInterpreter::~RegisterInterpreter() {
+  for (auto& entry : registerCache_) {
+    delete entry.second;
+  }
+}
+
+RegisterCode* RegisterInterpreter::translateRegisters(
+    classfile::CodeAttr* codeAttr) {
+  RegisterCode*& code = registerCache_[codeAttr];
+  if (code == nullptr) {
+    ThreadedCode stackCode(codeAttr, false);
+    code = new RegisterCode(codeAttr, &stackCode);
+    LOG(INFO) << "Register code: " << code->numBytecodes << " bytecodes -> "
+              << code->insts.size() << " insts"
+              << (code->supported ? "" : " (not supported)");
+  }
+  return code;
+}
+
+void RegisterInterpreter::execute(rtda::Thread* thread,
+                                  classfile::CodeAttr* codeAttr) {
+  thread->stack.topFrame->code = codeAttr;
+  // unverified code is left to the checked path of the base engine
+  if (__atomic_load_n(&codeAttr->verifyStatus, __ATOMIC_ACQUIRE) !=
+      classfile::kVerifyPassed) {
+    ThreadedInterpreter::execute(thread, codeAttr);
+    return;
+  }
+  RegisterCode* code = translateRegisters(codeAttr);
+  if (code->supported) {
+    run_(thread, code);
+  } else {
+    ThreadedInterpreter::execute(thread, codeAttr);
+  }
+}
+
+// An int register.
+#define R(index) (*(int*)(&regs[(index)].bytes))
+
+#define DISPATCH() goto* ip->handler
+
+#define NEXT()  \
+  do {          \
+    ++ip;       \
+    DISPATCH(); \
+  } while (0)
+
+#define BRANCH_IF(cond) \
+  {                     \
+    if (cond) {         \
+      ip = ip->target;  \
+      DISPATCH();       \
+    }                   \
+    NEXT();             \
+  }
+
+// Binary operation, in both forms: dst = src1 op src2 (register/immediate).
+#define BINARY_OP(name, expr)                       \
+  R_##name##_rr : {                                 \
+    int value1 = R(ip->src1), value2 = R(ip->src2); \
+    R(ip->dst) = (expr);                            \
+    NEXT();                                         \
+  }                                                 \
+  R_##name##_ri : {                                 \
+    int value1 = R(ip->src1), value2 = ip->src2;    \
+    R(ip->dst) = (expr);                            \
+    NEXT();                                         \
+  }
+
+// Division, in both forms. A zero divisor throws ArithmeticException, and a
+// divisor of -1 gives the overflow result (INT_MIN / -1 traps on x86).
+#define DIVISION_OP(name, expr, minusOne)            \
+  R_##name##_rr : {                                  \
+    int value1 = R(ip->src1), value2 = R(ip->src2);  \
+    if (value2 == 0) goto R_divide_by_zero;          \
+    R(ip->dst) = value2 == -1 ? (minusOne) : (expr); \
+    NEXT();                                          \
+  }                                                  \
+  R_##name##_ri : {                                  \
+    int value1 = R(ip->src1), value2 = ip->src2;     \
+    if (value2 == 0) goto R_divide_by_zero;          \
+    R(ip->dst) = value2 == -1 ? (minusOne) : (expr); \
+    NEXT();                                          \
+  }
+
+// Comparison and branch, in both forms.
+#define COMPARE_OP(cond, op)                                \
+  R_if_##cond##_rr : BRANCH_IF(R(ip->src1) op R(ip->src2)); \
+  R_if_##cond##_ri : BRANCH_IF(R(ip->src1) op ip->src2);
+
+void RegisterInterpreter::run_(rtda::Thread* thread, RegisterCode* code) {
+  static const void* handlers[kRegOpcodeEnd];
+  // filled once, by the first thread to get here (see ThreadedInterpreter)
+  static const bool handlersReady = ({
+    handlers[kReg_mov] = &&R_mov;
+    handlers[kReg_movi] = &&R_movi;
+    handlers[kReg_ineg] = &&R_ineg;
+#define X(name)                                 \
+  handlers[kReg_##name##_rr] = &&R_##name##_rr; \
+  handlers[kReg_##name##_ri] = &&R_##name##_ri;
+    REG_BINARY_OPS(X)
+#undef X
+#define X(cond)                                       \
+  handlers[kReg_if_##cond##_rr] = &&R_if_##cond##_rr; \
+  handlers[kReg_if_##cond##_ri] = &&R_if_##cond##_ri;
+    REG_CONDS(X)
+#undef X
+    handlers[kReg_goto] = &&R_goto;
+    handlers[kReg_ireturn_r] = &&R_ireturn_r;
+    handlers[kReg_ireturn_i] = &&R_ireturn_i;
+    handlers[kReg_return] = &&R_return;
+    true;
+  });
+  (void)handlersReady;
+
+  if (!code->linked) {
+    for (auto& inst : code->insts) {
+      inst.handler = handlers[inst.opcode];
+    }
+    code->linked = true;
+  }
+
+  // the register file is the frame itself: locals, the frame record, then
+  // operand stack slots (see RegInst)
+  rtda::StackFrame* frame = thread->stack.topFrame;
+  rtda::Slot* regs = frame->localVariableTable->slots();
+  RegInst* ip = code->at(frame->nextPc);
+  int value;
+
+  DISPATCH();
+
+R_mov:
+  regs[ip->dst] = regs[ip->src1];
+  NEXT();
+R_movi:
+  R(ip->dst) = ip->src1;
+  NEXT();
+R_ineg:
+  R(ip->dst) = int(0u - (unsigned int)(R(ip->src1)));
+  NEXT();
+
+  BINARY_OP(iadd, value1 + value2);
+  BINARY_OP(isub, value1 - value2);
+  BINARY_OP(imul, value1 * value2);
+  DIVISION_OP(idiv, value1 / value2, int(0u - value1));
+  DIVISION_OP(irem, value1 % value2, 0);
+  BINARY_OP(ishl, value1 << (value2 & 0x1f));
+  BINARY_OP(ishr, value1 >> (value2 & 0x1f));
+  BINARY_OP(iushr, int((unsigned int)(value1) >> (value2 & 0x1f)));
+  BINARY_OP(iand, value1 & value2);
+  BINARY_OP(ior, value1 | value2);
+  BINARY_OP(ixor, value1 ^ value2);
+
+  COMPARE_OP(eq, ==);
+  COMPARE_OP(ne, !=);
+  COMPARE_OP(lt, <);
+  COMPARE_OP(ge, >=);
+  COMPARE_OP(gt, >);
+  COMPARE_OP(le, <=);
+
+R_goto:
+  ip = ip->target;
+  DISPATCH();
+
+R_ireturn_r:
+  value = R(ip->src1);
+  goto R_ireturn;
+R_ireturn_i:
+  value = ip->src1;
+R_ireturn:
+  thread->stack.pop();
+  if (!thread->stack.isEmpty()) {
+    thread->stack.topFrame->operandStack->pushInt(value);
+  }
+  return;
+
+R_return:
+  thread->stack.pop();
+  return;
+
+R_divide_by_zero:
+  // no handlers in the code (see RegisterCode): the frame completes abruptly
+  frame->nextPc = ip->pc;
+  thread->exception = thread->raise(rtda::kArithmeticException);
+  thread->stack.pop();
+  return;
+}
+
+#undef R
+#undef DISPATCH
+#undef NEXT
+#undef BRANCH_IF
+#undef BINARY_OP
+#undef DIVISION_OP
+#undef COMPARE_OP
+
+}  // namespace vm
+
+}  // namespace coconut
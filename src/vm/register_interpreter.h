@@ -0,0 +1,79 @@
+/*!
+ *    ________  ________  ________  ________  ________   ___  ___  _________
+ *   |\   ____\|\   __  \|\   ____\|\   __  \|\   ___  \|\  \|\  \|\___   ___\
+ *   \ \  \___|\ \  \|\  \ \  \___|\ \  \|\  \ \  \\ \  \ \  \\\  \|___ \  \_|
+ *    \ \  \    \ \  \\\  \ \  \    \ \  \\\  \ \  \\ \  \ \  \\\  \   \ \  \
+ *     \ \  \____\ \  \\\  \ \  \____\ \  \\\  \ \  \\ \  \ \  \\\  \   \ \  \
+ *      \ \_______\ \_______\ \_______\ \_______\ \__\\ \__\ \_______\   \ \__\
+ *       \|_______|\|_______|\|_______|\|_______|\|__| \|__|\|_______|    \|__|
+ *
+ * \file src/vm/register_interpreter.h
+ * \brief Interpreter of the register-based code.
+ * \author SiriusNEO
+ */
+
+#ifndef SRC_VM_REGISTER_INTERPRETER_H_
+#define SRC_VM_REGISTER_INTERPRETER_H_
+
+#include "register_code.h"
+#include "threaded_interpreter.h"
+
+namespace coconut {
+
+namespace vm {
+
+/*!
+ * \brief Register-based Java Bytecode Interpreter.
+ *
+ * At the first invocation of a method, its code is translated into register
+ * code (see register_code.h), which needs far fewer dispatches than the stack
+ * code since most loads, constants and stores disappear into the operands of
+ * three-address instructions. It runs in a computed-goto loop like the
+ * threaded engine.
+ *
+ * The registers of a frame are its own slots in the stack arena: the local
+ * variables, then (past the frame record) the operand stack slots, so nothing
+ * is allocated or copied on entry. Methods which can not be translated run on
+ * the threaded engine instead.
+ */
+class RegisterInterpreter : public ThreadedInterpreter {
+ private:
+  /*! \brief Register code of each method. Owned by the interpreter. */
+  std::unordered_map<classfile::CodeAttr*, RegisterCode*> registerCache_;
+
+  /*!
+   * \brief The dispatch loop. Run until the top frame of the thread returns.
+   * \param thread The thread the interpreter runs.
+   * \param code The register code running in the thread.
+   */
+  void run_(rtda::Thread* thread, RegisterCode* code);
+
+ public:
+  /*!
+   * \brief Default constructor.
+   * \param superInstructions Whether the threaded engine fuses
+   * superinstructions, for the methods it runs.
+   */
+  explicit RegisterInterpreter(bool superInstructions = true)
+      : ThreadedInterpreter(superInstructions, false) {}
+
+  /*! \brief Default destructor. */
+  ~RegisterInterpreter();
+
+  /*!
+   * \brief Get the register code of a CodeAttr. Translate it at the first
+   * time.
+   * \param codeAttr The code.
+   * \return The register code, owned by the interpreter. It may be not
+   * supported.
+   */
+  RegisterCode* translateRegisters(classfile::CodeAttr* codeAttr);
+
+  void execute(rtda::Thread* thread, classfile::CodeAttr* codeAttr);
+};
+
+}  // namespace vm
+
+}  // namespace coconut
+
+#endif  // SRC_VM_REGISTER_INTERPRETER_H_
@@ -0,0 +1,53 @@
+/*!
+ *    ________  ________  ________  ________  ________   ___  ___  _________
+ *   |\   ____\|\   __  \|\   ____\|\   __  \|\   ___  \|\  \|\  \|\___   ___\
+ *   \ \  \___|\ \  \|\  \ \  \___|\ \  \|\  \ \  \\ \  \ \  \\\  \|___ \  \_|
+ *    \ \  \    \ \  \\\  \ \  \    \ \  \\\  \ \  \\ \  \ \  \\\  \   \ \  \
+ *     \ \  \____\ \  \\\  \ \  \____\ \  \\\  \ \  \\ \  \ \  \\\  \   \ \  \
+ *      \ \_______\ \_______\ \_______\ \_______\ \__\\ \__\ \_______\   \ \__\
+ *       \|_______|\|_______|\|_______|\|_______|\|__| \|__|\|_______|    \|__|
+ *
+ * \file src/vm/superinstructions.cc
+ * \brief Implementation of superinstructions.h
+ * \author SiriusNEO
+ */
+
+#include "superinstructions.h"
+
+namespace coconut {
+
+namespace vm {
+
+const SuperInstPattern kSuperInstPatterns[] = {
+#define SUPERINST(name, enabled, length, op1, op2, op3, op4) \
+  {#name, enabled, length, {op1, op2, op3, op4}, kSuper_##name},
+#include "superinstructions.def"
+#undef SUPERINST
+};
+
+const int kNumSuperInstPatterns =
+    sizeof(kSuperInstPatterns) / sizeof(SuperInstPattern);
+
+uint8_t canonicalOpcode(uint8_t opcode) {
+  // iconst_m1 ~ iconst_5, sipush
+  if ((opcode >= 0x02 && opcode <= 0x08) || opcode == 0x11) {
+    return 0x10;
+  }
+  // xload_n
+  if (opcode >= 0x1a && opcode <= 0x2d) {
+    return 0x15 + ((opcode - 0x1a) >> 2);
+  }
+  // xstore_n
+  if (opcode >= 0x3b && opcode <= 0x4e) {
+    return 0x36 + ((opcode - 0x3b) >> 2);
+  }
+  // goto_w
+  if (opcode == 0xc8) {
+    return 0xa7;
+  }
+  return opcode;
+}
+
+}  // namespace vm
+
+}  // namespace coconut
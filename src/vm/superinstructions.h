@@ -0,0 +1,83 @@
+/*!
+ *    ________  ________  ________  ________  ________   ___  ___  _________
+ *   |\   ____\|\   __  \|\   ____\|\   __  \|\   ___  \|\  \|\  \|\___   ___\
+ *   \ \  \___|\ \  \|\  \ \  \___|\ \  \|\  \ \  \\ \  \ \  \\\  \|___ \  \_|
+ *    \ \  \    \ \  \\\  \ \  \    \ \  \\\  \ \  \\ \  \ \  \\\  \   \ \  \
+ *     \ \  \____\ \  \\\  \ \  \____\ \  \\\  \ \  \\ \  \ \  \\\  \   \ \  \
+ *      \ \_______\ \_______\ \_______\ \_______\ \__\\ \__\ \_______\   \ \__\
+ *       \|_______|\|_______|\|_______|\|_______|\|__| \|__|\|_______|    \|__|
+ *
+ * \file src/vm/superinstructions.h
+ * \brief Superinstructions: common bytecode sequences fused into one.
+ * \author SiriusNEO
+ */
+
+#ifndef SRC_VM_SUPERINSTRUCTIONS_H_
+#define SRC_VM_SUPERINSTRUCTIONS_H_
+
+#include <cstdint>
+
+namespace coconut {
+
+namespace vm {
+
+/*!
+ * \brief Opcodes of superinstructions.
+ *
+ * They take the opcodes unused by the JVM specification, starting from 0xcb
+ * (the one after breakpoint), in the order of superinstructions.def.
+ */
+enum SuperOpcode : uint8_t {
+  kSuperOpcodeBegin = 0xca,
+#define SUPERINST(name, enabled, length, op1, op2, op3, op4) kSuper_##name,
+#include "superinstructions.def"
+#undef SUPERINST
+  kSuperOpcodeEnd
+};
+
+static_assert(kSuperOpcodeEnd <= 0xfe, "Too many superinstructions");
+
+/*! \brief The max number of instructions a superinstruction fuses. */
+#define MAX_SUPERINST_LENGTH 4
+
+/*! \brief A fusible sequence of instructions. */
+struct SuperInstPattern {
+  /*! \brief The name, for logging. */
+  const char* name;
+
+  /*! \brief Whether the translator fuses this pattern. */
+  bool enabled;
+
+  /*! \brief Number of instructions in the pattern. */
+  int length;
+
+  /*! \brief The canonical opcodes of the sequence. */
+  uint8_t opcodes[MAX_SUPERINST_LENGTH];
+
+  /*! \brief The opcode of the superinstruction. */
+  uint8_t superOpcode;
+};
+
+/*! \brief All patterns, in the order of superinstructions.def. */
+extern const SuperInstPattern kSuperInstPatterns[];
+
+/*! \brief Number of patterns. */
+extern const int kNumSuperInstPatterns;
+
+/*!
+ * \brief Map an opcode to its canonical form, so that instructions with the
+ * same semantics are counted and matched together.
+ *
+ * xload_n -> xload, xstore_n -> xstore, iconst_x/sipush -> bipush,
+ * goto_w -> goto. Other opcodes are unchanged.
+ *
+ * \param opcode The opcode.
+ * \return The canonical opcode.
+ */
+uint8_t canonicalOpcode(uint8_t opcode);
+
+}  // namespace vm
+
+}  // namespace coconut
+
+#endif  // SRC_VM_SUPERINSTRUCTIONS_H_
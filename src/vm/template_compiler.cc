@@ -0,0 +1,534 @@
+/*!
+ *    ________  ________  ________  ________  ________   ___  ___  _________
+ *   |\   ____\|\   __  \|\   ____\|\   __  \|\   ___  \|\  \|\  \|\___   ___\
+ *   \ \  \___|\ \  \|\  \ \  \___|\ \  \|\  \ \  \\ \  \ \  \\\  \|___ \  \_|
+ *    \ \  \    \ \  \\\  \ \  \    \ \  \\\  \ \  \\ \  \ \  \\\  \   \ \  \
+ *     \ \  \____\ \  \\\  \ \  \____\ \  \\\  \ \  \\ \  \ \  \\\  \   \ \  \
+ *      \ \_______\ \_______\ \_______\ \_______\ \__\\ \__\ \_______\   \ \__\
+ *       \|_______|\|_______|\|_______|\|_______|\|__| \|__|\|_______|    \|__|
+ *
+ * \file src/vm/template_compiler.cc
+ * \brief Implementation of template_compiler.h
+ * \author SiriusNEO
+ */
+
+#include "template_compiler.h"
+
+#include <algorithm>
+
+#include "verifier.h"
+
+namespace coconut {
+
+namespace vm {
+
+// Registers of the first locals (callee-saved) and of the first stack slots.
+static const X86Reg kLocalRegs[] = {kRbx, kRbp, kR12, kR13, kR14, kR15};
+static const int kNumLocalRegs = 6;
+static const X86Reg kStackRegs[] = {kR8, kR9, kR10, kR11};
+static const int kNumStackRegs = 4;
+
+// The arguments of the entry (System V ABI): the locals and the operand stack
+// of the frame. rax, rcx and rdx are scratch.
+static const X86Reg kLocalsBase = kRdi;
+static const X86Reg kStackBase = kRsi;
+
+static int readU2(const BYTE* code, int pc) {
+  return (code[pc] << 8) | code[pc + 1];
+}
+
+static int readS2(const BYTE* code, int pc) {
+  return int16_t(readU2(code, pc));
+}
+
+static int readS4(const BYTE* code, int pc) {
+  return int32_t((uint32_t(code[pc]) << 24) | (uint32_t(code[pc + 1]) << 16) |
+                 (uint32_t(code[pc + 2]) << 8) | uint32_t(code[pc + 3]));
+}
+
+// The condition of if<cond> (0x99 ~ 0x9e) and if_icmp<cond> (0x9f ~ 0xa4).
+static X86Cond branchCond(uint8_t opcode) {
+  static const X86Cond conds[] = {kCondEqual,        kCondNotEqual,
+                                  kCondLess,         kCondGreaterEqual,
+                                  kCondGreater,      kCondLessEqual};
+  return conds[(opcode - 0x99) % 6];
+}
+
+// The local index of a load, a store or iinc, with the short forms and wide.
+static int localIndex(const BYTE* code, int pc) {
+  uint8_t opcode = code[pc];
+  if (opcode == 0xc4) return readU2(code, pc + 2);
+  if (opcode >= 0x1a && opcode <= 0x1d) return opcode - 0x1a;
+  if (opcode >= 0x3b && opcode <= 0x3e) return opcode - 0x3b;
+  return code[pc + 1];
+}
+
+// The opcode an instruction acts as: wide is replaced by the one it modifies,
+// and short loads and stores by the long forms.
+static uint8_t baseOpcode(const BYTE* code, int pc) {
+  uint8_t opcode = code[pc];
+  if (opcode == 0xc4) return code[pc + 1];
+  if (opcode >= 0x1a && opcode <= 0x1d) return 0x15;
+  if (opcode >= 0x3b && opcode <= 0x3e) return 0x36;
+  return opcode;
+}
+
+// The start of the table of a switch: padding to 4 bytes, then default.
+static int switchBase(int pc) { return pc + 1 + (4 - (pc + 1) % 4) % 4; }
+
+// A tableswitch of this many cases jumps through a table, and a search stops
+// halving the cases at this many, which are compared in turn.
+static const int kMinJumpTable = 4;
+static const int kMaxCompareChain = 3;
+
+// Size of a jmp rel32, an entry of a jump table.
+static const int kJumpSize = 5;
+
+TemplateCompiler::TemplateCompiler(classfile::CodeAttr* codeAttr)
+    : codeAttr_(codeAttr) {}
+
+TemplateCompiler::~TemplateCompiler() {
+  for (auto& bailout : bailouts_) {
+    delete bailout.second;
+  }
+}
+
+bool TemplateCompiler::fail_(int pc, const std::string& what) {
+  error = what + " (pc " + std::to_string(pc) + ")";
+  return false;
+}
+
+bool TemplateCompiler::analyze_() {
+  const BYTE* code = codeAttr_->code;
+  int codeLen = codeAttr_->codeLen;
+  depths_.assign(codeLen, -1);
+  readsLocal_.assign(codeAttr_->maxLocals, false);
+  writesLocal_.assign(codeAttr_->maxLocals, false);
+
+  // the stack effect of each instruction, and the locals it touches
+  std::vector<int> pops(codeLen, 0), pushes(codeLen, 0), lengths(codeLen, 0);
+  for (int pc = 0; pc < codeLen; pc += lengths[pc]) {
+    lengths[pc] = instructionLength(code, codeLen, pc);
+    CHECK(lengths[pc] > 0) << "Compiling an unverified code";
+    uint8_t opcode = baseOpcode(code, pc);
+    if (opcode == 0x00 || opcode == 0x84 || opcode == 0xa7 ||
+        opcode == 0xc8 || opcode == 0xb1) {
+      // nop, iinc, goto, goto_w, return
+    } else if ((opcode >= 0x02 && opcode <= 0x08) || opcode == 0x10 ||
+               opcode == 0x11 || opcode == 0x15) {
+      // iconst_<i>, bipush, sipush, iload
+      pushes[pc] = 1;
+    } else if (opcode == 0x12 || opcode == 0x13) {
+      // ldc, ldc_w of an int
+      int index = opcode == 0x12 ? code[pc + 1] : readU2(code, pc + 1);
+      if (codeAttr_->cp->infoList[index]->tag !=
+          classfile::CONSTANT_TAG_Integer) {
+        return fail_(pc, "Unsupported ldc of a non-int constant");
+      }
+      pushes[pc] = 1;
+    } else if (opcode == 0x36 || opcode == 0x57 ||
+               (opcode >= 0x99 && opcode <= 0x9e) || opcode == 0xaa ||
+               opcode == 0xab || opcode == 0xac) {
+      // istore, pop, if<cond>, tableswitch, lookupswitch, ireturn
+      pops[pc] = 1;
+    } else if (opcode == 0x59 || opcode == 0x5f || opcode == 0x74) {
+      // dup, swap, ineg
+      pops[pc] = opcode == 0x5f ? 2 : 1;
+      pushes[pc] = opcode == 0x74 ? 1 : 2;
+    } else if (opcode == 0x60 || opcode == 0x64 || opcode == 0x68 ||
+               opcode == 0x6c || opcode == 0x70 || opcode == 0x78 ||
+               opcode == 0x7a || opcode == 0x7c || opcode == 0x7e ||
+               opcode == 0x80 || opcode == 0x82) {
+      // iadd, isub, imul, idiv, irem, ishl, ishr, iushr, iand, ior, ixor
+      pops[pc] = 2;
+      pushes[pc] = 1;
+    } else if (opcode >= 0x9f && opcode <= 0xa4) {
+      // if_icmp<cond>
+      pops[pc] = 2;
+    } else {
+      return fail_(pc, "Unsupported instruction " + std::to_string(opcode));
+    }
+    if (opcode == 0x15 || opcode == 0x84) {
+      readsLocal_[localIndex(code, pc)] = true;
+    }
+    if (opcode == 0x36 || opcode == 0x84) {
+      writesLocal_[localIndex(code, pc)] = true;
+    }
+  }
+
+  // the depth at each reachable pc. The verifier has proven they agree
+  std::vector<int> worklist = {0};
+  depths_[0] = 0;
+  while (!worklist.empty()) {
+    int pc = worklist.back();
+    worklist.pop_back();
+    int depth = depths_[pc] - pops[pc] + pushes[pc];
+    uint8_t opcode = code[pc];
+    std::vector<int> targets;
+    bool fallsThrough = true;
+    if (opcode >= 0x99 && opcode <= 0xa4) {
+      targets.push_back(pc + readS2(code, pc + 1));
+    } else if (opcode == 0xa7 || opcode == 0xc8) {
+      targets.push_back(pc + (opcode == 0xa7 ? readS2(code, pc + 1)
+                                             : readS4(code, pc + 1)));
+      fallsThrough = false;
+    } else if (opcode == 0xaa || opcode == 0xab) {
+      int base = switchBase(pc);
+      targets.push_back(pc + readS4(code, base));
+      if (opcode == 0xaa) {
+        int cases = readS4(code, base + 8) - readS4(code, base + 4) + 1;
+        for (int i = 0; i < cases; ++i) {
+          targets.push_back(pc + readS4(code, base + 12 + 4 * i));
+        }
+      } else {
+        int npairs = readS4(code, base + 4);
+        for (int i = 0; i < npairs; ++i) {
+          targets.push_back(pc + readS4(code, base + 12 + 8 * i));
+        }
+      }
+      fallsThrough = false;
+    } else if (opcode == 0xac || opcode == 0xb1) {
+      fallsThrough = false;
+    }
+    if (fallsThrough) targets.push_back(pc + lengths[pc]);
+    for (int target : targets) {
+      if (depths_[target] < 0) {
+        depths_[target] = depth;
+        worklist.push_back(target);
+      }
+      CHECK(depths_[target] == depth) << "Inconsistent stack depth";
+    }
+  }
+  return true;
+}
+
+X86Operand TemplateCompiler::local_(int index) const {
+  if (index < kNumLocalRegs) return X86Operand::ofReg(kLocalRegs[index]);
+  return X86Operand::ofMem(kLocalsBase, index * sizeof(rtda::Slot));
+}
+
+X86Operand TemplateCompiler::stack_(int index) const {
+  if (index < kNumStackRegs) return X86Operand::ofReg(kStackRegs[index]);
+  return X86Operand::ofMem(kStackBase, index * sizeof(rtda::Slot));
+}
+
+void TemplateCompiler::move_(const X86Operand& dst, const X86Operand& src) {
+  if (dst.isReg) {
+    asm_.movl(dst.reg, src);
+  } else if (src.isReg) {
+    asm_.movl(dst, src.reg);
+  } else {
+    asm_.movl(kRax, src);
+    asm_.movl(dst, kRax);
+  }
+}
+
+X86Label* TemplateCompiler::bailout_(int pc) {
+  for (auto& bailout : bailouts_) {
+    if (bailout.first == pc) return bailout.second;
+  }
+  bailouts_.emplace_back(pc, new X86Label());
+  return bailouts_.back().second;
+}
+
+void TemplateCompiler::emit_(int pc) {
+  const BYTE* code = codeAttr_->code;
+  uint8_t opcode = baseOpcode(code, pc);
+  bool wide = code[pc] == 0xc4;
+  int depth = depths_[pc];
+  X86Operand rax = X86Operand::ofReg(kRax), rcx = X86Operand::ofReg(kRcx);
+
+  switch (opcode) {
+    case 0x00:  // nop
+      break;
+    case 0x02:
+    case 0x03:
+    case 0x04:
+    case 0x05:
+    case 0x06:
+    case 0x07:
+    case 0x08:  // iconst_<i>
+      asm_.movl(stack_(depth), int(opcode) - 0x03);
+      break;
+    case 0x10:  // bipush
+      asm_.movl(stack_(depth), int8_t(code[pc + 1]));
+      break;
+    case 0x11:  // sipush
+      asm_.movl(stack_(depth), readS2(code, pc + 1));
+      break;
+    case 0x12:
+    case 0x13: {  // ldc, ldc_w
+      int index = opcode == 0x12 ? code[pc + 1] : readU2(code, pc + 1);
+      asm_.movl(stack_(depth),
+                static_cast<classfile::ConstantIntegerInfo*>(
+                    codeAttr_->cp->infoList[index])
+                    ->val);
+      break;
+    }
+    case 0x15:  // iload
+      move_(stack_(depth), local_(localIndex(code, pc)));
+      break;
+    case 0x36:  // istore
+      move_(local_(localIndex(code, pc)), stack_(depth - 1));
+      break;
+    case 0x57:  // pop
+      break;
+    case 0x59:  // dup
+      move_(stack_(depth), stack_(depth - 1));
+      break;
+    case 0x5f:  // swap
+      asm_.movl(kRcx, stack_(depth - 1));
+      move_(stack_(depth - 1), stack_(depth - 2));
+      asm_.movl(stack_(depth - 2), kRcx);
+      break;
+    case 0x60:
+    case 0x64:
+    case 0x68:
+    case 0x7e:
+    case 0x80:
+    case 0x82: {  // iadd, isub, imul, iand, ior, ixor
+      X86Operand dst = stack_(depth - 2), src = stack_(depth - 1);
+      X86Reg reg = dst.isReg ? dst.reg : kRax;
+      if (!dst.isReg) asm_.movl(kRax, dst);
+      if (opcode == 0x68) {
+        asm_.imull(reg, src);
+      } else {
+        X86Alu op = opcode == 0x60   ? kAluAdd
+                    : opcode == 0x64 ? kAluSub
+                    : opcode == 0x7e ? kAluAnd
+                    : opcode == 0x80 ? kAluOr
+                                     : kAluXor;
+        asm_.alul(op, reg, src);
+      }
+      if (!dst.isReg) asm_.movl(dst, kRax);
+      break;
+    }
+    case 0x6c:
+    case 0x70: {  // idiv, irem
+      // a zero divisor throws in the interpreter. x86 traps on INT_MIN / -1,
+      // which Java defines as INT_MIN (and the remainder as 0)
+      X86Label divide, done;
+      asm_.movl(kRcx, stack_(depth - 1));
+      asm_.testl(kRcx, kRcx);
+      asm_.jcc(kCondEqual, bailout_(pc));
+      asm_.movl(kRax, stack_(depth - 2));
+      asm_.alul(kAluCmp, rcx, -1);
+      asm_.jcc(kCondNotEqual, &divide);
+      asm_.negl(rax);
+      asm_.movl(X86Operand::ofReg(kRdx), 0);
+      asm_.jmp(&done);
+      asm_.bind(&divide);
+      asm_.cdq();
+      asm_.idivl(rcx);
+      asm_.bind(&done);
+      asm_.movl(stack_(depth - 2), opcode == 0x6c ? kRax : kRdx);
+      break;
+    }
+    case 0x74:  // ineg
+      asm_.negl(stack_(depth - 1));
+      break;
+    case 0x78:
+    case 0x7a:
+    case 0x7c:  // ishl, ishr, iushr. x86 masks the count by 31 like Java
+      asm_.movl(kRcx, stack_(depth - 1));
+      asm_.shiftl(opcode == 0x78   ? kShiftLeft
+                  : opcode == 0x7a ? kShiftArith
+                                   : kShiftRight,
+                  stack_(depth - 2));
+      break;
+    case 0x84:  // iinc
+      asm_.alul(kAluAdd, local_(localIndex(code, pc)),
+                wide ? readS2(code, pc + 4) : int8_t(code[pc + 2]));
+      break;
+    case 0x99:
+    case 0x9a:
+    case 0x9b:
+    case 0x9c:
+    case 0x9d:
+    case 0x9e:  // if<cond>
+      asm_.alul(kAluCmp, stack_(depth - 1), 0);
+      asm_.jcc(branchCond(opcode), &labels_[pc + readS2(code, pc + 1)]);
+      break;
+    case 0x9f:
+    case 0xa0:
+    case 0xa1:
+    case 0xa2:
+    case 0xa3:
+    case 0xa4: {  // if_icmp<cond>
+      X86Operand value1 = stack_(depth - 2);
+      X86Reg reg = value1.isReg ? value1.reg : kRax;
+      if (!value1.isReg) asm_.movl(kRax, value1);
+      asm_.alul(kAluCmp, reg, stack_(depth - 1));
+      asm_.jcc(branchCond(opcode), &labels_[pc + readS2(code, pc + 1)]);
+      break;
+    }
+    case 0xa7:  // goto
+      asm_.jmp(&labels_[pc + readS2(code, pc + 1)]);
+      break;
+    case 0xc8:  // goto_w
+      asm_.jmp(&labels_[pc + readS4(code, pc + 1)]);
+      break;
+    case 0xaa:
+    case 0xab:  // tableswitch, lookupswitch
+      emitSwitch_(pc);
+      break;
+    case 0xac:  // ireturn
+      move_(X86Operand::ofMem(kStackBase, 0), stack_(depth - 1));
+      asm_.movl(rax, kCompiledReturnInt);
+      asm_.jmp(&epilogue_);
+      break;
+    case 0xb1:  // return
+      asm_.movl(rax, kCompiledReturnVoid);
+      asm_.jmp(&epilogue_);
+      break;
+    default:
+      LOG(FATAL) << "No template of opcode " << int(opcode);
+  }
+}
+
+void TemplateCompiler::emitSwitch_(int pc) {
+  const BYTE* code = codeAttr_->code;
+  int base = switchBase(pc);
+  X86Label* defaultLabel = &labels_[pc + readS4(code, base)];
+  X86Operand rax = X86Operand::ofReg(kRax);
+  asm_.movl(kRax, stack_(depths_[pc] - 1));
+
+  std::vector<std::pair<int, int>> cases;
+  if (code[pc] == 0xaa) {
+    int low = readS4(code, base + 4), high = readS4(code, base + 8);
+    int count = int(static_cast<long long>(high) - low + 1);
+    if (count >= kMinJumpTable) {
+      // key - low, as unsigned, is below count for the keys of the table. It
+      // picks the jmp to the case from a table of them
+      X86Label table;
+      if (low != 0) asm_.alul(kAluSub, rax, low);
+      asm_.alul(kAluCmp, rax, count - 1);
+      asm_.jcc(kCondAbove, defaultLabel);
+      asm_.imull(kRax, rax, kJumpSize);
+      asm_.leaq(kRcx, &table);
+      asm_.addq(kRcx, kRax);
+      asm_.jmp(kRcx);
+      asm_.bind(&table);
+      for (int i = 0; i < count; ++i) {
+        asm_.jmp(&labels_[pc + readS4(code, base + 12 + 4 * i)]);
+      }
+      return;
+    }
+    for (int i = 0; i < count; ++i) {
+      cases.emplace_back(low + i, pc + readS4(code, base + 12 + 4 * i));
+    }
+  } else {
+    int npairs = readS4(code, base + 4);
+    for (int i = 0; i < npairs; ++i) {
+      cases.emplace_back(readS4(code, base + 8 + 8 * i),
+                         pc + readS4(code, base + 12 + 8 * i));
+    }
+    // the keys are sorted (see Verifier)
+  }
+  emitCompareTree_(cases, 0, cases.size(), defaultLabel);
+}
+
+void TemplateCompiler::emitCompareTree_(
+    const std::vector<std::pair<int, int>>& cases, int begin, int end,
+    X86Label* defaultLabel) {
+  X86Operand rax = X86Operand::ofReg(kRax);
+  if (end - begin <= kMaxCompareChain) {
+    for (int i = begin; i < end; ++i) {
+      asm_.alul(kAluCmp, rax, cases[i].first);
+      asm_.jcc(kCondEqual, &labels_[cases[i].second]);
+    }
+    asm_.jmp(defaultLabel);
+    return;
+  }
+  // the middle key, then the upper half, and the lower half
+  int mid = begin + (end - begin) / 2;
+  X86Label lower;
+  asm_.alul(kAluCmp, rax, cases[mid].first);
+  asm_.jcc(kCondEqual, &labels_[cases[mid].second]);
+  asm_.jcc(kCondLess, &lower);
+  emitCompareTree_(cases, mid + 1, end, defaultLabel);
+  asm_.bind(&lower);
+  emitCompareTree_(cases, begin, mid, defaultLabel);
+}
+
+void TemplateCompiler::emitBailouts_() {
+  for (auto& bailout : bailouts_) {
+    int pc = bailout.first;
+    asm_.bind(bailout.second);
+    // the interpreter finds the stack and the locals in the frame
+    for (int i = 0; i < std::min(depths_[pc], kNumStackRegs); ++i) {
+      asm_.movl(X86Operand::ofMem(kStackBase, i * sizeof(rtda::Slot)),
+                kStackRegs[i]);
+    }
+    for (int i = 0; i < std::min(int(writesLocal_.size()), kNumLocalRegs);
+         ++i) {
+      if (writesLocal_[i]) {
+        asm_.movl(X86Operand::ofMem(kLocalsBase, i * sizeof(rtda::Slot)),
+                  kLocalRegs[i]);
+      }
+    }
+    asm_.movl(X86Operand::ofReg(kRax), pc);
+    asm_.jmp(&epilogue_);
+  }
+}
+
+CompiledCode* TemplateCompiler::compile(CodeCache* cache, int osrPc) {
+#if !defined(__x86_64__)
+  fail_(0, "The template compiler only targets x86-64");
+  return nullptr;
+#endif
+  if (!analyze_()) return nullptr;
+  if (osrPc >= 0 &&
+      (osrPc >= int(codeAttr_->codeLen) || depths_[osrPc] < 0)) {
+    fail_(osrPc, "OSR entry is not the start of an instruction");
+    return nullptr;
+  }
+
+  // prologue: save the callee-saved registers of the locals, and load the
+  // locals which are read (the arguments, or set before a bail-out)
+  std::vector<X86Reg> saved;
+  for (int i = 0; i < std::min(int(readsLocal_.size()), kNumLocalRegs); ++i) {
+    if (readsLocal_[i] || writesLocal_[i]) saved.push_back(kLocalRegs[i]);
+  }
+  for (X86Reg reg : saved) asm_.push(reg);
+  for (int i = 0; i < std::min(int(readsLocal_.size()), kNumLocalRegs); ++i) {
+    if (readsLocal_[i]) {
+      asm_.movl(kLocalRegs[i],
+                X86Operand::ofMem(kLocalsBase, i * sizeof(rtda::Slot)));
+    }
+  }
+  // an OSR entry also loads the operand stack of the frame, and jumps to the
+  // loop header the interpreter stopped at
+  labels_.resize(codeAttr_->codeLen);
+  if (osrPc >= 0) {
+    for (int i = 0; i < std::min(depths_[osrPc], kNumStackRegs); ++i) {
+      asm_.movl(kStackRegs[i],
+                X86Operand::ofMem(kStackBase, i * sizeof(rtda::Slot)));
+    }
+    asm_.jmp(&labels_[osrPc]);
+  }
+
+  // the templates, in the order of the code
+  for (int pc = 0; pc < int(codeAttr_->codeLen); ++pc) {
+    if (depths_[pc] < 0) continue;
+    asm_.bind(&labels_[pc]);
+    emit_(pc);
+  }
+  emitBailouts_();
+
+  // epilogue: the status is in eax
+  asm_.bind(&epilogue_);
+  for (auto it = saved.rbegin(); it != saved.rend(); ++it) asm_.pop(*it);
+  asm_.ret();
+
+  CompiledCode* compiled = new CompiledCode();
+  compiled->entry = cache->install(asm_.code);
+  compiled->codeSize = asm_.code.size();
+  compiled->stackDepths = depths_;
+  compiled->osrPc = osrPc;
+  return compiled;
+}
+
+}  // namespace vm
+
+}  // namespace coconut
@@ -0,0 +1,218 @@
+/*!
+ *    ________  ________  ________  ________  ________   ___  ___  _________
+ *   |\   ____\|\   __  \|\   ____\|\   __  \|\   ___  \|\  \|\  \|\___   ___\
+ *   \ \  \___|\ \  \|\  \ \  \___|\ \  \|\  \ \  \\ \  \ \  \\\  \|___ \  \_|
+ *    \ \  \    \ \  \\\  \ \  \    \ \  \\\  \ \  \\ \  \ \  \\\  \   \ \  \
+ *     \ \  \____\ \  \\\  \ \  \____\ \  \\\  \ \  \\ \  \ \  \\\  \   \ \  \
+ *      \ \_______\ \_______\ \_______\ \_______\ \__\\ \__\ \_______\   \ \__\
+ *       \|_______|\|_______|\|_______|\|_______|\|__| \|__|\|_______|    \|__|
+ *
+ * \file src/vm/template_compiler.h
+ * \brief Baseline compiler: stamps out x86-64 templates for each bytecode.
+ * \author SiriusNEO
+ */
+
+#ifndef SRC_VM_TEMPLATE_COMPILER_H_
+#define SRC_VM_TEMPLATE_COMPILER_H_
+
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "../classfile/attributes.h"
+#include "../rtda/vmstack/slot.h"
+#include "code_cache.h"
+#include "x86_assembler.h"
+
+namespace coconut {
+
+namespace vm {
+
+/*!
+ * \brief What compiled code returns when the method returns. Otherwise it
+ * returns the pc at which the interpreter resumes the method.
+ */
+enum CompiledStatus : int {
+  /*! \brief The method returned without a value. */
+  kCompiledReturnVoid = -1,
+  /*! \brief The method returned an int, in the first slot of the stack. */
+  kCompiledReturnInt = -2
+};
+
+/*! \brief The machine code of a method, made by the TemplateCompiler. */
+struct CompiledCode {
+  /*!
+   * \brief The entry, in the code cache. A function of the locals and the
+   * operand stack of the frame: int (*)(rtda::Slot*, rtda::Slot*).
+   */
+  const void* entry;
+
+  /*! \brief Size of the machine code in bytes. */
+  size_t codeSize;
+
+  /*!
+   * \brief Depth of the operand stack before each pc, in slots. -1 if the pc
+   * is not the start of a reachable instruction.
+   */
+  std::vector<int> stackDepths;
+
+  /*!
+   * \brief The pc of the loop header it is entered at (on-stack replacement),
+   * or -1 if it is entered at the start of the method.
+   */
+  int osrPc;
+
+  /*!
+   * \brief Run the method on a frame. The operand stack of the frame is empty,
+   * or for an OSR entry, holds stackDepths[osrPc] values.
+   *
+   * If the code bails out (e.g. to throw an exception), the frame is left
+   * complete in memory: the locals, and stackDepths[pc] values on the operand
+   * stack, so the interpreter can resume at the pc.
+   *
+   * \param locals The local variables of the frame.
+   * \param stack The bottom of the operand stack of the frame.
+   * \return A CompiledStatus if it returned, otherwise the pc to resume at.
+   */
+  int run(rtda::Slot* locals, rtda::Slot* stack) const {
+    return reinterpret_cast<int (*)(rtda::Slot*, rtda::Slot*)>(
+        const_cast<void*>(entry))(locals, stack);
+  }
+};
+
+/*!
+ * \brief Baseline (template) compiler for x86-64.
+ *
+ * Each bytecode is translated on its own, by stamping out a fixed template of
+ * machine code, without any global optimization. Since the code is verified,
+ * the depth of the operand stack at each pc is known when compiling, so every
+ * stack slot and every local variable has a fixed home: the first slots of the
+ * operand stack and the first locals live in registers, and the others in the
+ * frame of the interpreter, addressed from its locals and stack pointers. A
+ * template then reads and writes these homes directly, e.g. iload_1; iload_2;
+ * iadd becomes two register moves and an add.
+ *
+ * Compiled code has the frame of the interpreter as its frame. When it can not
+ * go on (a division by zero), it writes the registers back into the frame and
+ * returns the pc, and the interpreter resumes there, e.g. to throw.
+ *
+ * A method may also be compiled with an OSR entry at a loop header: the code
+ * is the same, but it starts by loading the locals and the operand stack of a
+ * frame the interpreter has been running, and jumps to the header. So a loop
+ * which never returns can move into compiled code in the middle.
+ *
+ * Only methods on ints are compiled: constants, loads and stores, arithmetic,
+ * iinc, stack operations, branches, switches and returns. Others, e.g. with
+ * calls or objects, are rejected and stay interpreted.
+ */
+class TemplateCompiler {
+ private:
+  /*! \brief The code. */
+  classfile::CodeAttr* codeAttr_;
+
+  /*! \brief Depth of the operand stack before each pc. -1 if unreachable. */
+  std::vector<int> depths_;
+
+  /*! \brief Whether each local is read, and whether it is written. */
+  std::vector<bool> readsLocal_;
+  std::vector<bool> writesLocal_;
+
+  /*! \brief The assembler. */
+  X86Assembler asm_;
+
+  /*! \brief The label of each pc. */
+  std::vector<X86Label> labels_;
+
+  /*! \brief The epilogue, which returns the status in eax. */
+  X86Label epilogue_;
+
+  /*! \brief The bail-out stubs to emit after the code: pc, label. */
+  std::vector<std::pair<int, X86Label*>> bailouts_;
+
+  /*!
+   * \brief Record the reason of the failure.
+   * \param pc The pc of the failure.
+   * \param what The reason.
+   * \return false.
+   */
+  bool fail_(int pc, const std::string& what);
+
+  /*!
+   * \brief Check that every instruction is supported, and find the depth of
+   * the operand stack at each pc.
+   * \return Whether the code can be compiled.
+   */
+  bool analyze_();
+
+  /*! \brief The home of a local variable: a register, or the frame. */
+  X86Operand local_(int index) const;
+
+  /*! \brief The home of a slot of the operand stack, 0 is the bottom. */
+  X86Operand stack_(int index) const;
+
+  /*! \brief Move an int between two homes. */
+  void move_(const X86Operand& dst, const X86Operand& src);
+
+  /*!
+   * \brief Get a label which bails out to the interpreter at some pc.
+   * \param pc The pc to resume at.
+   * \return The label, owned by the compiler.
+   */
+  X86Label* bailout_(int pc);
+
+  /*!
+   * \brief Emit the template of an instruction.
+   * \param pc The pc of the instruction.
+   */
+  void emit_(int pc);
+
+  /*!
+   * \brief Emit a tableswitch or a lookupswitch. A tableswitch of at least
+   * kMinJumpTable cases jumps through a table, indexed by the key. Other
+   * switches search their sorted keys by a tree of compares.
+   * \param pc The pc of the instruction.
+   */
+  void emitSwitch_(int pc);
+
+  /*!
+   * \brief Emit a binary search of the key in eax.
+   * \param cases The keys and their target pcs, sorted by the key.
+   * \param begin The first case to search.
+   * \param end The case after the last one to search.
+   * \param defaultLabel Where to jump if the key is not found.
+   */
+  void emitCompareTree_(const std::vector<std::pair<int, int>>& cases,
+                        int begin, int end, X86Label* defaultLabel);
+
+  /*! \brief Emit the bail-out stubs. */
+  void emitBailouts_();
+
+ public:
+  /*! \brief The reason of the failure. Empty if compiled. */
+  std::string error;
+
+  /*!
+   * \brief Default constructor.
+   * \param codeAttr The code. It must be verified.
+   */
+  explicit TemplateCompiler(classfile::CodeAttr* codeAttr);
+
+  /*! \brief Default destructor. */
+  ~TemplateCompiler();
+
+  /*!
+   * \brief Compile the code.
+   * \param cache The code cache to install the machine code into.
+   * \param osrPc The pc of the loop header to enter at (see
+   * CompiledCode::osrPc), or -1 to enter at the start.
+   * \return The compiled code, owned by the caller. nullptr if the code can
+   * not be compiled (see error).
+   */
+  CompiledCode* compile(CodeCache* cache, int osrPc = -1);
+};
+
+}  // namespace vm
+
+}  // namespace coconut
+
+#endif  // SRC_VM_TEMPLATE_COMPILER_H_
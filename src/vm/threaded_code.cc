@@ -0,0 +1,395 @@
+/*!
+ *    ________  ________  ________  ________  ________   ___  ___  _________
+ *   |\   ____\|\   __  \|\   ____\|\   __  \|\   ___  \|\  \|\  \|\___   ___\
+ *   \ \  \___|\ \  \|\  \ \  \___|\ \  \|\  \ \  \\ \  \ \  \\\  \|___ \  \_|
+ *    \ \  \    \ \  \\\  \ \  \    \ \  \\\  \ \  \\ \  \ \  \\\  \   \ \  \
+ *     \ \  \____\ \  \\\  \ \  \____\ \  \\\  \ \  \\ \  \ \  \\\  \   \ \  \
+ *      \ \_______\ \_______\ \_______\ \_______\ \__\\ \__\ \_______\   \ \__\
+ *       \|_______|\|_______|\|_______|\|_______|\|__| \|__|\|_______|    \|__|
+ *
+ * \file src/vm/threaded_code.cc
+ * \brief Implementation of threaded_code.h
+ * \author SiriusNEO
+ */
+
+#include "threaded_code.h"
+
+#include "../bytecode/instructions/control.h"
+
+namespace coconut {
+
+namespace vm {
+
+ThreadedCode::ThreadedCode(classfile::CodeAttr* codeAttr,
+                           bool superInstructions)
+    : pcToIndex_(codeAttr->codeLen, -1),
+      codeAttr(codeAttr),
+      cp(codeAttr->cp),
+      maxLocals(codeAttr->maxLocals),
+      maxStack(codeAttr->maxStack),
+      exceptions(codeAttr),
+      linked(false),
+      profile(nullptr) {
+  utils::ByteReader reader(codeAttr->codeLen, codeAttr->code);
+
+  while (reader.good()) {
+    ThreadedInst inst;
+    inst.handler = nullptr;
+    inst.target = nullptr;
+    inst.resolved = nullptr;
+    inst.cachedHandler = nullptr;
+    inst.pc = reader.cursor;
+    inst.opcode = reader.fetchU1();
+    inst.operand1 = 0;
+    inst.operand2 = 0;
+    inst.operand3 = 0;
+    fetchOperands_(reader, inst);
+    if (inst.opcode == 0xb6 || inst.opcode == 0xb9) {  // virtual, interface
+      inst.operand3 = inlineCaches.size();
+      inlineCaches.emplace_back(inst.pc);
+    }
+
+    pcToIndex_[inst.pc] = insts.size();
+    insts.push_back(inst);
+  }
+
+  resolveTargets_();
+
+  if (superInstructions) {
+    fuse_(codeAttr);
+  }
+}
+
+void ThreadedCode::fetchOperands_(utils::ByteReader& reader,
+                                  ThreadedInst& inst) {
+  uint8_t opcode = inst.opcode;
+
+  switch (opcode) {
+    // iconst_m1 ~ iconst_5
+    case 0x02:
+    case 0x03:
+    case 0x04:
+    case 0x05:
+    case 0x06:
+    case 0x07:
+    case 0x08:
+      inst.operand1 = int(opcode) - 0x03;
+      break;
+    // lconst_x, fconst_x, dconst_x
+    case 0x09:
+    case 0x0a:
+      inst.operand1 = int(opcode) - 0x09;
+      break;
+    case 0x0b:
+    case 0x0c:
+    case 0x0d:
+      inst.operand1 = int(opcode) - 0x0b;
+      break;
+    case 0x0e:
+    case 0x0f:
+      inst.operand1 = int(opcode) - 0x0e;
+      break;
+    // bipush, sipush (sign-ext)
+    case 0x10:
+      inst.operand1 = int(reader.fetchInt8());
+      break;
+    case 0x11:
+      inst.operand1 = int(reader.fetchInt16());
+      break;
+    // xload, xstore, ldc, ret, newarray: 1-byte index
+    case 0x12:
+    case 0x15:
+    case 0x16:
+    case 0x17:
+    case 0x18:
+    case 0x19:
+    case 0x36:
+    case 0x37:
+    case 0x38:
+    case 0x39:
+    case 0x3a:
+    case 0xa9:
+    case 0xbc:
+      inst.operand1 = int(reader.fetchU1());
+      break;
+    // ldc_w, ldc2_w, field & method refs, new, anewarray, checkcast,
+    // instanceof: 2-bytes index
+    case 0x13:
+    case 0x14:
+    case 0xb2:
+    case 0xb3:
+    case 0xb4:
+    case 0xb5:
+    case 0xb6:
+    case 0xb7:
+    case 0xb8:
+    case 0xbb:
+    case 0xbd:
+    case 0xc0:
+    case 0xc1:
+      inst.operand1 = int(reader.fetchU2());
+      break;
+    // iinc
+    case 0x84:
+      inst.operand1 = int(reader.fetchU1());
+      inst.operand2 = int(reader.fetchInt8());
+      break;
+    // if<cond>, if_icmp<cond>, if_acmp<cond>, goto, jsr, ifnull, ifnonnull
+    case 0x99:
+    case 0x9a:
+    case 0x9b:
+    case 0x9c:
+    case 0x9d:
+    case 0x9e:
+    case 0x9f:
+    case 0xa0:
+    case 0xa1:
+    case 0xa2:
+    case 0xa3:
+    case 0xa4:
+    case 0xa5:
+    case 0xa6:
+    case 0xa7:
+    case 0xa8:
+    case 0xc6:
+    case 0xc7:
+      inst.operand1 = int(reader.fetchInt16());
+      break;
+    // goto_w, jsr_w
+    case 0xc8:
+    case 0xc9:
+      inst.operand1 = reader.fetchInt32();
+      break;
+    // tableswitch
+    case 0xaa: {
+      reader.padding4Bytes();
+      inst.operand1 = switchData.size();
+      inst.operand2 = switchOffsets_.size();
+      switchOffsets_.push_back(reader.fetchInt32());  // default
+      int low = reader.fetchInt32();
+      int high = reader.fetchInt32();
+      switchData.push_back(low);
+      switchData.push_back(high);
+      reader.fetchInt32List(high - low + 1, switchOffsets_);
+      break;
+    }
+    // lookupswitch
+    case 0xab: {
+      reader.padding4Bytes();
+      int defaultOffset = reader.fetchInt32();
+      int npairs = reader.fetchInt32();
+      std::vector<int> pairs;
+      reader.fetchInt32List(npairs << 1, pairs);
+      for (int i = 1; i < npairs; ++i) {
+        CHECK(pairs[i << 1] > pairs[(i - 1) << 1])
+            << "lookupswitch keys are not sorted";
+      }
+
+      inst.operand1 = switchData.size();
+      inst.operand2 = switchOffsets_.size();
+      switchOffsets_.push_back(defaultOffset);
+
+      if (npairs > 0 &&
+          bytecode::isDenseSwitch(npairs, pairs[0], pairs[(npairs - 1) << 1])) {
+        // compile into a tableswitch, holes go to default
+        int low = pairs[0], high = pairs[(npairs - 1) << 1];
+        inst.opcode = 0xaa;
+        switchData.push_back(low);
+        switchData.push_back(high);
+        size_t start = switchOffsets_.size();
+        switchOffsets_.resize(start + (high - low + 1), defaultOffset);
+        for (int i = 0; i < npairs; ++i) {
+          switchOffsets_[start + pairs[i << 1] - low] = pairs[(i << 1) | 1];
+        }
+      } else {
+        // binary search over the sorted matches
+        switchData.push_back(npairs);
+        for (int i = 0; i < npairs; ++i) {
+          switchData.push_back(pairs[i << 1]);
+          switchOffsets_.push_back(pairs[(i << 1) | 1]);
+        }
+      }
+      break;
+    }
+    // invokeinterface: index, count, 0
+    case 0xb9:
+      inst.operand1 = int(reader.fetchU2());
+      inst.operand2 = int(reader.fetchU1());
+      reader.fetchU1();
+      break;
+    // invokedynamic: index, 0, 0
+    case 0xba:
+      inst.operand1 = int(reader.fetchU2());
+      reader.fetchU2();
+      break;
+    // wide: fold into the modified instruction
+    case 0xc4:
+      inst.opcode = reader.fetchU1();
+      inst.operand1 = int(reader.fetchU2());
+      if (inst.opcode == 0x84) {
+        inst.operand2 = int(reader.fetchInt16());
+      }
+      break;
+    // multianewarray: index, dimensions
+    case 0xc5:
+      inst.operand1 = int(reader.fetchU2());
+      inst.operand2 = int(reader.fetchU1());
+      break;
+    // xload_n
+    case 0x1a:
+    case 0x1b:
+    case 0x1c:
+    case 0x1d:
+    case 0x1e:
+    case 0x1f:
+    case 0x20:
+    case 0x21:
+    case 0x22:
+    case 0x23:
+    case 0x24:
+    case 0x25:
+    case 0x26:
+    case 0x27:
+    case 0x28:
+    case 0x29:
+    case 0x2a:
+    case 0x2b:
+    case 0x2c:
+    case 0x2d:
+      inst.operand1 = (int(opcode) - 0x1a) & 0x3;
+      break;
+    // xstore_n
+    case 0x3b:
+    case 0x3c:
+    case 0x3d:
+    case 0x3e:
+    case 0x3f:
+    case 0x40:
+    case 0x41:
+    case 0x42:
+    case 0x43:
+    case 0x44:
+    case 0x45:
+    case 0x46:
+    case 0x47:
+    case 0x48:
+    case 0x49:
+    case 0x4a:
+    case 0x4b:
+    case 0x4c:
+    case 0x4d:
+    case 0x4e:
+      inst.operand1 = (int(opcode) - 0x3b) & 0x3;
+      break;
+    default:
+      // no operand
+      break;
+  }
+}
+
+// Whether the opcode is a branch with its offset in operand1.
+static bool isBranch(uint8_t opcode) {
+  return (opcode >= 0x99 && opcode <= 0xa8) ||
+         (opcode >= 0xc6 && opcode <= 0xc9);
+}
+
+ThreadedInst* ThreadedCode::targetAt_(int pc) {
+  CHECK(pc >= 0 && size_t(pc) < pcToIndex_.size() && pcToIndex_[pc] >= 0)
+      << "Bad branch target: " << pc;
+  return at(pc);
+}
+
+void ThreadedCode::resolveTargets_() {
+  for (auto& inst : insts) {
+    if (isBranch(inst.opcode)) {
+      inst.target = targetAt_(inst.pc + inst.operand1);
+    }
+  }
+
+  // switch offsets are relative to the pc of the switch
+  switchTargets.resize(switchOffsets_.size(), nullptr);
+  for (const auto& inst : insts) {
+    if (inst.opcode != 0xaa && inst.opcode != 0xab) {
+      continue;
+    }
+    const int* table = &switchData[inst.operand1];
+    int count = inst.opcode == 0xaa ? table[1] - table[0] + 1 : table[0];
+    for (int i = 0; i <= count; ++i) {
+      int index = inst.operand2 + i;
+      switchTargets[index] = targetAt_(inst.pc + switchOffsets_[index]);
+    }
+  }
+}
+
+void ThreadedCode::fuse_(classfile::CodeAttr* codeAttr) {
+  // pcs where a fused sequence can not continue
+  std::vector<bool> boundary(pcToIndex_.size() + 1, false);
+  for (const auto& inst : insts) {
+    if (inst.target != nullptr) {
+      boundary[inst.target->pc] = true;
+    }
+  }
+  for (ThreadedInst* target : switchTargets) {
+    boundary[target->pc] = true;
+  }
+  for (const auto& entry : codeAttr->exceptionTable) {
+    boundary[entry.startPc] = true;
+    boundary[entry.endPc] = true;
+    boundary[entry.handlerPc] = true;
+  }
+
+  for (size_t i = 0; i < insts.size(); ++i) {
+    for (int p = 0; p < kNumSuperInstPatterns; ++p) {
+      const SuperInstPattern& pattern = kSuperInstPatterns[p];
+      if (!pattern.enabled || i + pattern.length > insts.size()) {
+        continue;
+      }
+
+      bool match = true;
+      for (int k = 0; k < pattern.length && match; ++k) {
+        match = canonicalOpcode(insts[i + k].opcode) == pattern.opcodes[k] &&
+                (k == 0 || !boundary[insts[i + k].pc]);
+      }
+      if (!match) {
+        continue;
+      }
+
+      // collect the operands of the parts
+      int operands[3], count = 0;
+      for (int k = 0; k < pattern.length; ++k) {
+        const ThreadedInst& part = insts[i + k];
+        uint8_t opcode = canonicalOpcode(part.opcode);
+        if (opcode == 0x10 || opcode == 0x15 || opcode == 0x36) {
+          operands[count++] = part.operand1;
+        } else if (opcode == 0x84) {
+          operands[count++] = part.operand1;
+          operands[count++] = part.operand2;
+        } else if (isBranch(opcode)) {
+          operands[count++] = part.operand1 + part.pc - insts[i].pc;
+          insts[i].target = part.target;
+        }
+      }
+
+      ThreadedInst& fused = insts[i];
+      fused.opcode = pattern.superOpcode;
+      fused.operand1 = count > 0 ? operands[0] : 0;
+      fused.operand2 = count > 1 ? operands[1] : 0;
+      fused.operand3 = count > 2 ? operands[2] : 0;
+      i += pattern.length - 1;
+      break;
+    }
+  }
+}
+
+void ThreadedCode::bindProfile(MethodData* data) {
+  for (BranchProfile& branch : data->branches) {
+    // the part of a superinstruction keeps its pc
+    __atomic_store_n(&at(branch.pc)->resolved, static_cast<void*>(&branch),
+                     __ATOMIC_RELAXED);
+  }
+  __atomic_store_n(&profile, data, __ATOMIC_RELAXED);
+}
+
+}  // namespace vm
+
+}  // namespace coconut
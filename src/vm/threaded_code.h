@@ -0,0 +1,410 @@
+/*!
+ *    ________  ________  ________  ________  ________   ___  ___  _________
+ *   |\   ____\|\   __  \|\   ____\|\   __  \|\   ___  \|\  \|\  \|\___   ___\
+ *   \ \  \___|\ \  \|\  \ \  \___|\ \  \|\  \ \  \\ \  \ \  \\\  \|___ \  \_|
+ *    \ \  \    \ \  \\\  \ \  \    \ \  \\\  \ \  \\ \  \ \  \\\  \   \ \  \
+ *     \ \  \____\ \  \\\  \ \  \____\ \  \\\  \ \  \\ \  \ \  \\\  \   \ \  \
+ *      \ \_______\ \_______\ \_______\ \_______\ \__\\ \__\ \_______\   \ \__\
+ *       \|_______|\|_______|\|_______|\|_______|\|__| \|__|\|_______|    \|__|
+ *
+ * \file src/vm/threaded_code.h
+ * \brief Pre-decoded code for the direct-threaded interpreter.
+ * \author SiriusNEO
+ */
+
+#ifndef SRC_VM_THREADED_CODE_H_
+#define SRC_VM_THREADED_CODE_H_
+
+#include <algorithm>
+
+#include "../classfile/attributes.h"
+#include "exception_index.h"
+#include "method_data.h"
+#include "superinstructions.h"
+
+namespace coconut {
+
+namespace vm {
+
+/*!
+ * \brief A pre-decoded instruction in threaded code.
+ *
+ * All operands are fetched from the byte stream when translating, so executing
+ * it never touches the code bytes again. Short forms are expanded into the
+ * operands (e.g. iload_2 has operand1 = 2, iconst_m1 has operand1 = -1), and
+ * wide is folded into the instruction it modifies.
+ *
+ * A superinstruction carries the operands of its parts in order, e.g.
+ * iload_1; iload_2; iadd; istore_3 has operands (1, 2, 3). Branch offsets in it
+ * are relative to the pc of the superinstruction.
+ */
+struct ThreadedInst {
+  /*!
+   * \brief The address of the handler in the dispatch loop. It is bound by the
+   * engine when the code runs for the first time.
+   */
+  const void* handler;
+
+  /*!
+   * \brief The handler when the top of stack is cached in a register. Only
+   * used in the TOS caching mode.
+   */
+  const void* cachedHandler;
+
+  /*! \brief The JVM opcode. */
+  uint8_t opcode;
+
+  /*! \brief The pc of the instruction in the original code. */
+  int pc;
+
+  /*!
+   * \brief The first operand: local index, immediate, branch offset, or the
+   * start of the keys in ThreadedCode::switchData.
+   */
+  int operand1;
+
+  /*!
+   * \brief The second operand (e.g. the increment of iinc, or the start of the
+   * targets in ThreadedCode::switchTargets).
+   */
+  int operand2;
+
+  /*! \brief The third operand. Only used by superinstructions. */
+  int operand3;
+
+  /*!
+   * \brief The branch target, resolved when translating, so a taken branch is
+   * a single pointer load. nullptr if it is not a branch.
+   */
+  ThreadedInst* target;
+
+  /*!
+   * \brief What a quick instruction resolved from the constant pool, e.g. the
+   * code of the method invokestatic calls. nullptr if not resolved. For a
+   * conditional branch, its BranchProfile once the method is profiled (see
+   * ThreadedCode::bindProfile).
+   */
+  void* resolved;
+};
+
+/*!
+ * \brief Opcodes of quick instructions, following the superinstructions.
+ *
+ * An instruction that needs the constant pool resolves it at its first
+ * execution, stores the result in its operands and rewrites itself into the
+ * quick form (see ThreadedCode::quicken), which never looks at the pool again.
+ */
+enum QuickOpcode : uint8_t {
+  /*! \brief ldc, ldc_w of int/float. The bits are in operand2. */
+  kQuick_ldc = kSuperOpcodeEnd,
+  /*! \brief ldc2_w. The low/high 32 bits are in operand2/operand3. */
+  kQuick_ldc2_w,
+  /*!
+   * \brief invokestatic. The CodeAttr of the method is in resolved, and the
+   * number of argument slots is in operand2.
+   */
+  kQuick_invokestatic,
+  /*!
+   * \brief invokevirtual and invokeinterface. The number of argument slots
+   * (with the receiver) is in operand2, and the index of the inline cache in
+   * operand3. The vtable (or itable) slot of the method is in the inline cache.
+   */
+  kQuick_invokevirtual,
+  /*! \brief checkcast. The rtda::Class is in resolved. */
+  kQuick_checkcast,
+  /*! \brief instanceof. The rtda::Class is in resolved. */
+  kQuick_instanceof,
+  kQuickOpcodeEnd
+};
+
+static_assert(kQuickOpcodeEnd <= 0xfe, "Too many quick instructions");
+
+/*! \brief Max number of receiver classes in an inline cache. */
+const int kInlineCacheSize = 8;
+
+/*!
+ * \brief A polymorphic inline cache of a virtual or interface call site: the
+ * receiver classes seen at the site and the code each one dispatched to. A hit
+ * is a scan of a few class pointers, and a miss looks the method up in the
+ * vtable (or the itable of the interface) of the receiver class and adds an
+ * entry.
+ *
+ * The cache is bounded. Once a site has seen more than kInlineCacheSize
+ * classes, it is megamorphic: it stops scanning and every call indexes the
+ * vtable (or itable) by the slot of the method, which was resolved when
+ * quickening.
+ *
+ * Threads may run the site at the same time. An entry is written once: a
+ * thread reserves it by increasing the count, stores the target, and then
+ * publishes the class. A lookup skips the entries whose class is not
+ * published yet. Two threads missing on the same class may both add it.
+ *
+ * The counters are statistics of the site. They are not incremented
+ * atomically, so a race may lose counts.
+ */
+class InlineCache {
+ private:
+  /*! \brief An entry: a receiver class and the code it dispatches to. */
+  struct Entry {
+    const rtda::Class* receiverClass;
+    classfile::CodeAttr* target;
+  };
+
+  /*! \brief The entries. Only the first count_ ones are reserved. */
+  Entry entries_[kInlineCacheSize];
+
+  /*! \brief Number of reserved entries. */
+  int count_;
+
+  /*! \brief Whether the site is megamorphic. */
+  bool megamorphic_;
+
+  /*! \brief Increment a counter, without an atomic read-modify-write. */
+  static void increment_(uint64_t* counter) {
+    __atomic_store_n(counter, __atomic_load_n(counter, __ATOMIC_RELAXED) + 1,
+                     __ATOMIC_RELAXED);
+  }
+
+ public:
+  /*! \brief The pc of the call site. */
+  int pc;
+
+  /*!
+   * \brief The class (or interface) in the Methodref of the site. Set when
+   * the site is resolved. Every receiver is an instance of it.
+   */
+  const rtda::Class* resolvedClass;
+
+  /*!
+   * \brief The vtable slot of the method (see rtda::Class), or its itable
+   * slot if the resolved class is an interface. Set when the site is resolved.
+   */
+  int vtableSlot;
+
+  /*!
+   * \brief The itable index of the interface in the last receiver class that
+   * missed. Only used if the resolved class is an interface.
+   */
+  int itableIndex;
+
+  /*! \brief Number of calls dispatched by the cache. */
+  uint64_t hits;
+
+  /*! \brief Number of calls which missed and added an entry. */
+  uint64_t misses;
+
+  /*!
+   * \brief Number of calls dispatched by the vtable or the itable
+   * (megamorphic).
+   */
+  uint64_t vtableCalls;
+
+  /*!
+   * \brief Default constructor. An empty cache.
+   * \param pc The pc of the call site.
+   */
+  explicit InlineCache(int pc)
+      : entries_(),
+        count_(0),
+        megamorphic_(false),
+        pc(pc),
+        resolvedClass(nullptr),
+        vtableSlot(-1),
+        itableIndex(0),
+        hits(0),
+        misses(0),
+        vtableCalls(0) {}
+
+  /*! \brief Whether the site has seen too many classes to cache. */
+  bool megamorphic() const {
+    return __atomic_load_n(&megamorphic_, __ATOMIC_RELAXED);
+  }
+
+  /*! \brief Number of receiver classes cached. */
+  int size() const {
+    return std::min(__atomic_load_n(&count_, __ATOMIC_RELAXED),
+                    kInlineCacheSize);
+  }
+
+  /*!
+   * \brief Look up the target of a receiver class. Count a hit or a miss.
+   * \param receiverClass The class of the receiver.
+   * \return The target. nullptr if it misses, or the site is megamorphic.
+   */
+  classfile::CodeAttr* lookup(const rtda::Class* receiverClass) {
+    if (megamorphic()) {
+      increment_(&vtableCalls);
+      return nullptr;
+    }
+    int count = size();
+    for (int i = 0; i < count; ++i) {
+      if (__atomic_load_n(&entries_[i].receiverClass, __ATOMIC_ACQUIRE) ==
+          receiverClass) {
+        increment_(&hits);
+        return entries_[i].target;
+      }
+    }
+    increment_(&misses);
+    return nullptr;
+  }
+
+  /*!
+   * \brief Add an entry after a miss. If the cache is full, the site becomes
+   * megamorphic instead.
+   * \param receiverClass The class of the receiver.
+   * \param target The code the receiver dispatches to.
+   */
+  void add(const rtda::Class* receiverClass, classfile::CodeAttr* target) {
+    int index = __atomic_fetch_add(&count_, 1, __ATOMIC_RELAXED);
+    if (index >= kInlineCacheSize) {
+      __atomic_store_n(&megamorphic_, true, __ATOMIC_RELAXED);
+      return;
+    }
+    entries_[index].target = target;
+    __atomic_store_n(&entries_[index].receiverClass, receiverClass,
+                     __ATOMIC_RELEASE);
+  }
+};
+
+/*!
+ * \brief Pre-decoded (threaded) form of a CodeAttr.
+ *
+ * The instructions are stored contiguously, in the order of the code. Branch
+ * and switch targets are resolved into pointers to the instructions when
+ * translating, so the pc table is only used to enter the code.
+ *
+ * When superinstructions are on, the first instruction of a matched sequence
+ * (see superinstructions.def) is replaced by the superinstruction, whose
+ * handler skips the rest. The rest are kept, so the pc table is unchanged. A
+ * sequence is never fused across a branch target or an exception boundary.
+ */
+class ThreadedCode {
+ private:
+  /*! \brief Map from pc to the index of the instruction. -1 if not a start. */
+  std::vector<int> pcToIndex_;
+
+  /*!
+   * \brief Fetch the operands of an instruction from the reader.
+   * \param reader The reader, whose cursor is just after the opcode.
+   * \param inst The instruction.
+   */
+  void fetchOperands_(utils::ByteReader& reader, ThreadedInst& inst);
+
+  /*!
+   * \brief Offsets of switch targets, relative to the pc of the switch. The
+   * same layout as switchTargets.
+   */
+  std::vector<int> switchOffsets_;
+
+  /*!
+   * \brief Get the instruction at a branch target. Panic if the target is not
+   * the start of an instruction.
+   * \param pc The pc of the target.
+   * \return The pointer of the instruction.
+   */
+  ThreadedInst* targetAt_(int pc);
+
+  /*! \brief Resolve all branch and switch targets into pointers. */
+  void resolveTargets_();
+
+  /*!
+   * \brief Fuse the instructions into superinstructions.
+   * \param codeAttr The code, for its exception table.
+   */
+  void fuse_(classfile::CodeAttr* codeAttr);
+
+ public:
+  /*! \brief The code it is translated from, which keeps the counters. */
+  classfile::CodeAttr* codeAttr;
+
+  /*! \brief The constant pool of the class. */
+  classfile::ConstantPool* cp;
+
+  /*! \brief Max number of local variables. */
+  uint16_t maxLocals;
+
+  /*! \brief Max space for the operand stack. */
+  uint16_t maxStack;
+
+  /*! \brief The instructions. */
+  std::vector<ThreadedInst> insts;
+
+  /*!
+   * \brief Keys of tableswitch and lookupswitch.
+   *
+   * A tableswitch stores: low, high. A lookupswitch stores: npairs, matches...
+   */
+  std::vector<int> switchData;
+
+  /*!
+   * \brief Jump targets of tableswitch and lookupswitch: default, targets...
+   * (one target per case, in the order of the code).
+   */
+  std::vector<ThreadedInst*> switchTargets;
+
+  /*! \brief The exception handlers, indexed by pc. */
+  ExceptionIndex exceptions;
+
+  /*!
+   * \brief The inline caches of the invokevirtual and invokeinterface sites,
+   * in the order of the code. Built when translating, so they never move.
+   */
+  std::vector<InlineCache> inlineCaches;
+
+  /*! \brief Whether the handlers have been bound by the engine. */
+  bool linked;
+
+  /*!
+   * \brief The MethodData bound to the instructions. nullptr if the method is
+   * not profiled yet.
+   */
+  MethodData* profile;
+
+  /*!
+   * \brief Default constructor. Translate the code into threaded code.
+   * \param codeAttr The code.
+   * \param superInstructions Whether to fuse superinstructions.
+   */
+  explicit ThreadedCode(classfile::CodeAttr* codeAttr,
+                        bool superInstructions = true);
+
+  /*!
+   * \brief Get the instruction at some pc.
+   * \param pc The pc. It must be the start of an instruction.
+   * \return The pointer of the instruction.
+   */
+  ThreadedInst* at(int pc) { return &insts[pcToIndex_[pc]]; }
+
+  /*!
+   * \brief Bind the branch profiles of a MethodData to the branches, so that
+   * counting a branch needs no lookup. Other threads may run the code at the
+   * same time, and see the profile of a branch a bit later.
+   * \param data The MethodData of the code.
+   */
+  void bindProfile(MethodData* data);
+
+  /*!
+   * \brief Rewrite an instruction into its quick form.
+   *
+   * Other threads may run the instruction at the same time. So the resolved
+   * operands must be stored (atomically) before calling this, and the handler
+   * is published last with release order. A thread either runs the old
+   * handler, which resolves the same operands again, or the quick handler,
+   * which reads the operands after an acquire fence.
+   *
+   * \param inst The instruction.
+   * \param opcode The quick opcode.
+   * \param handler The handler of the quick opcode.
+   */
+  static void quicken(ThreadedInst* inst, uint8_t opcode,
+                      const void* handler) {
+    __atomic_store_n(&inst->opcode, opcode, __ATOMIC_RELAXED);
+    __atomic_store_n(&inst->handler, handler, __ATOMIC_RELEASE);
+  }
+};
+
+}  // namespace vm
+
+}  // namespace coconut
+
+#endif  // SRC_VM_THREADED_CODE_H_
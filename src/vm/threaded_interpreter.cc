@@ -0,0 +1,1502 @@
+/*!
+ *    ________  ________  ________  ________  ________   ___  ___  _________
+ *   |\   ____\|\   __  \|\   ____\|\   __  \|\   ___  \|\  \|\  \|\___   ___\
+ *   \ \  \___|\ \  \|\  \ \  \___|\ \  \|\  \ \  \\ \  \ \  \\\  \|___ \  \_|
+ *    \ \  \    \ \  \\\  \ \  \    \ \  \\\  \ \  \\ \  \ \  \\\  \   \ \  \
+ *     \ \  \____\ \  \\\  \ \  \____\ \  \\\  \ \  \\ \  \ \  \\\  \   \ \  \
+ *      \ \_______\ \_______\ \_______\ \_______\ \__\\ \__\ \_______\   \ \__\
+ *       \|_______|\|_______|\|_______|\|_______|\|__| \|__|\|_______|    \|__|
+ *
+ * \file src/vm/threaded_interpreter.cc
+ * \brief Implementation of threaded_interpreter.h
+ * \author SiriusNEO
+ */
+
+#include "threaded_interpreter.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+
+#include "../bytecode/instructions/control.h"
+#include "../bytecode/instructions/conversions.h"
+#include "../classfile/descriptor.h"
+#include "../utils/misc.h"
+#include "exec_context.h"
+#include "verifier.h"
+
+#if !defined(__GNUC__)
+#error "ThreadedInterpreter requires computed goto (GCC or Clang)."
+#endif
+
+namespace coconut {
+
+namespace vm {
+
+// The native stack an invoke leaves free, for the callee's run_ and anything
+// it calls out to (e.g. the classic engine, or raising an exception).
+static const size_t kNativeStackReserve = 64 * 1024;
+
+ThreadedInterpreter::~ThreadedInterpreter() {
+  for (auto& entry : codeCache_) {
+    delete entry.second;
+  }
+}
+
+ThreadedCode* ThreadedInterpreter::translate(classfile::CodeAttr* codeAttr) {
+  ThreadedCode*& code = codeCache_[codeAttr];
+  if (code == nullptr) {
+    code = new ThreadedCode(codeAttr, superInstructions_);
+  }
+  return code;
+}
+
+void ThreadedInterpreter::dumpInlineCaches(std::ostream& os) const {
+  for (const auto& entry : codeCache_) {
+    const classfile::CodeAttr* codeAttr = entry.first;
+    std::string method = "<unknown>";
+    if (codeAttr->cp != nullptr && codeAttr->methodNameIdx != 0) {
+      method = codeAttr->cp->getLiteral(codeAttr->methodNameIdx) +
+               codeAttr->cp->getLiteral(codeAttr->methodDescriptorIdx);
+    }
+    for (const InlineCache& cache : entry.second->inlineCaches) {
+      os << method << " pc " << cache.pc << ": " << cache.size()
+         << " classes, " << cache.hits << " hits, " << cache.misses
+         << " misses, " << cache.vtableCalls << " vtable calls"
+         << (cache.megamorphic() ? " (megamorphic)" : "") << "\n";
+    }
+  }
+}
+
+void ThreadedInterpreter::dumpProfiles(std::ostream& os, int limit) const {
+  std::vector<const classfile::CodeAttr*> codes;
+  for (const auto& entry : codeCache_) {
+    codes.push_back(entry.first);
+  }
+  vm::dumpProfiles(codes, os, limit);
+}
+
+// Number of backedges a frame counts before adding them to its code.
+static const int kBackedgeBatch = 256;
+
+// Increment a counter of a code, without an atomic read-modify-write.
+static void increment(uint64_t* counter) {
+  __atomic_store_n(counter, __atomic_load_n(counter, __ATOMIC_RELAXED) + 1,
+                   __ATOMIC_RELAXED);
+}
+
+// Get the MethodData of a code if it is warm, and bind it to the threaded code.
+static MethodData* warmUp(ThreadedCode* code, uint64_t threshold) {
+  MethodData* profile = MethodData::allocate(code->codeAttr, threshold);
+  if (profile != nullptr &&
+      __atomic_load_n(&code->profile, __ATOMIC_RELAXED) != profile) {
+    code->bindProfile(profile);
+  }
+  return profile;
+}
+
+// The miss path of an inline cache: find the method a receiver class
+// dispatches to in its vtable (or the itable of the interface), and cache it.
+static classfile::CodeAttr* dispatchVirtual(InlineCache* cache,
+                                            rtda::Class* receiverClass) {
+  // TODO: objects without a class come from native code only.
+  CHECK(receiverClass != nullptr) << "invoke on an object of no class";
+  const rtda::Class* resolvedClass =
+      __atomic_load_n(&cache->resolvedClass, __ATOMIC_RELAXED);
+  int slot = __atomic_load_n(&cache->vtableSlot, __ATOMIC_RELAXED);
+  rtda::ClassTable::instance().link(receiverClass);
+  const rtda::VTableEntry* entry;
+  // TODO: throw java.lang.IncompatibleClassChangeError. The verifier does not
+  // track the classes of references.
+  if (resolvedClass->isInterface) {
+    const rtda::ITable* itable =
+        receiverClass->findITable(resolvedClass, &cache->itableIndex);
+    CHECK(itable != nullptr)
+        << "Receiver " << receiverClass->name << " does not implement "
+        << resolvedClass->name;
+    entry = &itable->methods[slot];
+  } else {
+    CHECK(receiverClass->isSubtypeOf(resolvedClass))
+        << "Receiver " << receiverClass->name << " is not a "
+        << resolvedClass->name;
+    entry = &receiverClass->vtable[slot];
+  }
+  // TODO: native methods.
+  CHECK(entry->code != nullptr)
+      << "java.lang.AbstractMethodError: " << receiverClass->name << "."
+      << entry->method->fieldName() << entry->method->descriptor();
+  if (__atomic_load_n(&entry->code->verifyStatus, __ATOMIC_ACQUIRE) ==
+      classfile::kVerifyPending) {
+    verifyMethod(entry->method);
+  }
+  if (!cache->megamorphic()) {
+    cache->add(receiverClass, entry->code);
+  }
+  return entry->code;
+}
+
+// Resolve and link the class of checkcast or instanceof.
+static rtda::Class* resolveTypeCheck(classfile::ConstantPool* cp,
+                                     const ThreadedInst* inst) {
+  CHECK(cp->infoList[inst->operand1]->tag == classfile::CONSTANT_TAG_Class)
+      << "Bad type check constant";
+  std::string className = cp->getClassNameStr(inst->operand1);
+  // TODO: array classes.
+  CHECK(className[0] != '[')
+      << "Unsupported type check of an array class: " << className;
+  rtda::Class* cls = rtda::ClassTable::instance().resolve(className);
+  rtda::ClassTable::instance().link(cls);
+  return cls;
+}
+
+void ThreadedInterpreter::execute(rtda::Thread* thread,
+                                  classfile::CodeAttr* codeAttr) {
+  thread->stack.topFrame->code = codeAttr;
+  increment(&codeAttr->invocationCount);
+  if (__atomic_load_n(&codeAttr->verifyStatus, __ATOMIC_ACQUIRE) !=
+      classfile::kVerifyPassed) {
+    // the loop does no runtime checks: unverified code takes the checked path
+    Interpreter::execute(thread, codeAttr);
+    return;
+  }
+  if (jit) {
+    CompiledCode* compiled = policy.onInvocation(codeAttr);
+    if (compiled != nullptr && runCompiled_(thread, compiled)) return;
+  }
+  run_(thread, translate(codeAttr));
+}
+
+bool ThreadedInterpreter::runCompiled_(rtda::Thread* thread,
+                                       CompiledCode* compiled) {
+  rtda::StackFrame* frame = thread->stack.topFrame;
+  rtda::Slot* stack = frame->operandStack->slots();
+  int status = compiled->run(frame->localVariableTable->slots(), stack);
+  if (status == kCompiledReturnInt || status == kCompiledReturnVoid) {
+    thread->stack.pop();
+    if (status == kCompiledReturnInt && !thread->stack.isEmpty()) {
+      thread->stack.topFrame->operandStack->pushInt(int(stack[0].bytes));
+    }
+    return true;
+  }
+  // it bailed out: the frame is in memory, resume it at the pc
+  frame->nextPc = status;
+  frame->operandStack->setTop(stack + compiled->stackDepths[status]);
+  return false;
+}
+
+// Jump to the handler of current instruction. The handler may be rewritten by
+// other threads (see ThreadedCode::quicken), so it is loaded atomically.
+#define DISPATCH() goto* __atomic_load_n(&ctx.pc->handler, __ATOMIC_RELAXED)
+
+// Go to the next instruction.
+#define NEXT()  \
+  do {          \
+    ++ctx.pc;   \
+    DISPATCH(); \
+  } while (0)
+
+// Go to a target instruction, resolved when translating.
+#define BRANCH(target) \
+  do {                 \
+    ctx.pc = (target); \
+    DISPATCH();        \
+  } while (0)
+
+// Take a branch of the code. A backward one closes a loop: count the backedge,
+// start profiling the method if it gets warm, and tell the tiered policy,
+// which may give an OSR entry at the loop header to continue the frame in.
+// Backedges are counted in a register, and added to the counter of the code
+// in batches.
+#define JUMP(target)                                           \
+  do {                                                         \
+    ThreadedInst* target_ = (target);                          \
+    if (target_ <= ctx.pc && ++backedges == kBackedgeBatch) {  \
+      FLUSH_BACKEDGES();                                       \
+      if (profile == nullptr) {                                \
+        profile = warmUp(code, profileThreshold);              \
+      }                                                        \
+      if (jit) {                                               \
+        osr = policy.onBackedges(code->codeAttr, target_->pc); \
+        if (osr != nullptr) {                                  \
+          ctx.pc = target_;                                    \
+          goto L_osr;                                          \
+        }                                                      \
+      }                                                        \
+    }                                                          \
+    BRANCH(target_);                                           \
+  } while (0)
+
+// Add the backedges counted in the register to the counter of the code.
+#define FLUSH_BACKEDGES()                                                  \
+  do {                                                                     \
+    uint64_t* counter_ = &code->codeAttr->backedgeCount;                   \
+    __atomic_store_n(                                                      \
+        counter_, __atomic_load_n(counter_, __ATOMIC_RELAXED) + backedges, \
+        __ATOMIC_RELAXED);                                                 \
+    backedges = 0;                                                         \
+  } while (0)
+
+// Binary operation: value1, value2 -> result.
+#define BINARY_OP(type, pop, push, expr) \
+  {                                      \
+    type value2 = ctx.pop();             \
+    type value1 = ctx.pop();             \
+    ctx.push(expr);                      \
+    NEXT();                              \
+  }
+
+// Shift operation: value1, value2 (int) -> result.
+#define SHIFT_OP(type, pop, push, expr) \
+  {                                     \
+    int value2 = ctx.popInt();          \
+    type value1 = ctx.pop();            \
+    ctx.push(expr);                     \
+    NEXT();                             \
+  }
+
+// Skip the rest parts of a superinstruction of length n.
+#define NEXT_N(n)  \
+  do {             \
+    ctx.pc += (n); \
+    DISPATCH();    \
+  } while (0)
+
+// Conditional branch of a superinstruction of length n. The branch is its last
+// part.
+#define FUSED_BRANCH_IF(cond, n)   \
+  {                                \
+    bool taken = (cond);           \
+    COUNT_BRANCH(ctx.pc[(n) - 1]); \
+    if (taken) {                   \
+      JUMP(ctx.pc->target);        \
+    }                              \
+    NEXT_N(n);                     \
+  }
+
+// Go to the next instruction, whose top of stack is cached (TOS caching).
+#define NEXT_CACHED()            \
+  do {                           \
+    ++ctx.pc;                    \
+    goto* ctx.pc->cachedHandler; \
+  } while (0)
+
+// Binary operation with the top of stack cached: value1, tos -> tos.
+#define CACHED_BINARY_OP(expr) \
+  {                            \
+    int value2 = tos;          \
+    int value1 = ctx.popInt(); \
+    tos = (expr);              \
+    NEXT_CACHED();             \
+  }
+
+// Count the outcome (taken) of a conditional branch in its profile, if the
+// method is profiled.
+#define COUNT_BRANCH(inst)                                                  \
+  do {                                                                      \
+    void* branch_ = __atomic_load_n(&(inst).resolved, __ATOMIC_RELAXED);    \
+    if (branch_ != nullptr) {                                               \
+      MethodData::countBranch(static_cast<BranchProfile*>(branch_), taken); \
+    }                                                                       \
+  } while (0)
+
+// Conditional branch.
+#define BRANCH_IF(cond)     \
+  {                         \
+    bool taken = (cond);    \
+    COUNT_BRANCH(*ctx.pc);  \
+    if (taken) {            \
+      JUMP(ctx.pc->target); \
+    }                       \
+    NEXT();                 \
+  }
+
+// Throw an exception raised by the VM, with the stack trace at this pc.
+#define THROW_VM(kind)                  \
+  do {                                  \
+    ctx.save(thread->stack.topFrame);   \
+    thrown = thread->raise(rtda::kind); \
+    goto L_throw;                       \
+  } while (0)
+
+// Return a value to the invoker frame.
+#define RETURN_VALUE(type, popFunc, pushFunc)                \
+  {                                                          \
+    type value = ctx.popFunc();                              \
+    FLUSH_BACKEDGES();                                       \
+    thread->stack.pop();                                     \
+    if (!thread->stack.isEmpty()) {                          \
+      thread->stack.topFrame->operandStack->pushFunc(value); \
+    }                                                        \
+    return;                                                  \
+  }
+
+void ThreadedInterpreter::run_(rtda::Thread* thread, ThreadedCode* code) {
+  // Handler table, indexed by opcode.
+  static const void* handlers[256];
+  // Handler tables of the TOS caching mode: the handlers when the top of stack
+  // is in memory (some of them put the result in the register instead), and
+  // the handlers when the top of stack is cached in the register.
+  static const void* tosHandlers[256];
+  static const void* cachedHandlers[256];
+  // They are filled by the initializer of a local static, which runs once
+  // while other threads wait for it. It can not be a function of its own: the
+  // labels are local to this one.
+  static const bool handlersReady = ({
+    // Anything not below, e.g. the array instructions, fails verification and
+    // runs on the classic engine
+    for (int i = 0; i < 256; ++i) handlers[i] = &&L_unsupported;
+    // Constants
+    handlers[0x00] = &&L_nop;
+    handlers[0x01] = &&L_aconst_null;
+    for (int i = 0x02; i <= 0x08; ++i) handlers[i] = &&L_iconst;
+    handlers[0x09] = handlers[0x0a] = &&L_lconst;
+    handlers[0x0b] = handlers[0x0c] = handlers[0x0d] = &&L_fconst;
+    handlers[0x0e] = handlers[0x0f] = &&L_dconst;
+    handlers[0x10] = handlers[0x11] = &&L_iconst;  // bipush, sipush
+    handlers[0x12] = handlers[0x13] = &&L_ldc;     // ldc, ldc_w
+    handlers[0x14] = &&L_ldc2_w;
+    // Loads
+    handlers[0x15] = &&L_iload;
+    handlers[0x16] = &&L_lload;
+    handlers[0x17] = &&L_fload;
+    handlers[0x18] = &&L_dload;
+    handlers[0x19] = &&L_aload;
+    for (int i = 0; i < 4; ++i) {
+      handlers[0x1a + i] = &&L_iload;
+      handlers[0x1e + i] = &&L_lload;
+      handlers[0x22 + i] = &&L_fload;
+      handlers[0x26 + i] = &&L_dload;
+      handlers[0x2a + i] = &&L_aload;
+    }
+    // Stores
+    handlers[0x36] = &&L_istore;
+    handlers[0x37] = &&L_lstore;
+    handlers[0x38] = &&L_fstore;
+    handlers[0x39] = &&L_dstore;
+    handlers[0x3a] = &&L_astore;
+    for (int i = 0; i < 4; ++i) {
+      handlers[0x3b + i] = &&L_istore;
+      handlers[0x3f + i] = &&L_lstore;
+      handlers[0x43 + i] = &&L_fstore;
+      handlers[0x47 + i] = &&L_dstore;
+      handlers[0x4b + i] = &&L_astore;
+    }
+    // Stack
+    handlers[0x57] = &&L_pop;
+    handlers[0x58] = &&L_pop2;
+    handlers[0x59] = &&L_dup;
+    handlers[0x5a] = &&L_dup_x1;
+    handlers[0x5b] = &&L_dup_x2;
+    handlers[0x5c] = &&L_dup2;
+    handlers[0x5d] = &&L_dup2_x1;
+    handlers[0x5e] = &&L_dup2_x2;
+    handlers[0x5f] = &&L_swap;
+    // Math
+    handlers[0x60] = &&L_iadd;
+    handlers[0x61] = &&L_ladd;
+    handlers[0x62] = &&L_fadd;
+    handlers[0x63] = &&L_dadd;
+    handlers[0x64] = &&L_isub;
+    handlers[0x65] = &&L_lsub;
+    handlers[0x66] = &&L_fsub;
+    handlers[0x67] = &&L_dsub;
+    handlers[0x68] = &&L_imul;
+    handlers[0x69] = &&L_lmul;
+    handlers[0x6a] = &&L_fmul;
+    handlers[0x6b] = &&L_dmul;
+    handlers[0x6c] = &&L_idiv;
+    handlers[0x6d] = &&L_ldiv;
+    handlers[0x6e] = &&L_fdiv;
+    handlers[0x6f] = &&L_ddiv;
+    handlers[0x70] = &&L_irem;
+    handlers[0x71] = &&L_lrem;
+    handlers[0x72] = &&L_frem;
+    handlers[0x73] = &&L_drem;
+    handlers[0x74] = &&L_ineg;
+    handlers[0x75] = &&L_lneg;
+    handlers[0x76] = &&L_fneg;
+    handlers[0x77] = &&L_dneg;
+    handlers[0x78] = &&L_ishl;
+    handlers[0x79] = &&L_lshl;
+    handlers[0x7a] = &&L_ishr;
+    handlers[0x7b] = &&L_lshr;
+    handlers[0x7c] = &&L_iushr;
+    handlers[0x7d] = &&L_lushr;
+    handlers[0x7e] = &&L_iand;
+    handlers[0x7f] = &&L_land;
+    handlers[0x80] = &&L_ior;
+    handlers[0x81] = &&L_lor;
+    handlers[0x82] = &&L_ixor;
+    handlers[0x83] = &&L_lxor;
+    handlers[0x84] = &&L_iinc;
+    // Conversions
+    handlers[0x85] = &&L_i2l;
+    handlers[0x86] = &&L_i2f;
+    handlers[0x87] = &&L_i2d;
+    handlers[0x88] = &&L_l2i;
+    handlers[0x89] = &&L_l2f;
+    handlers[0x8a] = &&L_l2d;
+    handlers[0x8b] = &&L_f2i;
+    handlers[0x8c] = &&L_f2l;
+    handlers[0x8d] = &&L_f2d;
+    handlers[0x8e] = &&L_d2i;
+    handlers[0x8f] = &&L_d2l;
+    handlers[0x90] = &&L_d2f;
+    handlers[0x91] = &&L_i2b;
+    handlers[0x92] = &&L_i2c;
+    handlers[0x93] = &&L_i2s;
+    // Comparisons
+    handlers[0x94] = &&L_lcmp;
+    handlers[0x95] = &&L_fcmpl;
+    handlers[0x96] = &&L_fcmpg;
+    handlers[0x97] = &&L_dcmpl;
+    handlers[0x98] = &&L_dcmpg;
+    handlers[0x99] = &&L_ifeq;
+    handlers[0x9a] = &&L_ifne;
+    handlers[0x9b] = &&L_iflt;
+    handlers[0x9c] = &&L_ifge;
+    handlers[0x9d] = &&L_ifgt;
+    handlers[0x9e] = &&L_ifle;
+    handlers[0x9f] = &&L_if_icmpeq;
+    handlers[0xa0] = &&L_if_icmpne;
+    handlers[0xa1] = &&L_if_icmplt;
+    handlers[0xa2] = &&L_if_icmpge;
+    handlers[0xa3] = &&L_if_icmpgt;
+    handlers[0xa4] = &&L_if_icmple;
+    handlers[0xa5] = &&L_if_acmpeq;
+    handlers[0xa6] = &&L_if_acmpne;
+    // Control
+    handlers[0xa7] = &&L_goto;
+    handlers[0xaa] = &&L_tableswitch;
+    handlers[0xab] = &&L_lookupswitch;
+    handlers[0xac] = &&L_ireturn;
+    handlers[0xad] = &&L_lreturn;
+    handlers[0xae] = &&L_freturn;
+    handlers[0xaf] = &&L_dreturn;
+    handlers[0xb0] = &&L_areturn;
+    handlers[0xb1] = &&L_return;
+    // References
+    handlers[0xb6] = &&L_invokevirtual;
+    handlers[0xb8] = &&L_invokestatic;
+    handlers[0xb9] = &&L_invokeinterface;
+    handlers[0xbf] = &&L_athrow;
+    handlers[0xc0] = &&L_checkcast;
+    handlers[0xc1] = &&L_instanceof;
+    // Extended
+    handlers[0xc6] = &&L_ifnull;
+    handlers[0xc7] = &&L_ifnonnull;
+    handlers[0xc8] = &&L_goto;  // goto_w
+    // Superinstructions
+#define SUPERINST(name, enabled, length, op1, op2, op3, op4) \
+  handlers[kSuper_##name] = &&L_##name;
+#include "superinstructions.def"
+#undef SUPERINST
+    // Quick instructions
+    handlers[kQuick_ldc] = &&L_ldc_quick;
+    handlers[kQuick_ldc2_w] = &&L_ldc2_w_quick;
+    handlers[kQuick_invokestatic] = &&L_invokestatic_quick;
+    handlers[kQuick_invokevirtual] = &&L_invokevirtual_quick;
+    handlers[kQuick_checkcast] = &&L_checkcast_quick;
+    handlers[kQuick_instanceof] = &&L_instanceof_quick;
+
+    // TOS caching: push int results to the register
+    for (int i = 0; i < 256; ++i) tosHandlers[i] = handlers[i];
+    for (int i = 0x02; i <= 0x08; ++i) tosHandlers[i] = &&L_iconst_cache;
+    tosHandlers[0x10] = tosHandlers[0x11] = &&L_iconst_cache;
+    tosHandlers[0x15] = &&L_iload_cache;
+    for (int i = 0x1a; i <= 0x1d; ++i) tosHandlers[i] = &&L_iload_cache;
+    tosHandlers[kSuper_iload_iload] = &&L_iload_iload_cache;
+    tosHandlers[kSuper_iload_iload_iadd] = &&L_iload_iload_iadd_cache;
+
+    // TOS caching: the top of stack is in the register. Others spill it.
+    for (int i = 0; i < 256; ++i) cachedHandlers[i] = &&T_spill;
+    cachedHandlers[0x00] = &&T_nop;
+    for (int i = 0x02; i <= 0x08; ++i) cachedHandlers[i] = &&T_iconst;
+    cachedHandlers[0x10] = cachedHandlers[0x11] = &&T_iconst;
+    cachedHandlers[0x15] = &&T_iload;
+    for (int i = 0x1a; i <= 0x1d; ++i) cachedHandlers[i] = &&T_iload;
+    cachedHandlers[0x36] = &&T_istore;
+    for (int i = 0x3b; i <= 0x3e; ++i) cachedHandlers[i] = &&T_istore;
+    cachedHandlers[0x57] = &&T_pop;
+    cachedHandlers[0x59] = &&T_dup;
+    cachedHandlers[0x60] = &&T_iadd;
+    cachedHandlers[0x64] = &&T_isub;
+    cachedHandlers[0x68] = &&T_imul;
+    cachedHandlers[0x74] = &&T_ineg;
+    cachedHandlers[0x78] = &&T_ishl;
+    cachedHandlers[0x7a] = &&T_ishr;
+    cachedHandlers[0x7c] = &&T_iushr;
+    cachedHandlers[0x7e] = &&T_iand;
+    cachedHandlers[0x80] = &&T_ior;
+    cachedHandlers[0x82] = &&T_ixor;
+    cachedHandlers[0x84] = &&T_iinc;
+    cachedHandlers[0x99] = &&T_ifeq;
+    cachedHandlers[0x9a] = &&T_ifne;
+    cachedHandlers[0x9b] = &&T_iflt;
+    cachedHandlers[0x9c] = &&T_ifge;
+    cachedHandlers[0x9d] = &&T_ifgt;
+    cachedHandlers[0x9e] = &&T_ifle;
+    cachedHandlers[0x9f] = &&T_if_icmpeq;
+    cachedHandlers[0xa0] = &&T_if_icmpne;
+    cachedHandlers[0xa1] = &&T_if_icmplt;
+    cachedHandlers[0xa2] = &&T_if_icmpge;
+    cachedHandlers[0xa3] = &&T_if_icmpgt;
+    cachedHandlers[0xa4] = &&T_if_icmple;
+    cachedHandlers[0xac] = &&T_ireturn;
+    true;
+  });
+  (void)handlersReady;
+
+  if (!code->linked) {
+    for (auto& inst : code->insts) {
+      if (tosCaching_) {
+        inst.handler = tosHandlers[inst.opcode];
+        inst.cachedHandler = cachedHandlers[inst.opcode];
+      } else {
+        inst.handler = handlers[inst.opcode];
+        inst.cachedHandler = &&T_spill;
+      }
+    }
+    code->linked = true;
+  }
+
+  ExecContext ctx(thread->stack.topFrame, code);
+  // the profile of the method, nullptr until it is warm
+  MethodData* profile = warmUp(code, profileThreshold);
+  // the backedges not added to the counter of the code yet
+  int backedges = 0;
+  // the cached top of stack (an int), valid in the cachedHandler states
+  int tos = 0;
+  // the exception being thrown, valid at L_throw
+  rtda::Object* thrown = nullptr;
+  // the method to invoke and its argument slots, valid at L_invoke
+  classfile::CodeAttr* callee = nullptr;
+  int argSlots = 0;
+  // the compiled code to continue the frame in, valid at L_osr
+  CompiledCode* osr = nullptr;
+
+  DISPATCH();
+
+  /* Constants */
+
+L_nop:
+  NEXT();
+
+L_aconst_null:
+  ctx.pushRef(nullptr);
+  NEXT();
+
+L_iconst:
+  ctx.pushInt(ctx.pc->operand1);
+  NEXT();
+
+L_lconst:
+  ctx.pushLong(ctx.pc->operand1);
+  NEXT();
+
+L_fconst:
+  ctx.pushFloat(float(ctx.pc->operand1));
+  NEXT();
+
+L_dconst:
+  ctx.pushDouble(double(ctx.pc->operand1));
+  NEXT();
+
+L_ldc : {
+  CHECK(ctx.cp != nullptr) << "ldc without constant pool";
+  classfile::ConstantInfo* info = ctx.cp->infoList[ctx.pc->operand1];
+  int bits = 0;
+  if (info->tag == classfile::CONSTANT_TAG_Integer) {
+    bits = static_cast<classfile::ConstantIntegerInfo*>(info)->val;
+  } else if (info->tag == classfile::CONSTANT_TAG_Float) {
+    float val = static_cast<classfile::ConstantFloatInfo*>(info)->val;
+    std::memcpy(&bits, &val, sizeof(bits));
+  } else {
+    // TODO: String and Class constants need the heap.
+    thread->pc = ctx.pc->pc;
+    ctx.save(thread->stack.topFrame);
+    LOG(FATAL) << "Unsupported ldc constant, tag: " << int(info->tag);
+  }
+  __atomic_store_n(&ctx.pc->operand2, bits, __ATOMIC_RELAXED);
+  ThreadedCode::quicken(ctx.pc, kQuick_ldc, handlers[kQuick_ldc]);
+  DISPATCH();
+}
+
+L_ldc2_w : {
+  CHECK(ctx.cp != nullptr) << "ldc2_w without constant pool";
+  classfile::ConstantInfo* info = ctx.cp->infoList[ctx.pc->operand1];
+  long long bits;
+  if (info->tag == classfile::CONSTANT_TAG_Long) {
+    bits = static_cast<classfile::ConstantLongInfo*>(info)->val;
+  } else {
+    CHECK(info->tag == classfile::CONSTANT_TAG_Double)
+        << "Bad ldc2_w constant, tag: " << int(info->tag);
+    double val = static_cast<classfile::ConstantDoubleInfo*>(info)->val;
+    std::memcpy(&bits, &val, sizeof(bits));
+  }
+  __atomic_store_n(&ctx.pc->operand2, int(bits), __ATOMIC_RELAXED);
+  __atomic_store_n(&ctx.pc->operand3, int(bits >> 32), __ATOMIC_RELAXED);
+  ThreadedCode::quicken(ctx.pc, kQuick_ldc2_w, handlers[kQuick_ldc2_w]);
+  DISPATCH();
+}
+
+L_ldc_quick:
+  __atomic_thread_fence(__ATOMIC_ACQUIRE);
+  ctx.pushInt(__atomic_load_n(&ctx.pc->operand2, __ATOMIC_RELAXED));
+  NEXT();
+
+L_ldc2_w_quick : {
+  __atomic_thread_fence(__ATOMIC_ACQUIRE);
+  unsigned int low = __atomic_load_n(&ctx.pc->operand2, __ATOMIC_RELAXED);
+  long long high = __atomic_load_n(&ctx.pc->operand3, __ATOMIC_RELAXED);
+  ctx.pushLong((high << 32) | low);
+  NEXT();
+}
+
+  /* Loads */
+
+L_iload:
+  ctx.pushInt(ctx.getInt(ctx.pc->operand1));
+  NEXT();
+
+L_lload:
+  ctx.pushLong(ctx.getLong(ctx.pc->operand1));
+  NEXT();
+
+L_fload:
+  ctx.pushFloat(ctx.getFloat(ctx.pc->operand1));
+  NEXT();
+
+L_dload:
+  ctx.pushDouble(ctx.getDouble(ctx.pc->operand1));
+  NEXT();
+
+L_aload:
+  ctx.pushRef(ctx.getRef(ctx.pc->operand1));
+  NEXT();
+
+  /* Stores */
+
+L_istore:
+  ctx.setInt(ctx.pc->operand1, ctx.popInt());
+  NEXT();
+
+L_lstore:
+  ctx.setLong(ctx.pc->operand1, ctx.popLong());
+  NEXT();
+
+L_fstore:
+  ctx.setFloat(ctx.pc->operand1, ctx.popFloat());
+  NEXT();
+
+L_dstore:
+  ctx.setDouble(ctx.pc->operand1, ctx.popDouble());
+  NEXT();
+
+L_astore:
+  ctx.setRef(ctx.pc->operand1, ctx.popRef());
+  NEXT();
+
+  /* Stack */
+
+L_pop:
+  ctx.popSlot();
+  NEXT();
+
+L_pop2:
+  ctx.popSlot();
+  ctx.popSlot();
+  NEXT();
+
+L_dup : {
+  rtda::Slot value = ctx.popSlot();
+  ctx.pushSlot(value);
+  ctx.pushSlot(value);
+  NEXT();
+}
+
+L_dup_x1 : {
+  rtda::Slot value1 = ctx.popSlot(), value2 = ctx.popSlot();
+  ctx.pushSlot(value1);
+  ctx.pushSlot(value2);
+  ctx.pushSlot(value1);
+  NEXT();
+}
+
+L_dup_x2 : {
+  rtda::Slot value1 = ctx.popSlot(), value2 = ctx.popSlot(),
+             value3 = ctx.popSlot();
+  ctx.pushSlot(value1);
+  ctx.pushSlot(value3);
+  ctx.pushSlot(value2);
+  ctx.pushSlot(value1);
+  NEXT();
+}
+
+L_dup2 : {
+  rtda::Slot value1 = ctx.popSlot(), value2 = ctx.popSlot();
+  ctx.pushSlot(value2);
+  ctx.pushSlot(value1);
+  ctx.pushSlot(value2);
+  ctx.pushSlot(value1);
+  NEXT();
+}
+
+L_dup2_x1 : {
+  rtda::Slot value1 = ctx.popSlot(), value2 = ctx.popSlot(),
+             value3 = ctx.popSlot();
+  ctx.pushSlot(value2);
+  ctx.pushSlot(value1);
+  ctx.pushSlot(value3);
+  ctx.pushSlot(value2);
+  ctx.pushSlot(value1);
+  NEXT();
+}
+
+L_dup2_x2 : {
+  rtda::Slot value1 = ctx.popSlot(), value2 = ctx.popSlot(),
+             value3 = ctx.popSlot(), value4 = ctx.popSlot();
+  ctx.pushSlot(value2);
+  ctx.pushSlot(value1);
+  ctx.pushSlot(value4);
+  ctx.pushSlot(value3);
+  ctx.pushSlot(value2);
+  ctx.pushSlot(value1);
+  NEXT();
+}
+
+L_swap : {
+  rtda::Slot value1 = ctx.popSlot(), value2 = ctx.popSlot();
+  ctx.pushSlot(value1);
+  ctx.pushSlot(value2);
+  NEXT();
+}
+
+  /* Math */
+
+L_iadd:
+  BINARY_OP(int, popInt, pushInt, value1 + value2);
+L_ladd:
+  BINARY_OP(long long, popLong, pushLong, value1 + value2);
+L_fadd:
+  BINARY_OP(float, popFloat, pushFloat, value1 + value2);
+L_dadd:
+  BINARY_OP(double, popDouble, pushDouble, value1 + value2);
+
+L_isub:
+  BINARY_OP(int, popInt, pushInt, value1 - value2);
+L_lsub:
+  BINARY_OP(long long, popLong, pushLong, value1 - value2);
+L_fsub:
+  BINARY_OP(float, popFloat, pushFloat, value1 - value2);
+L_dsub:
+  BINARY_OP(double, popDouble, pushDouble, value1 - value2);
+
+L_imul:
+  BINARY_OP(int, popInt, pushInt, value1 * value2);
+L_lmul:
+  BINARY_OP(long long, popLong, pushLong, value1 * value2);
+L_fmul:
+  BINARY_OP(float, popFloat, pushFloat, value1 * value2);
+L_dmul:
+  BINARY_OP(double, popDouble, pushDouble, value1 * value2);
+
+L_idiv : {
+  int value2 = ctx.popInt(), value1 = ctx.popInt();
+  if (value2 == 0) THROW_VM(kArithmeticException);
+  // INT_MIN / -1 overflows, which traps on x86: Java wraps it to INT_MIN
+  ctx.pushInt(value2 == -1 ? int(0u - value1) : value1 / value2);
+  NEXT();
+}
+
+L_ldiv : {
+  long long value2 = ctx.popLong(), value1 = ctx.popLong();
+  if (value2 == 0) THROW_VM(kArithmeticException);
+  ctx.pushLong(value2 == -1 ? (long long)(0ull - value1) : value1 / value2);
+  NEXT();
+}
+
+L_fdiv:
+  BINARY_OP(float, popFloat, pushFloat, value1 / value2);
+L_ddiv:
+  BINARY_OP(double, popDouble, pushDouble, value1 / value2);
+
+L_irem : {
+  int value2 = ctx.popInt(), value1 = ctx.popInt();
+  if (value2 == 0) THROW_VM(kArithmeticException);
+  ctx.pushInt(value2 == -1 ? 0 : value1 % value2);
+  NEXT();
+}
+
+L_lrem : {
+  long long value2 = ctx.popLong(), value1 = ctx.popLong();
+  if (value2 == 0) THROW_VM(kArithmeticException);
+  ctx.pushLong(value2 == -1 ? 0 : value1 % value2);
+  NEXT();
+}
+
+L_frem:
+  BINARY_OP(float, popFloat, pushFloat, std::fmod(value1, value2));
+L_drem:
+  BINARY_OP(double, popDouble, pushDouble, std::fmod(value1, value2));
+
+L_ineg:
+  ctx.pushInt(-ctx.popInt());
+  NEXT();
+L_lneg:
+  ctx.pushLong(-ctx.popLong());
+  NEXT();
+L_fneg:
+  ctx.pushFloat(-ctx.popFloat());
+  NEXT();
+L_dneg:
+  ctx.pushDouble(-ctx.popDouble());
+  NEXT();
+
+L_ishl:
+  SHIFT_OP(int, popInt, pushInt, value1 << (value2 & 0x1f));
+L_lshl:
+  SHIFT_OP(long long, popLong, pushLong, value1 << (value2 & 0x3f));
+L_ishr:
+  SHIFT_OP(int, popInt, pushInt, value1 >> (value2 & 0x1f));
+L_lshr:
+  SHIFT_OP(long long, popLong, pushLong, value1 >> (value2 & 0x3f));
+L_iushr:
+  SHIFT_OP(int, popInt, pushInt,
+           int((unsigned int)(value1) >> (value2 & 0x1f)));
+L_lushr:
+  SHIFT_OP(long long, popLong, pushLong,
+           (long long)((unsigned long long)(value1) >> (value2 & 0x3f)));
+
+L_iand:
+  BINARY_OP(int, popInt, pushInt, value1 & value2);
+L_land:
+  BINARY_OP(long long, popLong, pushLong, value1 & value2);
+L_ior:
+  BINARY_OP(int, popInt, pushInt, value1 | value2);
+L_lor:
+  BINARY_OP(long long, popLong, pushLong, value1 | value2);
+L_ixor:
+  BINARY_OP(int, popInt, pushInt, value1 ^ value2);
+L_lxor:
+  BINARY_OP(long long, popLong, pushLong, value1 ^ value2);
+
+L_iinc:
+  ctx.setInt(ctx.pc->operand1, ctx.getInt(ctx.pc->operand1) + ctx.pc->operand2);
+  NEXT();
+
+  /* Conversions */
+
+L_i2l:
+  ctx.pushLong(ctx.popInt());
+  NEXT();
+L_i2f:
+  ctx.pushFloat(ctx.popInt());
+  NEXT();
+L_i2d:
+  ctx.pushDouble(ctx.popInt());
+  NEXT();
+L_l2i:
+  ctx.pushInt(ctx.popLong());
+  NEXT();
+L_l2f:
+  ctx.pushFloat(ctx.popLong());
+  NEXT();
+L_l2d:
+  ctx.pushDouble(ctx.popLong());
+  NEXT();
+L_f2i:
+  ctx.pushInt(bytecode::saturatingCast<int>(ctx.popFloat()));
+  NEXT();
+L_f2l:
+  ctx.pushLong(bytecode::saturatingCast<long long>(ctx.popFloat()));
+  NEXT();
+L_f2d:
+  ctx.pushDouble(ctx.popFloat());
+  NEXT();
+L_d2i:
+  ctx.pushInt(bytecode::saturatingCast<int>(ctx.popDouble()));
+  NEXT();
+L_d2l:
+  ctx.pushLong(bytecode::saturatingCast<long long>(ctx.popDouble()));
+  NEXT();
+L_d2f:
+  ctx.pushFloat(ctx.popDouble());
+  NEXT();
+L_i2b:
+  ctx.pushInt(int8_t(ctx.popInt()));
+  NEXT();
+L_i2c:
+  ctx.pushInt(uint16_t(ctx.popInt()));
+  NEXT();
+L_i2s:
+  ctx.pushInt(int16_t(ctx.popInt()));
+  NEXT();
+
+  /* Comparisons */
+
+L_lcmp : {
+  long long value2 = ctx.popLong(), value1 = ctx.popLong();
+  ctx.pushInt(value1 == value2 ? 0 : (value1 < value2 ? -1 : 1));
+  NEXT();
+}
+
+L_fcmpl:
+L_fcmpg : {
+  float value2 = ctx.popFloat(), value1 = ctx.popFloat();
+  // IEEE 754: NaN is unordered
+  if (std::isnan(value1) || std::isnan(value2)) {
+    ctx.pushInt(ctx.pc->opcode == 0x96 ? 1 : -1);
+  } else {
+    ctx.pushInt(value1 == value2 ? 0 : (value1 < value2 ? -1 : 1));
+  }
+  NEXT();
+}
+
+L_dcmpl:
+L_dcmpg : {
+  double value2 = ctx.popDouble(), value1 = ctx.popDouble();
+  // IEEE 754: NaN is unordered
+  if (std::isnan(value1) || std::isnan(value2)) {
+    ctx.pushInt(ctx.pc->opcode == 0x98 ? 1 : -1);
+  } else {
+    ctx.pushInt(value1 == value2 ? 0 : (value1 < value2 ? -1 : 1));
+  }
+  NEXT();
+}
+
+L_ifeq:
+  BRANCH_IF(ctx.popInt() == 0);
+L_ifne:
+  BRANCH_IF(ctx.popInt() != 0);
+L_iflt:
+  BRANCH_IF(ctx.popInt() < 0);
+L_ifge:
+  BRANCH_IF(ctx.popInt() >= 0);
+L_ifgt:
+  BRANCH_IF(ctx.popInt() > 0);
+L_ifle:
+  BRANCH_IF(ctx.popInt() <= 0);
+
+L_if_icmpeq : {
+  int value2 = ctx.popInt(), value1 = ctx.popInt();
+  BRANCH_IF(value1 == value2);
+}
+L_if_icmpne : {
+  int value2 = ctx.popInt(), value1 = ctx.popInt();
+  BRANCH_IF(value1 != value2);
+}
+L_if_icmplt : {
+  int value2 = ctx.popInt(), value1 = ctx.popInt();
+  BRANCH_IF(value1 < value2);
+}
+L_if_icmpge : {
+  int value2 = ctx.popInt(), value1 = ctx.popInt();
+  BRANCH_IF(value1 >= value2);
+}
+L_if_icmpgt : {
+  int value2 = ctx.popInt(), value1 = ctx.popInt();
+  BRANCH_IF(value1 > value2);
+}
+L_if_icmple : {
+  int value2 = ctx.popInt(), value1 = ctx.popInt();
+  BRANCH_IF(value1 <= value2);
+}
+L_if_acmpeq : {
+  rtda::Object *value2 = ctx.popRef(), *value1 = ctx.popRef();
+  BRANCH_IF(value1 == value2);
+}
+L_if_acmpne : {
+  rtda::Object *value2 = ctx.popRef(), *value1 = ctx.popRef();
+  BRANCH_IF(value1 != value2);
+}
+
+  /* Control */
+
+L_goto:
+  JUMP(ctx.pc->target);
+
+L_tableswitch : {
+  // low, high; default, targets...
+  const int* table = &code->switchData[ctx.pc->operand1];
+  ThreadedInst* const* targets = &code->switchTargets[ctx.pc->operand2];
+  int index = ctx.popInt();
+  if (profile != nullptr) profile->countSwitch(ctx.pc->pc, index);
+  if (index >= table[0] && index <= table[1]) {
+    JUMP(targets[1 + index - table[0]]);
+  }
+  JUMP(targets[0]);
+}
+
+L_lookupswitch : {
+  // npairs, matches...; default, targets...
+  // (a dense one has been translated into a tableswitch)
+  const int* table = &code->switchData[ctx.pc->operand1];
+  ThreadedInst* const* targets = &code->switchTargets[ctx.pc->operand2];
+  const int* matches = table + 1;
+  int key = ctx.popInt();
+  if (profile != nullptr) profile->countSwitch(ctx.pc->pc, key);
+  const int* found =
+      table[0] <= bytecode::kLinearSwitchMaxCases
+          ? std::find(matches, matches + table[0], key)
+          : std::lower_bound(matches, matches + table[0], key);
+  if (found != matches + table[0] && *found == key) {
+    JUMP(targets[1 + (found - matches)]);
+  }
+  JUMP(targets[0]);
+}
+
+L_ireturn:
+  RETURN_VALUE(int, popInt, pushInt);
+L_lreturn:
+  RETURN_VALUE(long long, popLong, pushLong);
+L_freturn:
+  RETURN_VALUE(float, popFloat, pushFloat);
+L_dreturn:
+  RETURN_VALUE(double, popDouble, pushDouble);
+L_areturn:
+  RETURN_VALUE(rtda::Object*, popRef, pushRef);
+
+L_return:
+  FLUSH_BACKEDGES();
+  thread->stack.pop();
+  return;
+
+  /* References */
+
+L_invokestatic : {
+  thread->pc = ctx.pc->pc;
+  CHECK(classFile != nullptr) << "invokestatic without a class";
+  CHECK(ctx.cp->infoList[ctx.pc->operand1]->tag ==
+        classfile::CONSTANT_TAG_Methodref)
+      << "Bad invokestatic constant";
+  classfile::ConstantRefInfo* ref = static_cast<classfile::ConstantRefInfo*>(
+      ctx.cp->infoList[ctx.pc->operand1]);
+  std::string className = ctx.cp->getClassNameStr(ref->classInfoIdx);
+  auto nameAndType = ctx.cp->getNameAndTypeStr(ref->nameAndTypeInfoIdx);
+  // TODO: load other classes.
+  CHECK(className == classFile->className())
+      << "Unsupported invokestatic of another class: " << className;
+  classfile::MethodInfo* method =
+      classFile->findMethod(nameAndType.first, nameAndType.second);
+  CHECK(method != nullptr) << "java.lang.NoSuchMethodError: "
+                           << nameAndType.first << nameAndType.second;
+  classfile::CodeAttr* callee = method->attributes->filtCodeAttr();
+  // TODO: native methods.
+  CHECK(callee != nullptr) << "No CodeAttr found: " << nameAndType.first;
+  if (__atomic_load_n(&callee->verifyStatus, __ATOMIC_ACQUIRE) ==
+      classfile::kVerifyPending) {
+    verifyMethod(method);
+  }
+
+  __atomic_store_n(&ctx.pc->operand2,
+                   classfile::argumentSlots(nameAndType.second),
+                   __ATOMIC_RELAXED);
+  __atomic_store_n(&ctx.pc->resolved, callee, __ATOMIC_RELAXED);
+  ThreadedCode::quicken(ctx.pc, kQuick_invokestatic,
+                        handlers[kQuick_invokestatic]);
+  DISPATCH();
+}
+
+L_invokestatic_quick:
+  __atomic_thread_fence(__ATOMIC_ACQUIRE);
+  callee = static_cast<classfile::CodeAttr*>(
+      __atomic_load_n(&ctx.pc->resolved, __ATOMIC_RELAXED));
+  argSlots = __atomic_load_n(&ctx.pc->operand2, __ATOMIC_RELAXED);
+  goto L_invoke;
+
+L_invokevirtual : {
+  thread->pc = ctx.pc->pc;
+  CHECK(ctx.cp->infoList[ctx.pc->operand1]->tag ==
+        classfile::CONSTANT_TAG_Methodref)
+      << "Bad invokevirtual constant";
+  classfile::ConstantRefInfo* ref = static_cast<classfile::ConstantRefInfo*>(
+      ctx.cp->infoList[ctx.pc->operand1]);
+  std::string className = ctx.cp->getClassNameStr(ref->classInfoIdx);
+  auto nameAndType = ctx.cp->getNameAndTypeStr(ref->nameAndTypeInfoIdx);
+  rtda::Class* cls = rtda::ClassTable::instance().resolve(className);
+  CHECK(cls->classFile != nullptr)
+      << "java.lang.NoClassDefFoundError: " << className;
+  CHECK(!cls->isInterface) << "java.lang.IncompatibleClassChangeError: "
+                           << className << " is an interface";
+  classfile::MethodInfo* method =
+      cls->findMethod(nameAndType.first, nameAndType.second);
+  CHECK(method != nullptr) << "java.lang.NoSuchMethodError: "
+                           << nameAndType.first << nameAndType.second;
+  CHECK((method->accessFlags & classfile::ACC_STATIC) == 0)
+      << "java.lang.IncompatibleClassChangeError: " << nameAndType.first;
+  rtda::ClassTable::instance().link(cls);
+  int slot = cls->vtableSlot(nameAndType.first, nameAndType.second);
+  // TODO: private methods (invokevirtual of nestmates).
+  CHECK(slot >= 0) << "Unsupported invokevirtual of a private method: "
+                   << nameAndType.first;
+
+  InlineCache* cache = &code->inlineCaches[ctx.pc->operand3];
+  __atomic_store_n(&cache->resolvedClass, cls, __ATOMIC_RELAXED);
+  __atomic_store_n(&cache->vtableSlot, slot, __ATOMIC_RELAXED);
+  // the receiver is an argument too
+  __atomic_store_n(&ctx.pc->operand2,
+                   classfile::argumentSlots(nameAndType.second) + 1,
+                   __ATOMIC_RELAXED);
+  ThreadedCode::quicken(ctx.pc, kQuick_invokevirtual,
+                        handlers[kQuick_invokevirtual]);
+  DISPATCH();
+}
+
+L_invokeinterface : {
+  thread->pc = ctx.pc->pc;
+  CHECK(ctx.cp->infoList[ctx.pc->operand1]->tag ==
+        classfile::CONSTANT_TAG_InterfaceMethodref)
+      << "Bad invokeinterface constant";
+  classfile::ConstantRefInfo* ref = static_cast<classfile::ConstantRefInfo*>(
+      ctx.cp->infoList[ctx.pc->operand1]);
+  std::string className = ctx.cp->getClassNameStr(ref->classInfoIdx);
+  auto nameAndType = ctx.cp->getNameAndTypeStr(ref->nameAndTypeInfoIdx);
+  rtda::Class* cls = rtda::ClassTable::instance().resolve(className);
+  CHECK(cls->classFile != nullptr)
+      << "java.lang.NoClassDefFoundError: " << className;
+  CHECK(cls->isInterface) << "java.lang.IncompatibleClassChangeError: "
+                          << className << " is not an interface";
+  // the vtable of an interface has the methods of its superinterfaces too
+  rtda::ClassTable::instance().link(cls);
+  int slot = cls->vtableSlot(nameAndType.first, nameAndType.second);
+  CHECK(slot >= 0) << "java.lang.NoSuchMethodError: " << nameAndType.first
+                   << nameAndType.second;
+
+  InlineCache* cache = &code->inlineCaches[ctx.pc->operand3];
+  __atomic_store_n(&cache->resolvedClass, cls, __ATOMIC_RELAXED);
+  __atomic_store_n(&cache->vtableSlot, slot, __ATOMIC_RELAXED);
+  __atomic_store_n(&ctx.pc->operand2,
+                   classfile::argumentSlots(nameAndType.second) + 1,
+                   __ATOMIC_RELAXED);
+  // the same as a virtual call from now on: the cache knows the interface
+  ThreadedCode::quicken(ctx.pc, kQuick_invokevirtual,
+                        handlers[kQuick_invokevirtual]);
+  DISPATCH();
+}
+
+L_invokevirtual_quick : {
+  __atomic_thread_fence(__ATOMIC_ACQUIRE);
+  argSlots = __atomic_load_n(&ctx.pc->operand2, __ATOMIC_RELAXED);
+  rtda::Object* receiver = ctx.sp[-argSlots].ref;
+  if (receiver == nullptr) THROW_VM(kNullPointerException);
+  if (profile != nullptr) profile->countReceiver(ctx.pc->pc, receiver->klass);
+  InlineCache* cache = &code->inlineCaches[ctx.pc->operand3];
+  callee = cache->lookup(receiver->klass);
+  if (callee == nullptr) {
+    ctx.save(thread->stack.topFrame);
+    callee = dispatchVirtual(cache, receiver->klass);
+  }
+  goto L_invoke;
+}
+
+L_invoke : {
+  // the arguments on the top of the stack become the locals of the callee
+  rtda::StackFrame* frame = thread->stack.topFrame;
+  ctx.save(frame);
+  // each invoke runs the callee in a native call, so a deep recursion may
+  // exhaust the native stack before the arena: it overflows as well
+  if (reinterpret_cast<uintptr_t>(__builtin_frame_address(0)) <
+      reinterpret_cast<uintptr_t>(
+          utils::nativeStackLimit(kNativeStackReserve))) {
+    THROW_VM(kStackOverflowError);
+  }
+  try {
+    thread->stack.push(callee->maxLocals, callee->maxStack, argSlots);
+  } catch (const rtda::StackOverflowPanic&) {
+    // the stack is unchanged: throw it at the invoke
+    THROW_VM(kStackOverflowError);
+  }
+  execute(thread, callee);
+  // the arguments are replaced by the returned value (if any)
+  ctx.sp = frame->operandStack->top();
+  if (thread->exception != nullptr) {
+    // the callee did not catch it: throw it again at the invoke
+    thrown = thread->exception;
+    thread->exception = nullptr;
+    goto L_throw;
+  }
+  NEXT();
+}
+
+L_athrow:
+  thrown = ctx.popRef();
+  if (thrown == nullptr) THROW_VM(kNullPointerException);
+  goto L_throw;
+
+L_checkcast:
+  thread->pc = ctx.pc->pc;
+  __atomic_store_n(&ctx.pc->resolved, resolveTypeCheck(ctx.cp, ctx.pc),
+                   __ATOMIC_RELAXED);
+  ThreadedCode::quicken(ctx.pc, kQuick_checkcast, handlers[kQuick_checkcast]);
+  DISPATCH();
+
+L_instanceof:
+  thread->pc = ctx.pc->pc;
+  __atomic_store_n(&ctx.pc->resolved, resolveTypeCheck(ctx.cp, ctx.pc),
+                   __ATOMIC_RELAXED);
+  ThreadedCode::quicken(ctx.pc, kQuick_instanceof,
+                        handlers[kQuick_instanceof]);
+  DISPATCH();
+
+L_checkcast_quick : {
+  __atomic_thread_fence(__ATOMIC_ACQUIRE);
+  // the reference stays on the stack. null passes
+  rtda::Object* object = ctx.sp[-1].ref;
+  if (object != nullptr &&
+      !object->klass->isSubtypeOf(static_cast<const rtda::Class*>(
+          __atomic_load_n(&ctx.pc->resolved, __ATOMIC_RELAXED)))) {
+    THROW_VM(kClassCastException);
+  }
+  NEXT();
+}
+
+L_instanceof_quick : {
+  __atomic_thread_fence(__ATOMIC_ACQUIRE);
+  rtda::Object* object = ctx.popRef();
+  ctx.pushInt(object != nullptr &&
+              object->klass->isSubtypeOf(static_cast<const rtda::Class*>(
+                  __atomic_load_n(&ctx.pc->resolved, __ATOMIC_RELAXED))));
+  NEXT();
+}
+
+  /* Exceptions */
+
+L_throw : {
+  // a handler in this frame: clear the stack, push the exception and jump
+  int handlerPc = code->exceptions.find(ctx.pc->pc, thrown->klass);
+  if (handlerPc >= 0) {
+    rtda::OperandStack* operandStack = thread->stack.topFrame->operandStack;
+    operandStack->clear();
+    ctx.sp = operandStack->top();
+    ctx.pushRef(thrown);
+    BRANCH(code->at(handlerPc));
+  }
+  // otherwise the frame completes abruptly, and the invoker throws it again
+  thread->pc = ctx.pc->pc;
+  thread->exception = thrown;
+  FLUSH_BACKEDGES();
+  thread->stack.pop();
+  return;
+}
+
+  /* On-stack replacement */
+
+L_osr : {
+  // the frame moves into the compiled code at the loop header: the locals and
+  // the operand stack are its state, so they only need to be in the frame
+  rtda::StackFrame* frame = thread->stack.topFrame;
+  ctx.save(frame);
+  if (runCompiled_(thread, osr)) return;
+  // it bailed out: resume the frame at the pc it stopped at
+  ctx = ExecContext(frame, code);
+  DISPATCH();
+}
+
+  /* Extended */
+
+L_ifnull:
+  BRANCH_IF(ctx.popRef() == nullptr);
+L_ifnonnull:
+  BRANCH_IF(ctx.popRef() != nullptr);
+
+  /* Superinstructions */
+
+L_iload_iload_iadd_istore:
+  ctx.setInt(ctx.pc->operand3, ctx.getInt(ctx.pc->operand1) +
+                                   ctx.getInt(ctx.pc->operand2));
+  NEXT_N(4);
+L_iload_iload_isub_istore:
+  ctx.setInt(ctx.pc->operand3, ctx.getInt(ctx.pc->operand1) -
+                                   ctx.getInt(ctx.pc->operand2));
+  NEXT_N(4);
+L_iload_iconst_iadd_istore:
+  ctx.setInt(ctx.pc->operand3, ctx.getInt(ctx.pc->operand1) + ctx.pc->operand2);
+  NEXT_N(4);
+L_iload_iload_iadd:
+  ctx.pushInt(ctx.getInt(ctx.pc->operand1) + ctx.getInt(ctx.pc->operand2));
+  NEXT_N(3);
+L_iload_iload:
+  ctx.pushInt(ctx.getInt(ctx.pc->operand1));
+  ctx.pushInt(ctx.getInt(ctx.pc->operand2));
+  NEXT_N(2);
+L_iinc_goto:
+  ctx.setInt(ctx.pc->operand1, ctx.getInt(ctx.pc->operand1) + ctx.pc->operand2);
+  JUMP(ctx.pc->target);
+
+L_iload_iconst_if_icmpeq:
+  FUSED_BRANCH_IF(ctx.getInt(ctx.pc->operand1) == ctx.pc->operand2, 3);
+L_iload_iconst_if_icmpne:
+  FUSED_BRANCH_IF(ctx.getInt(ctx.pc->operand1) != ctx.pc->operand2, 3);
+L_iload_iconst_if_icmplt:
+  FUSED_BRANCH_IF(ctx.getInt(ctx.pc->operand1) < ctx.pc->operand2, 3);
+L_iload_iconst_if_icmpge:
+  FUSED_BRANCH_IF(ctx.getInt(ctx.pc->operand1) >= ctx.pc->operand2, 3);
+L_iload_iconst_if_icmpgt:
+  FUSED_BRANCH_IF(ctx.getInt(ctx.pc->operand1) > ctx.pc->operand2, 3);
+L_iload_iconst_if_icmple:
+  FUSED_BRANCH_IF(ctx.getInt(ctx.pc->operand1) <= ctx.pc->operand2, 3);
+
+L_iload_iload_if_icmpeq:
+  FUSED_BRANCH_IF(
+      ctx.getInt(ctx.pc->operand1) == ctx.getInt(ctx.pc->operand2), 3);
+L_iload_iload_if_icmpne:
+  FUSED_BRANCH_IF(
+      ctx.getInt(ctx.pc->operand1) != ctx.getInt(ctx.pc->operand2), 3);
+L_iload_iload_if_icmplt:
+  FUSED_BRANCH_IF(
+      ctx.getInt(ctx.pc->operand1) < ctx.getInt(ctx.pc->operand2), 3);
+L_iload_iload_if_icmpge:
+  FUSED_BRANCH_IF(
+      ctx.getInt(ctx.pc->operand1) >= ctx.getInt(ctx.pc->operand2), 3);
+L_iload_iload_if_icmpgt:
+  FUSED_BRANCH_IF(
+      ctx.getInt(ctx.pc->operand1) > ctx.getInt(ctx.pc->operand2), 3);
+L_iload_iload_if_icmple:
+  FUSED_BRANCH_IF(
+      ctx.getInt(ctx.pc->operand1) <= ctx.getInt(ctx.pc->operand2), 3);
+
+  /*
+   * TOS caching (see ThreadedInterpreter). L_xxx_cache handlers run with the
+   * top of stack in memory and leave their int result in tos. T_xxx handlers
+   * run with the top of stack in tos. T_spill writes tos back to memory and
+   * runs the normal handler, so every instruction without a T_ version (calls,
+   * returns of other types, ...) sees a complete operand stack in memory.
+   */
+
+L_iconst_cache:
+  tos = ctx.pc->operand1;
+  NEXT_CACHED();
+L_iload_cache:
+  tos = ctx.getInt(ctx.pc->operand1);
+  NEXT_CACHED();
+L_iload_iload_cache:
+  ctx.pushInt(ctx.getInt(ctx.pc->operand1));
+  tos = ctx.getInt(ctx.pc->operand2);
+  ctx.pc += 1;
+  NEXT_CACHED();
+L_iload_iload_iadd_cache:
+  tos = ctx.getInt(ctx.pc->operand1) + ctx.getInt(ctx.pc->operand2);
+  ctx.pc += 2;
+  NEXT_CACHED();
+
+T_spill:
+  ctx.pushInt(tos);
+  DISPATCH();
+T_nop:
+  NEXT_CACHED();
+T_iconst:
+  ctx.pushInt(tos);
+  tos = ctx.pc->operand1;
+  NEXT_CACHED();
+T_iload:
+  ctx.pushInt(tos);
+  tos = ctx.getInt(ctx.pc->operand1);
+  NEXT_CACHED();
+T_istore:
+  ctx.setInt(ctx.pc->operand1, tos);
+  NEXT();
+T_pop:
+  NEXT();
+T_dup:
+  ctx.pushInt(tos);
+  NEXT_CACHED();
+T_iadd:
+  CACHED_BINARY_OP(value1 + value2);
+T_isub:
+  CACHED_BINARY_OP(value1 - value2);
+T_imul:
+  CACHED_BINARY_OP(value1 * value2);
+T_ineg:
+  tos = -tos;
+  NEXT_CACHED();
+T_ishl:
+  CACHED_BINARY_OP(value1 << (value2 & 0x1f));
+T_ishr:
+  CACHED_BINARY_OP(value1 >> (value2 & 0x1f));
+T_iushr:
+  CACHED_BINARY_OP(int((unsigned int)(value1) >> (value2 & 0x1f)));
+T_iand:
+  CACHED_BINARY_OP(value1 & value2);
+T_ior:
+  CACHED_BINARY_OP(value1 | value2);
+T_ixor:
+  CACHED_BINARY_OP(value1 ^ value2);
+T_iinc:
+  ctx.setInt(ctx.pc->operand1, ctx.getInt(ctx.pc->operand1) + ctx.pc->operand2);
+  NEXT_CACHED();
+
+T_ifeq:
+  BRANCH_IF(tos == 0);
+T_ifne:
+  BRANCH_IF(tos != 0);
+T_iflt:
+  BRANCH_IF(tos < 0);
+T_ifge:
+  BRANCH_IF(tos >= 0);
+T_ifgt:
+  BRANCH_IF(tos > 0);
+T_ifle:
+  BRANCH_IF(tos <= 0);
+
+T_if_icmpeq : {
+  int value1 = ctx.popInt();
+  BRANCH_IF(value1 == tos);
+}
+T_if_icmpne : {
+  int value1 = ctx.popInt();
+  BRANCH_IF(value1 != tos);
+}
+T_if_icmplt : {
+  int value1 = ctx.popInt();
+  BRANCH_IF(value1 < tos);
+}
+T_if_icmpge : {
+  int value1 = ctx.popInt();
+  BRANCH_IF(value1 >= tos);
+}
+T_if_icmpgt : {
+  int value1 = ctx.popInt();
+  BRANCH_IF(value1 > tos);
+}
+T_if_icmple : {
+  int value1 = ctx.popInt();
+  BRANCH_IF(value1 <= tos);
+}
+
+T_ireturn:
+  FLUSH_BACKEDGES();
+  thread->stack.pop();
+  if (!thread->stack.isEmpty()) {
+    thread->stack.topFrame->operandStack->pushInt(tos);
+  }
+  return;
+
+L_unsupported:
+  thread->pc = ctx.pc->pc;
+  ctx.save(thread->stack.topFrame);
+  LOG(FATAL) << "Unimplemented instruction: 0x" << std::hex
+             << static_cast<unsigned int>(ctx.pc->opcode) << std::dec
+             << " at pc " << ctx.pc->pc;
+}
+
+#undef DISPATCH
+#undef NEXT
+#undef BRANCH
+#undef JUMP
+#undef FLUSH_BACKEDGES
+#undef BINARY_OP
+#undef SHIFT_OP
+#undef BRANCH_IF
+#undef COUNT_BRANCH
+#undef NEXT_N
+#undef NEXT_CACHED
+#undef CACHED_BINARY_OP
+#undef FUSED_BRANCH_IF
+#undef RETURN_VALUE
+#undef THROW_VM
+
+}  // namespace vm
+
+}  // namespace coconut
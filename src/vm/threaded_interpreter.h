@@ -0,0 +1,164 @@
+/*!
+ *    ________  ________  ________  ________  ________   ___  ___  _________
+ *   |\   ____\|\   __  \|\   ____\|\   __  \|\   ___  \|\  \|\  \|\___   ___\
+ *   \ \  \___|\ \  \|\  \ \  \___|\ \  \|\  \ \  \\ \  \ \  \\\  \|___ \  \_|
+ *    \ \  \    \ \  \\\  \ \  \    \ \  \\\  \ \  \\ \  \ \  \\\  \   \ \  \
+ *     \ \  \____\ \  \\\  \ \  \____\ \  \\\  \ \  \\ \  \ \  \\\  \   \ \  \
+ *      \ \_______\ \_______\ \_______\ \_______\ \__\\ \__\ \_______\   \ \__\
+ *       \|_______|\|_______|\|_______|\|_______|\|__| \|__|\|_______|    \|__|
+ *
+ * \file src/vm/threaded_interpreter.h
+ * \brief Direct-threaded Java Bytecode Interpreter.
+ * \author SiriusNEO
+ */
+
+#ifndef SRC_VM_THREADED_INTERPRETER_H_
+#define SRC_VM_THREADED_INTERPRETER_H_
+
+#include <ostream>
+#include <unordered_map>
+
+#include "interpreter.h"
+#include "method_data.h"
+#include "threaded_code.h"
+#include "tiered_policy.h"
+
+namespace coconut {
+
+namespace vm {
+
+/*!
+ * \brief Direct-threaded Java Bytecode Interpreter.
+ *
+ * Instead of calling the virtual accept() of Instruction objects, it translates
+ * a method into threaded code (see threaded_code.h) and runs it in a single
+ * dispatch loop. Every opcode has its own label in the loop and the handler
+ * bodies are written inline, so that dispatching is one indirect jump (computed
+ * goto) at the end of each handler. Common sequences are fused into
+ * superinstructions, which work on the local variables directly.
+ *
+ * Handlers do not go through the frame: the stack pointer, the locals pointer,
+ * the pc and the constant pool are loaded into an ExecContext (see
+ * exec_context.h) when the loop starts, and every operand access is an inline
+ * load or store on it. There are no bound or type checks at runtime: only code
+ * proven safe by the verifier (see verifier.h) runs in the loop, and other
+ * code runs on the checked path of the classic engine.
+ *
+ * In the TOS caching mode, an int on the top of the operand stack is kept in a
+ * local variable of the loop (a machine register) instead of the stack memory.
+ * Whether it is cached is encoded in the dispatch: every instruction has two
+ * handlers, one for each state, and a handler continues with the handler of
+ * the state it leaves. The value is spilled to memory before any instruction
+ * that has no cached version (e.g. calls), so everything else sees a complete
+ * operand stack.
+ *
+ * It counts the invocations and the backedges of each method in its CodeAttr.
+ * Once a method is warm (profileThreshold), it allocates its MethodData, and
+ * from then on the branches, switches and virtual call sites of the method
+ * record their profiles there.
+ *
+ * With jit on, the TieredPolicy decides from these counters when a method is
+ * hot and gets compiled by the TemplateCompiler, and its later invocations
+ * run the machine code. Compiled code shares the frame of the interpreter, so
+ * when it bails out, the loop resumes the frame at the pc it stopped at. For
+ * the same reason, a frame running a hot loop moves into compiled code at a
+ * backedge (on-stack replacement), once its OSR entry is compiled.
+ *
+ * \note Computed goto ("labels as values") is a GCC extension. It is also
+ * supported by Clang.
+ */
+class ThreadedInterpreter : public Interpreter {
+ private:
+  /*! \brief Translated code of each method. Owned by the interpreter. */
+  std::unordered_map<classfile::CodeAttr*, ThreadedCode*> codeCache_;
+
+  /*! \brief Whether to fuse superinstructions when translating. */
+  bool superInstructions_;
+
+  /*! \brief Whether to cache the top of stack in a register. */
+  bool tosCaching_;
+
+  /*!
+   * \brief Run compiled code on the top frame of the thread, from the start,
+   * or from the loop header at the pc of the frame for an OSR entry.
+   * \param thread The thread.
+   * \param compiled The compiled code of the frame.
+   * \return Whether the method returned. Otherwise it bailed out, and the
+   * frame is ready to resume in the loop.
+   */
+  bool runCompiled_(rtda::Thread* thread, CompiledCode* compiled);
+
+  /*!
+   * \brief The dispatch loop. Run until the top frame of the thread returns.
+   * \param thread The thread the interpreter runs.
+   * \param code The threaded code running in the thread.
+   */
+  void run_(rtda::Thread* thread, ThreadedCode* code);
+
+ public:
+  /*!
+   * \brief Number of invocations and backedges after which a method is warm,
+   * and starts to be profiled (see MethodData).
+   */
+  uint64_t profileThreshold;
+
+  /*! \brief Whether to compile hot methods (see TemplateCompiler). */
+  bool jit;
+
+  /*! \brief When methods get compiled, if jit is on. */
+  TieredPolicy policy;
+
+  /*!
+   * \brief Default constructor.
+   * \param superInstructions Whether to fuse superinstructions.
+   * \param tosCaching Whether to cache the top of stack in a register.
+   */
+  explicit ThreadedInterpreter(bool superInstructions = true,
+                               bool tosCaching = false)
+      : superInstructions_(superInstructions),
+        tosCaching_(tosCaching),
+        profileThreshold(kProfileThreshold),
+        jit(false) {}
+
+  /*! \brief Default destructor. */
+  ~ThreadedInterpreter();
+
+  /*!
+   * \brief Get the threaded code of a CodeAttr. Translate it at the first time.
+   * \param codeAttr The code.
+   * \return The threaded code, owned by the interpreter.
+   */
+  ThreadedCode* translate(classfile::CodeAttr* codeAttr);
+
+  /*!
+   * \brief Get the compiled code of a CodeAttr.
+   * \param codeAttr The code.
+   * \return The compiled code. nullptr if it is not compiled.
+   */
+  const CompiledCode* compiled(classfile::CodeAttr* codeAttr) const {
+    return policy.compiled(codeAttr);
+  }
+
+  void execute(rtda::Thread* thread, classfile::CodeAttr* codeAttr);
+
+  /*!
+   * \brief Print the statistics of every inline cache, one call site per
+   * line, e.g. "main()I pc 3: 2 classes, 100 hits, 2 misses, 0 vtable calls".
+   * \param os The stream.
+   */
+  void dumpInlineCaches(std::ostream& os) const;
+
+  /*!
+   * \brief Print the hottest methods the engine has run, and the hottest
+   * branches, switches and call sites of their profiles (see dumpProfiles).
+   * \param os The stream.
+   * \param limit Max number of lines of each part.
+   */
+  void dumpProfiles(std::ostream& os, int limit = 10) const;
+};
+
+}  // namespace vm
+
+}  // namespace coconut
+
+#endif  // SRC_VM_THREADED_INTERPRETER_H_
@@ -0,0 +1,252 @@
+/*!
+ *    ________  ________  ________  ________  ________   ___  ___  _________
+ *   |\   ____\|\   __  \|\   ____\|\   __  \|\   ___  \|\  \|\  \|\___   ___\
+ *   \ \  \___|\ \  \|\  \ \  \___|\ \  \|\  \ \  \\ \  \ \  \\\  \|___ \  \_|
+ *    \ \  \    \ \  \\\  \ \  \    \ \  \\\  \ \  \\ \  \ \  \\\  \   \ \  \
+ *     \ \  \____\ \  \\\  \ \  \____\ \  \\\  \ \  \\ \  \ \  \\\  \   \ \  \
+ *      \ \_______\ \_______\ \_______\ \_______\ \__\\ \__\ \_______\   \ \__\
+ *       \|_______|\|_______|\|_______|\|_______|\|__| \|__|\|_______|    \|__|
+ *
+ * \file src/vm/tiered_policy.cc
+ * \brief When methods move from the interpreter to compiled code.
+ * \author SiriusNEO
+ */
+
+#include "tiered_policy.h"
+
+#include <algorithm>
+#include <chrono>
+
+#include "../utils/logging.h"
+#include "method_data.h"
+
+namespace coconut {
+
+namespace vm {
+
+std::ostream& operator<<(std::ostream& os, const TierTransition& transition) {
+  os << transition.method;
+  if (transition.osrPc >= 0) os << " osr at pc " << transition.osrPc;
+  os << ": ";
+  if (transition.to == transition.from) {
+    os << "not compiled";
+  } else {
+    os << "tier " << transition.from << " -> " << transition.to;
+  }
+  os << " (" << transition.invocations << " invocations, "
+     << transition.backedges << " backedges, queue " << transition.queueLength
+     << "), " << transition.compileMicros << " us";
+  if (transition.error.empty()) {
+    os << ", " << transition.codeSize << " bytes";
+  } else {
+    os << ": " << transition.error;
+  }
+  return os;
+}
+
+TieredPolicy::~TieredPolicy() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stopping_ = true;
+  }
+  queued_.notify_all();
+  for (std::thread& thread : threads_) {
+    thread.join();
+  }
+  for (auto& entry : tasks_) {
+    delete entry.second->compiled;
+    delete entry.second;
+  }
+  for (auto& entry : osrTasks_) {
+    delete entry.second->compiled;
+    delete entry.second;
+  }
+}
+
+uint64_t TieredPolicy::scale_() const {
+  // the thresholds grow with the load of each compiler thread
+  if (compilerThreads <= 0) return 1;
+  return 1 + __atomic_load_n(&pending_, __ATOMIC_RELAXED) /
+                 (uint64_t(compilerThreads) * std::max(queueLoadFeedback, 1));
+}
+
+TieredPolicy::Task* TieredPolicy::submit_(classfile::CodeAttr* codeAttr,
+                                          int osrPc) {
+  Task* task = new Task{codeAttr, kTaskQueued, nullptr, TierTransition()};
+  TierTransition& transition = task->transition;
+  transition.method = methodName(codeAttr);
+  transition.from = transition.to = kTierInterpreter;
+  transition.osrPc = osrPc;
+  transition.invocations =
+      __atomic_load_n(&codeAttr->invocationCount, __ATOMIC_RELAXED);
+  transition.backedges =
+      __atomic_load_n(&codeAttr->backedgeCount, __ATOMIC_RELAXED);
+  transition.queueLength = 0;
+  transition.compileMicros = 0;
+  transition.codeSize = 0;
+  if (osrPc >= 0) {
+    osrTasks_[std::make_pair(codeAttr, osrPc)] = task;
+  } else {
+    tasks_[codeAttr] = task;
+  }
+
+  if (compilerThreads <= 0) {
+    compile_(task);
+    return task;
+  }
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    transition.queueLength = pending_;
+    queue_.push_back(task);
+    __atomic_store_n(&pending_, pending_ + 1, __ATOMIC_RELAXED);
+    // the compiler threads are started by the first hot method
+    while (int(threads_.size()) < compilerThreads) {
+      threads_.emplace_back(&TieredPolicy::work_, this);
+    }
+  }
+  queued_.notify_one();
+  return task;
+}
+
+void TieredPolicy::compile_(Task* task) {
+  auto start = std::chrono::steady_clock::now();
+  TemplateCompiler compiler(task->codeAttr);
+  CompiledCode* compiled =
+      compiler.compile(&machineCode_, task->transition.osrPc);
+  std::chrono::duration<double, std::micro> elapsed =
+      std::chrono::steady_clock::now() - start;
+
+  TierTransition& transition = task->transition;
+  transition.compileMicros = elapsed.count();
+  if (compiled != nullptr) {
+    transition.to = kTierCompiled;
+    transition.codeSize = compiled->codeSize;
+  } else {
+    transition.error = compiler.error;
+  }
+  LOG(INFO) << transition;
+
+  task->compiled = compiled;
+  __atomic_store_n(&task->state, int(kTaskDone), __ATOMIC_RELEASE);
+  std::lock_guard<std::mutex> lock(mutex_);
+  transitions_.push_back(transition);
+}
+
+void TieredPolicy::work_() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  while (true) {
+    queued_.wait(lock, [this]() { return stopping_ || !queue_.empty(); });
+    if (stopping_) return;
+    Task* task = queue_.front();
+    queue_.pop_front();
+    lock.unlock();
+    compile_(task);
+    lock.lock();
+    __atomic_store_n(&pending_, pending_ - 1, __ATOMIC_RELAXED);
+    finished_.notify_all();
+  }
+}
+
+CompiledCode* TieredPolicy::onInvocation(classfile::CodeAttr* codeAttr) {
+  Task* task;
+  {
+    std::lock_guard<std::mutex> lock(tasksMutex_);
+    auto found = tasks_.find(codeAttr);
+    if (found != tasks_.end()) {
+      task = found->second;
+    } else {
+      uint64_t scale = scale_();
+      uint64_t invocations =
+          __atomic_load_n(&codeAttr->invocationCount, __ATOMIC_RELAXED);
+      uint64_t backedges =
+          __atomic_load_n(&codeAttr->backedgeCount, __ATOMIC_RELAXED);
+      if (invocations < invocationThreshold * scale &&
+          invocations + backedges < compileThreshold * scale &&
+          backedges < backedgeThreshold * scale) {
+        return nullptr;
+      }
+      task = submit_(codeAttr, -1);
+    }
+  }
+  if (__atomic_load_n(&task->state, __ATOMIC_ACQUIRE) != kTaskDone) {
+    return nullptr;
+  }
+  return task->compiled;
+}
+
+CompiledCode* TieredPolicy::onBackedges(classfile::CodeAttr* codeAttr,
+                                        int pc) {
+  uint64_t scale = scale_();
+  uint64_t invocations =
+      __atomic_load_n(&codeAttr->invocationCount, __ATOMIC_RELAXED);
+  uint64_t backedges =
+      __atomic_load_n(&codeAttr->backedgeCount, __ATOMIC_RELAXED);
+  Task* task;
+  {
+    std::lock_guard<std::mutex> lock(tasksMutex_);
+    // hot by its invocations: compile it for the next one
+    if (tasks_.count(codeAttr) == 0 &&
+        (invocations >= invocationThreshold * scale ||
+         invocations + backedges >= compileThreshold * scale)) {
+      submit_(codeAttr, -1);
+    }
+    // a hot loop: compile an entry at its header for this frame
+    auto found = osrTasks_.find(std::make_pair(codeAttr, pc));
+    if (found != osrTasks_.end()) {
+      task = found->second;
+    } else {
+      if (backedges < backedgeThreshold * scale) return nullptr;
+      task = submit_(codeAttr, pc);
+    }
+  }
+  if (__atomic_load_n(&task->state, __ATOMIC_ACQUIRE) != kTaskDone) {
+    return nullptr;
+  }
+  return task->compiled;
+}
+
+const CompiledCode* TieredPolicy::compiled(
+    classfile::CodeAttr* codeAttr) const {
+  std::lock_guard<std::mutex> lock(tasksMutex_);
+  auto found = tasks_.find(codeAttr);
+  if (found == tasks_.end() ||
+      __atomic_load_n(&found->second->state, __ATOMIC_ACQUIRE) != kTaskDone) {
+    return nullptr;
+  }
+  return found->second->compiled;
+}
+
+const CompiledCode* TieredPolicy::compiledOsr(classfile::CodeAttr* codeAttr,
+                                              int pc) const {
+  std::lock_guard<std::mutex> lock(tasksMutex_);
+  auto found = osrTasks_.find(std::make_pair(codeAttr, pc));
+  if (found == osrTasks_.end() ||
+      __atomic_load_n(&found->second->state, __ATOMIC_ACQUIRE) != kTaskDone) {
+    return nullptr;
+  }
+  return found->second->compiled;
+}
+
+size_t TieredPolicy::queueLength() const {
+  return __atomic_load_n(&pending_, __ATOMIC_RELAXED);
+}
+
+void TieredPolicy::waitForCompiles() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  finished_.wait(lock, [this]() { return pending_ == 0; });
+}
+
+std::vector<TierTransition> TieredPolicy::transitions() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return transitions_;
+}
+
+void TieredPolicy::dumpTransitions(std::ostream& os) const {
+  for (const TierTransition& transition : transitions()) {
+    os << transition << "\n";
+  }
+}
+
+}  // namespace vm
+
+}  // namespace coconut
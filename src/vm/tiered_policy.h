@@ -0,0 +1,298 @@
+/*!
+ *    ________  ________  ________  ________  ________   ___  ___  _________
+ *   |\   ____\|\   __  \|\   ____\|\   __  \|\   ___  \|\  \|\  \|\___   ___\
+ *   \ \  \___|\ \  \|\  \ \  \___|\ \  \|\  \ \  \\ \  \ \  \\\  \|___ \  \_|
+ *    \ \  \    \ \  \\\  \ \  \    \ \  \\\  \ \  \\ \  \ \  \\\  \   \ \  \
+ *     \ \  \____\ \  \\\  \ \  \____\ \  \\\  \ \  \\ \  \ \  \\\  \   \ \  \
+ *      \ \_______\ \_______\ \_______\ \_______\ \__\\ \__\ \_______\   \ \__\
+ *       \|_______|\|_______|\|_______|\|_______|\|__| \|__|\|_______|    \|__|
+ *
+ * \file src/vm/tiered_policy.h
+ * \brief When methods move from the interpreter to compiled code.
+ * \author SiriusNEO
+ */
+
+#ifndef SRC_VM_TIERED_POLICY_H_
+#define SRC_VM_TIERED_POLICY_H_
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "../classfile/attributes.h"
+#include "code_cache.h"
+#include "template_compiler.h"
+
+namespace coconut {
+
+namespace vm {
+
+/*! \brief The tiers a method runs in. */
+enum Tier : int {
+  /*! \brief Interpreted by the threaded engine (and profiled once warm). */
+  kTierInterpreter = 0,
+  /*! \brief Compiled by the TemplateCompiler. */
+  kTierCompiled = 1
+};
+
+/*!
+ * \brief Default number of invocations after which a method gets compiled.
+ */
+const uint64_t kInvocationThreshold = 5000;
+
+/*!
+ * \brief Default number of backedges after which a method gets compiled, for
+ * methods which loop much more than they are invoked.
+ */
+const uint64_t kBackedgeThreshold = 40000;
+
+/*!
+ * \brief Default number of invocations plus backedges after which a method
+ * gets compiled.
+ */
+const uint64_t kCompileThreshold = 10000;
+
+/*! \brief Default number of compiler threads. */
+const int kCompilerThreads = 1;
+
+/*!
+ * \brief Default number of queued methods per compiler thread which raise the
+ * thresholds by one more time.
+ */
+const int kQueueLoadFeedback = 5;
+
+/*! \brief A record of a method moving between tiers. */
+struct TierTransition {
+  /*! \brief The method, e.g. "main()I". */
+  std::string method;
+
+  /*! \brief The tier it ran in when it was queued. */
+  Tier from;
+
+  /*! \brief The tier it moved to. The same as from if it was rejected. */
+  Tier to;
+
+  /*! \brief The loop header of an OSR compile, -1 for a whole method. */
+  int osrPc;
+
+  /*! \brief The invocation counter of the method when it was queued. */
+  uint64_t invocations;
+
+  /*! \brief The backedge counter of the method when it was queued. */
+  uint64_t backedges;
+
+  /*! \brief Number of methods in the queue before it. */
+  size_t queueLength;
+
+  /*! \brief The time to compile it, in microseconds. */
+  double compileMicros;
+
+  /*! \brief Size of the machine code in bytes. 0 if rejected. */
+  size_t codeSize;
+
+  /*! \brief Why it was rejected. Empty if compiled. */
+  std::string error;
+};
+
+/*!
+ * \brief Print a transition, e.g. "main()I: tier 0 -> 1 (1 invocations, 10000
+ * backedges, queue 0), 35.2 us, 105 bytes", or "main()I osr at pc 4: ..." for
+ * an OSR compile.
+ */
+std::ostream& operator<<(std::ostream& os, const TierTransition& transition);
+
+/*!
+ * \brief The tiered execution policy of the threaded engine.
+ *
+ * Every method starts in the interpreter, which counts its invocations and
+ * backedges (see CodeAttr). The engine asks the policy at each invocation and
+ * at each batch of backedges, and the policy queues the method for compiling
+ * once it is hot:
+ *
+ *   invocations >= invocationThreshold * s, or
+ *   invocations + backedges >= compileThreshold * s, or
+ *   backedges >= backedgeThreshold * s (checked at invocations only),
+ *
+ * where s = 1 + queued / (compilerThreads * queueLoadFeedback) grows with the
+ * queue, so that a busy compiler only gets the hottest methods. The queue is
+ * served by compilerThreads background threads, started at the first compile,
+ * and the interpreter goes on running the method in the meantime. With 0
+ * compiler threads, methods are compiled at once by the thread which finds
+ * them hot.
+ *
+ * A loop which reaches backedgeThreshold * s is also compiled with an OSR
+ * entry at its header (see TemplateCompiler), so that a method which loops
+ * for long, but is rarely invoked (e.g. main), moves into compiled code while
+ * it runs: the interpreter enters the OSR code at its next batch of backedges
+ * at that header, with the frame as it is.
+ *
+ * Every transition is logged, with its compile time and code size, and kept
+ * (see transitions).
+ *
+ * The tasks are looked up and created under a lock of their own, so the engine
+ * may run on several threads, and a method is queued once. The compiler
+ * threads publish their results into the tasks with release stores.
+ */
+class TieredPolicy {
+ private:
+  /*! \brief The states of a compile task. */
+  enum TaskState : int { kTaskQueued, kTaskDone };
+
+  /*! \brief A method queued for compiling. */
+  struct Task {
+    classfile::CodeAttr* codeAttr;
+
+    /*! \brief A TaskState, read and written atomically. */
+    int state;
+
+    /*! \brief The compiled code. nullptr until done, or if rejected. */
+    CompiledCode* compiled;
+
+    /*! \brief The transition, filled when queued and when done. */
+    TierTransition transition;
+  };
+
+  /*!
+   * \brief Guards tasks_ and osrTasks_. If both are needed, it is taken before
+   * mutex_.
+   */
+  mutable std::mutex tasksMutex_;
+
+  /*! \brief The task of each method that got hot. */
+  std::unordered_map<classfile::CodeAttr*, Task*> tasks_;
+
+  /*! \brief The OSR task of each hot loop: by the method and its header. */
+  std::map<std::pair<classfile::CodeAttr*, int>, Task*> osrTasks_;
+
+  /*! \brief Executable memory of the compiled code. */
+  CodeCache machineCode_;
+
+  /*! \brief Guards the members below. */
+  mutable std::mutex mutex_;
+
+  /*! \brief Signals the compiler threads of a task, or of stopping. */
+  std::condition_variable queued_;
+
+  /*! \brief Signals waitForCompiles of a finished task. */
+  std::condition_variable finished_;
+
+  /*! \brief The tasks to compile, in the order they got hot. */
+  std::deque<Task*> queue_;
+
+  /*! \brief Number of tasks queued or being compiled. */
+  size_t pending_;
+
+  /*! \brief The compiler threads. */
+  std::vector<std::thread> threads_;
+
+  /*! \brief Whether the compiler threads should exit. */
+  bool stopping_;
+
+  /*! \brief The finished transitions, in order. */
+  std::vector<TierTransition> transitions_;
+
+  /*! \brief The scale of the thresholds, by the load of the compilers. */
+  uint64_t scale_() const;
+
+  /*!
+   * \brief Create the task of a hot code, and compile or queue it. tasksMutex_
+   * must be held.
+   * \param codeAttr The code.
+   * \param osrPc The loop header of an OSR compile, -1 for the method.
+   * \return The task, owned by the policy.
+   */
+  Task* submit_(classfile::CodeAttr* codeAttr, int osrPc);
+
+  /*! \brief Compile a task, and publish and log the result. */
+  void compile_(Task* task);
+
+  /*! \brief The loop of a compiler thread. */
+  void work_();
+
+ public:
+  /*! \brief See the class documentation. */
+  uint64_t invocationThreshold;
+  uint64_t backedgeThreshold;
+  uint64_t compileThreshold;
+  int compilerThreads;
+  int queueLoadFeedback;
+
+  /*! \brief Default constructor, with the default thresholds. */
+  TieredPolicy()
+      : pending_(0),
+        stopping_(false),
+        invocationThreshold(kInvocationThreshold),
+        backedgeThreshold(kBackedgeThreshold),
+        compileThreshold(kCompileThreshold),
+        compilerThreads(kCompilerThreads),
+        queueLoadFeedback(kQueueLoadFeedback) {}
+
+  /*!
+   * \brief Default destructor. Stop the compiler threads, and free the
+   * compiled code. Queued tasks are dropped.
+   */
+  ~TieredPolicy();
+
+  /*!
+   * \brief Called when a method is invoked, after its invocation is counted.
+   * \param codeAttr The code. It must be verified.
+   * \return The compiled code to run. nullptr if it stays in the interpreter
+   * for now.
+   */
+  CompiledCode* onInvocation(classfile::CodeAttr* codeAttr);
+
+  /*!
+   * \brief Called when the interpreter adds a batch of backedges to the
+   * counter of a method. A method hot by its invocations is compiled for its
+   * next invocation, and a hot loop gets an OSR compile.
+   * \param codeAttr The code. It must be verified.
+   * \param pc The loop header, the target of the backedge.
+   * \return The compiled code with an OSR entry at the header, to continue
+   * the frame in. nullptr if it stays in the interpreter for now.
+   */
+  CompiledCode* onBackedges(classfile::CodeAttr* codeAttr, int pc);
+
+  /*!
+   * \brief Get the compiled code of a code, if it is compiled.
+   * \param codeAttr The code.
+   * \return The compiled code. nullptr if not compiled (yet).
+   */
+  const CompiledCode* compiled(classfile::CodeAttr* codeAttr) const;
+
+  /*!
+   * \brief Get the compiled code with an OSR entry at a loop header.
+   * \param codeAttr The code.
+   * \param pc The loop header.
+   * \return The compiled code. nullptr if not compiled (yet).
+   */
+  const CompiledCode* compiledOsr(classfile::CodeAttr* codeAttr, int pc) const;
+
+  /*! \brief Number of methods queued or being compiled. */
+  size_t queueLength() const;
+
+  /*! \brief Block until every queued method is compiled. */
+  void waitForCompiles();
+
+  /*! \brief A copy of the finished transitions, in order. */
+  std::vector<TierTransition> transitions() const;
+
+  /*!
+   * \brief Print every finished transition, one per line.
+   * \param os The stream.
+   */
+  void dumpTransitions(std::ostream& os) const;
+};
+
+}  // namespace vm
+
+}  // namespace coconut
+
+#endif  // SRC_VM_TIERED_POLICY_H_
@@ -0,0 +1,758 @@
+/*!
+ *    ________  ________  ________  ________  ________   ___  ___  _________
+ *   |\   ____\|\   __  \|\   ____\|\   __  \|\   ___  \|\  \|\  \|\___   ___\
+ *   \ \  \___|\ \  \|\  \ \  \___|\ \  \|\  \ \  \\ \  \ \  \\\  \|___ \  \_|
+ *    \ \  \    \ \  \\\  \ \  \    \ \  \\\  \ \  \\ \  \ \  \\\  \   \ \  \
+ *     \ \  \____\ \  \\\  \ \  \____\ \  \\\  \ \  \\ \  \ \  \\\  \   \ \  \
+ *      \ \_______\ \_______\ \_______\ \_______\ \__\\ \__\ \_______\   \ \__\
+ *       \|_______|\|_______|\|_______|\|_______|\|__| \|__|\|_______|    \|__|
+ *
+ * \file src/vm/verifier.cc
+ * \brief Implementation of verifier.h
+ * \author SiriusNEO
+ */
+
+#include "verifier.h"
+
+#include <chrono>
+
+#include "../classfile/descriptor.h"
+
+namespace coconut {
+
+namespace vm {
+
+// Fail the verification of the instruction at pc if cond is false.
+#define VERIFY(cond, what) \
+  if (!(cond)) return fail_(pc, what)
+
+static int readU2(const BYTE* code, int pc) {
+  return (code[pc] << 8) | code[pc + 1];
+}
+
+static int readS2(const BYTE* code, int pc) {
+  return int16_t(readU2(code, pc));
+}
+
+static int readS4(const BYTE* code, int pc) {
+  return int32_t((uint32_t(code[pc]) << 24) | (uint32_t(code[pc + 1]) << 16) |
+                 (uint32_t(code[pc + 2]) << 8) | uint32_t(code[pc + 3]));
+}
+
+// The length of an instruction by its opcode, -1 if not supported. Switches
+// are read from the code, and checked to fit in it.
+static int opcodeLength(const BYTE* code, int codeLen, int pc) {
+  uint8_t opcode = code[pc];
+  if (opcode == 0xaa || opcode == 0xab) {
+    // switches: padding to 4 bytes, default, then the table
+    int base = pc + 1 + (4 - (pc + 1) % 4) % 4;
+    if (base + 12 > codeLen) return -1;
+    long long size;
+    if (opcode == 0xaa) {
+      long long low = readS4(code, base + 4), high = readS4(code, base + 8);
+      if (high < low) return -1;
+      size = 12 + 4 * (high - low + 1);
+    } else {
+      long long npairs = readS4(code, base + 4);
+      if (npairs < 0) return -1;
+      size = 8 + 8 * npairs;
+    }
+    if (base + size > codeLen) return -1;
+    return int(base + size - pc);
+  }
+  if (opcode == 0xc4) {
+    // wide: loads, stores and iinc with a 2-byte index
+    if (pc + 1 >= codeLen) return -1;
+    uint8_t modified = code[pc + 1];
+    if (modified == 0x84) return 6;
+    if ((modified >= 0x15 && modified <= 0x19) ||
+        (modified >= 0x36 && modified <= 0x3a)) {
+      return 4;
+    }
+    return -1;
+  }
+  if (opcode <= 0x0f || (opcode >= 0x1a && opcode <= 0x35) ||
+      (opcode >= 0x3b && opcode <= 0x83) ||
+      (opcode >= 0x85 && opcode <= 0x98) ||
+      (opcode >= 0xac && opcode <= 0xb1) || opcode == 0xbf) {
+    return 1;
+  }
+  if (opcode == 0x10 || opcode == 0x12 || (opcode >= 0x15 && opcode <= 0x19) ||
+      (opcode >= 0x36 && opcode <= 0x3a)) {
+    return 2;
+  }
+  if (opcode == 0x11 || opcode == 0x13 || opcode == 0x14 || opcode == 0x84 ||
+      (opcode >= 0x99 && opcode <= 0xa7) || opcode == 0xb6 || opcode == 0xb8 ||
+      opcode == 0xc0 || opcode == 0xc1 || opcode == 0xc6 || opcode == 0xc7) {
+    return 3;
+  }
+  if (opcode == 0xb9 || opcode == 0xc8) return 5;
+  return -1;
+}
+
+int instructionLength(const BYTE* code, int codeLen, int pc) {
+  if (pc < 0 || pc >= codeLen) return -1;
+  int length = opcodeLength(code, codeLen, pc);
+  // an instruction cut short by the end of the code
+  if (length < 0 || length > codeLen - pc) return -1;
+  return length;
+}
+
+// Whether the type takes two slots. Its second slot follows it.
+static bool isWide(uint8_t type) {
+  return type == kVType_Long || type == kVType_Double;
+}
+
+// Whether the type is the second slot of a long or a double.
+static bool isSecondHalf(uint8_t type) {
+  return type == kVType_Long2 || type == kVType_Double2;
+}
+
+// The type of a base type in descriptors (see classfile::argumentTypes).
+static uint8_t typeOfDescriptor(char type) {
+  switch (type) {
+    case 'J':
+      return kVType_Long;
+    case 'F':
+      return kVType_Float;
+    case 'D':
+      return kVType_Double;
+    case 'L':
+      return kVType_Ref;
+    default:
+      return kVType_Int;
+  }
+}
+
+// Expand types into slots: a long or a double takes two.
+static bool expandSlots(const std::vector<uint8_t>& types, size_t limit,
+                        std::vector<uint8_t>& slots) {
+  slots.clear();
+  for (uint8_t type : types) {
+    slots.push_back(type);
+    if (isWide(type)) slots.push_back(type + 1);
+  }
+  return slots.size() <= limit;
+}
+
+// Set a local. Overwriting a half of a long or a double kills the other half.
+static void setLocal(VerifyFrame& frame, int index, uint8_t type) {
+  std::vector<uint8_t>& locals = frame.locals;
+  int last = index + (isWide(type) ? 1 : 0);
+  if (isSecondHalf(locals[index])) locals[index - 1] = kVType_Top;
+  if (isWide(locals[last]) && last + 1 < (int)locals.size()) {
+    locals[last + 1] = kVType_Top;
+  }
+  locals[index] = type;
+  if (isWide(type)) locals[index + 1] = type + 1;
+}
+
+Verifier::Verifier(classfile::CodeAttr* codeAttr, const std::string& descriptor,
+                   bool isStatic)
+    : codeAttr_(codeAttr),
+      descriptor_(descriptor),
+      returnType_('V'),
+      isStatic_(isStatic),
+      usedStackMap(false) {}
+
+bool Verifier::fail_(int pc, const std::string& what) {
+  error = what + " (pc " + std::to_string(pc) + ")";
+  return false;
+}
+
+bool Verifier::decode_() {
+  int codeLen = codeAttr_->codeLen;
+  int pc = 0;
+  VERIFY(codeLen > 0, "Empty code");
+  lengths_.assign(codeLen, 0);
+  while (pc < codeLen) {
+    int length = instructionLength(codeAttr_->code, codeLen, pc);
+    VERIFY(length > 0, "Unsupported or truncated instruction");
+    lengths_[pc] = length;
+    pc += length;
+  }
+
+  for (const classfile::ExceptionTableEntry& entry :
+       codeAttr_->exceptionTable) {
+    pc = entry.handlerPc;
+    VERIFY(entry.startPc < entry.endPc && entry.endPc <= codeLen &&
+               lengths_[entry.startPc] > 0 &&
+               (entry.endPc == codeLen || lengths_[entry.endPc] > 0) &&
+               entry.handlerPc < codeLen && lengths_[entry.handlerPc] > 0,
+           "Bad exception table entry");
+    VERIFY(codeAttr_->maxStack >= 1, "No stack for the exception");
+  }
+  return true;
+}
+
+bool Verifier::entryFrame_(VerifyFrame& frame) {
+  int pc = 0;
+  std::vector<uint8_t> types;
+  if (!isStatic_) types.push_back(kVType_Ref);
+  for (char type : argumentTypes_) types.push_back(typeOfDescriptor(type));
+  VERIFY(expandSlots(types, codeAttr_->maxLocals, frame.locals),
+         "Arguments do not fit in the locals");
+  frame.locals.resize(codeAttr_->maxLocals, kVType_Top);
+  frame.stack.clear();
+  return true;
+}
+
+bool Verifier::step_(int pc, VerifyFrame& frame, std::vector<int>& targets,
+                     bool& fallsThrough) {
+  const BYTE* code = codeAttr_->code;
+  std::vector<uint8_t>& stack = frame.stack;
+  int maxLocals = codeAttr_->maxLocals;
+  int maxStack = codeAttr_->maxStack;
+  int size = stack.size();
+
+  // Pop a value of some type.
+  auto pop = [&](uint8_t type) {
+    if (isWide(type)) {
+      if (stack.size() < 2 || stack.back() != type + 1) return false;
+      stack.pop_back();
+    }
+    if (stack.empty() || stack.back() != type) return false;
+    stack.pop_back();
+    return true;
+  };
+  // Push a value of some type.
+  auto push = [&](uint8_t type) {
+    stack.push_back(type);
+    if (isWide(type)) stack.push_back(type + 1);
+    return (int)stack.size() <= maxStack;
+  };
+  // Load a local of some type.
+  auto load = [&](int index, uint8_t type) {
+    if (index + (isWide(type) ? 1 : 0) >= maxLocals) return false;
+    if (frame.locals[index] != type) return false;
+    if (isWide(type) && frame.locals[index + 1] != type + 1) return false;
+    return push(type);
+  };
+  // Store a value of some type into a local.
+  auto store = [&](int index, uint8_t type) {
+    if (index + (isWide(type) ? 1 : 0) >= maxLocals) return false;
+    if (!pop(type)) return false;
+    setLocal(frame, index, type);
+    return true;
+  };
+  // Whether a value starts at stack slot index (it does not split a long or a
+  // double).
+  auto boundary = [&](int index) {
+    return index >= 0 && !isSecondHalf(stack[index]);
+  };
+  // A branch target.
+  auto branch = [&](long long target) {
+    if (target < 0 || target >= codeAttr_->codeLen || lengths_[target] == 0) {
+      return false;
+    }
+    targets.push_back(int(target));
+    return true;
+  };
+  // A constant in the pool of some tag.
+  auto constant = [&](int index, uint8_t tag) {
+    classfile::ConstantPool* cp = codeAttr_->cp;
+    return cp != nullptr && index > 0 && index < cp->count() &&
+           cp->infoList[index] != nullptr && cp->infoList[index]->tag == tag;
+  };
+
+  // Types of loads, stores and returns, in the order of their opcodes.
+  static const uint8_t kTypes[] = {kVType_Int, kVType_Long, kVType_Float,
+                                   kVType_Double, kVType_Ref};
+  // Return types of ireturn ~ areturn in descriptors.
+  static const char* kReturnTypes[] = {"ZBCSI", "J", "F", "D", "L"};
+
+  uint8_t opcode = code[pc];
+  fallsThrough = true;
+
+  if (opcode == 0x00) {
+    // nop
+  } else if (opcode == 0x01) {
+    VERIFY(push(kVType_Ref), "Stack overflow");
+  } else if (opcode <= 0x0f) {
+    // iconst, lconst, fconst, dconst
+    uint8_t type = opcode <= 0x08   ? kVType_Int
+                   : opcode <= 0x0a ? kVType_Long
+                   : opcode <= 0x0d ? kVType_Float
+                                    : kVType_Double;
+    VERIFY(push(type), "Stack overflow");
+  } else if (opcode == 0x10 || opcode == 0x11) {
+    // bipush, sipush
+    VERIFY(push(kVType_Int), "Stack overflow");
+  } else if (opcode == 0x12 || opcode == 0x13) {
+    // ldc, ldc_w
+    int index = opcode == 0x12 ? code[pc + 1] : readU2(code, pc + 1);
+    uint8_t type;
+    if (constant(index, classfile::CONSTANT_TAG_Integer)) {
+      type = kVType_Int;
+    } else if (constant(index, classfile::CONSTANT_TAG_Float)) {
+      type = kVType_Float;
+    } else {
+      // Strings and classes are resolved by the classic engine only
+      return fail_(pc, "Unsupported ldc constant");
+    }
+    VERIFY(push(type), "Stack overflow");
+  } else if (opcode == 0x14) {
+    // ldc2_w
+    int index = readU2(code, pc + 1);
+    bool isLong = constant(index, classfile::CONSTANT_TAG_Long);
+    VERIFY(isLong || constant(index, classfile::CONSTANT_TAG_Double),
+           "Bad ldc2_w constant");
+    VERIFY(push(isLong ? kVType_Long : kVType_Double), "Stack overflow");
+  } else if (opcode >= 0x15 && opcode <= 0x19) {
+    VERIFY(load(code[pc + 1], kTypes[opcode - 0x15]), "Bad load");
+  } else if (opcode >= 0x1a && opcode <= 0x2d) {
+    int kind = (opcode - 0x1a) / 4;
+    VERIFY(load((opcode - 0x1a) % 4, kTypes[kind]), "Bad load");
+  } else if (opcode >= 0x36 && opcode <= 0x3a) {
+    VERIFY(store(code[pc + 1], kTypes[opcode - 0x36]), "Bad store");
+  } else if (opcode >= 0x3b && opcode <= 0x4e) {
+    int kind = (opcode - 0x3b) / 4;
+    VERIFY(store((opcode - 0x3b) % 4, kTypes[kind]), "Bad store");
+  } else if (opcode >= 0x57 && opcode <= 0x5f) {
+    // pop ~ swap: a permutation of the top slots, which must not split longs
+    // and doubles. The slots are named from the top: a, b, c, d.
+    static const int kTakes[] = {1, 2, 1, 2, 3, 2, 3, 4, 2};
+    int take = kTakes[opcode - 0x57];
+    VERIFY(size >= take, "Stack underflow");
+    bool ok;
+    switch (opcode) {
+      case 0x57:  // pop
+      case 0x59:  // dup
+        ok = boundary(size - 1);
+        break;
+      case 0x58:  // pop2
+      case 0x5c:  // dup2
+        ok = boundary(size - 2);
+        break;
+      case 0x5a:  // dup_x1
+      case 0x5f:  // swap
+        ok = boundary(size - 1) && boundary(size - 2);
+        break;
+      case 0x5b:  // dup_x2
+        ok = boundary(size - 1) && boundary(size - 3);
+        break;
+      case 0x5d:  // dup2_x1
+        ok = boundary(size - 2) && boundary(size - 3);
+        break;
+      default:  // dup2_x2
+        ok = boundary(size - 2) && boundary(size - 4);
+        break;
+    }
+    VERIFY(ok, "Splitting a long or a double on the stack");
+    std::vector<uint8_t> top(stack.end() - take, stack.end());
+    stack.resize(size - take);
+    switch (opcode) {
+      case 0x57:
+      case 0x58:
+        break;
+      case 0x5f:  // b a -> a b
+        stack.insert(stack.end(), {top[1], top[0]});
+        break;
+      default: {
+        // dup*: copy the top 1 or 2 slots below the taken ones
+        int copies = (opcode <= 0x5b) ? 1 : 2;
+        stack.insert(stack.end(), top.end() - copies, top.end());
+        stack.insert(stack.end(), top.begin(), top.end());
+        break;
+      }
+    }
+    VERIFY((int)stack.size() <= maxStack, "Stack overflow");
+  } else if (opcode >= 0x60 && opcode <= 0x77) {
+    // arithmetic and negation: i, l, f, d in turn
+    uint8_t type = kTypes[(opcode - 0x60) % 4];
+    bool binary = opcode < 0x74;
+    VERIFY(pop(type) && (!binary || pop(type)), "Bad arithmetic operands");
+    VERIFY(push(type), "Stack overflow");
+  } else if (opcode >= 0x78 && opcode <= 0x83) {
+    // shifts (by an int) and bitwise operations: i, l in turn
+    uint8_t type = (opcode - 0x78) % 2 == 0 ? kVType_Int : kVType_Long;
+    uint8_t operand2 = opcode <= 0x7d ? uint8_t(kVType_Int) : type;
+    VERIFY(pop(operand2) && pop(type), "Bad bitwise operands");
+    VERIFY(push(type), "Stack overflow");
+  } else if (opcode == 0x84) {
+    VERIFY(code[pc + 1] < maxLocals && frame.locals[code[pc + 1]] == kVType_Int,
+           "Bad iinc");
+  } else if (opcode >= 0x85 && opcode <= 0x93) {
+    // conversions: from i, l, f, d to the other three, then i2b, i2c, i2s
+    static const uint8_t kFrom[] = {kVType_Int,    kVType_Int,    kVType_Int,
+                                    kVType_Long,   kVType_Long,   kVType_Long,
+                                    kVType_Float,  kVType_Float,  kVType_Float,
+                                    kVType_Double, kVType_Double, kVType_Double,
+                                    kVType_Int,    kVType_Int,    kVType_Int};
+    static const uint8_t kTo[] = {kVType_Long,  kVType_Float,  kVType_Double,
+                                  kVType_Int,   kVType_Float,  kVType_Double,
+                                  kVType_Int,   kVType_Long,   kVType_Double,
+                                  kVType_Int,   kVType_Long,   kVType_Float,
+                                  kVType_Int,   kVType_Int,    kVType_Int};
+    VERIFY(pop(kFrom[opcode - 0x85]), "Bad conversion operand");
+    VERIFY(push(kTo[opcode - 0x85]), "Stack overflow");
+  } else if (opcode >= 0x94 && opcode <= 0x98) {
+    // lcmp, fcmpl, fcmpg, dcmpl, dcmpg
+    uint8_t type = opcode == 0x94   ? kVType_Long
+                   : opcode <= 0x96 ? kVType_Float
+                                    : kVType_Double;
+    VERIFY(pop(type) && pop(type), "Bad comparison operands");
+    VERIFY(push(kVType_Int), "Stack overflow");
+  } else if (opcode >= 0x99 && opcode <= 0xa6) {
+    // if<cond>, if_icmp<cond>, if_acmp<cond>
+    bool ok = opcode <= 0x9e   ? pop(kVType_Int)
+              : opcode <= 0xa4 ? pop(kVType_Int) && pop(kVType_Int)
+                               : pop(kVType_Ref) && pop(kVType_Ref);
+    VERIFY(ok, "Bad branch operands");
+    VERIFY(branch(pc + readS2(code, pc + 1)), "Bad branch target");
+  } else if (opcode == 0xa7 || opcode == 0xc8) {
+    // goto, goto_w
+    int offset = opcode == 0xa7 ? readS2(code, pc + 1) : readS4(code, pc + 1);
+    VERIFY(branch((long long)pc + offset), "Bad branch target");
+    fallsThrough = false;
+  } else if (opcode == 0xaa || opcode == 0xab) {
+    VERIFY(pop(kVType_Int), "Bad switch key");
+    int base = pc + 1 + (4 - (pc + 1) % 4) % 4;
+    VERIFY(branch((long long)pc + readS4(code, base)), "Bad switch target");
+    int cases = opcode == 0xaa
+                    ? readS4(code, base + 8) - readS4(code, base + 4) + 1
+                    : readS4(code, base + 4);
+    for (int i = 0; i < cases; ++i) {
+      int offset = opcode == 0xaa ? readS4(code, base + 12 + 4 * i)
+                                  : readS4(code, base + 12 + 8 * i);
+      VERIFY(branch((long long)pc + offset), "Bad switch target");
+      // the lookupswitch keys are sorted, so they can be searched
+      VERIFY(opcode == 0xaa || i == 0 ||
+                 readS4(code, base + 8 + 8 * i) > readS4(code, base + 8 * i),
+             "Unsorted lookupswitch keys");
+    }
+    fallsThrough = false;
+  } else if (opcode >= 0xac && opcode <= 0xb0) {
+    int kind = opcode - 0xac;
+    VERIFY(returnType_ != 'V' &&
+               std::string(kReturnTypes[kind]).find(returnType_) !=
+                   std::string::npos,
+           "Return type mismatch");
+    VERIFY(pop(kTypes[kind]), "Bad return value");
+    fallsThrough = false;
+  } else if (opcode == 0xb1) {
+    VERIFY(returnType_ == 'V', "Return type mismatch");
+    fallsThrough = false;
+  } else if (opcode == 0xb6 || opcode == 0xb8 || opcode == 0xb9) {
+    // invokevirtual, invokestatic, invokeinterface: pop the arguments (and the
+    // receiver), push the returned value
+    bool isVirtual = opcode != 0xb8;
+    int index = readU2(code, pc + 1);
+    VERIFY(constant(index, opcode == 0xb9
+                               ? classfile::CONSTANT_TAG_InterfaceMethodref
+                               : classfile::CONSTANT_TAG_Methodref),
+           "Bad invoke constant");
+    classfile::ConstantRefInfo* ref = static_cast<classfile::ConstantRefInfo*>(
+        codeAttr_->cp->infoList[index]);
+    auto nameAndType =
+        codeAttr_->cp->getNameAndTypeStr(ref->nameAndTypeInfoIdx);
+    VERIFY(!nameAndType.first.empty() && nameAndType.first[0] != '<',
+           "Bad invoke method name");
+    if (opcode == 0xb9) {
+      // the count is redundant: the argument slots and the receiver
+      VERIFY(code[pc + 3] == classfile::argumentSlots(nameAndType.second) + 1 &&
+                 code[pc + 4] == 0,
+             "Bad invokeinterface count");
+    }
+    std::string arguments = classfile::argumentTypes(nameAndType.second);
+    for (auto it = arguments.rbegin(); it != arguments.rend(); ++it) {
+      VERIFY(pop(typeOfDescriptor(*it)), "Bad invoke arguments");
+    }
+    if (isVirtual) {
+      VERIFY(pop(kVType_Ref), "Bad invoke receiver");
+    }
+    char result = classfile::returnType(nameAndType.second);
+    if (result != 'V') {
+      VERIFY(push(typeOfDescriptor(result)), "Stack overflow");
+    }
+  } else if (opcode == 0xbf) {
+    // athrow
+    VERIFY(pop(kVType_Ref), "Bad athrow operand");
+    fallsThrough = false;
+  } else if (opcode == 0xc0 || opcode == 0xc1) {
+    // checkcast, instanceof: a reference checked against a class
+    VERIFY(constant(readU2(code, pc + 1), classfile::CONSTANT_TAG_Class),
+           "Bad type check constant");
+    VERIFY(pop(kVType_Ref), "Bad type check operand");
+    VERIFY(push(opcode == 0xc0 ? kVType_Ref : kVType_Int), "Stack overflow");
+  } else if (opcode == 0xc4) {
+    // wide
+    uint8_t modified = code[pc + 1];
+    int index = readU2(code, pc + 2);
+    if (modified == 0x84) {
+      VERIFY(index < maxLocals && frame.locals[index] == kVType_Int,
+             "Bad iinc");
+    } else if (modified <= 0x19) {
+      VERIFY(load(index, kTypes[modified - 0x15]), "Bad load");
+    } else {
+      VERIFY(store(index, kTypes[modified - 0x36]), "Bad store");
+    }
+  } else if (opcode == 0xc6 || opcode == 0xc7) {
+    // ifnull, ifnonnull
+    VERIFY(pop(kVType_Ref), "Bad branch operand");
+    VERIFY(branch(pc + readS2(code, pc + 1)), "Bad branch target");
+  } else {
+    return fail_(pc, "Unsupported instruction");
+  }
+  return true;
+}
+
+bool Verifier::merge_(int pc, const VerifyFrame& frame, bool& changed) {
+  changed = false;
+  if (!hasFrame_[pc]) {
+    frames_[pc] = frame;
+    hasFrame_[pc] = true;
+    changed = true;
+    return true;
+  }
+  VerifyFrame& old = frames_[pc];
+  VERIFY(old.stack == frame.stack, "Stack mismatch at a join point");
+  for (size_t i = 0; i < old.locals.size(); ++i) {
+    if (old.locals[i] != frame.locals[i] && old.locals[i] != kVType_Top) {
+      old.locals[i] = kVType_Top;
+      changed = true;
+    }
+  }
+  return true;
+}
+
+bool Verifier::infer_() {
+  int codeLen = codeAttr_->codeLen;
+  frames_.assign(codeLen, VerifyFrame());
+  hasFrame_.assign(codeLen, false);
+
+  VerifyFrame entry;
+  bool changed;
+  if (!entryFrame_(entry) || !merge_(0, entry, changed)) return false;
+
+  std::vector<int> worklist = {0};
+  std::vector<bool> queued(codeLen, false);
+  queued[0] = true;
+  std::vector<int> targets;
+  while (!worklist.empty()) {
+    int pc = worklist.back();
+    worklist.pop_back();
+    queued[pc] = false;
+
+    VerifyFrame frame = frames_[pc];
+    std::vector<uint8_t> localsBefore = frame.locals;
+    bool fallsThrough;
+    targets.clear();
+    if (!step_(pc, frame, targets, fallsThrough)) return false;
+    if (fallsThrough) {
+      VERIFY(pc + lengths_[pc] < codeLen, "Falling off the end of the code");
+      targets.push_back(pc + lengths_[pc]);
+    }
+
+    // a handler may be entered before or after the instruction
+    std::vector<int> handlers;
+    for (const classfile::ExceptionTableEntry& entry :
+         codeAttr_->exceptionTable) {
+      if (entry.startPc <= pc && pc < entry.endPc) {
+        VerifyFrame thrown = {localsBefore, {kVType_Ref}};
+        if (!merge_(entry.handlerPc, thrown, changed)) return false;
+        if (changed) handlers.push_back(entry.handlerPc);
+        thrown.locals = frame.locals;
+        if (!merge_(entry.handlerPc, thrown, changed)) return false;
+        if (changed) handlers.push_back(entry.handlerPc);
+      }
+    }
+
+    for (int target : targets) {
+      if (!merge_(target, frame, changed)) return false;
+      if (changed) handlers.push_back(target);
+    }
+    for (int next : handlers) {
+      if (!queued[next]) {
+        queued[next] = true;
+        worklist.push_back(next);
+      }
+    }
+  }
+  return true;
+}
+
+bool Verifier::loadStackMap_(classfile::StackMapTableAttr* table) {
+  int codeLen = codeAttr_->codeLen;
+  frames_.assign(codeLen, VerifyFrame());
+  hasFrame_.assign(codeLen, false);
+
+  // the locals as the frames list them: a long or a double is one entry
+  std::vector<uint8_t> locals;
+  if (!isStatic_) locals.push_back(kVType_Ref);
+  for (char type : argumentTypes_) locals.push_back(typeOfDescriptor(type));
+
+  auto typeOf = [](const classfile::VerificationTypeInfo& info) -> int {
+    switch (info.tag) {
+      case classfile::ITEM_Top:
+        return kVType_Top;
+      case classfile::ITEM_Integer:
+        return kVType_Int;
+      case classfile::ITEM_Float:
+        return kVType_Float;
+      case classfile::ITEM_Double:
+        return kVType_Double;
+      case classfile::ITEM_Long:
+        return kVType_Long;
+      case classfile::ITEM_Null:
+      case classfile::ITEM_UninitializedThis:
+      case classfile::ITEM_Object:
+      case classfile::ITEM_Uninitialized:
+        return kVType_Ref;
+      default:
+        return -1;
+    }
+  };
+
+  int pc = -1;
+  for (size_t i = 0; i < table->entries.size(); ++i) {
+    const classfile::StackMapFrame& entry = table->entries[i];
+    pc = i == 0 ? entry.offsetDelta : pc + entry.offsetDelta + 1;
+    VERIFY(pc < codeLen && lengths_[pc] > 0,
+           "Stack map frame is not at an instruction");
+
+    std::vector<uint8_t> stack;
+    if (entry.frameType >= 248 && entry.frameType <= 250) {
+      // chop
+      size_t chopped = 251 - entry.frameType;
+      VERIFY(locals.size() >= chopped, "Bad chop frame");
+      locals.resize(locals.size() - chopped);
+    } else if (entry.frameType == 255) {
+      locals.clear();
+    }
+    for (const classfile::VerificationTypeInfo& info : entry.locals) {
+      int type = typeOf(info);
+      VERIFY(type >= 0, "Bad verification type");
+      locals.push_back(type);
+    }
+    for (const classfile::VerificationTypeInfo& info : entry.stack) {
+      int type = typeOf(info);
+      VERIFY(type >= 0, "Bad verification type");
+      stack.push_back(type);
+    }
+
+    VerifyFrame& frame = frames_[pc];
+    VERIFY(expandSlots(locals, codeAttr_->maxLocals, frame.locals),
+           "Stack map locals over maxLocals");
+    frame.locals.resize(codeAttr_->maxLocals, kVType_Top);
+    VERIFY(expandSlots(stack, codeAttr_->maxStack, frame.stack),
+           "Stack map stack over maxStack");
+    hasFrame_[pc] = true;
+  }
+  return true;
+}
+
+bool Verifier::assignable_(int pc, const VerifyFrame& frame) {
+  const VerifyFrame& declared = frames_[pc];
+  bool ok = declared.stack.size() == frame.stack.size();
+  for (size_t i = 0; ok && i < declared.stack.size(); ++i) {
+    ok = declared.stack[i] == kVType_Top || declared.stack[i] == frame.stack[i];
+  }
+  for (size_t i = 0; ok && i < declared.locals.size(); ++i) {
+    ok = declared.locals[i] == kVType_Top ||
+         declared.locals[i] == frame.locals[i];
+  }
+  VERIFY(ok, "Frame does not match the stack map");
+  return true;
+}
+
+bool Verifier::check_() {
+  int codeLen = codeAttr_->codeLen;
+  VerifyFrame frame;
+  if (!entryFrame_(frame)) return false;
+
+  bool reachable = true;
+  std::vector<int> targets;
+  for (int pc = 0; pc < codeLen; pc += lengths_[pc]) {
+    if (hasFrame_[pc]) {
+      if (reachable && !assignable_(pc, frame)) return false;
+      frame = frames_[pc];
+    } else {
+      VERIFY(reachable, "No stack map frame after an unconditional branch");
+    }
+
+    std::vector<uint8_t> localsBefore = frame.locals;
+    bool fallsThrough;
+    targets.clear();
+    if (!step_(pc, frame, targets, fallsThrough)) return false;
+
+    for (const classfile::ExceptionTableEntry& entry :
+         codeAttr_->exceptionTable) {
+      if (entry.startPc <= pc && pc < entry.endPc) {
+        VERIFY(hasFrame_[entry.handlerPc], "No stack map frame at a handler");
+        if (!assignable_(entry.handlerPc, {localsBefore, {kVType_Ref}}) ||
+            !assignable_(entry.handlerPc, {frame.locals, {kVType_Ref}})) {
+          return false;
+        }
+      }
+    }
+    for (int target : targets) {
+      VERIFY(hasFrame_[target], "No stack map frame at a branch target");
+      if (!assignable_(target, frame)) return false;
+    }
+    reachable = fallsThrough;
+  }
+  if (reachable) return fail_(codeLen, "Falling off the end of the code");
+  return true;
+}
+
+bool Verifier::verify() {
+  error.clear();
+  try {
+    argumentTypes_ = classfile::argumentTypes(descriptor_);
+    returnType_ = classfile::returnType(descriptor_);
+    if (!decode_()) return false;
+    classfile::StackMapTableAttr* table =
+        codeAttr_->attributes->filtStackMapTableAttr();
+    usedStackMap = table != nullptr;
+    if (usedStackMap) return loadStackMap_(table) && check_();
+    return infer_();
+  } catch (const utils::JVMPanic& e) {
+    // e.g. a malformed descriptor or constant pool
+    return fail_(0, e.what());
+  }
+}
+
+bool verifyCode(classfile::CodeAttr* codeAttr, const std::string& descriptor,
+                bool isStatic) {
+  Verifier verifier(codeAttr, descriptor, isStatic);
+  bool passed = verifier.verify();
+  if (!passed) {
+    LOG(WARNING) << "Verification failed: " << verifier.error;
+  }
+  // published to the engines, which may run on other threads
+  __atomic_store_n(&codeAttr->verifyStatus,
+                   passed ? classfile::kVerifyPassed : classfile::kVerifyFailed,
+                   __ATOMIC_RELEASE);
+  return passed;
+}
+
+bool verifyMethod(classfile::MethodInfo* method) {
+  classfile::CodeAttr* codeAttr = method->attributes->filtCodeAttr();
+  if (codeAttr == nullptr) return true;
+  return verifyCode(codeAttr, method->descriptor(),
+                    (method->accessFlags & classfile::ACC_STATIC) != 0);
+}
+
+VerifyStats verifyClass(classfile::ClassFile* classFile) {
+  auto start = std::chrono::steady_clock::now();
+  VerifyStats stats = {0, 0, 0};
+  for (classfile::MethodInfo& method : classFile->methods) {
+    if (method.attributes->filtCodeAttr() == nullptr) continue;
+    ++stats.methods;
+    if (verifyMethod(&method)) ++stats.passed;
+  }
+  stats.micros = std::chrono::duration<double, std::micro>(
+                     std::chrono::steady_clock::now() - start)
+                     .count();
+  LOG(INFO) << "Verified class " << classFile->className() << ": "
+            << stats.passed << "/" << stats.methods << " methods passed in "
+            << stats.micros << " us";
+  return stats;
+}
+
+#undef VERIFY
+
+}  // namespace vm
+
+}  // namespace coconut
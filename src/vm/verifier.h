@@ -0,0 +1,238 @@
+/*!
+ *    ________  ________  ________  ________  ________   ___  ___  _________
+ *   |\   ____\|\   __  \|\   ____\|\   __  \|\   ___  \|\  \|\  \|\___   ___\
+ *   \ \  \___|\ \  \|\  \ \  \___|\ \  \|\  \ \  \\ \  \ \  \\\  \|___ \  \_|
+ *    \ \  \    \ \  \\\  \ \  \    \ \  \\\  \ \  \\ \  \ \  \\\  \   \ \  \
+ *     \ \  \____\ \  \\\  \ \  \____\ \  \\\  \ \  \\ \  \ \  \\\  \   \ \  \
+ *      \ \_______\ \_______\ \_______\ \_______\ \__\\ \__\ \_______\   \ \__\
+ *       \|_______|\|_______|\|_______|\|_______|\|__| \|__|\|_______|    \|__|
+ *
+ * \file src/vm/verifier.h
+ * \brief Static verification of the bytecode.
+ * \author SiriusNEO
+ */
+
+#ifndef SRC_VM_VERIFIER_H_
+#define SRC_VM_VERIFIER_H_
+
+#include <string>
+#include <vector>
+
+#include "../classfile/classfile.h"
+
+namespace coconut {
+
+namespace vm {
+
+/*! \brief Types of values in the frames of the verifier. */
+enum VerifyType : uint8_t {
+  /*! \brief Unusable: never set, or merged from different types. */
+  kVType_Top,
+  /*! \brief int, and also boolean, byte, char and short. */
+  kVType_Int,
+  kVType_Float,
+  /*! \brief The first slot of a long. */
+  kVType_Long,
+  /*! \brief The second slot of a long. */
+  kVType_Long2,
+  /*! \brief The first slot of a double. */
+  kVType_Double,
+  /*! \brief The second slot of a double. */
+  kVType_Double2,
+  /*! \brief A reference or null. Classes are not tracked. */
+  kVType_Ref
+};
+
+/*! \brief Types of the local variables and the operand stack at some pc. */
+struct VerifyFrame {
+  /*! \brief One type per local slot (maxLocals). */
+  std::vector<uint8_t> locals;
+
+  /*! \brief One type per stack slot, the top is the last one. */
+  std::vector<uint8_t> stack;
+};
+
+/*!
+ * \brief Load-time bytecode verifier.
+ *
+ * It proves that a code is type-safe: every instruction finds operands of the
+ * right types on the stack and in the locals, the stack never underflows or
+ * grows over maxStack, local indices are below maxLocals, branches land on
+ * instructions, and the code never falls off its end. The engines which work
+ * on raw slots (see exec_context.h) rely on it, and only run verified code.
+ *
+ * If the code has a StackMapTable, its frames are checked in a single linear
+ * pass (type checking): the state at each frame is the declared one, and every
+ * jump must agree with the frame of its target. Otherwise the types are
+ * inferred by a dataflow analysis, which merges states at join points until
+ * a fixpoint (type inference).
+ *
+ * Only the instructions the engines implement are understood, e.g. loads and
+ * stores, arithmetic, conversions, comparisons, branches, switches, returns,
+ * invokestatic, invokevirtual, invokeinterface, athrow, checkcast and
+ * instanceof. A code with any other instruction, e.g. an array load or store,
+ * or an ldc of a String or a Class, is rejected, and runs on the checked path.
+ */
+class Verifier {
+ private:
+  /*! \brief The code. */
+  classfile::CodeAttr* codeAttr_;
+
+  /*! \brief The descriptor of the method. */
+  std::string descriptor_;
+
+  /*! \brief The argument types of the method (see classfile::argumentTypes). */
+  std::string argumentTypes_;
+
+  /*! \brief The return type of the method (see classfile::returnType). */
+  char returnType_;
+
+  /*! \brief Whether the method is static (without this in local 0). */
+  bool isStatic_;
+
+  /*! \brief Length of the instruction at each pc. 0 if not a start. */
+  std::vector<int> lengths_;
+
+  /*! \brief The frame before each instruction. Empty if not known. */
+  std::vector<VerifyFrame> frames_;
+
+  /*! \brief Whether frames_ has a frame at each pc. */
+  std::vector<bool> hasFrame_;
+
+  /*!
+   * \brief Record the reason of the failure.
+   * \param pc The pc of the failure.
+   * \param what The reason.
+   * \return false.
+   */
+  bool fail_(int pc, const std::string& what);
+
+  /*!
+   * \brief Find the start and the length of each instruction.
+   * \return Whether the code is well-formed.
+   */
+  bool decode_();
+
+  /*!
+   * \brief The frame on entry: the arguments in the first locals.
+   * \param frame The frame.
+   * \return Whether the arguments fit in the locals.
+   */
+  bool entryFrame_(VerifyFrame& frame);
+
+  /*!
+   * \brief Simulate an instruction on a frame.
+   * \param pc The pc of the instruction.
+   * \param frame The frame before it, turned into the frame after it.
+   * \param targets The branch targets of it.
+   * \param fallsThrough Whether it may go to the next instruction.
+   * \return Whether it is type-safe.
+   */
+  bool step_(int pc, VerifyFrame& frame, std::vector<int>& targets,
+             bool& fallsThrough);
+
+  /*!
+   * \brief Merge a frame into the frame at some pc (type inference).
+   * \param pc The pc. It must be the start of an instruction.
+   * \param frame The incoming frame.
+   * \param changed Set if the frame at pc is changed.
+   * \return Whether they can be merged (the stacks agree).
+   */
+  bool merge_(int pc, const VerifyFrame& frame, bool& changed);
+
+  /*!
+   * \brief Load the frames of the StackMapTable into frames_.
+   * \param table The attribute.
+   * \return Whether the table is well-formed.
+   */
+  bool loadStackMap_(classfile::StackMapTableAttr* table);
+
+  /*!
+   * \brief Check that a frame can flow into the frame declared at some pc
+   * (type checking).
+   * \param pc The pc. It must have a frame.
+   * \param frame The incoming frame.
+   * \return Whether it can.
+   */
+  bool assignable_(int pc, const VerifyFrame& frame);
+
+  /*! \brief Verify by type inference. */
+  bool infer_();
+
+  /*! \brief Verify by type checking with the stack map frames. */
+  bool check_();
+
+ public:
+  /*! \brief Whether the StackMapTable was used. */
+  bool usedStackMap;
+
+  /*! \brief The reason of the failure. Empty if passed. */
+  std::string error;
+
+  /*!
+   * \brief Default constructor.
+   * \param codeAttr The code.
+   * \param descriptor The descriptor of the method.
+   * \param isStatic Whether the method is static.
+   */
+  Verifier(classfile::CodeAttr* codeAttr, const std::string& descriptor,
+           bool isStatic);
+
+  /*!
+   * \brief Verify the code.
+   * \return Whether it is type-safe.
+   */
+  bool verify();
+};
+
+/*! \brief Statistics of the verification of a class. */
+struct VerifyStats {
+  /*! \brief Number of methods with code. */
+  int methods;
+
+  /*! \brief Number of methods passed. */
+  int passed;
+
+  /*! \brief Time of the verification, in microseconds. */
+  double micros;
+};
+
+/*!
+ * \brief Get the length of the instruction at some pc.
+ * \param code The code bytes.
+ * \param codeLen The length of the code.
+ * \param pc The pc of the instruction.
+ * \return The length. -1 if the verifier does not know the instruction or it
+ * is truncated.
+ */
+int instructionLength(const BYTE* code, int codeLen, int pc);
+
+/*!
+ * \brief Verify a code, and record the result in its verifyStatus.
+ * \param codeAttr The code.
+ * \param descriptor The descriptor of the method.
+ * \param isStatic Whether the method is static.
+ * \return Whether it is verified.
+ */
+bool verifyCode(classfile::CodeAttr* codeAttr, const std::string& descriptor,
+                bool isStatic = true);
+
+/*!
+ * \brief Verify a method. Methods without code (native, abstract) pass.
+ * \param method The method.
+ * \return Whether it is verified.
+ */
+bool verifyMethod(classfile::MethodInfo* method);
+
+/*!
+ * \brief Verify all methods of a class, and log the time it takes.
+ * \param classFile The class.
+ * \return The statistics.
+ */
+VerifyStats verifyClass(classfile::ClassFile* classFile);
+
+}  // namespace vm
+
+}  // namespace coconut
+
+#endif  // SRC_VM_VERIFIER_H_
@@ -0,0 +1,190 @@
+/*!
+ *    ________  ________  ________  ________  ________   ___  ___  _________
+ *   |\   ____\|\   __  \|\   ____\|\   __  \|\   ___  \|\  \|\  \|\___   ___\
+ *   \ \  \___|\ \  \|\  \ \  \___|\ \  \|\  \ \  \\ \  \ \  \\\  \|___ \  \_|
+ *    \ \  \    \ \  \\\  \ \  \    \ \  \\\  \ \  \\ \  \ \  \\\  \   \ \  \
+ *     \ \  \____\ \  \\\  \ \  \____\ \  \\\  \ \  \\ \  \ \  \\\  \   \ \  \
+ *      \ \_______\ \_______\ \_______\ \_______\ \__\\ \__\ \_______\   \ \__\
+ *       \|_______|\|_______|\|_______|\|_______|\|__| \|__|\|_______|    \|__|
+ *
+ * \file src/vm/x86_assembler.cc
+ * \brief Implementation of x86_assembler.h
+ * \author SiriusNEO
+ */
+
+#include "x86_assembler.h"
+
+#include "../utils/logging.h"
+
+namespace coconut {
+
+namespace vm {
+
+static bool isInt8(int32_t val) { return val >= -128 && val <= 127; }
+
+void X86Assembler::rex_(bool w, X86Reg reg, X86Reg rm) {
+  uint8_t rex = 0x40 | (w << 3) | ((reg >> 3) << 2) | (rm >> 3);
+  if (rex != 0x40) code.push_back(rex);
+}
+
+void X86Assembler::modrm_(uint8_t reg, const X86Operand& rm) {
+  uint8_t regBits = (reg & 7) << 3;
+  if (rm.isReg) {
+    code.push_back(0xc0 | regBits | (rm.reg & 7));
+    return;
+  }
+  uint8_t base = rm.reg & 7;
+  CHECK(base != (kRsp & 7)) << "rsp and r12 can not be a base";
+  // rbp and r13 have no form without a displacement
+  if (rm.disp == 0 && base != (kRbp & 7)) {
+    code.push_back(regBits | base);
+  } else if (isInt8(rm.disp)) {
+    code.push_back(0x40 | regBits | base);
+    code.push_back(uint8_t(rm.disp));
+  } else {
+    code.push_back(0x80 | regBits | base);
+    emit32_(rm.disp);
+  }
+}
+
+void X86Assembler::emit_(std::initializer_list<uint8_t> opcode, uint8_t reg,
+                         const X86Operand& rm) {
+  rex_(false, X86Reg(reg), rm.reg);
+  code.insert(code.end(), opcode);
+  modrm_(reg, rm);
+}
+
+void X86Assembler::emit32_(int32_t val) {
+  for (int i = 0; i < 4; ++i) {
+    code.push_back(uint8_t(uint32_t(val) >> (8 * i)));
+  }
+}
+
+void X86Assembler::movl(X86Reg dst, const X86Operand& src) {
+  emit_({0x8b}, dst, src);
+}
+
+void X86Assembler::movl(const X86Operand& dst, X86Reg src) {
+  emit_({0x89}, src, dst);
+}
+
+void X86Assembler::movl(const X86Operand& dst, int32_t imm) {
+  if (dst.isReg) {
+    rex_(false, kRax, dst.reg);
+    code.push_back(0xb8 | (dst.reg & 7));
+  } else {
+    emit_({0xc7}, 0, dst);
+  }
+  emit32_(imm);
+}
+
+void X86Assembler::alul(X86Alu op, X86Reg dst, const X86Operand& src) {
+  emit_({uint8_t((op << 3) | 3)}, dst, src);
+}
+
+void X86Assembler::alul(X86Alu op, const X86Operand& dst, int32_t imm) {
+  if (isInt8(imm)) {
+    emit_({0x83}, op, dst);
+    code.push_back(uint8_t(imm));
+  } else {
+    emit_({0x81}, op, dst);
+    emit32_(imm);
+  }
+}
+
+void X86Assembler::imull(X86Reg dst, const X86Operand& src) {
+  emit_({0x0f, 0xaf}, dst, src);
+}
+
+void X86Assembler::imull(X86Reg dst, const X86Operand& src, int32_t imm) {
+  if (isInt8(imm)) {
+    emit_({0x6b}, dst, src);
+    code.push_back(uint8_t(imm));
+  } else {
+    emit_({0x69}, dst, src);
+    emit32_(imm);
+  }
+}
+
+void X86Assembler::addq(X86Reg dst, X86Reg src) {
+  rex_(true, dst, src);
+  code.push_back(0x03);
+  modrm_(dst, X86Operand::ofReg(src));
+}
+
+void X86Assembler::leaq(X86Reg dst, X86Label* label) {
+  rex_(true, dst, kRax);
+  code.push_back(0x8d);
+  // mod 00, rm 101: [rip + disp32], relative to the end of the instruction
+  code.push_back(((dst & 7) << 3) | 0x05);
+  rel32_(label);
+}
+
+void X86Assembler::negl(const X86Operand& dst) { emit_({0xf7}, 3, dst); }
+
+void X86Assembler::shiftl(X86Shift op, const X86Operand& dst) {
+  emit_({0xd3}, op, dst);
+}
+
+void X86Assembler::cdq() { code.push_back(0x99); }
+
+void X86Assembler::idivl(const X86Operand& src) { emit_({0xf7}, 7, src); }
+
+void X86Assembler::testl(X86Reg a, X86Reg b) {
+  emit_({0x85}, b, X86Operand::ofReg(a));
+}
+
+void X86Assembler::push(X86Reg reg) {
+  rex_(false, kRax, reg);
+  code.push_back(0x50 | (reg & 7));
+}
+
+void X86Assembler::pop(X86Reg reg) {
+  rex_(false, kRax, reg);
+  code.push_back(0x58 | (reg & 7));
+}
+
+void X86Assembler::ret() { code.push_back(0xc3); }
+
+void X86Assembler::rel32_(X86Label* label) {
+  int at = code.size();
+  if (label->offset >= 0) {
+    emit32_(label->offset - (at + 4));
+  } else {
+    label->fixups.push_back(at);
+    emit32_(0);
+  }
+}
+
+void X86Assembler::jcc(X86Cond cond, X86Label* label) {
+  code.push_back(0x0f);
+  code.push_back(0x80 | cond);
+  rel32_(label);
+}
+
+void X86Assembler::jmp(X86Label* label) {
+  code.push_back(0xe9);
+  rel32_(label);
+}
+
+void X86Assembler::jmp(X86Reg target) {
+  rex_(false, kRax, target);
+  code.push_back(0xff);
+  code.push_back(0xe0 | (target & 7));
+}
+
+void X86Assembler::bind(X86Label* label) {
+  CHECK(label->offset < 0) << "A label is bound twice";
+  label->offset = code.size();
+  for (int at : label->fixups) {
+    int32_t rel = label->offset - (at + 4);
+    for (int i = 0; i < 4; ++i) {
+      code[at + i] = uint8_t(uint32_t(rel) >> (8 * i));
+    }
+  }
+  label->fixups.clear();
+}
+
+}  // namespace vm
+
+}  // namespace coconut
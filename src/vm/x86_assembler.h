@@ -0,0 +1,181 @@
+/*!
+ *    ________  ________  ________  ________  ________   ___  ___  _________
+ *   |\   ____\|\   __  \|\   ____\|\   __  \|\   ___  \|\  \|\  \|\___   ___\
+ *   \ \  \___|\ \  \|\  \ \  \___|\ \  \|\  \ \  \\ \  \ \  \\\  \|___ \  \_|
+ *    \ \  \    \ \  \\\  \ \  \    \ \  \\\  \ \  \\ \  \ \  \\\  \   \ \  \
+ *     \ \  \____\ \  \\\  \ \  \____\ \  \\\  \ \  \\ \  \ \  \\\  \   \ \  \
+ *      \ \_______\ \_______\ \_______\ \_______\ \__\\ \__\ \_______\   \ \__\
+ *       \|_______|\|_______|\|_______|\|_______|\|__| \|__|\|_______|    \|__|
+ *
+ * \file src/vm/x86_assembler.h
+ * \brief A small x86-64 assembler for the template compiler.
+ * \author SiriusNEO
+ */
+
+#ifndef SRC_VM_X86_ASSEMBLER_H_
+#define SRC_VM_X86_ASSEMBLER_H_
+
+#include <cstdint>
+#include <initializer_list>
+#include <vector>
+
+namespace coconut {
+
+namespace vm {
+
+/*! \brief General purpose registers, by their encodings. */
+enum X86Reg : uint8_t {
+  kRax,
+  kRcx,
+  kRdx,
+  kRbx,
+  kRsp,
+  kRbp,
+  kRsi,
+  kRdi,
+  kR8,
+  kR9,
+  kR10,
+  kR11,
+  kR12,
+  kR13,
+  kR14,
+  kR15
+};
+
+/*! \brief Condition codes of jcc. */
+enum X86Cond : uint8_t {
+  kCondEqual = 0x4,
+  kCondNotEqual = 0x5,
+  /*! \brief Unsigned greater. */
+  kCondAbove = 0x7,
+  kCondLess = 0xc,
+  kCondGreaterEqual = 0xd,
+  kCondLessEqual = 0xe,
+  kCondGreater = 0xf
+};
+
+/*! \brief Arithmetic operations, by the reg field of their 0x81 forms. */
+enum X86Alu : uint8_t {
+  kAluAdd = 0,
+  kAluOr = 1,
+  kAluAnd = 4,
+  kAluSub = 5,
+  kAluXor = 6,
+  kAluCmp = 7
+};
+
+/*! \brief Shifts by cl, by the reg field of their 0xd3 forms. */
+enum X86Shift : uint8_t { kShiftLeft = 4, kShiftRight = 5, kShiftArith = 7 };
+
+/*! \brief An operand: a register, or a memory at base + disp. */
+struct X86Operand {
+  bool isReg;
+  /*! \brief The register, or the base of the memory. */
+  X86Reg reg;
+  int32_t disp;
+
+  static X86Operand ofReg(X86Reg reg) { return X86Operand{true, reg, 0}; }
+
+  static X86Operand ofMem(X86Reg base, int32_t disp) {
+    return X86Operand{false, base, disp};
+  }
+};
+
+/*!
+ * \brief A position in the code, which jumps may refer to before it is bound.
+ */
+struct X86Label {
+  /*! \brief The offset it is bound to. -1 if not bound yet. */
+  int offset = -1;
+
+  /*! \brief Offsets of the rel32 fields which refer to it, to patch. */
+  std::vector<int> fixups;
+};
+
+/*!
+ * \brief A small x86-64 assembler. It only has the instructions the template
+ * compiler emits: 32-bit moves and arithmetic on registers and memory, the
+ * jumps, pushes and pops around them, and the address arithmetic of a jump
+ * table.
+ *
+ * A memory operand is always [base + disp32]. The base must not be rsp or r12,
+ * which would need a SIB byte.
+ */
+class X86Assembler {
+ private:
+  /*! \brief Emit a REX prefix if any of its bits is set. */
+  void rex_(bool w, X86Reg reg, X86Reg rm);
+
+  /*! \brief Emit the ModRM byte (and the displacement) of an operand. */
+  void modrm_(uint8_t reg, const X86Operand& rm);
+
+  /*! \brief Emit an instruction: prefix, opcode and ModRM. */
+  void emit_(std::initializer_list<uint8_t> opcode, uint8_t reg,
+             const X86Operand& rm);
+
+  void emit32_(int32_t val);
+
+  /*! \brief Emit the rel32 to a label, which ends a jump or a lea. */
+  void rel32_(X86Label* label);
+
+ public:
+  /*! \brief The machine code. */
+  std::vector<uint8_t> code;
+
+  /*! \brief mov dst, src (32-bit). */
+  void movl(X86Reg dst, const X86Operand& src);
+  void movl(const X86Operand& dst, X86Reg src);
+  void movl(const X86Operand& dst, int32_t imm);
+
+  /*! \brief add/or/and/sub/xor/cmp dst, src (32-bit). */
+  void alul(X86Alu op, X86Reg dst, const X86Operand& src);
+  void alul(X86Alu op, const X86Operand& dst, int32_t imm);
+
+  /*! \brief imul dst, src (32-bit). */
+  void imull(X86Reg dst, const X86Operand& src);
+  /*! \brief imul dst, src, imm (32-bit). */
+  void imull(X86Reg dst, const X86Operand& src, int32_t imm);
+
+  /*! \brief add dst, src (64-bit). */
+  void addq(X86Reg dst, X86Reg src);
+
+  /*! \brief lea dst, [rip + rel32]: the address of a label (64-bit). */
+  void leaq(X86Reg dst, X86Label* label);
+
+  /*! \brief neg dst (32-bit). */
+  void negl(const X86Operand& dst);
+
+  /*! \brief shl/shr/sar dst, cl (32-bit). */
+  void shiftl(X86Shift op, const X86Operand& dst);
+
+  /*! \brief cdq: sign-extend eax into edx. */
+  void cdq();
+
+  /*! \brief idiv src (32-bit): edx:eax / src, quotient eax, remainder edx. */
+  void idivl(const X86Operand& src);
+
+  /*! \brief test a, b (32-bit). */
+  void testl(X86Reg a, X86Reg b);
+
+  /*! \brief push, pop (64-bit). */
+  void push(X86Reg reg);
+  void pop(X86Reg reg);
+
+  void ret();
+
+  /*! \brief Jump to a label, if the condition holds. */
+  void jcc(X86Cond cond, X86Label* label);
+  void jmp(X86Label* label);
+  /*! \brief Jump to the address in a register. */
+  void jmp(X86Reg target);
+
+  /*! \brief Bind a label to the current offset, and patch its jumps. */
+  void bind(X86Label* label);
+};
+
+}  // namespace vm
+
+}  // namespace coconut
+
+#endif  // SRC_VM_X86_ASSEMBLER_H_
@@ -0,0 +1,143 @@
+// Helpers to build code for tests
+
+#ifndef TESTING_CODE_BUILDER_H_
+#define TESTING_CODE_BUILDER_H_
+
+#include <string>
+
+#include "../src/classfile/classfile.h"
+
+// build a CodeAttr (no exception table, no attributes) from raw code
+
+inline coconut::classfile::CodeAttr* makeCodeAttr(
+    uint16_t maxStack, uint16_t maxLocals, const std::vector<BYTE>& code,
+    coconut::classfile::ConstantPool* cp = nullptr) {
+  std::vector<BYTE> bytes = {
+      BYTE(maxStack >> 8),     BYTE(maxStack),          BYTE(maxLocals >> 8),
+      BYTE(maxLocals),         BYTE(code.size() >> 24), BYTE(code.size() >> 16),
+      BYTE(code.size() >> 8),  BYTE(code.size())};
+  bytes.insert(bytes.end(), code.begin(), code.end());
+  bytes.insert(bytes.end(), {0, 0, 0, 0});
+  coconut::utils::ByteReader reader(bytes.size(), bytes.data());
+  return new coconut::classfile::CodeAttr(reader, cp);
+}
+
+// append a big-endian int32 to the code (for switch tables)
+
+inline void appendInt32(std::vector<BYTE>& code, int val) {
+  code.insert(code.end(), {BYTE(val >> 24), BYTE(val >> 16), BYTE(val >> 8),
+                           BYTE(val)});
+}
+
+// a static method of the class built by makeClassFile
+
+struct MethodSpec {
+  std::string name;
+  std::string descriptor;
+  uint16_t maxStack;
+  uint16_t maxLocals;
+  std::vector<BYTE> code;
+  // the body of a StackMapTable attribute (entries), if not empty
+  std::vector<BYTE> stackMap = {};
+  // the exception table
+  std::vector<coconut::classfile::ExceptionTableEntry> exceptionTable = {};
+  // public static by default. An abstract method (0x0400) has no Code
+  uint16_t accessFlags = 0x09;
+};
+
+// build a class (default "Test") of methods. The superclass and interfaces are
+// constant pool indices (e.g. of a Class in classNames), 0 if none. If the
+// access flags have ACC_INTERFACE (0x0200), the Methodrefs below are
+// InterfaceMethodrefs, e.g. for invokeinterface. The constant pool is:
+// #1 Utf8 className, #2 Class #1, #3 Utf8 "Code", and for the i-th method,
+// #(4i + 4) Utf8 name, #(4i + 5) Utf8 descriptor, #(4i + 6) NameAndType,
+// #(4i + 7) Methodref. So invokestatic of the i-th method is 0xb8, 0, 4i + 7.
+// Then Utf8 "StackMapTable" at #(4n + 4), and for the k-th of classNames (e.g.
+// catch types), #(4n + 2k + 5) Utf8 name and #(4n + 2k + 6) Class.
+
+inline coconut::classfile::ClassFile* makeClassFile(
+    const std::vector<MethodSpec>& methods,
+    const std::vector<std::string>& classNames = {},
+    const std::string& className = "Test", int superClass = 0,
+    const std::vector<int>& interfaces = {}, uint16_t accessFlags = 0x21) {
+  std::vector<BYTE> bytes = {0xca, 0xfe, 0xba, 0xbe, 0, 0, 0, 52};
+  auto u2 = [&bytes](int val) {
+    bytes.insert(bytes.end(), {BYTE(val >> 8), BYTE(val)});
+  };
+  auto utf8 = [&](const std::string& str) {
+    bytes.push_back(1);
+    u2(str.size());
+    bytes.insert(bytes.end(), str.begin(), str.end());
+  };
+
+  u2(5 + 4 * methods.size() + 2 * classNames.size());
+  utf8(className);
+  bytes.push_back(7);
+  u2(1);
+  utf8("Code");
+  for (size_t i = 0; i < methods.size(); ++i) {
+    utf8(methods[i].name);
+    utf8(methods[i].descriptor);
+    bytes.push_back(12);
+    u2(4 * i + 4);
+    u2(4 * i + 5);
+    bytes.push_back((accessFlags & 0x0200) != 0 ? 11 : 10);
+    u2(2);
+    u2(4 * i + 6);
+  }
+  utf8("StackMapTable");
+  for (size_t k = 0; k < classNames.size(); ++k) {
+    utf8(classNames[k]);
+    bytes.push_back(7);
+    u2(4 * methods.size() + 2 * k + 5);
+  }
+
+  u2(accessFlags);
+  u2(2);           // this class
+  u2(superClass);  // super class
+  u2(interfaces.size());
+  for (int index : interfaces) u2(index);
+  u2(0);  // fields
+  u2(methods.size());
+  for (size_t i = 0; i < methods.size(); ++i) {
+    const MethodSpec& method = methods[i];
+    u2(method.accessFlags);
+    u2(4 * i + 4);
+    u2(4 * i + 5);
+    if ((method.accessFlags & 0x0400) != 0) {
+      u2(0);  // attributes
+      continue;
+    }
+    u2(1);  // attributes: Code
+    u2(3);
+    size_t stackMapSize =
+        method.stackMap.empty() ? 0 : 6 + method.stackMap.size();
+    appendInt32(bytes, 12 + method.code.size() +
+                           8 * method.exceptionTable.size() + stackMapSize);
+    u2(method.maxStack);
+    u2(method.maxLocals);
+    appendInt32(bytes, method.code.size());
+    bytes.insert(bytes.end(), method.code.begin(), method.code.end());
+    u2(method.exceptionTable.size());
+    for (const auto& entry : method.exceptionTable) {
+      u2(entry.startPc);
+      u2(entry.endPc);
+      u2(entry.handlerPc);
+      u2(entry.catchType);
+    }
+    if (method.stackMap.empty()) {
+      u2(0);  // attributes
+    } else {
+      u2(1);  // attributes: StackMapTable
+      u2(4 + 4 * methods.size());
+      appendInt32(bytes, method.stackMap.size());
+      bytes.insert(bytes.end(), method.stackMap.begin(), method.stackMap.end());
+    }
+  }
+  u2(0);  // attributes
+
+  coconut::utils::ByteReader reader(bytes.size(), bytes.data());
+  return new coconut::classfile::ClassFile(reader);
+}
+
+#endif  // TESTING_CODE_BUILDER_H_
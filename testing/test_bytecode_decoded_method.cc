@@ -0,0 +1,35 @@
+// Test bytecode/decoded_method
+
+#include <gtest/gtest.h>
+
+#include "../src/bytecode/decoded_method.h"
+#include "code_builder.h"
+
+// test decode once and dispatch from cache
+
+TEST(BYTECODE_DECODED_METHOD, FetchAndExecute) {
+  // iconst_1; bipush 5; iadd; istore_0; goto -5
+  coconut::classfile::CodeAttr* codeAttr = makeCodeAttr(
+      2, 3, {0x04, 0x10, 0x05, 0x60, 0x3b, 0xa7, 0xff, 0xfb});
+  coconut::bytecode::DecodedMethod* method =
+      coconut::bytecode::DecodedMethod::of(codeAttr);
+
+  EXPECT_EQ(method, coconut::bytecode::DecodedMethod::of(codeAttr));
+  EXPECT_EQ(1, method->fetch(0).nextPc);
+  EXPECT_EQ(3, method->fetch(1).nextPc);
+  EXPECT_EQ(8, method->fetch(5).nextPc);
+
+  // decoded only once
+  coconut::bytecode::Instruction* inst = method->fetch(1).inst;
+  EXPECT_EQ(inst, method->fetch(1).inst);
+
+  coconut::rtda::Thread thread;
+  thread.stack.push(codeAttr->maxLocals, codeAttr->maxStack);
+  coconut::bytecode::FrameExecutor executor(&thread, thread.stack.topFrame);
+  for (int pc = 0; pc < 5; pc = method->fetch(pc).nextPc) {
+    executor.execute(method->fetch(pc).inst);
+  }
+  EXPECT_EQ(6, thread.stack.topFrame->localVariableTable->getInt(0));
+
+  delete codeAttr;
+}
@@ -0,0 +1,92 @@
+// Test bytecode/instructions
+
+#include <gtest/gtest.h>
+
+#include "../src/bytecode/bytecode_decoder.h"
+
+using namespace coconut;
+
+// execute a single instruction (no operand) on a frame
+
+static void executeOpcode(rtda::Thread* thread, uint8_t opcode) {
+  bytecode::BytecodeDecoder decoder(0, nullptr);
+  bytecode::Instruction* inst = decoder.instructionFactory(opcode);
+  bytecode::FrameExecutor executor(thread, thread->stack.topFrame);
+  executor.execute(inst);
+  delete inst;
+}
+
+// test the specialized int/long arithmetic
+
+TEST(BYTECODE_INSTRUCTIONS, IntLongArith) {
+  rtda::Thread thread;
+  thread.stack.push(0, 4);
+  rtda::OperandStack* stack = thread.stack.topFrame->operandStack;
+
+  struct Case {
+    uint8_t opcode;
+    int value1, value2, result;
+  };
+  for (const Case& c : std::vector<Case>{{0x60, 7, 3, 10},
+                                         {0x64, 7, 3, 4},
+                                         {0x68, 7, -3, -21},
+                                         {0x6c, -7, 2, -3},
+                                         {0x70, -7, 2, -1},
+                                         {0x78, 1, 33, 2},
+                                         {0x7a, -8, 1, -4},
+                                         {0x7c, -1, 28, 0xf},
+                                         {0x7e, 6, 3, 2},
+                                         {0x80, 6, 3, 7},
+                                         {0x82, 6, 3, 5}}) {
+    stack->pushInt(c.value1);
+    stack->pushInt(c.value2);
+    executeOpcode(&thread, c.opcode);
+    EXPECT_EQ(c.result, stack->popInt()) << "opcode " << int(c.opcode);
+  }
+
+  stack->pushInt(5);
+  executeOpcode(&thread, 0x74);  // ineg
+  EXPECT_EQ(-5, stack->popInt());
+
+  stack->pushLong(-1);
+  stack->pushInt(60);
+  executeOpcode(&thread, 0x7d);  // lushr
+  EXPECT_EQ(0xf, stack->popLong());
+
+  stack->pushLong(1LL << 40);
+  stack->pushLong(3);
+  executeOpcode(&thread, 0x71);  // lrem
+  EXPECT_EQ((1LL << 40) % 3, stack->popLong());
+}
+
+// test the specialized float/double arithmetic and comparisons
+
+TEST(BYTECODE_INSTRUCTIONS, FloatDoubleArith) {
+  rtda::Thread thread;
+  thread.stack.push(0, 4);
+  rtda::OperandStack* stack = thread.stack.topFrame->operandStack;
+
+  stack->pushFloat(5.5f);
+  stack->pushFloat(2.0f);
+  executeOpcode(&thread, 0x72);  // frem
+  EXPECT_EQ(1.5f, stack->popFloat());
+
+  stack->pushDouble(1.5);
+  stack->pushDouble(0.25);
+  executeOpcode(&thread, 0x6f);  // ddiv
+  EXPECT_EQ(6.0, stack->popDouble());
+
+  stack->pushDouble(2.0);
+  executeOpcode(&thread, 0x77);  // dneg
+  EXPECT_EQ(-2.0, stack->popDouble());
+
+  stack->pushDouble(1.0);
+  stack->pushDouble(2.0);
+  executeOpcode(&thread, 0x97);  // dcmpl
+  EXPECT_EQ(-1, stack->popInt());
+
+  stack->pushFloat(NAN);
+  stack->pushFloat(2.0f);
+  executeOpcode(&thread, 0x96);  // fcmpg
+  EXPECT_EQ(1, stack->popInt());
+}
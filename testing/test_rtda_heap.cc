@@ -0,0 +1,228 @@
+// Test rtda/heap
+
+#include <gtest/gtest.h>
+
+#include <string>
+#include <vector>
+
+#include "../src/rtda/heap/class.h"
+#include "code_builder.h"
+
+using coconut::rtda::Class;
+using coconut::rtda::ClassTable;
+
+// test the vtable layout: an override keeps the slot of the superclass, and
+// new virtual methods follow the inherited ones
+
+TEST(RTDA_HEAP, VTable) {
+  // a table of its own: the classes go away before their class files
+  ClassTable::Scope scope;
+  // #18 Class java/lang/Object
+  coconut::classfile::ClassFile* base = makeClassFile(
+      {
+          {"a", "()I", 1, 1, {0x04, 0xac}, {}, {}, 0x01},
+          {"b", "()I", 1, 1, {0x04, 0xac}, {}, {}, 0x01},
+          // static and private methods are not virtual
+          {"s", "()I", 1, 0, {0x04, 0xac}},
+          {"p", "()I", 1, 1, {0x04, 0xac}, {}, {}, 0x02},
+      },
+      {"java/lang/Object"}, "VTableBase", 22);
+  // #14 Class VTableBase
+  coconut::classfile::ClassFile* derived = makeClassFile(
+      {
+          {"c", "()I", 1, 1, {0x05, 0xac}, {}, {}, 0x01},
+          {"b", "()I", 1, 1, {0x05, 0xac}, {}, {}, 0x01},
+      },
+      {"VTableBase"}, "VTableDerived", 14);
+  ClassTable& table = ClassTable::instance();
+  Class* baseClass = table.define(base);
+  Class* derivedClass = table.define(derived);
+  EXPECT_EQ(baseClass, derivedClass->superClass);
+  EXPECT_FALSE(derivedClass->isLinked());
+
+  // linking a class links its superclasses
+  table.link(derivedClass);
+  EXPECT_TRUE(baseClass->isLinked());
+  ASSERT_EQ(2u, baseClass->vtable.size());
+  ASSERT_EQ(3u, derivedClass->vtable.size());
+  EXPECT_EQ(0, baseClass->vtableSlot("a", "()I"));
+  EXPECT_EQ(1, baseClass->vtableSlot("b", "()I"));
+  EXPECT_EQ(-1, baseClass->vtableSlot("s", "()I"));
+  EXPECT_EQ(-1, baseClass->vtableSlot("p", "()I"));
+  EXPECT_EQ(0, derivedClass->vtableSlot("a", "()I"));
+  EXPECT_EQ(1, derivedClass->vtableSlot("b", "()I"));
+  EXPECT_EQ(2, derivedClass->vtableSlot("c", "()I"));
+  EXPECT_EQ(-1, derivedClass->vtableSlot("c", "()J"));
+  EXPECT_EQ(baseClass->vtable[0].method, derivedClass->vtable[0].method);
+  EXPECT_EQ(&derived->methods[1], derivedClass->vtable[1].method);
+  EXPECT_EQ(derived->methods[1].attributes->filtCodeAttr(),
+            derivedClass->vtable[1].code);
+
+  // a class is defined once
+  EXPECT_THROW(table.define(derived), coconut::utils::JVMPanic);
+
+  delete derived;
+  delete base;
+}
+
+// test the itable layout: an interface lays out its methods, then the ones of
+// its superinterfaces, and the itables of a superclass keep their indices
+
+TEST(RTDA_HEAP, ITable) {
+  ClassTable::Scope scope;
+  // #10 Class java/lang/Object
+  coconut::classfile::ClassFile* a =
+      makeClassFile({{"a", "()I", 0, 1, {}, {}, {}, 0x0401}},
+                    {"java/lang/Object"}, "ITableA", 10, {}, 0x0601);
+  // #12 Class ITableA
+  coconut::classfile::ClassFile* b =
+      makeClassFile({{"b", "()I", 0, 1, {}, {}, {}, 0x0401}},
+                    {"java/lang/Object", "ITableA"}, "ITableB", 10, {12},
+                    0x0601);
+  coconut::classfile::ClassFile* base =
+      makeClassFile({{"a", "()I", 1, 1, {0x04, 0xac}, {}, {}, 0x01}},
+                    {"java/lang/Object", "ITableA"}, "ITableBase", 10, {12});
+  // #10 Class ITableBase, #12 Class ITableB
+  coconut::classfile::ClassFile* derived =
+      makeClassFile({{"b", "()I", 1, 1, {0x05, 0xac}, {}, {}, 0x01}},
+                    {"ITableBase", "ITableB"}, "ITableDerived", 10, {12});
+  ClassTable& table = ClassTable::instance();
+  Class* aClass = table.define(a);
+  Class* bClass = table.define(b);
+  Class* baseClass = table.define(base);
+  Class* derivedClass = table.define(derived);
+  EXPECT_TRUE(aClass->isInterface);
+  EXPECT_FALSE(baseClass->isInterface);
+  ASSERT_EQ(1u, bClass->interfaces.size());
+  EXPECT_EQ(aClass, bClass->interfaces[0]);
+
+  table.link(derivedClass);
+  EXPECT_TRUE(bClass->isLinked());
+  ASSERT_EQ(2u, bClass->vtable.size());
+  EXPECT_EQ(0, bClass->vtableSlot("b", "()I"));
+  EXPECT_EQ(1, bClass->vtableSlot("a", "()I"));
+  EXPECT_TRUE(bClass->itables.empty());
+
+  ASSERT_EQ(1u, baseClass->itables.size());
+  EXPECT_EQ(aClass, baseClass->itables[0].interfaceClass);
+  ASSERT_EQ(2u, derivedClass->itables.size());
+  EXPECT_EQ(aClass, derivedClass->itables[0].interfaceClass);
+  EXPECT_EQ(bClass, derivedClass->itables[1].interfaceClass);
+  const auto& methods = derivedClass->itables[1].methods;
+  ASSERT_EQ(2u, methods.size());
+  EXPECT_EQ(derived->methods[0].attributes->filtCodeAttr(), methods[0].code);
+  EXPECT_EQ(base->methods[0].attributes->filtCodeAttr(), methods[1].code);
+  EXPECT_EQ(methods[1].code, derivedClass->itables[0].methods[0].code);
+
+  // the hint is updated to the index found
+  int hint = 0;
+  EXPECT_EQ(&derivedClass->itables[1], derivedClass->findITable(bClass, &hint));
+  EXPECT_EQ(1, hint);
+  EXPECT_EQ(&derivedClass->itables[1], derivedClass->findITable(bClass, &hint));
+  EXPECT_EQ(nullptr, baseClass->findITable(bClass, &hint));
+  EXPECT_EQ(1, hint);
+
+  delete derived;
+  delete base;
+  delete b;
+  delete a;
+}
+
+// test subtype checks: the primary supers display, the secondary supers past
+// its depth and of interfaces, and classes linked again when completed
+
+TEST(RTDA_HEAP, SubtypeCheck) {
+  ClassTable::Scope scope;
+  ClassTable& table = ClassTable::instance();
+  Class* object = table.resolve("java/lang/Object");
+  // interface SubtypeI, and classes Subtype0 ... Subtype9, where Subtype3
+  // implements SubtypeI
+  Class* interfaceClass = new Class("SubtypeI", object);
+  interfaceClass->isInterface = true;
+  std::vector<Class*> classes;
+  for (int i = 0; i < 10; ++i) {
+    classes.push_back(new Class("Subtype" + std::to_string(i),
+                                i == 0 ? object : classes.back()));
+  }
+  classes[3]->interfaces.push_back(interfaceClass);
+  Class* leaf = classes.back();
+
+  // a check links the classes
+  EXPECT_TRUE(leaf->isSubtypeOf(classes[2]));
+  EXPECT_TRUE(leaf->isLinked());
+  EXPECT_EQ(10, leaf->depth);
+  EXPECT_EQ(object, leaf->primarySupers[0]);
+  EXPECT_EQ(classes[6], leaf->primarySupers[7]);
+  // Subtype7 ... Subtype9 are too deep for the display
+  ASSERT_EQ(4u, leaf->secondarySupers.size());
+  EXPECT_EQ(interfaceClass, leaf->secondarySupers[0]);
+  EXPECT_EQ(leaf, leaf->secondarySupers.back());
+
+  EXPECT_TRUE(leaf->isSubtypeOf(object));
+  EXPECT_TRUE(leaf->isSubtypeOf(leaf));
+  EXPECT_TRUE(leaf->isSubtypeOf(classes[8]));
+  EXPECT_TRUE(leaf->isSubtypeOf(interfaceClass));
+  EXPECT_TRUE(classes[3]->isSubtypeOf(interfaceClass));
+  EXPECT_FALSE(classes[2]->isSubtypeOf(interfaceClass));
+  EXPECT_FALSE(classes[2]->isSubtypeOf(classes[3]));
+  EXPECT_FALSE(classes[8]->isSubtypeOf(leaf));
+  EXPECT_TRUE(interfaceClass->isSubtypeOf(object));
+  EXPECT_TRUE(interfaceClass->isSubtypeOf(interfaceClass));
+  EXPECT_FALSE(object->isSubtypeOf(interfaceClass));
+
+  // a class linked before its definition is linked again
+  Class* exception = table.resolve("java/lang/Exception");
+  Class* late = table.resolve("SubtypeLate");
+  EXPECT_FALSE(late->isSubtypeOf(exception));
+  EXPECT_TRUE(late->isLinked());
+  // #6 Class java/lang/Exception
+  coconut::classfile::ClassFile* lateFile =
+      makeClassFile({}, {"java/lang/Exception"}, "SubtypeLate", 6);
+  EXPECT_EQ(late, table.define(lateFile));
+  EXPECT_FALSE(late->isLinked());
+  EXPECT_TRUE(late->isSubtypeOf(exception));
+  EXPECT_EQ(3, late->depth);
+
+  // and so is a subclass linked against it before
+  Class* bare = table.resolve("SubtypeBare");
+  // #6 Class SubtypeBare
+  coconut::classfile::ClassFile* subFile =
+      makeClassFile({}, {"SubtypeBare"}, "SubtypeBareSub", 6);
+  Class* sub = table.define(subFile);
+  EXPECT_TRUE(sub->isSubtypeOf(bare));
+  EXPECT_EQ(1, sub->depth);
+  coconut::classfile::ClassFile* bareFile =
+      makeClassFile({}, {"java/lang/Exception"}, "SubtypeBare", 6);
+  EXPECT_EQ(bare, table.define(bareFile));
+  EXPECT_FALSE(sub->isLinked());
+  EXPECT_TRUE(sub->isSubtypeOf(bare));
+  EXPECT_TRUE(sub->isSubtypeOf(exception));
+  EXPECT_EQ(4, sub->depth);
+  EXPECT_EQ(bare, sub->primarySupers[3]);
+
+  delete lateFile;
+  delete subFile;
+  delete bareFile;
+  for (Class* cls : classes) delete cls;
+  delete interfaceClass;
+}
+
+// test a scoped table replaces the shared one while it lives
+
+TEST(RTDA_HEAP, ClassTableScope) {
+  ClassTable& shared = ClassTable::instance();
+  {
+    ClassTable::Scope scope;
+    ClassTable& scoped = ClassTable::instance();
+    EXPECT_NE(&shared, &scoped);
+    // with its own bootstrap classes
+    EXPECT_NE(shared.resolve("java/lang/Object"),
+              scoped.resolve("java/lang/Object"));
+    {
+      ClassTable::Scope inner;
+      EXPECT_NE(&scoped, &ClassTable::instance());
+    }
+    EXPECT_EQ(&scoped, &ClassTable::instance());
+  }
+  EXPECT_EQ(&shared, &ClassTable::instance());
+}
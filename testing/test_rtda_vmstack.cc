@@ -2,12 +2,16 @@
 
 #include <gtest/gtest.h>
 
+#include <cmath>
+#include <cstring>
+#include <vector>
+
 #include "../src/rtda/vmstack/jvm_stack.h"
 
 // test local_variable_table
 
 TEST(RTDA_VMSTACK, LocalVariableTable) {
-  coconut::rtda::JVMStack vmStack(10);
+  coconut::rtda::JVMStack vmStack;
 
   vmStack.push(100, 100);
 
@@ -31,7 +35,7 @@ TEST(RTDA_VMSTACK, LocalVariableTable) {
 // test operand_stack
 
 TEST(RTDA_VMSTACK, OperandStack) {
-  coconut::rtda::JVMStack vmStack(10);
+  coconut::rtda::JVMStack vmStack;
 
   vmStack.push(100, 100);
 
@@ -51,3 +55,147 @@ TEST(RTDA_VMSTACK, OperandStack) {
   EXPECT_EQ(-100, vmStack.topFrame->operandStack->popInt());
   EXPECT_EQ(100, vmStack.topFrame->operandStack->popInt());
 }
+
+// test the layout of longs and doubles in their two slots
+
+TEST(RTDA_VMSTACK, WideSlots) {
+  coconut::rtda::JVMStack vmStack;
+  vmStack.push(4, 4);
+  coconut::rtda::LocalVariableTable* locals =
+      vmStack.topFrame->localVariableTable;
+  coconut::rtda::OperandStack* stack = vmStack.topFrame->operandStack;
+  coconut::rtda::Slot* slots = locals->slots();
+  const long long val = -(1LL << 40) + 7;
+
+  locals->setInt(1, 42);
+  locals->setLong(0, val);
+#ifdef COCONUT_SPLIT_WIDE_SLOTS
+  EXPECT_EQ(coconut::rtda::Slot32(val), slots[0].bytes);
+  EXPECT_EQ(coconut::rtda::Slot32(val >> 32), slots[1].bytes);
+#else
+  // the whole value is in the first slot, and the second one is untouched
+  EXPECT_EQ(val, slots[0].i64);
+  EXPECT_EQ(42, locals->getInt(1));
+#endif
+  EXPECT_EQ(val, locals->getLong(0));
+
+  // the bits of a double are kept, e.g. of -0.0 and NaN
+  for (double d : {-0.0, std::nan("1"), 1e300}) {
+    locals->setDouble(2, d);
+    stack->pushDouble(locals->getDouble(2));
+    double popped = stack->popDouble();
+    EXPECT_EQ(0, std::memcmp(&d, &popped, sizeof(double)));
+  }
+
+  // dup2 and pop2 move the two slots as they are
+  stack->pushLong(val);
+  stack->pushSlot(stack->getSlot(0));
+  stack->pushSlot(stack->getSlot(1));
+  EXPECT_EQ(val, stack->popLong());
+  EXPECT_EQ(val, stack->popLong());
+}
+
+// test jvm_stack: frames are bump-allocated in the slot arena
+
+TEST(RTDA_VMSTACK, FrameArena) {
+  coconut::rtda::JVMStack vmStack;
+
+  vmStack.push(2, 3);
+  coconut::rtda::StackFrame* lower = vmStack.topFrame;
+  lower->operandStack->pushInt(7);
+  vmStack.push(4, 4);
+  coconut::rtda::StackFrame* upper = vmStack.topFrame;
+
+  // locals, frame, operand stack; the upper frame follows the lower one
+  EXPECT_EQ((void*)(upper->localVariableTable->slots() + 4), (void*)upper);
+  EXPECT_EQ(lower->operandStack->top() + 2,
+            upper->localVariableTable->slots());
+
+  // popping frees the memory of the frame for the next push
+  coconut::rtda::Slot* upperLocals = upper->localVariableTable->slots();
+  vmStack.pop();
+  vmStack.push(1, 1);
+  EXPECT_EQ(upperLocals, vmStack.topFrame->localVariableTable->slots());
+  vmStack.pop();
+  EXPECT_EQ(7, vmStack.topFrame->operandStack->popInt());
+}
+
+// test jvm_stack: arguments are passed in place
+
+TEST(RTDA_VMSTACK, OverlappedFrames) {
+  coconut::rtda::JVMStack vmStack;
+
+  vmStack.push(0, 4);
+  coconut::rtda::OperandStack* invoker = vmStack.topFrame->operandStack;
+  invoker->pushInt(1);
+  invoker->pushInt(2);
+  invoker->pushLong(1LL << 40);
+  coconut::rtda::Slot* args = invoker->top() - 3;
+
+  // (IJ) -> 3 argument slots
+  vmStack.push(5, 2, 3);
+  coconut::rtda::StackFrame* callee = vmStack.topFrame;
+  EXPECT_EQ(args, callee->localVariableTable->slots());
+  EXPECT_EQ(2, callee->localVariableTable->getInt(0));
+  EXPECT_EQ(1LL << 40, callee->localVariableTable->getLong(1));
+  callee->localVariableTable->setInt(4, 9);
+  callee->operandStack->pushInt(3);
+
+  // a frame pushed by the callee does not overlap it
+  vmStack.push(1, 1);
+  EXPECT_EQ(callee->operandStack->top() + 1,
+            vmStack.topFrame->localVariableTable->slots());
+  vmStack.pop();
+
+  // the result replaces the arguments
+  int result = callee->operandStack->popInt();
+  vmStack.pop();
+  invoker->pushInt(result);
+  EXPECT_EQ(3, invoker->popInt());
+  EXPECT_EQ(1, invoker->popInt());
+}
+
+// test jvm_stack: an overflow faults in the guard zone
+
+TEST(RTDA_VMSTACK, StackOverflow) {
+  coconut::rtda::JVMStack vmStack(4096);
+
+  unsigned int depth = 0;
+  try {
+    for (;; ++depth) vmStack.push(2, 2);
+  } catch (const coconut::utils::JVMPanic& e) {
+    EXPECT_NE(nullptr, std::strstr(e.what(), "java.lang.StackOverflowError"));
+  }
+  EXPECT_GT(depth, 0u);
+  EXPECT_EQ(depth, vmStack.size);
+
+  // the stack is left unchanged, even by a frame larger than the guard page
+  coconut::rtda::StackFrame* top = vmStack.topFrame;
+  vmStack.pop();
+  EXPECT_THROW(vmStack.push(0xffff, 0xffff), coconut::utils::JVMPanic);
+  EXPECT_EQ(depth - 1, vmStack.size);
+  vmStack.push(2, 2);
+  EXPECT_EQ(top, vmStack.topFrame);
+
+  // arguments are not popped from the invoker by an overflowing push
+  vmStack.topFrame->operandStack->pushInt(42);
+  EXPECT_THROW(vmStack.push(1, 0x8000, 1), coconut::utils::JVMPanic);
+  EXPECT_EQ(42, vmStack.topFrame->operandStack->popInt());
+
+  // the stack is still usable after the overflows
+  vmStack.clear();
+  vmStack.push(4, 4);
+  vmStack.topFrame->operandStack->pushInt(1);
+  EXPECT_EQ(1, vmStack.topFrame->operandStack->popInt());
+}
+
+// test jvm_stack: stacks are committed lazily, so many threads are cheap
+
+TEST(RTDA_VMSTACK, ManyStacks) {
+  std::vector<coconut::rtda::JVMStack*> stacks;
+  for (int i = 0; i < 1000; ++i) {
+    stacks.push_back(new coconut::rtda::JVMStack(64 << 20));
+    stacks.back()->push(1, 1);
+  }
+  for (coconut::rtda::JVMStack* stack : stacks) delete stack;
+}
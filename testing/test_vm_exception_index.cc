@@ -0,0 +1,79 @@
+// Test vm/exception_index, rtda/heap/class
+
+#include <gtest/gtest.h>
+
+#include "../src/vm/exception_index.h"
+#include "code_builder.h"
+
+using coconut::rtda::Class;
+using coconut::rtda::ClassTable;
+using coconut::vm::ExceptionIndex;
+
+// test the bootstrap class hierarchy
+
+TEST(VM_EXCEPTION_INDEX, ClassTable) {
+  ClassTable& table = ClassTable::instance();
+  Class* throwable = table.resolve("java/lang/Throwable");
+  Class* arithmetic = table.resolve("java/lang/ArithmeticException");
+  Class* overflow = table.resolve("java/lang/StackOverflowError");
+
+  EXPECT_EQ(throwable, table.resolve("java/lang/Throwable"));
+  EXPECT_TRUE(arithmetic->isSubtypeOf(throwable));
+  EXPECT_TRUE(arithmetic->isSubtypeOf(arithmetic));
+  EXPECT_TRUE(overflow->isSubtypeOf(table.resolve("java/lang/Error")));
+  EXPECT_FALSE(overflow->isSubtypeOf(table.resolve("java/lang/Exception")));
+  EXPECT_FALSE(throwable->isSubtypeOf(arithmetic));
+
+  // an unknown class is defined on demand, without a superclass
+  Class* unknown = table.resolve("Unknown");
+  EXPECT_EQ("Unknown", unknown->name);
+  EXPECT_EQ(nullptr, unknown->superClass);
+  EXPECT_EQ(unknown, table.resolve("Unknown"));
+}
+
+// test nested and overlapping handler ranges
+
+TEST(VM_EXCEPTION_INDEX, Find) {
+  // #10 Class java/lang/RuntimeException, #12 Class java/lang/Error
+  coconut::classfile::ClassFile* classFile = makeClassFile(
+      {{"main",
+        "()V",
+        0,
+        0,
+        {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0xb1},
+        {},
+        {{2, 8, 20, 10}, {4, 6, 30, 0}, {0, 10, 40, 12}}}},
+      {"java/lang/RuntimeException", "java/lang/Error"});
+  ExceptionIndex index(
+      classFile->findMethod("main", "()V")->attributes->filtCodeAttr());
+  ClassTable& table = ClassTable::instance();
+  Class* arithmetic = table.resolve("java/lang/ArithmeticException");
+  Class* overflow = table.resolve("java/lang/StackOverflowError");
+
+  EXPECT_FALSE(index.empty());
+  EXPECT_EQ(-1, index.find(0, arithmetic));
+  EXPECT_EQ(40, index.find(0, overflow));
+  EXPECT_EQ(20, index.find(3, arithmetic));
+  EXPECT_EQ(40, index.find(3, overflow));
+  // the first matching handler in the table order wins
+  EXPECT_EQ(20, index.find(5, arithmetic));
+  EXPECT_EQ(30, index.find(5, overflow));
+  EXPECT_EQ(30, index.find(5, nullptr));
+  EXPECT_EQ(-1, index.find(7, nullptr));
+  EXPECT_EQ(40, index.find(9, overflow));
+  // endPc is exclusive
+  EXPECT_EQ(-1, index.find(10, overflow));
+  EXPECT_EQ(-1, index.find(100, overflow));
+
+  delete classFile;
+}
+
+// test a code without handlers
+
+TEST(VM_EXCEPTION_INDEX, Empty) {
+  coconut::classfile::CodeAttr* codeAttr = makeCodeAttr(0, 0, {0xb1});
+  ExceptionIndex index(codeAttr);
+  EXPECT_TRUE(index.empty());
+  EXPECT_EQ(-1, index.find(0, nullptr));
+  delete codeAttr;
+}
@@ -0,0 +1,1300 @@
+// Test vm/interpreter, vm/threaded_interpreter, vm/register_interpreter
+
+#include <gtest/gtest.h>
+#include <pthread.h>
+
+#include <sstream>
+#include <tuple>
+
+#include "../src/vm/interpreter.h"
+#include "../src/vm/register_interpreter.h"
+#include "../src/vm/threaded_interpreter.h"
+#include "../src/vm/verifier.h"
+#include "code_builder.h"
+
+using coconut::classfile::CodeAttr;
+using coconut::rtda::ClassTable;
+using coconut::rtda::Object;
+using coconut::rtda::Throwable;
+using coconut::rtda::Thread;
+using coconut::vm::Interpreter;
+using coconut::vm::OpcodePairHistogram;
+using coconut::vm::RegisterCode;
+using coconut::vm::RegisterInterpreter;
+using coconut::vm::ThreadedCode;
+using coconut::vm::ThreadedInst;
+using coconut::vm::ThreadedInterpreter;
+using coconut::vm::verifyClass;
+using coconut::vm::verifyCode;
+
+// run a code in a thread. The bottom frame is the invoker, which receives the
+// returned value.
+
+static void runCode(Interpreter* engine, CodeAttr* codeAttr, Thread* thread) {
+  thread->stack.push(0, 4);
+  thread->stack.push(codeAttr->maxLocals, codeAttr->maxStack);
+  engine->execute(thread, codeAttr);
+  EXPECT_EQ(1u, thread->stack.size);
+}
+
+// run a code as runCode does, in a native thread with a small stack
+
+static void runCodeOnSmallStack(Interpreter* engine, CodeAttr* codeAttr,
+                                Thread* thread, size_t stackSize) {
+  struct Run {
+    Interpreter* engine;
+    CodeAttr* codeAttr;
+    Thread* thread;
+  } run{engine, codeAttr, thread};
+  pthread_attr_t attr;
+  pthread_attr_init(&attr);
+  pthread_attr_setstacksize(&attr, stackSize);
+  pthread_t native;
+  ASSERT_EQ(0, pthread_create(
+                   &native, &attr,
+                   [](void* arg) -> void* {
+                     Run* run = static_cast<Run*>(arg);
+                     runCode(run->engine, run->codeAttr, run->thread);
+                     return nullptr;
+                   },
+                   &run));
+  pthread_join(native, nullptr);
+  pthread_attr_destroy(&attr);
+}
+
+// test int loop: sum of 0 ~ 9
+
+TEST(VM_INTERPRETER, IntLoop) {
+  CodeAttr* codeAttr = makeCodeAttr(
+      2, 2,
+      {0x03, 0x3b, 0x03, 0x3c, 0x1b, 0x10, 0x0a, 0xa2, 0x00, 0x0d, 0x1a, 0x1b,
+       0x60, 0x3b, 0x84, 0x01, 0x01, 0xa7, 0xff, 0xf3, 0x1a, 0xac});
+  Interpreter classic;
+  ThreadedInterpreter threaded, tos(true, true);
+  RegisterInterpreter reg;
+  EXPECT_TRUE(verifyCode(codeAttr, "()I"));
+
+  for (Interpreter* engine : {&classic, (Interpreter*)&threaded,
+                              (Interpreter*)&tos, (Interpreter*)&reg}) {
+    Thread thread;
+    runCode(engine, codeAttr, &thread);
+    EXPECT_EQ(45, thread.stack.topFrame->operandStack->popInt());
+  }
+
+  delete codeAttr;
+}
+
+// test long: shift, lcmp, lreturn
+
+TEST(VM_INTERPRETER, Long) {
+  CodeAttr* codeAttr = makeCodeAttr(
+      4, 2,
+      {0x0a, 0x10, 0x28, 0x79, 0x10, 0x07, 0x85, 0x61, 0x3f, 0x1e, 0x09, 0x94,
+       0x9e, 0x00, 0x06, 0x1e, 0xad, 0x00, 0x09, 0xad});
+  EXPECT_TRUE(verifyCode(codeAttr, "()J"));
+  Interpreter classic;
+  ThreadedInterpreter threaded, tos(true, true);
+  RegisterInterpreter reg;
+
+  for (Interpreter* engine : {&classic, (Interpreter*)&threaded,
+                              (Interpreter*)&tos, (Interpreter*)&reg}) {
+    Thread thread;
+    runCode(engine, codeAttr, &thread);
+    EXPECT_EQ((1LL << 40) + 7, thread.stack.topFrame->operandStack->popLong());
+  }
+
+  delete codeAttr;
+}
+
+// test MIN / -1 and MIN % -1, which overflow (and trap on x86)
+
+TEST(VM_INTERPRETER, DivisionOverflow) {
+  // iconst_1; bipush 31; ishl; iconst_m1; idiv (irem); ireturn
+  // iconst_m1; istore_0; iconst_1; bipush 31; ishl; iload_0; idiv; ireturn
+  // lconst_1; bipush 63; lshl; iconst_m1; i2l; ldiv (lrem); lreturn
+  struct Case {
+    std::vector<BYTE> code;
+    std::string descriptor;
+    long long result;
+  };
+  std::vector<Case> cases = {
+      {{0x04, 0x10, 0x1f, 0x78, 0x02, 0x6c, 0xac}, "()I", INT32_MIN},
+      {{0x04, 0x10, 0x1f, 0x78, 0x02, 0x70, 0xac}, "()I", 0},
+      {{0x02, 0x3b, 0x04, 0x10, 0x1f, 0x78, 0x1a, 0x6c, 0xac},
+       "()I",
+       INT32_MIN},
+      {{0x0a, 0x10, 0x3f, 0x79, 0x02, 0x85, 0x6d, 0xad}, "()J", INT64_MIN},
+      {{0x0a, 0x10, 0x3f, 0x79, 0x02, 0x85, 0x71, 0xad}, "()J", 0}};
+  for (const Case& c : cases) {
+    CodeAttr* codeAttr = makeCodeAttr(4, 1, c.code);
+    Interpreter classic;
+    ThreadedInterpreter threaded, tos(true, true);
+    RegisterInterpreter reg;
+    EXPECT_TRUE(verifyCode(codeAttr, c.descriptor));
+    // the register engine has ints only
+    EXPECT_EQ(c.descriptor == "()I",
+              reg.translateRegisters(codeAttr)->supported);
+    for (Interpreter* engine : {&classic, (Interpreter*)&threaded,
+                                (Interpreter*)&tos, (Interpreter*)&reg}) {
+      Thread thread;
+      runCode(engine, codeAttr, &thread);
+      ASSERT_EQ(nullptr, thread.exception);
+      coconut::rtda::OperandStack* stack = thread.stack.topFrame->operandStack;
+      EXPECT_EQ(c.result,
+                c.descriptor == "()I" ? stack->popInt() : stack->popLong());
+    }
+    delete codeAttr;
+  }
+}
+
+// test f2i, f2l, d2i and d2l of NaN and out-of-range values, which saturate
+
+TEST(VM_INTERPRETER, SaturatingConversions) {
+  struct Case {
+    std::vector<BYTE> code;
+    std::string descriptor;
+    long long result;
+  };
+  std::vector<Case> cases = {
+      // fconst_0; fconst_0; fdiv; f2i (f2l); ireturn (lreturn): NaN
+      {{0x0b, 0x0b, 0x6e, 0x8b, 0xac}, "()I", 0},
+      {{0x0b, 0x0b, 0x6e, 0x8c, 0xad}, "()J", 0},
+      // fconst_1; fneg; fconst_0; fdiv; f2i (f2l): -Infinity
+      {{0x0c, 0x76, 0x0b, 0x6e, 0x8b, 0xac}, "()I", INT32_MIN},
+      {{0x0c, 0x76, 0x0b, 0x6e, 0x8c, 0xad}, "()J", INT64_MIN},
+      // dconst_1; dconst_0; ddiv; d2i (d2l): Infinity
+      {{0x0f, 0x0e, 0x6f, 0x8e, 0xac}, "()I", INT32_MAX},
+      {{0x0f, 0x0e, 0x6f, 0x8f, 0xad}, "()J", INT64_MAX},
+      // lconst_1; bipush 40; lshl; l2d (l2f); d2i (f2i): 2^40
+      {{0x0a, 0x10, 0x28, 0x79, 0x8a, 0x8e, 0xac}, "()I", INT32_MAX},
+      {{0x0a, 0x10, 0x28, 0x79, 0x89, 0x8b, 0xac}, "()I", INT32_MAX},
+      // lconst_1; bipush 40; lshl; l2d; dneg; d2l: in range
+      {{0x0a, 0x10, 0x28, 0x79, 0x8a, 0x77, 0x8f, 0xad}, "()J", -(1LL << 40)}};
+  for (const Case& c : cases) {
+    CodeAttr* codeAttr = makeCodeAttr(4, 0, c.code);
+    Interpreter classic;
+    ThreadedInterpreter threaded, tos(true, true);
+    EXPECT_TRUE(verifyCode(codeAttr, c.descriptor));
+    for (Interpreter* engine :
+         {&classic, (Interpreter*)&threaded, (Interpreter*)&tos}) {
+      Thread thread;
+      runCode(engine, codeAttr, &thread);
+      coconut::rtda::OperandStack* stack = thread.stack.topFrame->operandStack;
+      EXPECT_EQ(c.result,
+                c.descriptor == "()I" ? stack->popInt() : stack->popLong());
+    }
+    delete codeAttr;
+  }
+}
+
+// test float & double: NaN comparisons, conversions, dreturn
+
+TEST(VM_INTERPRETER, FloatDouble) {
+  // fconst_0; fconst_0; fdiv; fconst_1; fcmpg;    (NaN -> 1)
+  // fconst_1; fconst_2; fcmpl; isub; i2d;         (1 - (-1) -> 2.0)
+  // fconst_2; fconst_1; fdiv; f2d; dadd; dreturn  (2.0 + 2.0)
+  CodeAttr* codeAttr =
+      makeCodeAttr(4, 0,
+                   {0x0b, 0x0b, 0x6e, 0x0c, 0x96, 0x0c, 0x0d, 0x95, 0x64,
+                    0x87, 0x0d, 0x0c, 0x6e, 0x8d, 0x63, 0xaf});
+  EXPECT_TRUE(verifyCode(codeAttr, "()D"));
+  Interpreter classic;
+  ThreadedInterpreter threaded, tos(true, true);
+
+  for (Interpreter* engine :
+       {&classic, (Interpreter*)&threaded, (Interpreter*)&tos}) {
+    Thread thread;
+    runCode(engine, codeAttr, &thread);
+    EXPECT_EQ(4.0, thread.stack.topFrame->operandStack->popDouble());
+  }
+
+  delete codeAttr;
+}
+
+// test stack instructions
+
+TEST(VM_INTERPRETER, Stack) {
+  // iconst_1; iconst_2; swap; isub; dup; iadd; ireturn
+  CodeAttr* codeAttr =
+      makeCodeAttr(2, 0, {0x04, 0x05, 0x5f, 0x64, 0x59, 0x60, 0xac});
+  EXPECT_TRUE(verifyCode(codeAttr, "()I"));
+  Interpreter classic;
+  ThreadedInterpreter threaded, tos(true, true);
+  RegisterInterpreter reg;
+
+  for (Interpreter* engine : {&classic, (Interpreter*)&threaded,
+                              (Interpreter*)&tos, (Interpreter*)&reg}) {
+    Thread thread;
+    runCode(engine, codeAttr, &thread);
+    EXPECT_EQ(2, thread.stack.topFrame->operandStack->popInt());
+  }
+
+  delete codeAttr;
+}
+
+// test tableswitch & lookupswitch
+
+TEST(VM_INTERPRETER, Switch) {
+  // iconst_2; tableswitch (1: 10, 2: 20, 3: 30, default: -1)
+  std::vector<BYTE> tableCode = {0x05, 0xaa, 0x00, 0x00};
+  for (int val : {36, 1, 3, 27, 30, 33}) appendInt32(tableCode, val);
+  tableCode.insert(tableCode.end(), {0x10, 10, 0xac, 0x10, 20, 0xac, 0x10, 30,
+                                     0xac, 0x02, 0xac});
+
+  // bipush 100; lookupswitch (7: 1, 100: 2, default: 0)
+  std::vector<BYTE> lookupCode = {0x10, 100, 0xab, 0x00};
+  for (int val : {30, 2, 7, 26, 100, 28}) appendInt32(lookupCode, val);
+  lookupCode.insert(lookupCode.end(),
+                    {0x04, 0xac, 0x05, 0xac, 0x03, 0xac});
+
+  CodeAttr* tableAttr = makeCodeAttr(1, 0, tableCode);
+  CodeAttr* lookupAttr = makeCodeAttr(1, 0, lookupCode);
+  EXPECT_TRUE(verifyCode(tableAttr, "()I"));
+  EXPECT_TRUE(verifyCode(lookupAttr, "()I"));
+
+  // targets are resolved: default, cases...
+  ThreadedCode table(tableAttr), lookup(lookupAttr);
+  EXPECT_EQ((std::vector<ThreadedInst*>{table.at(37), table.at(28),
+                                        table.at(31), table.at(34)}),
+            table.switchTargets);
+  EXPECT_EQ((std::vector<ThreadedInst*>{lookup.at(32), lookup.at(28),
+                                        lookup.at(30)}),
+            lookup.switchTargets);
+
+  Interpreter classic;
+  ThreadedInterpreter threaded, tos(true, true);
+
+  for (Interpreter* engine :
+       {&classic, (Interpreter*)&threaded, (Interpreter*)&tos}) {
+    Thread thread;
+    runCode(engine, tableAttr, &thread);
+    EXPECT_EQ(20, thread.stack.topFrame->operandStack->popInt());
+    thread.stack.pop();
+    runCode(engine, lookupAttr, &thread);
+    EXPECT_EQ(2, thread.stack.topFrame->operandStack->popInt());
+  }
+
+  delete tableAttr;
+  delete lookupAttr;
+}
+
+// test wide is folded by the threaded engine
+
+TEST(VM_INTERPRETER, ThreadedWide) {
+  // iconst_0; istore_1; wide iinc 1 256; iload_1; ireturn
+  CodeAttr* codeAttr = makeCodeAttr(
+      1, 2, {0x03, 0x3c, 0xc4, 0x84, 0x00, 0x01, 0x01, 0x00, 0x1b, 0xac});
+  EXPECT_TRUE(verifyCode(codeAttr, "()I"));
+  ThreadedInterpreter threaded;
+  Thread thread;
+
+  runCode(&threaded, codeAttr, &thread);
+  EXPECT_EQ(256, thread.stack.topFrame->operandStack->popInt());
+
+  delete codeAttr;
+}
+
+// test superinstructions: fusion and its result
+
+TEST(VM_INTERPRETER, SuperInstructions) {
+  // the int loop in IntLoop
+  CodeAttr* codeAttr = makeCodeAttr(
+      2, 2,
+      {0x03, 0x3b, 0x03, 0x3c, 0x1b, 0x10, 0x0a, 0xa2, 0x00, 0x0d, 0x1a, 0x1b,
+       0x60, 0x3b, 0x84, 0x01, 0x01, 0xa7, 0xff, 0xf3, 0x1a, 0xac});
+
+  ThreadedCode code(codeAttr);
+  EXPECT_TRUE(verifyCode(codeAttr, "()I"));
+  EXPECT_EQ(coconut::vm::kSuper_iload_iconst_if_icmpge, code.at(4)->opcode);
+  EXPECT_EQ(1, code.at(4)->operand1);
+  EXPECT_EQ(10, code.at(4)->operand2);
+  EXPECT_EQ(16, code.at(4)->operand3);  // to pc 20
+  EXPECT_EQ(coconut::vm::kSuper_iload_iload_iadd_istore,
+            code.at(10)->opcode);
+  EXPECT_EQ(coconut::vm::kSuper_iinc_goto, code.at(14)->opcode);
+  EXPECT_EQ(-10, code.at(14)->operand3);  // to pc 4
+
+  EXPECT_EQ(code.at(20), code.at(4)->target);
+  EXPECT_EQ(code.at(4), code.at(14)->target);
+
+  ThreadedCode plain(codeAttr, false);
+  EXPECT_EQ(0x1b, plain.at(4)->opcode);
+  EXPECT_EQ(plain.at(20), plain.at(7)->target);
+  EXPECT_EQ(plain.at(4), plain.at(17)->target);
+
+  ThreadedInterpreter fused(true), unfused(false);
+  ThreadedInterpreter fusedTos(true, true), unfusedTos(false, true);
+  for (Interpreter* engine : {&fused, &unfused, &fusedTos, &unfusedTos}) {
+    Thread thread;
+    runCode(engine, codeAttr, &thread);
+    EXPECT_EQ(45, thread.stack.topFrame->operandStack->popInt());
+  }
+
+  delete codeAttr;
+}
+
+// test no fusion across a branch target
+
+TEST(VM_INTERPRETER, SuperInstructionsBoundary) {
+  // 0: iconst_1; 1: istore_0; 2: iload_0; 3: goto 7;
+  // 6: iload_0; 7: iload_0; 8: iadd; 9: ireturn
+  CodeAttr* codeAttr = makeCodeAttr(
+      2, 1, {0x04, 0x3b, 0x1a, 0xa7, 0x00, 0x04, 0x1a, 0x1a, 0x60, 0xac});
+  EXPECT_TRUE(verifyCode(codeAttr, "()I"));
+
+  ThreadedCode code(codeAttr);
+  EXPECT_EQ(0x1a, code.at(6)->opcode);
+
+  ThreadedInterpreter threaded;
+  Thread thread;
+  runCode(&threaded, codeAttr, &thread);
+  EXPECT_EQ(2, thread.stack.topFrame->operandStack->popInt());
+
+  delete codeAttr;
+}
+
+// test the opcode pair histogram of the classic engine
+
+TEST(VM_INTERPRETER, PairHistogram) {
+  CodeAttr* codeAttr = makeCodeAttr(
+      2, 2,
+      {0x03, 0x3b, 0x03, 0x3c, 0x1b, 0x10, 0x0a, 0xa2, 0x00, 0x0d, 0x1a, 0x1b,
+       0x60, 0x3b, 0x84, 0x01, 0x01, 0xa7, 0xff, 0xf3, 0x1a, 0xac});
+  OpcodePairHistogram histogram;
+  Interpreter classic;
+  classic.histogram = &histogram;
+
+  Thread thread;
+  runCode(&classic, codeAttr, &thread);
+  EXPECT_EQ(10u, histogram.count(0x15, 0x15));  // iload_0; iload_1
+  EXPECT_EQ(10u, histogram.count(0x84, 0xa7));  // iinc; goto
+  EXPECT_EQ(11u, histogram.count(0x15, 0x10));  // iload_1; bipush
+  EXPECT_EQ(2u, histogram.count(0x10, 0x36));   // iconst_0; istore_x
+
+  delete codeAttr;
+}
+
+// test TOS caching on an arithmetic chain, with spills around other types
+
+TEST(VM_INTERPRETER, TosCaching) {
+  // iconst_3; bipush 5; imul; iconst_2; ishl;       (60)
+  // dup; i2l; l2i; iadd; ineg; istore_0;          (-120)
+  // iload_0; ifge +5; iload_0; ireturn; iconst_0; ireturn
+  CodeAttr* codeAttr = makeCodeAttr(
+      3, 1,
+      {0x06, 0x10, 0x05, 0x68, 0x05, 0x78, 0x59, 0x85, 0x88, 0x60, 0x74, 0x3b,
+       0x1a, 0x9c, 0x00, 0x05, 0x1a, 0xac, 0x03, 0xac});
+  EXPECT_TRUE(verifyCode(codeAttr, "()I"));
+  Interpreter classic;
+  ThreadedInterpreter threaded, tos(true, true);
+
+  for (Interpreter* engine :
+       {&classic, (Interpreter*)&threaded, (Interpreter*)&tos}) {
+    Thread thread;
+    runCode(engine, codeAttr, &thread);
+    EXPECT_EQ(-120, thread.stack.topFrame->operandStack->popInt());
+  }
+
+  delete codeAttr;
+}
+
+// test quickening of ldc, ldc2_w
+
+TEST(VM_INTERPRETER, Quickening) {
+  // #1: int 123456, #2: float 1.5, #3: long 2^40 + 3
+  std::vector<BYTE> constants;
+  for (int val : {123456, 0x3fc00000, 1 << 8, 3}) appendInt32(constants, val);
+  coconut::utils::ByteReader reader(constants.size(), constants.data());
+  coconut::classfile::ConstantPool cp(5);
+  cp.infoList[1] = new coconut::classfile::ConstantIntegerInfo(reader);
+  cp.infoList[2] = new coconut::classfile::ConstantFloatInfo(reader);
+  cp.infoList[3] = new coconut::classfile::ConstantLongInfo(reader);
+  EXPECT_EQ(1.5f,
+            static_cast<coconut::classfile::ConstantFloatInfo*>(cp.infoList[2])
+                ->val);
+
+  // ldc #1; ldc #2; f2i; iadd; i2l; ldc2_w #3; ladd; lreturn
+  CodeAttr* codeAttr = makeCodeAttr(
+      4, 0,
+      {0x12, 0x01, 0x12, 0x02, 0x8b, 0x60, 0x85, 0x14, 0x00, 0x03, 0x61, 0xad},
+      &cp);
+  EXPECT_TRUE(verifyCode(codeAttr, "()J"));
+  ThreadedInterpreter threaded;
+
+  for (int i = 0; i < 2; ++i) {
+    Thread thread;
+    runCode(&threaded, codeAttr, &thread);
+    EXPECT_EQ(123457 + (1LL << 40) + 3,
+              thread.stack.topFrame->operandStack->popLong());
+  }
+
+  ThreadedCode* code = threaded.translate(codeAttr);
+  EXPECT_EQ(coconut::vm::kQuick_ldc, code->at(0)->opcode);
+  EXPECT_EQ(coconut::vm::kQuick_ldc, code->at(2)->opcode);
+  EXPECT_EQ(coconut::vm::kQuick_ldc2_w, code->at(7)->opcode);
+
+  delete codeAttr;
+}
+
+// test dense lookupswitch (translated into a jump table) and sparse ones
+
+TEST(VM_INTERPRETER, LookupSwitch) {
+  // iload_0; lookupswitch (keys..., i-th case returns i + 1, default 0)
+  auto makeSwitch = [](const std::vector<int>& keys) {
+    std::vector<BYTE> code = {0x1a, 0xab, 0x00, 0x00};
+    int casesPc = 12 + 8 * keys.size();
+    appendInt32(code, casesPc + 3 * keys.size() - 1);  // default
+    appendInt32(code, keys.size());
+    for (size_t i = 0; i < keys.size(); ++i) {
+      appendInt32(code, keys[i]);
+      appendInt32(code, casesPc + 3 * i - 1);
+    }
+    for (size_t i = 0; i <= keys.size(); ++i) {
+      code.insert(code.end(), {0x10, BYTE((i + 1) % (keys.size() + 1)), 0xac});
+    }
+    return makeCodeAttr(1, 1, code);
+  };
+  auto makeVerifiedSwitch = [&](const std::vector<int>& keys) {
+    CodeAttr* codeAttr = makeSwitch(keys);
+    EXPECT_TRUE(verifyCode(codeAttr, "(I)I"));
+    return codeAttr;
+  };
+
+  CodeAttr* dense = makeVerifiedSwitch({-2, -1, 1, 3});
+  CodeAttr* sparse = makeVerifiedSwitch({-100000, -5, 7, 100, 1 << 30});
+  std::vector<int> manyKeys;
+  for (int i = 0; i < 100; ++i) manyKeys.push_back(i * 1000);
+  CodeAttr* large = makeVerifiedSwitch(manyKeys);  // binary search
+  EXPECT_EQ(0xaa, ThreadedCode(dense).at(1)->opcode);
+  EXPECT_EQ(0xab, ThreadedCode(sparse).at(1)->opcode);
+  EXPECT_EQ(0xab, ThreadedCode(large).at(1)->opcode);
+  // unsorted or repeated keys fail verification, so the code is not
+  // translated and the classic engine rejects it
+  CodeAttr* unsorted = makeSwitch({3, -1});
+  EXPECT_FALSE(verifyCode(unsorted, "(I)I"));
+  CodeAttr* repeated = makeSwitch({1, 1});
+  EXPECT_FALSE(verifyCode(repeated, "(I)I"));
+
+  Interpreter classic;
+  ThreadedInterpreter threaded;
+  for (Interpreter* engine : {&classic, (Interpreter*)&threaded}) {
+    for (auto& c : std::vector<std::pair<int, int>>{
+             {-2, 1}, {-1, 2}, {0, 0}, {1, 3}, {2, 0}, {3, 4}, {4, 0}}) {
+      Thread thread;
+      thread.stack.push(0, 4);
+      thread.stack.push(1, 1);
+      thread.stack.topFrame->localVariableTable->setInt(0, c.first);
+      engine->execute(&thread, dense);
+      EXPECT_EQ(c.second, thread.stack.topFrame->operandStack->popInt());
+    }
+    for (auto& c : std::vector<std::pair<int, int>>{
+             {-100000, 1}, {7, 3}, {1 << 30, 5}, {8, 0}, {-6, 0}}) {
+      Thread thread;
+      thread.stack.push(0, 4);
+      thread.stack.push(1, 1);
+      thread.stack.topFrame->localVariableTable->setInt(0, c.first);
+      engine->execute(&thread, sparse);
+      EXPECT_EQ(c.second, thread.stack.topFrame->operandStack->popInt());
+    }
+    for (auto& c : std::vector<std::pair<int, int>>{
+             {0, 1}, {57000, 58}, {99000, 100}, {57001, 0}, {-1, 0}}) {
+      Thread thread;
+      thread.stack.push(0, 4);
+      thread.stack.push(1, 1);
+      thread.stack.topFrame->localVariableTable->setInt(0, c.first);
+      engine->execute(&thread, large);
+      EXPECT_EQ(c.second, thread.stack.topFrame->operandStack->popInt());
+    }
+    Thread thread;
+    thread.stack.push(0, 4);
+    thread.stack.push(1, 1);
+    EXPECT_THROW(engine->execute(&thread, unsorted), coconut::utils::JVMPanic);
+  }
+
+  delete dense;
+  delete sparse;
+  delete large;
+  delete unsorted;
+  delete repeated;
+}
+
+// test register code: translation, store forwarding, writing out pending
+// loads before the local changes, and stack entries across blocks
+
+TEST(VM_INTERPRETER, RegisterCode) {
+  // the loop of IntLoop: 15 bytecodes
+  CodeAttr* loop = makeCodeAttr(
+      2, 2,
+      {0x03, 0x3b, 0x03, 0x3c, 0x1b, 0x10, 0x0a, 0xa2, 0x00, 0x0d, 0x1a, 0x1b,
+       0x60, 0x3b, 0x84, 0x01, 0x01, 0xa7, 0xff, 0xf3, 0x1a, 0xac});
+  // bipush 5; istore_0; iload_0; iinc 0 1; iload_0; isub; istore_1;
+  // iload_0; bipush 10; istore_0; iload_0; iadd; iload_1; imul; ireturn
+  // (5 - 6) * (6 + 10)
+  CodeAttr* locals = makeCodeAttr(
+      3, 2,
+      {0x10, 0x05, 0x3b, 0x1a, 0x84, 0x00, 0x01, 0x1a, 0x64, 0x3c, 0x1a, 0x10,
+       0x0a, 0x3b, 0x1a, 0x60, 0x1b, 0x68, 0xac});
+  // iconst_0; istore_0; iconst_2; iload_0; ifeq L1; bipush 3; goto L2;
+  // L1: bipush 4; L2: iadd; ireturn  (2 + (0 == 0 ? 4 : 3))
+  CodeAttr* merge = makeCodeAttr(
+      2, 1,
+      {0x03, 0x3b, 0x05, 0x1a, 0x99, 0x00, 0x08, 0x10, 0x03, 0xa7, 0x00, 0x05,
+       0x10, 0x04, 0x60, 0xac});
+  // bipush 3; istore_0; bipush 4; istore_1; iload_0; iload_1; iadd; dup;
+  // istore_2; ireturn  (return x = a + b: the sum is not only stored)
+  CodeAttr* dupStore = makeCodeAttr(
+      2, 3,
+      {0x10, 0x03, 0x3b, 0x10, 0x04, 0x3c, 0x1a, 0x1b, 0x60, 0x59, 0x3d, 0xac});
+  // long code is not supported
+  CodeAttr* notSupported = makeCodeAttr(4, 0, {0x0a, 0x0a, 0x61, 0xad});
+  for (CodeAttr* codeAttr : {loop, locals, merge, dupStore}) {
+    EXPECT_TRUE(verifyCode(codeAttr, "()I"));
+  }
+  EXPECT_TRUE(verifyCode(notSupported, "()J"));
+
+  RegisterInterpreter reg;
+  RegisterCode* code = reg.translateRegisters(loop);
+  EXPECT_TRUE(code->supported);
+  EXPECT_EQ(15, code->numBytecodes);
+  // movi; movi; if_ge; iadd (to local 0); iadd (iinc); goto; ireturn
+  EXPECT_EQ(7u, code->insts.size());
+  EXPECT_FALSE(reg.translateRegisters(notSupported)->supported);
+  EXPECT_TRUE(reg.translateRegisters(dupStore)->supported);
+
+  ThreadedInterpreter threaded;
+  for (Interpreter* engine : {(Interpreter*)&threaded, (Interpreter*)&reg}) {
+    Thread thread1, thread2, thread3, thread4;
+    runCode(engine, locals, &thread1);
+    EXPECT_EQ(-16, thread1.stack.topFrame->operandStack->popInt());
+    runCode(engine, merge, &thread2);
+    EXPECT_EQ(6, thread2.stack.topFrame->operandStack->popInt());
+    runCode(engine, notSupported, &thread3);
+    EXPECT_EQ(2, thread3.stack.topFrame->operandStack->popLong());
+    runCode(engine, dupStore, &thread4);
+    EXPECT_EQ(7, thread4.stack.topFrame->operandStack->popInt());
+  }
+
+  delete loop;
+  delete locals;
+  delete merge;
+  delete dupStore;
+  delete notSupported;
+}
+
+// test invokestatic: arguments are passed in place and replaced by the result
+
+TEST(VM_INTERPRETER, InvokeStatic) {
+  coconut::classfile::ClassFile* classFile = makeClassFile({
+      // static int add(int a, int b) { return a + b; }
+      {"add", "(II)I", 2, 2, {0x1a, 0x1b, 0x60, 0xac}},
+      // static int fib(int n) { return n < 2 ? n : fib(n - 1) + fib(n - 2); }
+      {"fib",
+       "(I)I",
+       3,
+       1,
+       {0x1a, 0x05, 0xa2, 0x00, 0x05, 0x1a, 0xac, 0x1a, 0x04, 0x64, 0xb8, 0x00,
+        0x0b, 0x1a, 0x05, 0x64, 0xb8, 0x00, 0x0b, 0x60, 0xac}},
+      // static long shift(long x, int n) { return x << n; }
+      {"shift", "(JI)J", 3, 3, {0x1e, 0x1c, 0x79, 0xad}},
+      // static int main() { return (int)shift(add(fib(20), 3), 2); }
+      {"main",
+       "()I",
+       4,
+       0,
+       {0x10, 0x14, 0xb8, 0x00, 0x0b, 0x06, 0xb8, 0x00, 0x07, 0x85, 0x05, 0xb8,
+        0x00, 0x0f, 0x88, 0xac}},
+  });
+  CodeAttr* main =
+      classFile->findMethod("main", "()I")->attributes->filtCodeAttr();
+  EXPECT_EQ((int)classFile->methods.size(), verifyClass(classFile).passed);
+
+  ThreadedInterpreter threaded, tos(true, true);
+  RegisterInterpreter reg;
+  for (Interpreter* engine :
+       {(Interpreter*)&threaded, (Interpreter*)&tos, (Interpreter*)&reg}) {
+    engine->classFile = classFile;
+    for (int i = 0; i < 2; ++i) {  // resolve, then quick
+      Thread thread;
+      runCode(engine, main, &thread);
+      EXPECT_EQ((6765 + 3) << 2, thread.stack.topFrame->operandStack->popInt());
+    }
+  }
+  EXPECT_EQ(coconut::vm::kQuick_invokestatic,
+            threaded.translate(main)->at(2)->opcode);
+
+  delete classFile;
+}
+
+// test a deep recursion: it overflows a small stack, which throws
+// java.lang.StackOverflowError with the trace of the recursion
+
+TEST(VM_INTERPRETER, StackOverflow) {
+  coconut::classfile::ClassFile* classFile = makeClassFile({
+      // static int down(int n) { return n == 0 ? 0 : down(n - 1); }
+      {"down",
+       "(I)I",
+       2,
+       1,
+       {0x1a, 0x99, 0x00, 0x0a, 0x1a, 0x04, 0x64, 0xb8, 0x00, 0x07, 0xac, 0x03,
+        0xac}},
+      // static int main() { return down(1000); }
+      {"main", "()I", 1, 0, {0x11, 0x03, 0xe8, 0xb8, 0x00, 0x07, 0xac}},
+  });
+  CodeAttr* main =
+      classFile->findMethod("main", "()I")->attributes->filtCodeAttr();
+  EXPECT_EQ((int)classFile->methods.size(), verifyClass(classFile).passed);
+
+  ThreadedInterpreter threaded, tos(true, true);
+  RegisterInterpreter reg;
+  for (Interpreter* engine :
+       {(Interpreter*)&threaded, (Interpreter*)&tos, (Interpreter*)&reg}) {
+    engine->classFile = classFile;
+    {
+      Thread thread;
+      runCode(engine, main, &thread);
+      EXPECT_EQ(nullptr, thread.exception);
+      EXPECT_EQ(0, thread.stack.topFrame->operandStack->popInt());
+    }
+    {
+      Thread thread(4096);
+      runCode(engine, main, &thread);
+      auto* error = dynamic_cast<Throwable*>(thread.exception);
+      ASSERT_NE(nullptr, error);
+      EXPECT_EQ("java/lang/StackOverflowError", error->klass->name);
+      // thrown at the invoke in the deepest frame which fits
+      std::vector<std::string> trace = error->getStackTrace();
+      ASSERT_GT(trace.size(), 2u);
+      EXPECT_EQ("down(I)I (pc 7)", trace.front());
+      EXPECT_EQ("main()I (pc 3)", trace.back());
+    }
+    {
+      // the arena fits, but the native stack of the engine's recursion does
+      // not: it throws at an invoke instead of crashing
+      Thread thread;
+      runCodeOnSmallStack(engine, main, &thread, 128 * 1024);
+      auto* error = dynamic_cast<Throwable*>(thread.exception);
+      ASSERT_NE(nullptr, error);
+      EXPECT_EQ("java/lang/StackOverflowError", error->klass->name);
+      std::vector<std::string> trace = error->getStackTrace();
+      ASSERT_GT(trace.size(), 2u);
+      EXPECT_EQ("down(I)I (pc 7)", trace.front());
+      EXPECT_EQ("main()I (pc 3)", trace.back());
+    }
+  }
+
+  delete classFile;
+}
+
+// test the exceptions raised by the VM: / by zero and athrow of null. The
+// instance is preallocated per thread, and the trace is captured at the raise
+
+TEST(VM_INTERPRETER, VMExceptions) {
+  // #12 Class java/lang/ArithmeticException
+  coconut::classfile::ClassFile* classFile = makeClassFile(
+      {
+          // static int div(int a, int b) { return a / b; }
+          {"div", "(II)I", 2, 2, {0x1a, 0x1b, 0x6c, 0xac}},
+          // static int safeDiv(int a, int b) {
+          //   try { return div(a, b); } catch (ArithmeticException e) {
+          //   return -1; }
+          // }
+          {"safeDiv",
+           "(II)I",
+           2,
+           2,
+           {0x1a, 0x1b, 0xb8, 0x00, 0x07, 0xac, 0x57, 0x02, 0xac},
+           {},
+           {{0, 6, 6, 12}}},
+      },
+      {"java/lang/ArithmeticException"});
+  EXPECT_EQ((int)classFile->methods.size(), verifyClass(classFile).passed);
+  CodeAttr* div =
+      classFile->findMethod("div", "(II)I")->attributes->filtCodeAttr();
+  CodeAttr* safeDiv =
+      classFile->findMethod("safeDiv", "(II)I")->attributes->filtCodeAttr();
+  // athrow of null
+  CodeAttr* throwNull = makeCodeAttr(1, 0, {0x01, 0xbf});
+  EXPECT_TRUE(verifyCode(throwNull, "()V"));
+
+  auto run = [](Interpreter* engine, CodeAttr* codeAttr, int a, int b,
+                Thread* thread) {
+    thread->stack.push(0, 4);
+    thread->stack.push(codeAttr->maxLocals, codeAttr->maxStack);
+    thread->stack.topFrame->localVariableTable->setInt(0, a);
+    thread->stack.topFrame->localVariableTable->setInt(1, b);
+    engine->execute(thread, codeAttr);
+    EXPECT_EQ(1u, thread->stack.size);
+  };
+
+  ThreadedInterpreter threaded, tos(true, true);
+  RegisterInterpreter reg;
+  for (Interpreter* engine :
+       {(Interpreter*)&threaded, (Interpreter*)&tos, (Interpreter*)&reg}) {
+    engine->classFile = classFile;
+    {
+      Thread thread;
+      run(engine, div, 7, 0, &thread);
+      auto* error = dynamic_cast<Throwable*>(thread.exception);
+      ASSERT_NE(nullptr, error);
+      EXPECT_EQ("java/lang/ArithmeticException", error->klass->name);
+      EXPECT_STREQ("/ by zero", error->message);
+      ASSERT_EQ(1u, error->getStackTrace().size());
+      EXPECT_EQ("div(II)I (pc 2)", error->getStackTrace()[0]);
+      std::ostringstream printed;
+      error->printStackTrace(printed);
+      EXPECT_EQ(
+          "java.lang.ArithmeticException: / by zero\n"
+          "\tat div(II)I (pc 2)\n",
+          printed.str());
+    }
+    for (int b : {2, 0}) {
+      Thread thread;
+      run(engine, safeDiv, 7, b, &thread);
+      EXPECT_EQ(nullptr, thread.exception);
+      EXPECT_EQ(b == 0 ? -1 : 3,
+                thread.stack.topFrame->operandStack->popInt());
+    }
+    {
+      // the instance is reused by every raise of the thread
+      Thread thread;
+      Throwable* first = thread.raise(coconut::rtda::kArithmeticException);
+      EXPECT_EQ(first, thread.raise(coconut::rtda::kArithmeticException));
+    }
+    {
+      Thread thread;
+      runCode(engine, throwNull, &thread);
+      ASSERT_NE(nullptr, thread.exception);
+      EXPECT_EQ("java/lang/NullPointerException",
+                thread.exception->klass->name);
+    }
+  }
+
+  delete throwNull;
+  delete classFile;
+}
+
+// test athrow: the handler is found by the class of the exception, in the
+// frame or in its invokers
+
+TEST(VM_INTERPRETER, Exceptions) {
+  // #18 Class java/lang/RuntimeException, #20 Class java/lang/Error
+  coconut::classfile::ClassFile* classFile = makeClassFile(
+      {
+          // static int check(Throwable t) {
+          //   try { throw t; } catch (RuntimeException e) { return 1; }
+          //   catch (Error e) { return 2; } catch (Throwable e) { return 3; }
+          // }
+          {"check",
+           "(Ljava/lang/Throwable;)I",
+           1,
+           1,
+           {0x2a, 0xbf, 0x57, 0x04, 0xac, 0x57, 0x05, 0xac, 0x57, 0x06, 0xac},
+           {},
+           {{0, 2, 2, 18}, {0, 2, 5, 20}, {0, 2, 8, 0}}},
+          // static int rethrow(Throwable t) { throw t; }
+          {"rethrow", "(Ljava/lang/Throwable;)I", 1, 1, {0x2a, 0xbf}},
+          // static int outer(Throwable t) {
+          //   try { return rethrow(t); } catch (RuntimeException e) {
+          //   return 10; }
+          // }
+          {"outer",
+           "(Ljava/lang/Throwable;)I",
+           1,
+           1,
+           {0x2a, 0xb8, 0x00, 0x0b, 0xac, 0x57, 0x10, 0x0a, 0xac},
+           {},
+           {{0, 5, 5, 18}}},
+      },
+      {"java/lang/RuntimeException", "java/lang/Error"});
+  EXPECT_EQ((int)classFile->methods.size(), verifyClass(classFile).passed);
+  const char* descriptor = "(Ljava/lang/Throwable;)I";
+  CodeAttr* check =
+      classFile->findMethod("check", descriptor)->attributes->filtCodeAttr();
+  CodeAttr* outer =
+      classFile->findMethod("outer", descriptor)->attributes->filtCodeAttr();
+
+  ClassTable& table = ClassTable::instance();
+  Object arithmetic(table.resolve("java/lang/ArithmeticException"));
+  Object overflow(table.resolve("java/lang/StackOverflowError"));
+  Object exception(table.resolve("java/lang/Exception"));
+  Object unknown;
+
+  // run a method with the exception as the argument
+  auto run = [](Interpreter* engine, CodeAttr* codeAttr, Object* arg,
+                Thread* thread) {
+    thread->stack.push(0, 4);
+    thread->stack.push(codeAttr->maxLocals, codeAttr->maxStack);
+    thread->stack.topFrame->localVariableTable->setRef(0, arg);
+    engine->execute(thread, codeAttr);
+    EXPECT_EQ(1u, thread->stack.size);
+  };
+
+  ThreadedInterpreter threaded, tos(true, true);
+  RegisterInterpreter reg;
+  for (Interpreter* engine :
+       {(Interpreter*)&threaded, (Interpreter*)&tos, (Interpreter*)&reg}) {
+    engine->classFile = classFile;
+    std::pair<Object*, int> cases[] = {
+        {&arithmetic, 1}, {&overflow, 2}, {&exception, 3}, {&unknown, 3}};
+    for (auto& c : cases) {
+      Thread thread;
+      run(engine, check, c.first, &thread);
+      EXPECT_EQ(nullptr, thread.exception);
+      EXPECT_EQ(c.second, thread.stack.topFrame->operandStack->popInt());
+    }
+    for (int i = 0; i < 2; ++i) {  // resolve, then quick
+      Thread thread;
+      run(engine, outer, &arithmetic, &thread);
+      EXPECT_EQ(nullptr, thread.exception);
+      EXPECT_EQ(10, thread.stack.topFrame->operandStack->popInt());
+    }
+    {
+      // uncaught: every frame completes abruptly
+      Thread thread;
+      run(engine, outer, &overflow, &thread);
+      EXPECT_EQ(&overflow, thread.exception);
+    }
+  }
+
+  delete classFile;
+}
+
+// test invokevirtual: the call dispatches on the class of the receiver, and
+// the inline cache of the site hits while the class does not change
+
+TEST(VM_INTERPRETER, InvokeVirtual) {
+  // a table of its own: the classes go away before their class files
+  ClassTable::Scope scope;
+  // #14 Class java/lang/Object, #10 Class Animal of Dog and Cat
+  coconut::classfile::ClassFile* animal = makeClassFile(
+      {
+          // int speak() { return 1; }
+          {"speak", "()I", 1, 1, {0x04, 0xac}, {}, {}, 0x01},
+          // static int call(Animal a) { return a.speak(); }
+          {"call", "(LAnimal;)I", 1, 1, {0x2a, 0xb6, 0x00, 0x07, 0xac}},
+      },
+      {"java/lang/Object"}, "Animal", 14);
+  coconut::classfile::ClassFile* dog =
+      makeClassFile({{"speak", "()I", 1, 1, {0x05, 0xac}, {}, {}, 0x01}},
+                    {"Animal"}, "Dog", 10);
+  coconut::classfile::ClassFile* cat =
+      makeClassFile({{"speak", "()I", 1, 1, {0x06, 0xac}, {}, {}, 0x01}},
+                    {"Animal"}, "Cat", 10);
+  ClassTable& table = ClassTable::instance();
+  coconut::rtda::Class* animalClass = table.define(animal);
+  Object dogObject(table.define(dog)), catObject(table.define(cat));
+  Object animalObject(animalClass);
+  EXPECT_EQ(animalClass, dogObject.klass->superClass);
+  for (auto* classFile : {animal, dog, cat}) {
+    EXPECT_EQ((int)classFile->methods.size(), verifyClass(classFile).passed);
+  }
+  CodeAttr* call =
+      animal->findMethod("call", "(LAnimal;)I")->attributes->filtCodeAttr();
+
+  auto run = [](Interpreter* engine, CodeAttr* codeAttr, Object* arg,
+                Thread* thread) {
+    thread->stack.push(0, 4);
+    thread->stack.push(codeAttr->maxLocals, codeAttr->maxStack);
+    thread->stack.topFrame->localVariableTable->setRef(0, arg);
+    engine->execute(thread, codeAttr);
+    EXPECT_EQ(1u, thread->stack.size);
+  };
+
+  ThreadedInterpreter threaded, tos(true, true);
+  for (ThreadedInterpreter* engine : {&threaded, &tos}) {
+    std::pair<Object*, int> calls[] = {
+        {&dogObject, 2}, {&dogObject, 2}, {&catObject, 3},
+        {&catObject, 3}, {&catObject, 3}, {&animalObject, 1}};
+    for (auto& c : calls) {
+      Thread thread;
+      run(engine, call, c.first, &thread);
+      EXPECT_EQ(c.second, thread.stack.topFrame->operandStack->popInt());
+    }
+    {
+      Thread thread;
+      run(engine, call, nullptr, &thread);
+      ASSERT_NE(nullptr, thread.exception);
+      EXPECT_EQ("java/lang/NullPointerException",
+                thread.exception->klass->name);
+    }
+
+    const auto& caches = engine->translate(call)->inlineCaches;
+    ASSERT_EQ(1u, caches.size());
+    EXPECT_EQ(1, caches[0].pc);
+    EXPECT_EQ(3, caches[0].size());
+    EXPECT_EQ(3u, caches[0].hits);
+    EXPECT_EQ(3u, caches[0].misses);
+    EXPECT_FALSE(caches[0].megamorphic());
+    std::ostringstream dump;
+    engine->dumpInlineCaches(dump);
+    EXPECT_NE(std::string::npos,
+              dump.str().find("call(LAnimal;)I pc 1: 3 classes, 3 hits, "
+                              "3 misses, 0 vtable calls\n"));
+  }
+
+  delete cat;
+  delete dog;
+  delete animal;
+}
+
+// test a megamorphic site: after kInlineCacheSize classes, the calls go
+// through the vtable
+
+TEST(VM_INTERPRETER, MegamorphicCall) {
+  ClassTable::Scope scope;
+  const int kClasses = coconut::vm::kInlineCacheSize + 2;
+  // #14 Class java/lang/Object
+  coconut::classfile::ClassFile* shape = makeClassFile(
+      {
+          // int sides() { return 0; }
+          {"sides", "()I", 1, 1, {0x03, 0xac}, {}, {}, 0x01},
+          // static int call(Shape s) { return s.sides(); }
+          {"call", "(LShape;)I", 1, 1, {0x2a, 0xb6, 0x00, 0x07, 0xac}},
+      },
+      {"java/lang/Object"}, "Shape", 14);
+  ClassTable& table = ClassTable::instance();
+  table.define(shape);
+  EXPECT_EQ(2, verifyClass(shape).passed);
+  // #10 Class Shape. int sides() { return i; }
+  std::vector<coconut::classfile::ClassFile*> subclasses;
+  std::vector<Object> objects;
+  for (int i = 0; i < kClasses; ++i) {
+    subclasses.push_back(makeClassFile(
+        {{"sides", "()I", 1, 1, {0x10, BYTE(i), 0xac}, {}, {}, 0x01}},
+        {"Shape"}, "Shape" + std::to_string(i), 10));
+    objects.emplace_back(table.define(subclasses.back()));
+    EXPECT_EQ(1, verifyClass(subclasses.back()).passed);
+  }
+  CodeAttr* call =
+      shape->findMethod("call", "(LShape;)I")->attributes->filtCodeAttr();
+
+  ThreadedInterpreter threaded;
+  for (int round = 0; round < 2; ++round) {
+    for (int i = 0; i < kClasses; ++i) {
+      Thread thread;
+      thread.stack.push(0, 4);
+      thread.stack.push(call->maxLocals, call->maxStack);
+      thread.stack.topFrame->localVariableTable->setRef(0, &objects[i]);
+      threaded.execute(&thread, call);
+      EXPECT_EQ(i, thread.stack.topFrame->operandStack->popInt());
+    }
+  }
+  const coconut::vm::InlineCache& cache =
+      threaded.translate(call)->inlineCaches[0];
+  EXPECT_TRUE(cache.megamorphic());
+  const int cached = coconut::vm::kInlineCacheSize;
+  EXPECT_EQ(cached, cache.size());
+  EXPECT_EQ(0u, cache.hits);
+  // the miss of the class which does not fit makes it megamorphic
+  EXPECT_EQ(uint64_t(cached + 1), cache.misses);
+  EXPECT_EQ(uint64_t(2 * kClasses - cached - 1), cache.vtableCalls);
+
+  for (auto* classFile : subclasses) delete classFile;
+  delete shape;
+}
+
+// test the profiles: counters, and the branch, switch and receiver profiles
+// once the method is warm
+
+TEST(VM_INTERPRETER, Profiles) {
+  ClassTable::Scope scope;
+  // the int loop: if_icmpge at pc 7, goto back at pc 17
+  const std::vector<BYTE> loop = {0x03, 0x3b, 0x03, 0x3c, 0x1b, 0x10,
+                                  0x0a, 0xa2, 0x00, 0x0d, 0x1a, 0x1b,
+                                  0x60, 0x3b, 0x84, 0x01, 0x01, 0xa7,
+                                  0xff, 0xf3, 0x1a, 0xac};
+  {
+    // cold: counted, but not profiled
+    CodeAttr* codeAttr = makeCodeAttr(2, 2, loop);
+    EXPECT_TRUE(verifyCode(codeAttr, "()I"));
+    ThreadedInterpreter threaded;
+    Thread thread;
+    runCode(&threaded, codeAttr, &thread);
+    EXPECT_EQ(1u, codeAttr->invocationCount);
+    EXPECT_EQ(10u, codeAttr->backedgeCount);
+    EXPECT_EQ(nullptr, codeAttr->methodData);
+    delete codeAttr;
+  }
+  // the branch is fused into a superinstruction, or cached (TOS caching)
+  ThreadedInterpreter threaded, plain(false), tos(true, true);
+  for (ThreadedInterpreter* engine : {&threaded, &plain, &tos}) {
+    CodeAttr* codeAttr = makeCodeAttr(2, 2, loop);
+    EXPECT_TRUE(verifyCode(codeAttr, "()I"));
+    engine->profileThreshold = 12;
+    for (int i = 0; i < 2; ++i) {
+      Thread thread;
+      runCode(engine, codeAttr, &thread);
+      EXPECT_EQ(45, thread.stack.topFrame->operandStack->popInt());
+    }
+    EXPECT_EQ(2u, codeAttr->invocationCount);
+    EXPECT_EQ(20u, codeAttr->backedgeCount);
+    // warm at the second invocation: only it is profiled
+    ASSERT_NE(nullptr, codeAttr->methodData);
+    const coconut::vm::BranchProfile* branch =
+        codeAttr->methodData->branchAt(7);
+    ASSERT_NE(nullptr, branch);
+    EXPECT_EQ(1u, branch->taken);
+    EXPECT_EQ(10u, branch->notTaken);
+    EXPECT_EQ(nullptr, codeAttr->methodData->branchAt(17));
+    std::ostringstream dump;
+    engine->dumpProfiles(dump);
+    EXPECT_NE(std::string::npos,
+              dump.str().find("2 invocations, 20 backedges\n"));
+    EXPECT_NE(std::string::npos,
+              dump.str().find("pc 7: 1 taken, 10 not taken\n"));
+    delete codeAttr;
+  }
+
+  // iload_0; lookupswitch -1: return 1, 3: return 2, default: return 0. The
+  // dense one is translated into a tableswitch
+  for (int high : {3, 1000}) {
+    std::vector<BYTE> code = {0x1a, 0xab, 0x00, 0x00};
+    appendInt32(code, 31);  // default
+    appendInt32(code, 2);
+    appendInt32(code, -1);
+    appendInt32(code, 27);
+    appendInt32(code, high);
+    appendInt32(code, 29);
+    code.insert(code.end(), {0x04, 0xac, 0x05, 0xac, 0x03, 0xac});
+    CodeAttr* codeAttr = makeCodeAttr(1, 1, code);
+    EXPECT_TRUE(verifyCode(codeAttr, "(I)I"));
+    ThreadedInterpreter threaded;
+    threaded.profileThreshold = 1;
+    for (auto& c : std::vector<std::pair<int, int>>{
+             {-1, 1}, {-1, 1}, {high, 2}, {0, 0}}) {
+      Thread thread;
+      thread.stack.push(0, 4);
+      thread.stack.push(1, 1);
+      thread.stack.topFrame->localVariableTable->setInt(0, c.first);
+      threaded.execute(&thread, codeAttr);
+      EXPECT_EQ(c.second, thread.stack.topFrame->operandStack->popInt());
+    }
+    ASSERT_NE(nullptr, codeAttr->methodData);
+    const coconut::vm::SwitchProfile* profile =
+        codeAttr->methodData->switchAt(1);
+    ASSERT_NE(nullptr, profile);
+    EXPECT_EQ((std::vector<uint64_t>{1, 2, 1}), profile->counts);
+    delete codeAttr;
+  }
+
+  // receivers: Pet0 3 times, Pet1 twice, then Pet2 which has no row
+  // #14 Class java/lang/Object
+  coconut::classfile::ClassFile* pet = makeClassFile(
+      {
+          // int legs() { return 4; }
+          {"legs", "()I", 1, 1, {0x07, 0xac}, {}, {}, 0x01},
+          // static int call(Pet p) { return p.legs(); }
+          {"call", "(LPet;)I", 1, 1, {0x2a, 0xb6, 0x00, 0x07, 0xac}},
+      },
+      {"java/lang/Object"}, "Pet", 14);
+  ClassTable& table = ClassTable::instance();
+  table.define(pet);
+  EXPECT_EQ(2, verifyClass(pet).passed);
+  // #6 Class Pet, the subclasses inherit legs()
+  std::vector<coconut::classfile::ClassFile*> subclasses;
+  std::vector<Object> objects;
+  for (int i = 0; i < 3; ++i) {
+    subclasses.push_back(
+        makeClassFile({}, {"Pet"}, "Pet" + std::to_string(i), 6));
+    objects.emplace_back(table.define(subclasses.back()));
+  }
+  CodeAttr* call =
+      pet->findMethod("call", "(LPet;)I")->attributes->filtCodeAttr();
+  ThreadedInterpreter engine;
+  engine.profileThreshold = 1;
+  for (int i : {0, 0, 1, 0, 1, 2}) {
+    Thread thread;
+    thread.stack.push(0, 4);
+    thread.stack.push(call->maxLocals, call->maxStack);
+    thread.stack.topFrame->localVariableTable->setRef(0, &objects[i]);
+    engine.execute(&thread, call);
+    EXPECT_EQ(4, thread.stack.topFrame->operandStack->popInt());
+  }
+  ASSERT_NE(nullptr, call->methodData);
+  const coconut::vm::ReceiverProfile* receivers =
+      call->methodData->receiverAt(1);
+  ASSERT_NE(nullptr, receivers);
+  EXPECT_EQ(objects[0].klass, receivers->classes[0]);
+  EXPECT_EQ(3u, receivers->counts[0]);
+  EXPECT_EQ(objects[1].klass, receivers->classes[1]);
+  EXPECT_EQ(2u, receivers->counts[1]);
+  EXPECT_EQ(1u, receivers->others);
+  std::ostringstream dump;
+  engine.dumpProfiles(dump);
+  EXPECT_NE(std::string::npos,
+            dump.str().find("call(LPet;)I pc 1: Pet0 3, Pet1 2, others 1\n"));
+
+  for (auto* classFile : subclasses) delete classFile;
+  delete pet;
+}
+
+// test checkcast and instanceof against a class and an interface
+
+TEST(VM_INTERPRETER, TypeChecks) {
+  ClassTable::Scope scope;
+  // #14 Class java/lang/Object, #16 Class TcInterface, #18 Class TcBase
+  coconut::classfile::ClassFile* classFile = makeClassFile(
+      {
+          // static int isA(Object o) { return o instanceof TcInterface; }
+          {"isA", "(Ljava/lang/Object;)I", 1, 1,
+           {0x2a, 0xc1, 0x00, 0x10, 0xac}},
+          // static int cast(Object o) { TcBase b = (TcBase) o; return 1; }
+          {"cast", "(Ljava/lang/Object;)I", 1, 1,
+           {0x2a, 0xc0, 0x00, 0x12, 0x57, 0x04, 0xac}},
+      },
+      {"java/lang/Object", "TcInterface", "TcBase"}, "TcTest", 14);
+  coconut::classfile::ClassFile* interfaceFile = makeClassFile(
+      {}, {"java/lang/Object"}, "TcInterface", 6, {}, 0x0601);
+  // class TcBase implements TcInterface, and TcDerived extends TcBase
+  coconut::classfile::ClassFile* base = makeClassFile(
+      {}, {"java/lang/Object", "TcInterface"}, "TcBase", 6, {8});
+  coconut::classfile::ClassFile* derived =
+      makeClassFile({}, {"TcBase"}, "TcDerived", 6);
+  ClassTable& table = ClassTable::instance();
+  table.define(classFile);
+  table.define(interfaceFile);
+  table.define(base);
+  Object derivedObject(table.define(derived));
+  Object other(table.resolve("java/lang/Object"));
+  EXPECT_EQ(2, verifyClass(classFile).passed);
+  CodeAttr* isA = classFile->findMethod("isA", "(Ljava/lang/Object;)I")
+                      ->attributes->filtCodeAttr();
+  CodeAttr* cast = classFile->findMethod("cast", "(Ljava/lang/Object;)I")
+                       ->attributes->filtCodeAttr();
+
+  auto run = [](Interpreter* engine, CodeAttr* codeAttr, Object* arg,
+                Thread* thread) {
+    thread->stack.push(0, 4);
+    thread->stack.push(codeAttr->maxLocals, codeAttr->maxStack);
+    thread->stack.topFrame->localVariableTable->setRef(0, arg);
+    engine->execute(thread, codeAttr);
+    EXPECT_EQ(1u, thread->stack.size);
+    return thread->exception != nullptr
+               ? -1
+               : thread->stack.topFrame->operandStack->popInt();
+  };
+
+  ThreadedInterpreter threaded, tos(true, true);
+  for (ThreadedInterpreter* engine : {&threaded, &tos}) {
+    std::tuple<CodeAttr*, Object*, int> calls[] = {
+        {isA, &derivedObject, 1}, {isA, &other, 0},
+        {isA, nullptr, 0},        {cast, &derivedObject, 1},
+        {cast, nullptr, 1},       {isA, &derivedObject, 1}};
+    for (auto& c : calls) {
+      Thread thread;
+      EXPECT_EQ(std::get<2>(c),
+                run(engine, std::get<0>(c), std::get<1>(c), &thread));
+    }
+    Thread thread;
+    EXPECT_EQ(-1, run(engine, cast, &other, &thread));
+    EXPECT_EQ("java/lang/ClassCastException", thread.exception->klass->name);
+  }
+
+  delete derived;
+  delete base;
+  delete interfaceFile;
+  delete classFile;
+}
+
+// test invokeinterface: the receivers implement the interface directly, by a
+// superclass, or by a superinterface, at different itable indices
+
+TEST(VM_INTERPRETER, InvokeInterface) {
+  ClassTable::Scope scope;
+  // #14 Class java/lang/Object
+  coconut::classfile::ClassFile* getter = makeClassFile(
+      {
+          // int get();
+          {"get", "()I", 0, 1, {}, {}, {}, 0x0401},
+          // static int call(IGetter g) { return g.get(); }
+          {"call", "(LIGetter;)I", 1, 1,
+           {0x2a, 0xb9, 0x00, 0x07, 0x01, 0x00, 0xac}},
+      },
+      {"java/lang/Object"}, "IGetter", 14, {}, 0x0601);
+  coconut::classfile::ClassFile* sized = makeClassFile(
+      {
+          // default int size() { return 7; }
+          {"size", "()I", 1, 1, {0x10, 0x07, 0xac}, {}, {}, 0x01},
+          // static int call(ISized s) { return s.size(); }
+          {"call", "(LISized;)I", 1, 1,
+           {0x2a, 0xb9, 0x00, 0x07, 0x01, 0x00, 0xac}},
+      },
+      {"java/lang/Object"}, "ISized", 14, {}, 0x0601);
+  // interface ISizedGetter extends IGetter, ISized {}
+  coconut::classfile::ClassFile* sizedGetter =
+      makeClassFile({}, {"java/lang/Object", "IGetter", "ISized"},
+                    "ISizedGetter", 6, {8, 10}, 0x0601);
+  // class IListA implements IGetter, and IListB extends IListA
+  coconut::classfile::ClassFile* listA =
+      makeClassFile({{"get", "()I", 1, 1, {0x05, 0xac}, {}, {}, 0x01}},
+                    {"java/lang/Object", "IGetter"}, "IListA", 10, {12});
+  coconut::classfile::ClassFile* listB =
+      makeClassFile({{"get", "()I", 1, 1, {0x06, 0xac}, {}, {}, 0x01}},
+                    {"IListA"}, "IListB", 10);
+  // class IMapC implements ISized, IGetter
+  coconut::classfile::ClassFile* mapC = makeClassFile(
+      {
+          {"get", "()I", 1, 1, {0x07, 0xac}, {}, {}, 0x01},
+          {"size", "()I", 1, 1, {0x08, 0xac}, {}, {}, 0x01},
+      },
+      {"java/lang/Object", "ISized", "IGetter"}, "IMapC", 14, {16, 18});
+  // class IListD implements ISizedGetter, with the default size()
+  coconut::classfile::ClassFile* listD =
+      makeClassFile({{"get", "()I", 1, 1, {0x10, 0x06, 0xac}, {}, {}, 0x01}},
+                    {"java/lang/Object", "ISizedGetter"}, "IListD", 10, {12});
+  ClassTable& table = ClassTable::instance();
+  table.define(getter);
+  table.define(sized);
+  table.define(sizedGetter);
+  Object a(table.define(listA)), b(table.define(listB));
+  Object c(table.define(mapC)), d(table.define(listD));
+  Object object(table.resolve("java/lang/Object"));
+  for (auto* classFile : {getter, sized, listA, listB, mapC, listD}) {
+    EXPECT_EQ((int)classFile->methods.size() -
+                  (classFile == getter ? 1 : 0),
+              verifyClass(classFile).passed);
+  }
+  CodeAttr* callGet =
+      getter->findMethod("call", "(LIGetter;)I")->attributes->filtCodeAttr();
+  CodeAttr* callSize =
+      sized->findMethod("call", "(LISized;)I")->attributes->filtCodeAttr();
+
+  auto run = [](Interpreter* engine, CodeAttr* codeAttr, Object* arg) {
+    Thread thread;
+    thread.stack.push(0, 4);
+    thread.stack.push(codeAttr->maxLocals, codeAttr->maxStack);
+    thread.stack.topFrame->localVariableTable->setRef(0, arg);
+    engine->execute(&thread, codeAttr);
+    EXPECT_EQ(1u, thread.stack.size);
+    return thread.stack.topFrame->operandStack->popInt();
+  };
+
+  ThreadedInterpreter threaded, tos(true, true);
+  for (ThreadedInterpreter* engine : {&threaded, &tos}) {
+    EXPECT_EQ(2, run(engine, callGet, &a));
+    EXPECT_EQ(3, run(engine, callGet, &b));
+    EXPECT_EQ(4, run(engine, callGet, &c));
+    EXPECT_EQ(6, run(engine, callGet, &d));
+    EXPECT_EQ(2, run(engine, callGet, &a));
+    EXPECT_EQ(5, run(engine, callSize, &c));
+    EXPECT_EQ(7, run(engine, callSize, &d));
+    // IncompatibleClassChangeError
+    EXPECT_THROW(run(engine, callGet, &object), coconut::utils::JVMPanic);
+
+    const auto& caches = engine->translate(callGet)->inlineCaches;
+    ASSERT_EQ(1u, caches.size());
+    EXPECT_EQ(4, caches[0].size());
+    EXPECT_EQ(1u, caches[0].hits);
+    EXPECT_EQ(5u, caches[0].misses);
+    std::ostringstream dump;
+    engine->dumpInlineCaches(dump);
+    EXPECT_NE(std::string::npos,
+              dump.str().find("call(LIGetter;)I pc 1: 4 classes, 1 hits, "
+                              "5 misses, 0 vtable calls\n"));
+  }
+
+  for (auto* classFile : {listD, mapC, listB, listA, sizedGetter, sized}) {
+    delete classFile;
+  }
+  delete getter;
+}
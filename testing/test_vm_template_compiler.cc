@@ -0,0 +1,420 @@
+// Test vm/template_compiler, vm/x86_assembler, vm/code_cache
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <climits>
+
+#include "../src/vm/template_compiler.h"
+#include "../src/vm/threaded_interpreter.h"
+#include "../src/vm/verifier.h"
+#include "code_builder.h"
+
+using coconut::classfile::CodeAttr;
+using coconut::rtda::Slot;
+using coconut::rtda::Throwable;
+using coconut::rtda::Thread;
+using coconut::vm::CodeCache;
+using coconut::vm::CompiledCode;
+using coconut::vm::TemplateCompiler;
+using coconut::vm::ThreadedInterpreter;
+using coconut::vm::verifyClass;
+using coconut::vm::verifyCode;
+using coconut::vm::X86Assembler;
+using coconut::vm::X86Label;
+using coconut::vm::X86Operand;
+
+#if defined(__x86_64__)
+
+// run compiled code on ints, expecting it to return an int
+
+static int runInts(const CompiledCode* compiled, std::vector<int> args) {
+  Slot locals[16] = {}, stack[16] = {};
+  for (size_t i = 0; i < args.size(); ++i) {
+    locals[i].bytes = static_cast<uint32_t>(args[i]);
+  }
+  EXPECT_EQ(coconut::vm::kCompiledReturnInt,
+            compiled->run(locals, stack));
+  return static_cast<int>(stack[0].bytes);
+}
+
+// test the encodings of the assembler
+
+TEST(VM_TEMPLATE_COMPILER, Assembler) {
+  using namespace coconut::vm;  // NOLINT
+  X86Assembler a;
+  a.movl(kRax, X86Operand::ofReg(kR8));
+  EXPECT_EQ(std::vector<uint8_t>({0x41, 0x8b, 0xc0}), a.code);
+  a.code.clear();
+  a.movl(X86Operand::ofMem(kRdi, 8), kRbx);
+  EXPECT_EQ(std::vector<uint8_t>({0x89, 0x5f, 0x08}), a.code);
+  a.code.clear();
+  a.movl(X86Operand::ofMem(kRsi, 0x100), 5);
+  EXPECT_EQ(std::vector<uint8_t>(
+                {0xc7, 0x86, 0x00, 0x01, 0x00, 0x00, 0x05, 0x00, 0x00, 0x00}),
+            a.code);
+  a.code.clear();
+  a.alul(kAluAdd, X86Operand::ofReg(kR12), 1);
+  EXPECT_EQ(std::vector<uint8_t>({0x41, 0x83, 0xc4, 0x01}), a.code);
+  a.code.clear();
+
+  // a backward jump, and a forward one patched by bind
+  X86Label back, forward;
+  a.bind(&back);
+  a.jmp(&back);
+  a.jcc(kCondEqual, &forward);
+  a.bind(&forward);
+  EXPECT_EQ(std::vector<uint8_t>({0xe9, 0xfb, 0xff, 0xff, 0xff, 0x0f, 0x84,
+                                  0x00, 0x00, 0x00, 0x00}),
+            a.code);
+  a.code.clear();
+
+  // the dispatch of a jump table: rcx = table + 5 * rax; jmp rcx (r11 here)
+  X86Label table;
+  a.bind(&table);
+  a.imull(kRax, X86Operand::ofReg(kRax), 5);
+  a.leaq(kRcx, &table);
+  a.addq(kRcx, kRax);
+  a.jmp(kR11);
+  EXPECT_EQ(std::vector<uint8_t>({0x6b, 0xc0, 0x05, 0x48, 0x8d, 0x0d, 0xf6,
+                                  0xff, 0xff, 0xff, 0x48, 0x03, 0xc8, 0x41,
+                                  0xff, 0xe3}),
+            a.code);
+}
+
+// test compiling int loop: sum of 0 ~ 9, in the interpreter and by itself
+
+TEST(VM_TEMPLATE_COMPILER, IntLoop) {
+  CodeAttr* codeAttr = makeCodeAttr(
+      2, 2,
+      {0x03, 0x3b, 0x03, 0x3c, 0x1b, 0x10, 0x0a, 0xa2, 0x00, 0x0d, 0x1a, 0x1b,
+       0x60, 0x3b, 0x84, 0x01, 0x01, 0xa7, 0xff, 0xf3, 0x1a, 0xac});
+  EXPECT_TRUE(verifyCode(codeAttr, "()I"));
+
+  ThreadedInterpreter engine;
+  engine.jit = true;
+  engine.policy.compileThreshold = 0;
+  engine.policy.compilerThreads = 0;
+  for (int i = 0; i < 2; ++i) {
+    Thread thread;
+    thread.stack.push(0, 4);
+    thread.stack.push(codeAttr->maxLocals, codeAttr->maxStack);
+    engine.execute(&thread, codeAttr);
+    ASSERT_EQ(1u, thread.stack.size);
+    EXPECT_EQ(45, thread.stack.topFrame->operandStack->popInt());
+  }
+  const CompiledCode* compiled = engine.compiled(codeAttr);
+  ASSERT_NE(nullptr, compiled);
+  EXPECT_GT(compiled->codeSize, 0u);
+  EXPECT_EQ(0, compiled->stackDepths[0]);
+  EXPECT_EQ(2, compiled->stackDepths[7]);
+  EXPECT_EQ(-1, compiled->stackDepths[8]);
+  EXPECT_EQ(45, runInts(compiled, {}));
+
+  delete codeAttr;
+}
+
+// test arithmetic: the corner cases of idiv, irem and shifts
+
+TEST(VM_TEMPLATE_COMPILER, Arithmetic) {
+  CodeCache cache;
+  // iload_0; iload_1; <op>; ireturn
+  auto compileOp = [&](BYTE op) {
+    CodeAttr* codeAttr = makeCodeAttr(2, 2, {0x1a, 0x1b, op, 0xac});
+    EXPECT_TRUE(verifyCode(codeAttr, "(II)I"));
+    TemplateCompiler compiler(codeAttr);
+    CompiledCode* compiled = compiler.compile(&cache);
+    EXPECT_NE(nullptr, compiled) << compiler.error;
+    delete codeAttr;
+    return compiled;
+  };
+  CompiledCode* idiv = compileOp(0x6c);
+  CompiledCode* irem = compileOp(0x70);
+  CompiledCode* ishl = compileOp(0x78);
+  CompiledCode* ishr = compileOp(0x7a);
+  CompiledCode* iushr = compileOp(0x7c);
+  CompiledCode* isub = compileOp(0x64);
+  CompiledCode* imul = compileOp(0x68);
+
+  EXPECT_EQ(-3, runInts(idiv, {7, -2}));
+  EXPECT_EQ(INT_MIN, runInts(idiv, {INT_MIN, -1}));
+  EXPECT_EQ(1, runInts(irem, {7, -2}));
+  EXPECT_EQ(-1, runInts(irem, {-7, 2}));
+  EXPECT_EQ(0, runInts(irem, {INT_MIN, -1}));
+  EXPECT_EQ(2, runInts(ishl, {1, 33}));
+  EXPECT_EQ(-1, runInts(ishr, {-8, 35}));
+  EXPECT_EQ(0x1fffffff, runInts(iushr, {-8, 3}));
+  EXPECT_EQ(INT_MAX, runInts(isub, {INT_MIN, 1}));
+  EXPECT_EQ(-6, runInts(imul, {3, -2}));
+
+  // division by zero bails out at idiv, with the frame in memory
+  Slot locals[2] = {}, stack[2] = {};
+  locals[0].bytes = 7;
+  EXPECT_EQ(2, idiv->run(locals, stack));
+  EXPECT_EQ(2, idiv->stackDepths[2]);
+  EXPECT_EQ(7u, stack[0].bytes);
+  EXPECT_EQ(0u, stack[1].bytes);
+
+  for (CompiledCode* compiled : {idiv, irem, ishl, ishr, iushr, isub, imul}) {
+    delete compiled;
+  }
+}
+
+// test the homes in the frame: more stack slots and locals than registers,
+// switches and the wide forms
+
+TEST(VM_TEMPLATE_COMPILER, Homes) {
+  CodeCache cache;
+  {
+    // 1 + 2 + ... + 6, all pushed first
+    CodeAttr* codeAttr =
+        makeCodeAttr(6, 0,
+                     {0x04, 0x05, 0x06, 0x07, 0x08, 0x10, 0x06, 0x60, 0x60,
+                      0x60, 0x60, 0x60, 0xac});
+    EXPECT_TRUE(verifyCode(codeAttr, "()I"));
+    TemplateCompiler compiler(codeAttr);
+    CompiledCode* compiled = compiler.compile(&cache);
+    ASSERT_NE(nullptr, compiled) << compiler.error;
+    EXPECT_EQ(21, runInts(compiled, {}));
+    delete compiled;
+    delete codeAttr;
+  }
+  {
+    // static int f(int a0, ..., int a7) { return a7 * 10 + a6 - a0; } by
+    // iload 7, bipush 10, imul, iload 6, iadd, iload_0, isub, and the same
+    // result stored into local 300 and loaded back by the wide forms
+    CodeAttr* codeAttr = makeCodeAttr(
+        2, 301,
+        {0x15, 0x07, 0x10, 0x0a, 0x68, 0x15, 0x06, 0x60, 0x1a, 0x64, 0xc4,
+         0x36, 0x01, 0x2c, 0xc4, 0x84, 0x01, 0x2c, 0x00, 0x02, 0xc4, 0x15,
+         0x01, 0x2c, 0xac});
+    EXPECT_TRUE(verifyCode(codeAttr, "(IIIIIIII)I"));
+    TemplateCompiler compiler(codeAttr);
+    CompiledCode* compiled = compiler.compile(&cache);
+    ASSERT_NE(nullptr, compiled) << compiler.error;
+    Slot locals[301] = {}, stack[2] = {};
+    for (int i = 0; i < 8; ++i) locals[i].bytes = i + 1;
+    EXPECT_EQ(coconut::vm::kCompiledReturnInt, compiled->run(locals, stack));
+    EXPECT_EQ(8u * 10 + 7 - 1 + 2, stack[0].bytes);
+    delete compiled;
+    delete codeAttr;
+  }
+  {
+    // switch (x) { case 1: return 10; case 5: return 50; default: return 0; }
+    std::vector<BYTE> code = {0x1a, 0xab, 0x00, 0x00};
+    appendInt32(code, 33);  // default
+    appendInt32(code, 2);
+    appendInt32(code, 1);
+    appendInt32(code, 27);
+    appendInt32(code, 5);
+    appendInt32(code, 30);
+    // 28: case 1, 31: case 5, 34: default
+    code.insert(code.end(),
+                {0x10, 0x0a, 0xac, 0x10, 0x32, 0xac, 0x03, 0xac});
+    // a tableswitch of 0 ~ 2 over the same cases
+    std::vector<BYTE> table = {0x1a, 0xaa, 0x00, 0x00};
+    appendInt32(table, 30);  // default
+    appendInt32(table, 0);
+    appendInt32(table, 2);
+    appendInt32(table, 30);
+    appendInt32(table, 27);
+    appendInt32(table, 27);
+    // 28: case 1, 2, 31: default and case 0
+    table.insert(table.end(), {0x10, 0x0a, 0xac, 0x03, 0xac});
+    CodeAttr* lookupAttr = makeCodeAttr(1, 1, code);
+    CodeAttr* tableAttr = makeCodeAttr(1, 1, table);
+    EXPECT_TRUE(verifyCode(lookupAttr, "(I)I"));
+    EXPECT_TRUE(verifyCode(tableAttr, "(I)I"));
+    TemplateCompiler lookupCompiler(lookupAttr), tableCompiler(tableAttr);
+    CompiledCode* lookup = lookupCompiler.compile(&cache);
+    CompiledCode* tableswitch = tableCompiler.compile(&cache);
+    ASSERT_NE(nullptr, lookup) << lookupCompiler.error;
+    ASSERT_NE(nullptr, tableswitch) << tableCompiler.error;
+    EXPECT_EQ(10, runInts(lookup, {1}));
+    EXPECT_EQ(50, runInts(lookup, {5}));
+    EXPECT_EQ(0, runInts(lookup, {3}));
+    EXPECT_EQ(0, runInts(tableswitch, {0}));
+    EXPECT_EQ(10, runInts(tableswitch, {1}));
+    EXPECT_EQ(10, runInts(tableswitch, {2}));
+    EXPECT_EQ(0, runInts(tableswitch, {3}));
+    EXPECT_EQ(0, runInts(tableswitch, {-1}));
+    delete lookup;
+    delete tableswitch;
+    delete lookupAttr;
+    delete tableAttr;
+  }
+}
+
+// iload_0; a switch over keys, where case i returns i + 1 and the default
+// returns 0. A tableswitch takes the keys from keys[0] to keys.back()
+
+static CodeAttr* makeSwitch(bool table, const std::vector<int>& keys) {
+  std::vector<BYTE> code = {0x1a, BYTE(table ? 0xaa : 0xab)};
+  while (code.size() % 4 != 0) code.push_back(0x00);
+  int n = keys.size();
+  // the cases follow the table, 3 bytes each, then the default. The offsets
+  // are from the switch, at pc 1
+  int cases = code.size() + (table ? 12 + 4 * n : 8 + 8 * n);
+  appendInt32(code, cases + 3 * n - 1);
+  if (table) {
+    appendInt32(code, keys[0]);
+    appendInt32(code, keys.back());
+  } else {
+    appendInt32(code, n);
+  }
+  for (int i = 0; i < n; ++i) {
+    if (!table) appendInt32(code, keys[i]);
+    appendInt32(code, cases + 3 * i - 1);
+  }
+  for (int i = 0; i < n; ++i) {
+    code.insert(code.end(), {0x10, BYTE(i + 1), 0xac});
+  }
+  code.insert(code.end(), {0x03, 0xac});
+  CodeAttr* codeAttr = makeCodeAttr(1, 1, code);
+  EXPECT_TRUE(verifyCode(codeAttr, "(I)I"));
+  return codeAttr;
+}
+
+// test the jump table of a tableswitch, and the compare tree of a lookupswitch
+
+TEST(VM_TEMPLATE_COMPILER, Switches) {
+  CodeCache cache;
+  std::vector<int> table = {-3, -2, -1, 0, 1, 2, 3, 4};
+  // key - low wraps around for the keys below
+  std::vector<int> high = {INT_MAX - 4, INT_MAX - 3, INT_MAX - 2, INT_MAX - 1,
+                           INT_MAX};
+  std::vector<int> lookup = {INT_MIN, -100, -5, 0,     1,
+                             7,       8,    1000, 65536, INT_MAX};
+  for (const auto& test : std::vector<std::pair<bool, std::vector<int>>>{
+           {true, table}, {true, high}, {false, lookup}}) {
+    const std::vector<int>& keys = test.second;
+    CodeAttr* codeAttr = makeSwitch(test.first, keys);
+    TemplateCompiler compiler(codeAttr);
+    CompiledCode* compiled = compiler.compile(&cache);
+    ASSERT_NE(nullptr, compiled) << compiler.error;
+    // each key and its neighbours
+    for (size_t i = 0; i < keys.size(); ++i) {
+      for (long long x = keys[i] - 1LL; x <= keys[i] + 1LL; ++x) {
+        if (x < INT_MIN || x > INT_MAX) continue;
+        auto it = std::find(keys.begin(), keys.end(), int(x));
+        int expected = it == keys.end() ? 0 : int(it - keys.begin()) + 1;
+        EXPECT_EQ(expected, runInts(compiled, {int(x)})) << "key " << x;
+      }
+    }
+    EXPECT_EQ(0, runInts(compiled, {INT_MIN + 1}));
+    EXPECT_EQ(0, runInts(compiled, {INT_MAX - 10}));
+    delete compiled;
+    delete codeAttr;
+  }
+}
+
+// test OSR entries: the code starts from the locals and the operand stack of
+// a frame, at a loop header
+
+TEST(VM_TEMPLATE_COMPILER, OsrEntry) {
+  CodeCache cache;
+  // static int f(int n): pushes 0, then adds n, n - 1, ..., 1 to it on the
+  // stack, so the loop header at pc 1 has a value on the stack
+  CodeAttr* codeAttr =
+      makeCodeAttr(2, 1,
+                   {0x03, 0x1a, 0x9e, 0x00, 0x0b, 0x1a, 0x60, 0x84, 0x00, 0xff,
+                    0xa7, 0xff, 0xf7, 0xac});
+  EXPECT_TRUE(verifyCode(codeAttr, "(I)I"));
+  TemplateCompiler compiler(codeAttr), osrCompiler(codeAttr),
+      badCompiler(codeAttr);
+  CompiledCode* compiled = compiler.compile(&cache);
+  CompiledCode* osr = osrCompiler.compile(&cache, 1);
+  ASSERT_NE(nullptr, compiled) << compiler.error;
+  ASSERT_NE(nullptr, osr) << osrCompiler.error;
+  EXPECT_EQ(-1, compiled->osrPc);
+  EXPECT_EQ(1, osr->osrPc);
+  EXPECT_EQ(1, osr->stackDepths[1]);
+  EXPECT_EQ(10, runInts(compiled, {4}));
+
+  // the frame stopped at the header with n = 3 and 100 on the stack
+  Slot locals[1] = {}, stack[2] = {};
+  locals[0].bytes = 3;
+  stack[0].bytes = 100;
+  EXPECT_EQ(coconut::vm::kCompiledReturnInt, osr->run(locals, stack));
+  EXPECT_EQ(106u, stack[0].bytes);
+
+  // pc 3 is inside ifle
+  EXPECT_EQ(nullptr, badCompiler.compile(&cache, 3));
+  EXPECT_FALSE(badCompiler.error.empty());
+
+  delete compiled;
+  delete osr;
+  delete codeAttr;
+}
+
+// test that compiled code bails out to the interpreter, which throws, and
+// that methods with calls are rejected
+
+TEST(VM_TEMPLATE_COMPILER, Bailout) {
+  // #12 Class java/lang/ArithmeticException
+  coconut::classfile::ClassFile* classFile = makeClassFile(
+      {
+          // static int div(int a, int b) { return a / b; }
+          {"div", "(II)I", 2, 2, {0x1a, 0x1b, 0x6c, 0xac}},
+          // static int safeDiv(int a, int b) {
+          //   try { return div(a, b); } catch (ArithmeticException e) {
+          //   return -1; }
+          // }
+          {"safeDiv",
+           "(II)I",
+           2,
+           2,
+           {0x1a, 0x1b, 0xb8, 0x00, 0x07, 0xac, 0x57, 0x02, 0xac},
+           {},
+           {{0, 6, 6, 12}}},
+      },
+      {"java/lang/ArithmeticException"});
+  EXPECT_EQ((int)classFile->methods.size(), verifyClass(classFile).passed);
+  CodeAttr* div =
+      classFile->findMethod("div", "(II)I")->attributes->filtCodeAttr();
+  CodeAttr* safeDiv =
+      classFile->findMethod("safeDiv", "(II)I")->attributes->filtCodeAttr();
+
+  ThreadedInterpreter engine;
+  engine.classFile = classFile;
+  engine.jit = true;
+  engine.policy.compileThreshold = 0;
+  engine.policy.compilerThreads = 0;
+  for (int b : {2, 0}) {
+    Thread thread;
+    thread.stack.push(0, 4);
+    thread.stack.push(safeDiv->maxLocals, safeDiv->maxStack);
+    thread.stack.topFrame->localVariableTable->setInt(0, 7);
+    thread.stack.topFrame->localVariableTable->setInt(1, b);
+    engine.execute(&thread, safeDiv);
+    ASSERT_EQ(1u, thread.stack.size);
+    EXPECT_EQ(nullptr, thread.exception);
+    EXPECT_EQ(b == 0 ? -1 : 3, thread.stack.topFrame->operandStack->popInt());
+  }
+  {
+    // the exception is thrown by the interpreter at the pc of idiv
+    Thread thread;
+    thread.stack.push(0, 4);
+    thread.stack.push(div->maxLocals, div->maxStack);
+    thread.stack.topFrame->localVariableTable->setInt(0, 7);
+    thread.stack.topFrame->localVariableTable->setInt(1, 0);
+    engine.execute(&thread, div);
+    auto* error = dynamic_cast<Throwable*>(thread.exception);
+    ASSERT_NE(nullptr, error);
+    EXPECT_EQ("java/lang/ArithmeticException", error->klass->name);
+    ASSERT_EQ(1u, error->getStackTrace().size());
+    EXPECT_EQ("div(II)I (pc 2)", error->getStackTrace()[0]);
+  }
+  EXPECT_NE(nullptr, engine.compiled(div));
+  EXPECT_EQ(nullptr, engine.compiled(safeDiv));
+
+  TemplateCompiler compiler(safeDiv);
+  CodeCache cache;
+  EXPECT_EQ(nullptr, compiler.compile(&cache));
+  EXPECT_FALSE(compiler.error.empty());
+  EXPECT_EQ(0u, cache.codeBytes);
+
+  delete classFile;
+}
+
+#endif  // __x86_64__
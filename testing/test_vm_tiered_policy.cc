@@ -0,0 +1,250 @@
+// Test vm/tiered_policy
+
+#include <gtest/gtest.h>
+
+#include <sstream>
+#include <thread>
+
+#include "../src/vm/threaded_interpreter.h"
+#include "../src/vm/tiered_policy.h"
+#include "../src/vm/verifier.h"
+#include "code_builder.h"
+
+using coconut::classfile::CodeAttr;
+using coconut::rtda::Thread;
+using coconut::vm::ThreadedInterpreter;
+using coconut::vm::TieredPolicy;
+using coconut::vm::TierTransition;
+using coconut::vm::verifyCode;
+
+#if defined(__x86_64__)
+
+// int sum = 0; for (int i = 0; i < n; ++i) sum += i; return sum;
+
+static CodeAttr* makeSumLoop(int n) {
+  CodeAttr* codeAttr = makeCodeAttr(
+      2, 2,
+      {0x03, 0x3b, 0x03, 0x3c, 0x1b, 0x11, BYTE(n >> 8), BYTE(n), 0xa2, 0x00,
+       0x0d, 0x1a, 0x1b, 0x60, 0x3b, 0x84, 0x01, 0x01, 0xa7, 0xff, 0xf2, 0x1a,
+       0xac});
+  EXPECT_TRUE(verifyCode(codeAttr, "()I"));
+  return codeAttr;
+}
+
+// run a code with no arguments, returning an int
+
+static int runInt(ThreadedInterpreter* engine, CodeAttr* codeAttr) {
+  Thread thread;
+  thread.stack.push(0, 4);
+  thread.stack.push(codeAttr->maxLocals, codeAttr->maxStack);
+  engine->execute(&thread, codeAttr);
+  EXPECT_EQ(1u, thread.stack.size);
+  return thread.stack.topFrame->operandStack->popInt();
+}
+
+// test the invocation threshold, compiling in place
+
+TEST(VM_TIERED_POLICY, Invocations) {
+  CodeAttr* codeAttr = makeSumLoop(10);
+  ThreadedInterpreter engine;
+  engine.jit = true;
+  engine.policy.compilerThreads = 0;
+  engine.policy.invocationThreshold = 3;
+  engine.policy.backedgeThreshold = 1000000;
+  engine.policy.compileThreshold = 1000000;
+
+  for (int i = 1; i <= 4; ++i) {
+    EXPECT_EQ(45, runInt(&engine, codeAttr));
+    EXPECT_EQ(i >= 3, engine.compiled(codeAttr) != nullptr);
+  }
+  std::vector<TierTransition> transitions = engine.policy.transitions();
+  ASSERT_EQ(1u, transitions.size());
+  EXPECT_EQ(coconut::vm::kTierInterpreter, transitions[0].from);
+  EXPECT_EQ(coconut::vm::kTierCompiled, transitions[0].to);
+  EXPECT_EQ(3u, transitions[0].invocations);
+  EXPECT_EQ(20u, transitions[0].backedges);
+  EXPECT_EQ(0u, transitions[0].queueLength);
+  EXPECT_EQ(engine.compiled(codeAttr)->codeSize, transitions[0].codeSize);
+  EXPECT_GT(transitions[0].codeSize, 0u);
+  EXPECT_TRUE(transitions[0].error.empty());
+  // the compiled code ran instead of the interpreter, which counts backedges
+  EXPECT_EQ(20u, codeAttr->backedgeCount);
+
+  delete codeAttr;
+}
+
+// test the backedge threshold: at an invocation, and in a long loop
+
+TEST(VM_TIERED_POLICY, Backedges) {
+  CodeAttr* shortLoop = makeSumLoop(100);
+  CodeAttr* longLoop = makeSumLoop(1000);
+  ThreadedInterpreter engine;
+  engine.jit = true;
+  engine.policy.compilerThreads = 0;
+  engine.policy.invocationThreshold = 1000000;
+  engine.policy.backedgeThreshold = 250;
+  engine.policy.compileThreshold = 1000000;
+
+  // 100 backedges a run, counted when it returns
+  for (int i = 1; i <= 4; ++i) {
+    EXPECT_EQ(4950, runInt(&engine, shortLoop));
+    EXPECT_EQ(i >= 4, engine.compiled(shortLoop) != nullptr);
+  }
+  // the loop gets hot in its first run, which moves into an OSR entry at the
+  // loop header. The method is compiled at its next invocation
+  EXPECT_EQ(499500, runInt(&engine, longLoop));
+  EXPECT_EQ(256u, longLoop->backedgeCount);
+  EXPECT_NE(nullptr, engine.policy.compiledOsr(longLoop, 4));
+  EXPECT_EQ(nullptr, engine.compiled(longLoop));
+  EXPECT_EQ(499500, runInt(&engine, longLoop));
+  EXPECT_NE(nullptr, engine.compiled(longLoop));
+  EXPECT_EQ(256u, longLoop->backedgeCount);
+
+  std::vector<TierTransition> transitions = engine.policy.transitions();
+  ASSERT_EQ(3u, transitions.size());
+  EXPECT_EQ(-1, transitions[0].osrPc);
+  EXPECT_EQ(4u, transitions[0].invocations);
+  EXPECT_EQ(300u, transitions[0].backedges);
+  EXPECT_EQ(4, transitions[1].osrPc);
+  EXPECT_EQ(1u, transitions[1].invocations);
+  EXPECT_EQ(256u, transitions[1].backedges);
+  EXPECT_EQ(-1, transitions[2].osrPc);
+  EXPECT_EQ(2u, transitions[2].invocations);
+
+  delete shortLoop;
+  delete longLoop;
+}
+
+// test on-stack replacement of a loop which is entered once: it moves into
+// compiled code in its first run, and bails out of it to throw
+
+TEST(VM_TIERED_POLICY, OnStackReplacement) {
+  ThreadedInterpreter engine, tos(true, true);
+  for (ThreadedInterpreter* e : {&engine, &tos}) {
+    // int sum = 0; for (int i = 0; i < 1000; ++i) sum += 1000 / (500 - i);
+    // return sum;
+    CodeAttr* codeAttr = makeCodeAttr(
+        4, 2,
+        {0x03, 0x3b, 0x03, 0x3c, 0x1b, 0x11, 0x03, 0xe8, 0xa2, 0x00, 0x15,
+         0x1a, 0x11, 0x03, 0xe8, 0x11, 0x01, 0xf4, 0x1b, 0x64, 0x6c, 0x60,
+         0x3b, 0x84, 0x01, 0x01, 0xa7, 0xff, 0xea, 0x1a, 0xac});
+    EXPECT_TRUE(verifyCode(codeAttr, "()I"));
+    CodeAttr* loop = makeSumLoop(1000);
+    e->jit = true;
+    e->policy.compilerThreads = 0;
+    e->policy.backedgeThreshold = 256;
+
+    // the division by zero at i = 500 is in the compiled code, at pc 20
+    Thread thread;
+    thread.stack.push(0, 4);
+    thread.stack.push(codeAttr->maxLocals, codeAttr->maxStack);
+    e->execute(&thread, codeAttr);
+    ASSERT_NE(nullptr, thread.exception);
+    EXPECT_EQ("java/lang/ArithmeticException", thread.exception->klass->name);
+    EXPECT_EQ(20, thread.pc);
+    EXPECT_EQ(1u, thread.stack.size);
+    EXPECT_NE(nullptr, e->policy.compiledOsr(codeAttr, 4));
+    EXPECT_EQ(nullptr, e->compiled(codeAttr));
+    EXPECT_EQ(256u, codeAttr->backedgeCount);
+
+    // the loop returns from the compiled code
+    EXPECT_EQ(499500, runInt(e, loop));
+    EXPECT_EQ(256u, loop->backedgeCount);
+
+    delete codeAttr;
+    delete loop;
+  }
+}
+
+// test compiling in the background, and a rejected method
+
+TEST(VM_TIERED_POLICY, CompilerThreads) {
+  CodeAttr* loop = makeSumLoop(10);
+  // lconst_1; l2i; ireturn: longs are not compiled
+  CodeAttr* rejected = makeCodeAttr(2, 0, {0x0a, 0x88, 0xac});
+  EXPECT_TRUE(verifyCode(rejected, "()I"));
+  ThreadedInterpreter engine;
+  engine.jit = true;
+  engine.policy.compilerThreads = 2;
+  engine.policy.compileThreshold = 0;
+
+  // the first runs may be interpreted, while the methods are compiled
+  EXPECT_EQ(45, runInt(&engine, loop));
+  EXPECT_EQ(1, runInt(&engine, rejected));
+  engine.policy.waitForCompiles();
+  EXPECT_EQ(0u, engine.policy.queueLength());
+  EXPECT_NE(nullptr, engine.compiled(loop));
+  EXPECT_EQ(nullptr, engine.compiled(rejected));
+  EXPECT_EQ(45, runInt(&engine, loop));
+  EXPECT_EQ(1, runInt(&engine, rejected));
+
+  std::vector<TierTransition> transitions = engine.policy.transitions();
+  ASSERT_EQ(2u, transitions.size());
+  for (const TierTransition& transition : transitions) {
+    if (transition.to == coconut::vm::kTierCompiled) {
+      EXPECT_GT(transition.codeSize, 0u);
+    } else {
+      EXPECT_EQ(coconut::vm::kTierInterpreter, transition.to);
+      EXPECT_EQ(0u, transition.codeSize);
+      EXPECT_FALSE(transition.error.empty());
+    }
+  }
+
+  delete loop;
+  delete rejected;
+}
+
+// test the policy asked by several Java threads at once: a hot method and a
+// hot loop are queued once
+
+TEST(VM_TIERED_POLICY, JavaThreads) {
+  CodeAttr* loop = makeSumLoop(10);
+  loop->invocationCount = 1 << 20;
+  loop->backedgeCount = 1 << 20;
+  TieredPolicy policy;
+  policy.compilerThreads = 1;
+
+  std::vector<std::thread> threads;
+  for (int i = 0; i < 4; ++i) {
+    threads.emplace_back([&policy, loop]() {
+      for (int j = 0; j < 1000; ++j) {
+        policy.onInvocation(loop);
+        policy.onBackedges(loop, 4);
+        policy.compiled(loop);
+        policy.compiledOsr(loop, 4);
+      }
+    });
+  }
+  for (std::thread& thread : threads) thread.join();
+  policy.waitForCompiles();
+  EXPECT_NE(nullptr, policy.compiled(loop));
+  EXPECT_NE(nullptr, policy.compiledOsr(loop, 4));
+  EXPECT_EQ(2u, policy.transitions().size());
+
+  delete loop;
+}
+
+// test the log lines of the transitions
+
+TEST(VM_TIERED_POLICY, Log) {
+  TierTransition compiled{"main()I", coconut::vm::kTierInterpreter,
+                          coconut::vm::kTierCompiled, -1, 1, 10000, 2, 35,
+                          105, ""};
+  TierTransition osr{"main()I", coconut::vm::kTierInterpreter,
+                     coconut::vm::kTierCompiled, 4, 1, 40000, 0, 20, 105, ""};
+  TierTransition rejected{"f()J", coconut::vm::kTierInterpreter,
+                          coconut::vm::kTierInterpreter, -1, 5000, 0, 0, 1.5,
+                          0, "pc 0: lconst_1 is not supported"};
+  std::ostringstream os;
+  os << compiled << "\n" << osr << "\n" << rejected;
+  EXPECT_EQ(
+      "main()I: tier 0 -> 1 (1 invocations, 10000 backedges, queue 2), 35 us, "
+      "105 bytes\n"
+      "main()I osr at pc 4: tier 0 -> 1 (1 invocations, 40000 backedges, "
+      "queue 0), 20 us, 105 bytes\n"
+      "f()J: not compiled (5000 invocations, 0 backedges, queue 0), 1.5 us: "
+      "pc 0: lconst_1 is not supported",
+      os.str());
+}
+
+#endif  // __x86_64__
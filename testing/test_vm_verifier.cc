@@ -0,0 +1,212 @@
+// Test vm/verifier
+
+#include <gtest/gtest.h>
+
+#include "../src/vm/threaded_interpreter.h"
+#include "../src/vm/verifier.h"
+#include "code_builder.h"
+
+using coconut::classfile::CodeAttr;
+using coconut::rtda::Thread;
+using coconut::vm::ThreadedInterpreter;
+using coconut::vm::Verifier;
+using coconut::vm::verifyClass;
+using coconut::vm::verifyCode;
+
+// verify a code by type inference
+
+static bool verifies(uint16_t maxStack, uint16_t maxLocals,
+                     const std::vector<BYTE>& code,
+                     const std::string& descriptor) {
+  CodeAttr* codeAttr = makeCodeAttr(maxStack, maxLocals, code);
+  Verifier verifier(codeAttr, descriptor, true);
+  bool passed = verifier.verify();
+  EXPECT_FALSE(verifier.usedStackMap);
+  EXPECT_EQ(passed, verifier.error.empty());
+  delete codeAttr;
+  return passed;
+}
+
+// test type inference: accepted and rejected code
+
+TEST(VM_VERIFIER, TypeInference) {
+  // the int loop of VM_INTERPRETER.IntLoop
+  EXPECT_TRUE(verifies(
+      2, 2,
+      {0x03, 0x3b, 0x03, 0x3c, 0x1b, 0x10, 0x0a, 0xa2, 0x00, 0x0d, 0x1a, 0x1b,
+       0x60, 0x3b, 0x84, 0x01, 0x01, 0xa7, 0xff, 0xf3, 0x1a, 0xac},
+      "()I"));
+
+  // iadd; ireturn: stack underflow
+  EXPECT_FALSE(verifies(2, 0, {0x60, 0xac}, "()I"));
+  // iconst_1; iconst_1; iadd; ireturn: over maxStack
+  EXPECT_FALSE(verifies(1, 0, {0x04, 0x04, 0x60, 0xac}, "()I"));
+  // fconst_0; iconst_1; iadd; ireturn: type mismatch
+  EXPECT_FALSE(verifies(2, 0, {0x0b, 0x04, 0x60, 0xac}, "()I"));
+  // iload 5; ireturn: over maxLocals
+  EXPECT_FALSE(verifies(1, 1, {0x15, 0x05, 0xac}, "()I"));
+  // iload_0; ireturn: the local is set only if it is an argument
+  EXPECT_FALSE(verifies(1, 1, {0x1a, 0xac}, "()I"));
+  EXPECT_TRUE(verifies(1, 1, {0x1a, 0xac}, "(I)I"));
+  EXPECT_FALSE(verifies(1, 1, {0x1a, 0xac}, "(II)I"));
+  // bipush 1; goto 1: into the middle of an instruction
+  EXPECT_FALSE(verifies(1, 0, {0x10, 0x01, 0xa7, 0xff, 0xff}, "()V"));
+  // iconst_0: falling off the end
+  EXPECT_FALSE(verifies(1, 0, {0x03}, "()I"));
+  // iconst_0; ireturn; then an instruction cut short by the end of the code
+  EXPECT_FALSE(verifies(1, 0, {0x03, 0xac, 0x10}, "()I"));
+  EXPECT_FALSE(verifies(1, 0, {0x03, 0xac, 0xa7, 0x00}, "()I"));
+  EXPECT_FALSE(verifies(1, 1, {0x03, 0xac, 0xc4, 0x15, 0x00}, "()I"));
+  // iconst_0; ireturn: return types
+  EXPECT_FALSE(verifies(1, 0, {0x03, 0xac}, "()J"));
+  EXPECT_FALSE(verifies(1, 0, {0x03, 0xac}, "()V"));
+  EXPECT_TRUE(verifies(1, 0, {0x03, 0xac}, "()Z"));
+  // lconst_0; pop; pop; iconst_0; ireturn: splitting a long
+  EXPECT_FALSE(verifies(2, 0, {0x09, 0x57, 0x57, 0x03, 0xac}, "()I"));
+  // lconst_0; pop2; iconst_0; ireturn
+  EXPECT_TRUE(verifies(2, 0, {0x09, 0x58, 0x03, 0xac}, "()I"));
+  // lconst_0; lstore_0; (iconst_0; istore_1;) lload_0; lreturn
+  EXPECT_TRUE(verifies(2, 2, {0x09, 0x3f, 0x1e, 0xad}, "()J"));
+  EXPECT_FALSE(verifies(2, 2, {0x09, 0x3f, 0x03, 0x3c, 0x1e, 0xad}, "()J"));
+  // getstatic #1; ireturn: not understood by the verifier
+  EXPECT_FALSE(verifies(1, 0, {0xb2, 0x00, 0x01, 0xac}, "()I"));
+  // aconst_null; iconst_0; iaload; ireturn: arrays are left to the classic
+  // engine
+  EXPECT_FALSE(verifies(2, 0, {0x01, 0x03, 0x2e, 0xac}, "()I"));
+  // aconst_null; iconst_0; iconst_0; iastore; return
+  EXPECT_FALSE(verifies(3, 0, {0x01, 0x03, 0x03, 0x4f, 0xb1}, "()V"));
+
+  // ldc #2 (Class Test); areturn: so are strings and classes
+  coconut::classfile::ClassFile* classFile =
+      makeClassFile({{"f", "()Ljava/lang/Object;", 1, 0, {0x12, 0x02, 0xb0}}});
+  CodeAttr* codeAttr = classFile->methods[0].attributes->filtCodeAttr();
+  EXPECT_FALSE(verifyCode(codeAttr, "()Ljava/lang/Object;"));
+  delete classFile;
+}
+
+// test merging at join points
+
+TEST(VM_VERIFIER, JoinPoints) {
+  // 0: iload_0; 1: ifeq 8; 4: iconst_1; 5: goto 9; 8: xconst_0;
+  // 9: pop; 10: iconst_0; 11: ireturn
+  auto makeJoin = [](BYTE constant) {
+    return std::vector<BYTE>{0x1a, 0x99, 0x00, 0x07, 0x04, 0xa7,
+                             0x00, 0x04, constant, 0x57, 0x03, 0xac};
+  };
+  EXPECT_TRUE(verifies(1, 1, makeJoin(0x03), "(I)I"));   // iconst_0
+  EXPECT_FALSE(verifies(1, 1, makeJoin(0x0b), "(I)I"));  // fconst_0
+
+  // a local set on one path only is unusable after the join:
+  // 0: iload_0; 1: ifeq 6; 4: iconst_1; 5: istore_1; 6: iload_1; 7: ireturn
+  EXPECT_FALSE(verifies(1, 2, {0x1a, 0x99, 0x00, 0x05, 0x04, 0x3c, 0x1b, 0xac},
+                        "(I)I"));
+  // ... but it is usable when it is set on both paths
+  EXPECT_TRUE(verifies(1, 2,
+                       {0x04, 0x3c, 0x1a, 0x99, 0x00, 0x05, 0x04, 0x3c, 0x1b,
+                        0xac},
+                       "(I)I"));
+}
+
+// test the exception table: the ranges and handlers must be in the code and
+// at instruction starts
+
+TEST(VM_VERIFIER, ExceptionTable) {
+  // 0: bipush 0; 2: ireturn; 3: pop; 4: iconst_1; 5: ireturn
+  auto verifiesWith = [](const coconut::classfile::ExceptionTableEntry& entry) {
+    CodeAttr* codeAttr =
+        makeCodeAttr(1, 0, {0x10, 0x00, 0xac, 0x57, 0x04, 0xac});
+    codeAttr->exceptionTable.push_back(entry);
+    Verifier verifier(codeAttr, "()I", true);
+    bool passed = verifier.verify();
+    delete codeAttr;
+    return passed;
+  };
+  EXPECT_TRUE(verifiesWith({0, 3, 3, 0}));
+  EXPECT_TRUE(verifiesWith({0, 6, 3, 0}));   // the handler covers itself
+  EXPECT_FALSE(verifiesWith({2, 2, 3, 0}));  // empty range
+  EXPECT_FALSE(verifiesWith({2, 0, 3, 0}));  // reversed range
+  EXPECT_FALSE(verifiesWith({0, 7, 3, 0}));  // past the end of the code
+  EXPECT_FALSE(verifiesWith({0, 3, 6, 0}));
+  EXPECT_FALSE(verifiesWith({1, 3, 3, 0}));  // in the middle of bipush
+  EXPECT_FALSE(verifiesWith({0, 1, 3, 0}));
+  EXPECT_FALSE(verifiesWith({0, 3, 1, 0}));
+}
+
+// test type checking with the StackMapTable
+
+TEST(VM_VERIFIER, StackMapTable) {
+  // static int sum(int n) { int s = 0; while (n > 0) { s += n; n--; }
+  //                         return s; }
+  std::vector<BYTE> sum = {0x03, 0x3c, 0x1a, 0x9e, 0x00, 0x0d,
+                           0x1b, 0x1a, 0x60, 0x3c, 0x84, 0x00,
+                           0xff, 0xa7, 0xff, 0xf5, 0x1b, 0xac};
+  coconut::classfile::ClassFile* classFile = makeClassFile({
+      // pc 2: append_frame (int), pc 16: same_frame
+      {"sum", "(I)I", 2, 2, sum, {0x00, 0x02, 252, 0x00, 0x02, 0x01, 13}},
+      // pc 16: same_locals_1_stack_item_frame (int) does not match
+      {"badFrame",
+       "(I)I",
+       2,
+       2,
+       sum,
+       {0x00, 0x02, 252, 0x00, 0x02, 0x01, 64 + 13, 0x01}},
+      // no frame at pc 16, after goto
+      {"noFrame", "(I)I", 2, 2, sum, {0x00, 0x01, 252, 0x00, 0x02, 0x01}},
+      // static int main() { return sum(10); }
+      {"main", "()I", 1, 0, {0x10, 0x0a, 0xb8, 0x00, 0x07, 0xac}},
+  });
+
+  for (int i = 0; i < 3; ++i) {
+    CodeAttr* codeAttr = classFile->methods[i].attributes->filtCodeAttr();
+    Verifier verifier(codeAttr, "(I)I", true);
+    EXPECT_EQ(i == 0, verifier.verify());
+    EXPECT_TRUE(verifier.usedStackMap);
+  }
+  EXPECT_EQ(4, verifyClass(classFile).methods);
+
+  ThreadedInterpreter threaded;
+  threaded.classFile = classFile;
+  Thread thread;
+  thread.stack.push(0, 1);
+  CodeAttr* main =
+      classFile->findMethod("main", "()I")->attributes->filtCodeAttr();
+  thread.stack.push(main->maxLocals, main->maxStack);
+  threaded.execute(&thread, main);
+  EXPECT_EQ(55, thread.stack.topFrame->operandStack->popInt());
+
+  delete classFile;
+}
+
+// test unverified code takes the checked path
+
+TEST(VM_VERIFIER, CheckedPath) {
+  // iadd; ireturn
+  CodeAttr* bad = makeCodeAttr(2, 0, {0x60, 0xac});
+  // iconst_1; iconst_2; iadd; ireturn
+  CodeAttr* good = makeCodeAttr(2, 0, {0x04, 0x05, 0x60, 0xac});
+  EXPECT_FALSE(verifyCode(bad, "()I"));
+  EXPECT_TRUE(verifyCode(good, "()I"));
+  EXPECT_EQ(coconut::classfile::kVerifyFailed, bad->verifyStatus);
+  EXPECT_EQ(coconut::classfile::kVerifyPassed, good->verifyStatus);
+
+  ThreadedInterpreter threaded;
+  {
+    Thread thread;
+    thread.stack.push(0, 1);
+    thread.stack.push(good->maxLocals, good->maxStack);
+    threaded.execute(&thread, good);
+    EXPECT_EQ(3, thread.stack.topFrame->operandStack->popInt());
+    EXPECT_EQ(nullptr, good->decodedMethod);  // not the classic engine
+  }
+  {
+    // the classic engine checks the stack
+    Thread thread;
+    thread.stack.push(0, 1);
+    thread.stack.push(bad->maxLocals, bad->maxStack);
+    EXPECT_THROW(threaded.execute(&thread, bad), coconut::utils::JVMPanic);
+    EXPECT_NE(nullptr, bad->decodedMethod);
+  }
+
+  delete bad;
+  delete good;
+}